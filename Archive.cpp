@@ -0,0 +1,743 @@
+/**********************************************************
+ * File: Archive.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the archives from Archive.h.  Creating one writes
+ * the header, hands every file to compressFilesInto to fill in the
+ * entries, then appends the directory of the files that succeeded.  A
+ * deduplicated archive is written by a ChunkedArchiveWriter instead,
+ * which chunks the files on the calling thread and compresses the new
+ * chunks on a pool.  Extracting gives each entry to a task of its own
+ * that seeks straight to its chunks, so entries are decompressed side
+ * by side.
+ */
+
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include "Archive.h"
+#include "BinaryIO.h"
+#include "Checksum.h"
+#include "Chunking.h"
+#include "ThreadPool.h"
+#include "error.h"
+#include "filelib.h"
+#include "map.h"
+
+/* Constants: ARCHIVE_MAGIC, ARCHIVE_WHOLE_FILES, ARCHIVE_CHUNKED
+ * The number that starts and ends every archive ("HUFA"), and the
+ *   versions of the format, one of which follows the first: entries
+ *   stored whole, and entries made of deduplicated chunks.
+ */
+static const unsigned long ARCHIVE_MAGIC = 0x48554641UL;
+static const int ARCHIVE_WHOLE_FILES = 1;
+static const int ARCHIVE_CHUNKED = 2;
+
+/* Constants: ARCHIVE_HEADER_BYTES, ARCHIVE_TRAILER_BYTES
+ * The sizes of the header and of the trailer: the directory's offset
+ *   (8 bytes), the number of entries (4) and the magic number (4).
+ */
+static const int ARCHIVE_HEADER_BYTES = 5;
+static const int ARCHIVE_TRAILER_BYTES = 16;
+
+/* Constant: MAX_ENTRY_NAME
+ * The longest name an entry may have, which must fit in two bytes.
+ */
+static const int MAX_ENTRY_NAME = 0xFFFF;
+
+/* Constant: CHUNK_READ_SIZE
+ * How much of a file is read at a time for chunking.
+ */
+static const long CHUNK_READ_SIZE = 1024 * 1024;
+
+/* Function: isSafeEntryName
+ * Usage: if (isSafeEntryName(name)) ...
+ * --------------------------------------------------------
+ * Returns whether name can be extracted without escaping the directory
+ * it is extracted into: it must be relative and have no ".." part.
+ * Names are checked both when an archive is made and when it is read,
+ * since an archive may come from anywhere.
+ */
+static bool isSafeEntryName(const std::string& name) {
+    if (name.empty() || name.length() > MAX_ENTRY_NAME || name[0] == '/') return false;
+    size_t start = 0;
+    while (start <= name.length()) {
+        size_t end = name.find('/', start);
+        if (end == std::string::npos) end = name.length();
+        if (name.compare(start, end - start, "..") == 0) return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+/* Function: listArchiveInputs
+ * Usage: listArchiveInputs(path, files);
+ * --------------------------------------------------------
+ * Walks directories depth first, adding their files in the order
+ * listDirectory gives them.  A path that does not exist is added
+ * anyway, so that it fails, and is reported, like any unreadable file.
+ */
+void listArchiveInputs(const std::string& path, Vector<std::string>& files) {
+    if (!isDirectory(path)) {
+        files.add(path);
+        return;
+    }
+    Vector<std::string> names;
+    listDirectory(path, names);
+    std::string prefix = path;
+    if (prefix[prefix.length() - 1] != '/') prefix += "/";
+    foreach (std::string name in names) {
+        std::string child = prefix + name;
+        if (isSymbolicLink(child)) continue;
+        if (isDirectory(child) || isFile(child)) listArchiveInputs(child, files);
+    }
+}
+
+/* Function: writeArchiveDirectory
+ * Usage: writeArchiveDirectory(outfile, jobs, directoryOffset);
+ * --------------------------------------------------------
+ * Writes the directory entry of every job that succeeded, then the
+ * trailer.
+ */
+static void writeArchiveDirectory(std::ostream& outfile, const Vector<FileCompressionJob>& jobs,
+                                  long long directoryOffset) {
+    int numEntries = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        const FileCompressionJob& job = jobs[i];
+        if (!job.succeeded) continue;
+        writeNumber(outfile, job.outputName.length(), 2);
+        outfile << job.outputName;
+        writeNumber(outfile, job.outputOffset, 8);
+        writeNumber(outfile, job.outputSize, 8);
+        writeNumber(outfile, job.stats.uncompressedBytes, 8);
+        writeNumber(outfile, job.checksum, 4);
+        numEntries++;
+    }
+    writeNumber(outfile, directoryOffset, 8);
+    writeNumber(outfile, numEntries, 4);
+    writeNumber(outfile, ARCHIVE_MAGIC, 4);
+}
+
+/* Type: ArchiveChunkTask
+ * A new chunk to compress on a pool thread.  Once done is set, under
+ *   the writer's lock, its output, checksum, statistics and any error
+ *   are ready.
+ */
+struct ArchiveChunkTask : public ThreadPoolTask {
+    std::string input;
+    const CompressionOptions* options;
+    Lock* doneLock;
+    CompressionStats* owner;      // of the first file found to hold it
+    std::string output;
+    std::string errorMessage;
+    unsigned long checksum;
+    CompressionStats stats;
+    bool done;
+
+    void run() {
+        checksum = crc32(input.data(), input.length());
+        try {
+            std::istringstream source(input);
+            std::ostringstream sink;
+            compress(source, sink, *options, &stats);
+            output = sink.str();
+        } catch (ErrorException& ex) {
+            errorMessage = ex.getMessage();
+        } catch (std::exception& ex) {
+            errorMessage = ex.what();
+        }
+        std::string().swap(input);
+        synchronized (*doneLock) {
+            done = true;
+            doneLock->signal();
+        }
+    }
+};
+
+/* Class: ChunkedArchiveWriter
+ * --------------------------------------------------------
+ * Writes the chunks of a deduplicated archive.  The calling thread
+ * reads and chunks each file and looks every chunk up by its hash;
+ * only chunks never seen before go to the pool to be compressed, and
+ * they are written to the archive in the order they were found, while
+ * no more than maxBufferedBytes of them wait.  Every chunk is
+ * compressed on its own, on one thread, so it can be decompressed
+ * alone.
+ */
+class ChunkedArchiveWriter {
+public:
+    ChunkedArchiveWriter(std::ostream& archive, const CompressionOptions& options);
+    ~ChunkedArchiveWriter();
+
+    /* Member function: addFile
+     * Usage: writer.addFile(input, chunkIds, stats);
+     * --------------------------------------------------------
+     * Chunks the rest of input, adding the index of each of its chunks
+     * to chunkIds.  The statistics of compressing the chunks it was the
+     * first to hold are added to stats as they are written.  Reports an
+     * error if the input cannot be read.
+     */
+    void addFile(std::istream& input, Vector<int>& chunkIds, CompressionStats& stats);
+
+    /* Member function: finish
+     * Usage: writer.finish();
+     * --------------------------------------------------------
+     * Writes every chunk still waiting.  Reports an error if any chunk
+     * could not be compressed or written, which spoils the whole
+     * archive rather than one file.
+     */
+    void finish();
+
+    /* Member functions: chunk, chunkChecksum, numChunks
+     * Usage: ArchiveChunk chunk = writer.chunk(id);
+     * --------------------------------------------------------
+     * Once finished, tell where each chunk went and what its checksum
+     * is, and how many there are.
+     */
+    const ArchiveChunk& chunk(int id) const;
+    unsigned long chunkChecksum(int id) const;
+    int numChunks() const;
+
+private:
+    std::ostream& archive;
+    long long position;
+    CompressionOptions chunkOptions;
+    long long maxBufferedBytes;
+    long long bufferedBytes;
+    std::string failure;                      // the first chunk that failed
+    Map<std::string, int> chunkIds;           // by hash
+    Vector<ArchiveChunk> chunks;
+    Vector<unsigned long> checksums;
+
+    // the lock and the tasks are declared first so that they outlive
+    //   the pool, whose destructor waits for any tasks still running
+    Lock doneLock;
+    Vector<ArchiveChunkTask*> tasks;
+    Queue<int> pending;                       // not yet written, in order
+    ThreadPool pool;
+
+    void addChunk(const char* data, long length, Vector<int>& ids, CompressionStats& stats);
+    void writeChunks(bool mustWait);
+};
+
+/* Constructor: ChunkedArchiveWriter
+ * --------------------------------------------------------
+ * Starts writing after the header.  Every chunk is compressed on a
+ * single thread, since the pool is what spreads them over the threads;
+ * an empty input is compressed here first, so that bad options are
+ * reported before any work is done.
+ */
+ChunkedArchiveWriter::ChunkedArchiveWriter(std::ostream& archive, const CompressionOptions& options)
+    : archive(archive), pool(options.numThreads > 0 ? options.numThreads : defaultThreadCount()) {
+    position = ARCHIVE_HEADER_BYTES;
+    chunkOptions = options;
+    chunkOptions.numThreads = 1;
+    int numThreads = (options.numThreads > 0) ? options.numThreads : defaultThreadCount();
+    maxBufferedBytes = (options.maxBufferedBytes > 0) ? options.maxBufferedBytes
+                                                      : 2LL * numThreads * CHUNK_MAX_SIZE;
+    bufferedBytes = 0;
+    std::istringstream nothing("");
+    std::ostringstream ignored;
+    compress(nothing, ignored, options);
+}
+
+/* Destructor: ~ChunkedArchiveWriter
+ * --------------------------------------------------------
+ * Deletes the tasks once the pool has finished them.
+ */
+ChunkedArchiveWriter::~ChunkedArchiveWriter() {
+    pool.waitForAll();
+    for (int i = 0; i < tasks.size(); i++) {
+        delete tasks[i];
+    }
+}
+
+/* Member function: addFile
+ * --------------------------------------------------------
+ * Keeps at least CHUNK_MAX_SIZE bytes ahead of the next cut, as
+ * findChunkEnd needs, reading a CHUNK_READ_SIZE piece at a time.
+ */
+void ChunkedArchiveWriter::addFile(std::istream& input, Vector<int>& ids, CompressionStats& stats) {
+    std::string buffer;
+    long start = 0;
+    bool atEnd = false;
+    while (failure.empty()) {
+        long available = long(buffer.length()) - start;
+        if (!atEnd && available < CHUNK_MAX_SIZE) {
+            buffer.erase(0, start);
+            start = 0;
+            buffer.resize(available + CHUNK_READ_SIZE);
+            input.read(&buffer[available], CHUNK_READ_SIZE);
+            buffer.resize(available + input.gcount());
+            if (input.bad()) error("Cannot read the file.");
+            atEnd = !input;
+            continue;
+        }
+        if (available == 0) break;
+        long length = findChunkEnd(buffer.data() + start, available);
+        addChunk(buffer.data() + start, length, ids, stats);
+        start += length;
+    }
+}
+
+/* Member function: addChunk
+ * Usage: addChunk(data, length, ids, stats);
+ * --------------------------------------------------------
+ * Looks the chunk up by two 64-bit hashes and its length, and starts
+ * compressing it only if it is new.
+ */
+void ChunkedArchiveWriter::addChunk(const char* data, long length, Vector<int>& ids,
+                                    CompressionStats& stats) {
+    ContentHash first(0), second(ARCHIVE_MAGIC);
+    first.update(data, length);
+    second.update(data, length);
+    std::ostringstream key;
+    key << std::hex << first.digest() << ":" << second.digest() << ":" << length;
+    if (chunkIds.containsKey(key.str())) {
+        ids.add(chunkIds[key.str()]);
+        return;
+    }
+
+    int id = chunks.size();
+    ArchiveChunk chunk;
+    chunk.offset = chunk.compressedSize = 0;
+    chunk.size = length;
+    chunks.add(chunk);
+    checksums.add(0);
+    chunkIds.put(key.str(), id);
+    ids.add(id);
+
+    ArchiveChunkTask* task = new ArchiveChunkTask;
+    task->input.assign(data, length);
+    task->options = &chunkOptions;
+    task->doneLock = &doneLock;
+    task->owner = &stats;
+    task->checksum = 0;
+    task->done = false;
+    tasks.add(task);
+    pending.enqueue(id);
+    bufferedBytes += length;
+    pool.submit(task);
+    writeChunks(bufferedBytes > maxBufferedBytes);
+}
+
+/* Member function: writeChunks
+ * Usage: writeChunks(mustWait);
+ * --------------------------------------------------------
+ * Writes the chunks at the front of pending that are done, waiting for
+ * them while mustWait is set and too much is buffered.  A failure is
+ * kept for finish to report, so that it is not taken for a failure of
+ * the file being read.
+ */
+void ChunkedArchiveWriter::writeChunks(bool mustWait) {
+    while (!pending.isEmpty()) {
+        ArchiveChunkTask* task = tasks[pending.peek()];
+        bool done = false;
+        synchronized (doneLock) {
+            while (mustWait && bufferedBytes > maxBufferedBytes && !task->done) {
+                doneLock.wait();
+            }
+            done = task->done;
+        }
+        if (!done) break;
+
+        int id = pending.dequeue();
+        if (!task->errorMessage.empty() && failure.empty()) failure = task->errorMessage;
+        archive.write(task->output.data(), task->output.length());
+        chunks[id].offset = position;
+        chunks[id].compressedSize = task->output.length();
+        checksums[id] = task->checksum;
+        task->owner->add(task->stats);
+        position += task->output.length();
+        bufferedBytes -= chunks[id].size;
+        std::string().swap(task->output);
+    }
+    if (!archive && failure.empty()) failure = "Cannot write the output.";
+}
+
+/* Member function: finish
+ * --------------------------------------------------------
+ * Waits for and writes every chunk.
+ */
+void ChunkedArchiveWriter::finish() {
+    maxBufferedBytes = 0;
+    writeChunks(true);
+    if (!failure.empty()) error(failure);
+}
+
+/* Member functions: chunk, chunkChecksum, numChunks
+ * --------------------------------------------------------
+ * Look the answers up.
+ */
+const ArchiveChunk& ChunkedArchiveWriter::chunk(int id) const {
+    return chunks[id];
+}
+
+unsigned long ChunkedArchiveWriter::chunkChecksum(int id) const {
+    return checksums[id];
+}
+
+int ChunkedArchiveWriter::numChunks() const {
+    return chunks.size();
+}
+
+/* Function: writeChunkedArchive
+ * Usage: writeChunkedArchive(archive, jobs, options);
+ * --------------------------------------------------------
+ * Writes the chunks of every job's file after the header, then the
+ * chunk index, the directory of the files that succeeded, and the
+ * trailer.  Each file's checksum is put together from its chunks'.
+ */
+static void writeChunkedArchive(std::ostream& archive, Vector<FileCompressionJob>& jobs,
+                                const CompressionOptions& options) {
+    ChunkedArchiveWriter writer(archive, options);
+    Vector< Vector<int> > chunkLists(jobs.size());
+    for (int i = 0; i < jobs.size(); i++) {
+        FileCompressionJob& job = jobs[i];
+        job.stats = CompressionStats();
+        std::ifstream input(job.inputName.c_str(), std::ios::binary);
+        if (!input.is_open()) {
+            job.errorMessage = "Cannot open the file.";
+            continue;
+        }
+        try {
+            writer.addFile(input, chunkLists[i], job.stats);
+            job.succeeded = true;
+        } catch (ErrorException& ex) {
+            job.errorMessage = ex.getMessage();
+        }
+    }
+    writer.finish();
+
+    long long directoryOffset = ARCHIVE_HEADER_BYTES;
+    writeNumber(archive, writer.numChunks(), 4);
+    for (int id = 0; id < writer.numChunks(); id++) {
+        const ArchiveChunk& chunk = writer.chunk(id);
+        writeNumber(archive, chunk.offset, 8);
+        writeNumber(archive, chunk.compressedSize, 4);
+        writeNumber(archive, chunk.size, 4);
+    }
+    if (writer.numChunks() > 0) {
+        const ArchiveChunk& last = writer.chunk(writer.numChunks() - 1);
+        directoryOffset = last.offset + last.compressedSize;
+    }
+
+    int numEntries = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        FileCompressionJob& job = jobs[i];
+        if (!job.succeeded) continue;
+        long long size = 0;
+        job.checksum = 0;
+        foreach (int id in chunkLists[i]) {
+            size += writer.chunk(id).size;
+            job.checksum = crc32Combine(job.checksum, writer.chunkChecksum(id), writer.chunk(id).size);
+        }
+
+        // the chunks were recorded as they were compressed, so the job
+        //   only says how much of the file took how much new space
+        job.outputSize = job.stats.compressedBytes;
+        job.stats.uncompressedBytes = size;
+        job.stats.operations = 1;
+        writeNumber(archive, job.outputName.length(), 2);
+        archive << job.outputName;
+        writeNumber(archive, size, 8);
+        writeNumber(archive, job.checksum, 4);
+        writeNumber(archive, chunkLists[i].size(), 4);
+        foreach (int id in chunkLists[i]) {
+            writeNumber(archive, id, 4);
+        }
+        numEntries++;
+    }
+    writeNumber(archive, directoryOffset, 8);
+    writeNumber(archive, numEntries, 4);
+    writeNumber(archive, ARCHIVE_MAGIC, 4);
+}
+
+/* Function: createArchive
+ * Usage: int numFailed = createArchive(archiveName, jobs, options, deduplicate);
+ * --------------------------------------------------------
+ * Drops the leading slashes of absolute names, as tar does, turns away
+ * the jobs whose names still cannot be stored, compresses the rest into
+ * the archive after its header, and appends the directory.
+ */
+int createArchive(const std::string& archiveName, Vector<FileCompressionJob>& jobs,
+                  const CompressionOptions& options, bool deduplicate) {
+    Vector<FileCompressionJob> accepted;
+    Vector<int> positions;
+    Map<std::string, bool> taken;
+    for (int i = 0; i < jobs.size(); i++) {
+        FileCompressionJob& job = jobs[i];
+        job.succeeded = false;
+        size_t start = job.outputName.find_first_not_of('/');
+        if (start != std::string::npos) job.outputName.erase(0, start);
+        if (!isSafeEntryName(job.outputName)) {
+            job.errorMessage = "Name cannot be stored in an archive.";
+        } else if (taken.containsKey(job.outputName)) {
+            job.errorMessage = "Archive already has an entry named " + job.outputName + ".";
+        } else {
+            taken.put(job.outputName, true);
+            accepted.add(job);
+            positions.add(i);
+        }
+    }
+
+    std::ofstream archive(archiveName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!archive.is_open()) error("Cannot create " + archiveName + ".");
+    writeNumber(archive, ARCHIVE_MAGIC, 4);
+    archive.put(char(deduplicate ? ARCHIVE_CHUNKED : ARCHIVE_WHOLE_FILES));
+    try {
+        if (deduplicate) {
+            writeChunkedArchive(archive, accepted, options);
+            archive.close();
+        } else {
+            archive.close();
+            if (archive.fail()) error("Cannot write the output.");
+            long long directoryOffset = compressFilesInto(accepted, archiveName,
+                                                          ARCHIVE_HEADER_BYTES, options);
+            archive.open(archiveName.c_str(), std::ios::out | std::ios::binary | std::ios::app);
+            writeArchiveDirectory(archive, accepted, directoryOffset);
+            archive.close();
+        }
+        if (archive.fail()) error("Cannot write the output.");
+    } catch (ErrorException&) {
+        remove(archiveName.c_str());
+        throw;
+    }
+
+    for (int i = 0; i < accepted.size(); i++) {
+        jobs[positions[i]] = accepted[i];
+    }
+    int numFailed = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        if (!jobs[i].succeeded) numFailed++;
+    }
+    return numFailed;
+}
+
+/* Function: readEntryName
+ * Usage: readEntryName(archive, name);
+ * --------------------------------------------------------
+ * Reads an entry's name and the two-byte length before it.  Reports an
+ * error if the name would be extracted outside the directory it is
+ * extracted into.
+ */
+static void readEntryName(std::istream& archive, std::string& name) {
+    int length = int(readNumber(archive, 2));
+    name.resize(length);
+    if (length > 0) archive.read(&name[0], length);
+    if (length > 0 && archive.gcount() != length) error("Archive has a damaged directory.");
+    if (!isSafeEntryName(name)) error("Archive has a damaged directory.");
+}
+
+/* Function: readWholeFileEntries
+ * Usage: readWholeFileEntries(archive, directoryOffset, numEntries, entries);
+ * --------------------------------------------------------
+ * Reads the directory of an archive whose entries are stored whole,
+ * giving each entry a single chunk, and checks that every entry lies
+ * between the header and the directory.
+ */
+static void readWholeFileEntries(std::istream& archive, long long directoryOffset,
+                                 long numEntries, Vector<ArchiveEntry>& entries) {
+    for (long i = 0; i < numEntries; i++) {
+        ArchiveEntry entry;
+        readEntryName(archive, entry.name);
+        ArchiveChunk chunk;
+        chunk.offset = readNumber(archive, 8);
+        chunk.compressedSize = readNumber(archive, 8);
+        chunk.size = entry.size = readNumber(archive, 8);
+        entry.checksum = (unsigned long) readNumber(archive, 4);
+        if (chunk.offset < ARCHIVE_HEADER_BYTES || chunk.compressedSize < 0 ||
+            chunk.offset + chunk.compressedSize > directoryOffset) {
+            error("Archive has a damaged directory.");
+        }
+        entry.compressedSize = chunk.compressedSize;
+        entry.chunks.add(chunk);
+        entries.add(entry);
+    }
+}
+
+/* Function: readChunkedEntries
+ * Usage: readChunkedEntries(archive, tableOffset, numEntries, entries);
+ * --------------------------------------------------------
+ * Reads the chunk index and directory of a deduplicated archive,
+ * checking that every chunk lies between the header and the index and
+ * that every entry refers only to chunks there are, which add up to its
+ * size.
+ */
+static void readChunkedEntries(std::istream& archive, long long tableOffset,
+                               long numEntries, Vector<ArchiveEntry>& entries) {
+    long numChunks = long(readNumber(archive, 4));
+    Vector<ArchiveChunk> chunks;
+    for (long i = 0; i < numChunks && archive; i++) {
+        ArchiveChunk chunk;
+        chunk.offset = readNumber(archive, 8);
+        chunk.compressedSize = readNumber(archive, 4);
+        chunk.size = readNumber(archive, 4);
+        if (chunk.offset < ARCHIVE_HEADER_BYTES || chunk.offset + chunk.compressedSize > tableOffset) {
+            error("Archive has a damaged directory.");
+        }
+        chunks.add(chunk);
+    }
+    for (long i = 0; i < numEntries && archive; i++) {
+        ArchiveEntry entry;
+        readEntryName(archive, entry.name);
+        entry.size = readNumber(archive, 8);
+        entry.checksum = (unsigned long) readNumber(archive, 4);
+        entry.compressedSize = 0;
+        long numRefs = long(readNumber(archive, 4));
+        long long size = 0;
+        for (long j = 0; j < numRefs && archive; j++) {
+            long long id = readNumber(archive, 4);
+            if (id >= chunks.size()) error("Archive has a damaged directory.");
+            entry.chunks.add(chunks[int(id)]);
+            entry.compressedSize += chunks[int(id)].compressedSize;
+            size += chunks[int(id)].size;
+        }
+        if (size != entry.size) error("Archive has a damaged directory.");
+        entries.add(entry);
+    }
+}
+
+/* Function: readArchiveDirectory
+ * Usage: readArchiveDirectory(archiveName, entries);
+ * --------------------------------------------------------
+ * Checks the header, finds the directory from the trailer, and reads it
+ * in whichever version the header gives.
+ */
+void readArchiveDirectory(const std::string& archiveName, Vector<ArchiveEntry>& entries) {
+    std::ifstream archive(archiveName.c_str(), std::ios::binary);
+    if (!archive.is_open()) error("Cannot open the file.");
+    archive.seekg(0, std::ios::end);
+    long long size = archive.tellg();
+    archive.seekg(0, std::ios::beg);
+    if (size < ARCHIVE_HEADER_BYTES + ARCHIVE_TRAILER_BYTES ||
+        readNumber(archive, 4) != ARCHIVE_MAGIC) {
+        error("Not an archive.");
+    }
+    int version = archive.get();
+    if (version != ARCHIVE_WHOLE_FILES && version != ARCHIVE_CHUNKED) {
+        error("Archive is of an unknown version.");
+    }
+
+    archive.seekg(size - ARCHIVE_TRAILER_BYTES);
+    long long directoryOffset = readNumber(archive, 8);
+    long numEntries = long(readNumber(archive, 4));
+    if (readNumber(archive, 4) != ARCHIVE_MAGIC) error("Archive is truncated.");
+    if (directoryOffset < ARCHIVE_HEADER_BYTES || directoryOffset > size - ARCHIVE_TRAILER_BYTES) {
+        error("Archive has a damaged directory.");
+    }
+
+    archive.seekg(directoryOffset);
+    entries.clear();
+    if (version == ARCHIVE_WHOLE_FILES) {
+        readWholeFileEntries(archive, directoryOffset, numEntries, entries);
+    } else {
+        readChunkedEntries(archive, directoryOffset, numEntries, entries);
+    }
+    if (!archive || archive.tellg() != size - ARCHIVE_TRAILER_BYTES) {
+        error("Archive has a damaged directory.");
+    }
+}
+
+/* Type: ArchiveExtractTask
+ * One entry to extract on a pool thread.  Errors stay in the job rather
+ *   than going to the pool, so that every entry is tried.
+ */
+struct ArchiveExtractTask : public ThreadPoolTask {
+    const std::string* archiveName;
+    ArchiveEntry entry;
+    FileCompressionJob* job;
+
+    void run() {
+        std::ofstream output;
+        try {
+            std::ifstream archive(archiveName->c_str(), std::ios::binary);
+            if (!archive.is_open()) error("Cannot open the archive.");
+            output.open(job->outputName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!output.is_open()) error("Cannot create " + job->outputName + ".");
+            ChecksumStream checked(output);
+            foreach (ArchiveChunk chunk in entry.chunks) {
+                CompressionStats stats;
+                archive.seekg(chunk.offset);
+                decompressLeveled(archive, checked, &stats);
+                job->stats.add(stats);
+                if (archive.tellg() != chunk.offset + chunk.compressedSize) {
+                    error("Entry is not the size the directory gives.");
+                }
+            }
+            checked.flush();
+            if (checked.length() != entry.size || checked.checksum() != entry.checksum) {
+                error("Entry does not match its checksum.");
+            }
+            output.close();
+            if (output.fail() || checked.fail()) error("Cannot write the output.");
+            job->succeeded = true;
+        } catch (ErrorException& ex) {
+            job->errorMessage = ex.getMessage();
+        } catch (std::exception& ex) {
+            job->errorMessage = ex.what();
+        }
+        if (!job->succeeded) {
+            if (output.is_open()) output.close();
+            remove(job->outputName.c_str());
+        }
+    }
+};
+
+/* Function: extractArchive
+ * Usage: int numFailed = extractArchive(archiveName, jobs, numThreads);
+ * --------------------------------------------------------
+ * Looks up every job's entry, creates the directories the outputs go
+ * in on this thread, where creating the same one twice cannot race,
+ * then extracts the entries on the pool.
+ */
+int extractArchive(const std::string& archiveName, Vector<FileCompressionJob>& jobs,
+                   int numThreads) {
+    Vector<ArchiveEntry> entries;
+    readArchiveDirectory(archiveName, entries);
+    Map<std::string, int> byName;
+    for (int i = 0; i < entries.size(); i++) {
+        byName.put(entries[i].name, i);
+    }
+
+    Vector<ArchiveExtractTask*> tasks;
+    ThreadPool pool(numThreads > 0 ? numThreads : defaultThreadCount());
+    for (int i = 0; i < jobs.size(); i++) {
+        FileCompressionJob& job = jobs[i];
+        job.succeeded = false;
+        job.stats = CompressionStats();
+        if (!byName.containsKey(job.inputName)) {
+            job.errorMessage = "Archive has no entry named " + job.inputName + ".";
+            continue;
+        }
+        std::string directory = getHead(job.outputName);
+        try {
+            if (!directory.empty() && !isDirectory(directory)) createDirectoryPath(directory);
+        } catch (ErrorException& ex) {
+            job.errorMessage = ex.getMessage();
+            continue;
+        }
+        ArchiveExtractTask* task = new ArchiveExtractTask;
+        task->archiveName = &archiveName;
+        task->entry = entries[byName[job.inputName]];
+        task->job = &job;
+        job.outputOffset = task->entry.chunks.isEmpty() ? 0 : task->entry.chunks[0].offset;
+        job.outputSize = task->entry.compressedSize;
+        job.checksum = task->entry.checksum;
+        tasks.add(task);
+        pool.submit(task);
+    }
+    pool.waitForAll();
+    for (int i = 0; i < tasks.size(); i++) {
+        delete tasks[i];
+    }
+
+    int numFailed = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        if (!jobs[i].succeeded) numFailed++;
+    }
+    return numFailed;
+}
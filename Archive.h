@@ -0,0 +1,113 @@
+/*******************************************************
+ * File: Archive.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Archives that hold many compressed files in one, so that a directory
+ * tree becomes a single file instead of thousands of .huf files, each
+ * with its own header and its own open and close.  An archive is laid
+ * out as
+ *
+ *   - a header: ARCHIVE_MAGIC and the format version,
+ *   - the entries, each compressed as compress with options writes it,
+ *     one after another,
+ *   - the central directory: for each entry its name, where it starts,
+ *     its compressed and original sizes and the CRC-32 of its contents,
+ *   - a trailer giving where the directory starts and how many entries
+ *     it has, followed by ARCHIVE_MAGIC again.
+ *
+ * The directory comes last so that the entries can be written as they
+ * are compressed, on many threads at once, by compressFilesInto.  A
+ * reader finds it from the trailer at the end, and can then go straight
+ * to any entry without reading the others, so entries are extracted in
+ * parallel, and a few of them as cheaply as all.
+ *
+ * A deduplicated archive (version 2) stores chunks rather than whole
+ * files.  Every file is cut into chunks by content (see Chunking.h),
+ * and each distinct chunk is compressed and stored once, however many
+ * files contain it; a chunk seen before is recognized by its hash and
+ * skipped before any work is spent compressing it.  The directory then
+ * starts with a chunk index giving where each chunk is and its sizes,
+ * and each entry lists the chunks it is made of, in order.  Reading an
+ * archive turns the entries of either version into lists of chunks, an
+ * entry of version 1 being a single chunk.
+ */
+
+#ifndef Archive_Included
+#define Archive_Included
+
+#include "BatchCompression.h"
+#include "vector.h"
+#include <string>
+
+/* Type: ArchiveChunk
+ * A piece of the compressed data of an archive, compressed as compress
+ *   with options writes a file.
+ */
+struct ArchiveChunk {
+    long long offset;            // where it starts
+    long long compressedSize;
+    long long size;              // once decompressed
+};
+
+/* Type: ArchiveEntry
+ * What the central directory says about one entry.
+ */
+struct ArchiveEntry {
+    std::string name;
+    long long compressedSize;    // of its chunks, shared or not
+    long long size;              // once decompressed
+    unsigned long checksum;      // CRC-32 of its contents
+    Vector<ArchiveChunk> chunks; // its contents, in order
+};
+
+/* Function: listArchiveInputs
+ * Usage: listArchiveInputs(path, files);
+ * --------------------------------------------------------
+ * Adds path to files if it is not a directory, and otherwise every
+ * file beneath it, in order of name.  Symbolic links found inside a
+ * directory are skipped, so that the walk cannot loop.
+ */
+void listArchiveInputs(const std::string& path, Vector<std::string>& files);
+
+/* Function: createArchive
+ * Usage: int numFailed = createArchive(archiveName, jobs, options, deduplicate);
+ * --------------------------------------------------------
+ * Writes an archive of the job's input files, compressed with the
+ * options, storing each under the job's outputName without its leading
+ * slashes, and storing each distinct chunk only once if deduplicate is
+ * set.  A file that cannot be read or compressed, or whose name is
+ * unsafe to extract (with a ".." part) or already taken, is left out:
+ * its job records the error.  Returns how many jobs failed.  Reports an
+ * error, removing the archive, if it cannot be written or the options
+ * are out of range.
+ */
+int createArchive(const std::string& archiveName, Vector<FileCompressionJob>& jobs,
+                  const CompressionOptions& options, bool deduplicate = false);
+
+/* Function: readArchiveDirectory
+ * Usage: readArchiveDirectory(archiveName, entries);
+ * --------------------------------------------------------
+ * Fills entries from the archive's central directory, in the order the
+ * entries were stored.  Reports an error if the file cannot be opened,
+ * is not an intact archive, or has an entry whose name is unsafe to
+ * extract.
+ */
+void readArchiveDirectory(const std::string& archiveName, Vector<ArchiveEntry>& entries);
+
+/* Function: extractArchive
+ * Usage: int numFailed = extractArchive(archiveName, jobs, numThreads);
+ * --------------------------------------------------------
+ * Extracts the entry named by each job's inputName into the file named
+ * by its outputName, creating any directories it needs, using
+ * numThreads threads (0 for one per processor).  An entry that is
+ * missing, cannot be written, or does not match its checksum fails on
+ * its own: its job records the error and its output is removed.  The
+ * stats of each job describe its decompression.  Returns how many jobs
+ * failed.  Reports an error if the directory cannot be read.
+ */
+int extractArchive(const std::string& archiveName, Vector<FileCompressionJob>& jobs,
+                   int numThreads);
+
+#endif
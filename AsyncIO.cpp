@@ -0,0 +1,465 @@
+/**********************************************************
+ * File: AsyncIO.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the asynchronous file I/O backends from
+ * AsyncIO.h.
+ *
+ * The io_uring backend talks to the kernel through the raw system
+ * calls and the shared rings they map, as liburing does, so that it
+ * needs nothing beyond the kernel's own header.  Only the submitting
+ * thread moves the tail of the submission ring and only the completion
+ * thread moves the head of the completion ring.  The destructor wakes
+ * the completion thread with a no-op request whose user data is zero.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(HUFFMAN_USE_IO_URING) && defined(__linux__)
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define HUFFMAN_IO_URING_AVAILABLE
+#endif
+
+#include "AsyncIO.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
+#include "error.h"
+
+/* Constant: DEFAULT_IO_THREADS
+ * How many threads the threaded backend runs blocking calls on when it
+ *   stands in for io_uring.
+ */
+static const int DEFAULT_IO_THREADS = 4;
+
+/* Constant: IO_BUFFER_ALIGNMENT
+ * Buffers start on a page boundary, as direct I/O would need.
+ */
+static const size_t IO_BUFFER_ALIGNMENT = 4096;
+
+/* Constructor: AsyncFileIO
+ * --------------------------------------------------------
+ * Allocates the buffers, all free to begin with.
+ */
+AsyncFileIO::AsyncFileIO(Lock& completionLock, int numBuffers, long bufferSize)
+    : completionLock(completionLock) {
+    if (numBuffers < 1 || bufferSize < 1) error("I/O buffers must not be empty.");
+    size = bufferSize;
+    inFlight = 0;
+    for (int i = 0; i < numBuffers; i++) {
+        void* memory = NULL;
+        if (posix_memalign(&memory, IO_BUFFER_ALIGNMENT, bufferSize) != 0) {
+            error("Cannot allocate I/O buffers.");
+        }
+        buffers.add((char*) memory);
+        freeBuffers.add(numBuffers - 1 - i);
+    }
+}
+
+/* Destructor: ~AsyncFileIO
+ * --------------------------------------------------------
+ * Frees the buffers.  Backends have stopped their threads by now.
+ */
+AsyncFileIO::~AsyncFileIO() {
+    for (int i = 0; i < buffers.size(); i++) {
+        free(buffers[i]);
+    }
+}
+
+/* Member function: submit
+ * --------------------------------------------------------
+ * Counts the request, then lets the backend start it.
+ */
+void AsyncFileIO::submit(IORequest* request) {
+    inFlight++;
+    start(request);
+}
+
+/* Member function: complete
+ * --------------------------------------------------------
+ * Queues the request, then signals under the completion lock, so that
+ * a thread that saw no completions while holding that lock is already
+ * waiting when the signal comes.
+ */
+void AsyncFileIO::complete(IORequest* request) {
+    synchronized (completedLock) {
+        completed.enqueue(request);
+    }
+    synchronized (completionLock) {
+        completionLock.signal();
+    }
+}
+
+/* Member functions: takeCompleted, hasCompleted, numInFlight
+ * --------------------------------------------------------
+ * Read the queue of completed requests under its own lock.
+ */
+IORequest* AsyncFileIO::takeCompleted() {
+    IORequest* request = NULL;
+    synchronized (completedLock) {
+        if (!completed.isEmpty()) request = completed.dequeue();
+    }
+    if (request != NULL) inFlight--;
+    return request;
+}
+
+bool AsyncFileIO::hasCompleted() {
+    bool any = false;
+    synchronized (completedLock) {
+        any = !completed.isEmpty();
+    }
+    return any;
+}
+
+int AsyncFileIO::numInFlight() const {
+    return inFlight;
+}
+
+/* Member functions: takeBuffer, releaseBuffer, buffer, bufferSize
+ * --------------------------------------------------------
+ * The free buffers are kept as a stack of indices.
+ */
+int AsyncFileIO::takeBuffer() {
+    if (freeBuffers.isEmpty()) return -1;
+    int index = freeBuffers[freeBuffers.size() - 1];
+    freeBuffers.remove(freeBuffers.size() - 1);
+    return index;
+}
+
+void AsyncFileIO::releaseBuffer(int index) {
+    freeBuffers.add(index);
+}
+
+char* AsyncFileIO::buffer(int index) {
+    return buffers[index];
+}
+
+long AsyncFileIO::bufferSize() const {
+    return size;
+}
+
+/* Class: ThreadedFileIO
+ * --------------------------------------------------------
+ * The backend that runs each request as a blocking call on a pool
+ * thread.
+ */
+class ThreadedFileIO : public AsyncFileIO {
+public:
+    ThreadedFileIO(Lock& completionLock, int numBuffers, long bufferSize, int numThreads)
+        : AsyncFileIO(completionLock, numBuffers, bufferSize), pool(numThreads) {
+    }
+
+    /* The pool is a member, so it finishes every request still running
+     * before the buffers are freed.
+     */
+    ~ThreadedFileIO() {
+    }
+
+    const char* name() const {
+        return "threads";
+    }
+
+protected:
+    void start(IORequest* request);
+
+private:
+    ThreadPool pool;
+
+    /* Class: FileIOTask
+     * One request on its way through the pool.  The task deletes
+     *   itself once the request is complete.
+     */
+    class FileIOTask : public ThreadPoolTask {
+    public:
+        ThreadedFileIO* io;
+        IORequest* request;
+        void run();
+    };
+};
+
+/* Member function: start
+ * --------------------------------------------------------
+ * Hands the request to the pool.
+ */
+void ThreadedFileIO::start(IORequest* request) {
+    FileIOTask* task = new FileIOTask;
+    task->io = this;
+    task->request = request;
+    pool.submit(task);
+}
+
+/* Member function: run
+ * --------------------------------------------------------
+ * Transfers the whole length, carrying on after short transfers and
+ * interrupted calls, and stopping at the end of the file or at an
+ * error.
+ */
+void ThreadedFileIO::FileIOTask::run() {
+    TRACE_SCOPE(request->write ? "pwrite" : "pread");
+    char* data = io->buffer(request->buffer);
+    long done = 0;
+    long failure = 0;
+    while (done < request->length) {
+        ssize_t count = request->write
+            ? pwrite(request->fd, data + done, request->length - done, request->offset + done)
+            : pread(request->fd, data + done, request->length - done, request->offset + done);
+        if (count < 0 && errno == EINTR) continue;
+        if (count < 0) failure = -errno;
+        if (count <= 0) break;
+        done += count;
+    }
+    request->result = (failure != 0) ? failure : done;
+
+    // the request is handed back last, since the task is gone after that
+    ThreadedFileIO* backend = io;
+    IORequest* finished = request;
+    delete this;
+    backend->complete(finished);
+}
+
+/* Function: newThreadedFileIO
+ * Usage: AsyncFileIO* io = newThreadedFileIO(lock, numBuffers, bufferSize, numThreads);
+ * --------------------------------------------------------
+ * Makes the threaded backend.
+ */
+AsyncFileIO* newThreadedFileIO(Lock& completionLock, int numBuffers, long bufferSize,
+                               int numThreads) {
+    return new ThreadedFileIO(completionLock, numBuffers, bufferSize, numThreads);
+}
+
+#ifdef HUFFMAN_IO_URING_AVAILABLE
+
+/* Class: URingFileIO
+ * --------------------------------------------------------
+ * The io_uring backend.  Buffers are registered with the ring when the
+ * kernel allows it, so that requests can use the fixed-buffer reads and
+ * writes; otherwise plain reads and writes are used.
+ */
+class URingFileIO : public AsyncFileIO {
+public:
+    URingFileIO(Lock& completionLock, int numBuffers, long bufferSize);
+    ~URingFileIO();
+
+    /* Member function: isReady
+     * Usage: if (io->isReady()) ...
+     * --------------------------------------------------------
+     * Returns whether the ring was set up.
+     */
+    bool isReady() const;
+
+    const char* name() const {
+        return "io_uring";
+    }
+
+protected:
+    void start(IORequest* request);
+
+private:
+    int ringFd;
+    bool fixedBuffers;
+    void* submissionRing;
+    size_t submissionRingSize;
+    void* completionRing;
+    size_t completionRingSize;
+    io_uring_sqe* entries;
+    size_t entriesSize;
+    volatile unsigned* submissionTail;
+    unsigned* submissionMask;
+    unsigned* submissionArray;
+    volatile unsigned* completionHead;
+    volatile unsigned* completionTail;
+    unsigned* completionMask;
+    io_uring_cqe* completions;
+    Thread completionThread;
+
+    void queueEntry(unsigned char opcode, IORequest* request);
+    static void runCompletions(URingFileIO& io);
+};
+
+/* Constructor: URingFileIO
+ * --------------------------------------------------------
+ * Sets up a ring with room for a request per buffer plus the closing
+ * no-op, maps its three shared areas, registers the buffers and starts
+ * the completion thread.  On any failure the ring is left unset, for
+ * newAsyncFileIO to fall back on threads.
+ */
+URingFileIO::URingFileIO(Lock& completionLock, int numBuffers, long bufferSize)
+    : AsyncFileIO(completionLock, numBuffers, bufferSize) {
+    ringFd = -1;
+    fixedBuffers = false;
+    submissionRing = completionRing = entries = NULL;
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = int(syscall(__NR_io_uring_setup, numBuffers + 1, &params));
+    if (fd < 0) return;
+
+    submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && completionRingSize > submissionRingSize) submissionRingSize = completionRingSize;
+    submissionRing = mmap(NULL, submissionRingSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    completionRing = singleMap ? submissionRing
+                   : mmap(NULL, completionRingSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* mappedEntries = mmap(NULL, entriesSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (submissionRing == MAP_FAILED || completionRing == MAP_FAILED || mappedEntries == MAP_FAILED) {
+        if (submissionRing != MAP_FAILED) munmap(submissionRing, submissionRingSize);
+        if (!singleMap && completionRing != MAP_FAILED) munmap(completionRing, completionRingSize);
+        if (mappedEntries != MAP_FAILED) munmap(mappedEntries, entriesSize);
+        submissionRing = completionRing = NULL;
+        close(fd);
+        return;
+    }
+    entries = (io_uring_sqe*) mappedEntries;
+
+    char* sq = (char*) submissionRing;
+    char* cq = (char*) completionRing;
+    submissionTail = (unsigned*) (sq + params.sq_off.tail);
+    submissionMask = (unsigned*) (sq + params.sq_off.ring_mask);
+    submissionArray = (unsigned*) (sq + params.sq_off.array);
+    completionHead = (unsigned*) (cq + params.cq_off.head);
+    completionTail = (unsigned*) (cq + params.cq_off.tail);
+    completionMask = (unsigned*) (cq + params.cq_off.ring_mask);
+    completions = (io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    Vector<iovec> vectors;
+    for (int i = 0; i < numBuffers; i++) {
+        iovec vector;
+        vector.iov_base = buffers[i];
+        vector.iov_len = bufferSize;
+        vectors.add(vector);
+    }
+    fixedBuffers = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                           &vectors[0], numBuffers) == 0;
+
+    ringFd = fd;
+    completionThread = fork(runCompletions, *this);
+}
+
+/* Destructor: ~URingFileIO
+ * --------------------------------------------------------
+ * Sends the no-op that stops the completion thread, then unmaps and
+ * closes the ring.  Closing it also releases the registered buffers.
+ */
+URingFileIO::~URingFileIO() {
+    if (ringFd < 0) return;
+    queueEntry(IORING_OP_NOP, NULL);
+    join(completionThread);
+    munmap(entries, entriesSize);
+    if (completionRing != submissionRing) munmap(completionRing, completionRingSize);
+    munmap(submissionRing, submissionRingSize);
+    close(ringFd);
+}
+
+bool URingFileIO::isReady() const {
+    return ringFd >= 0;
+}
+
+/* Member function: start
+ * --------------------------------------------------------
+ * Queues a read or write of the request's buffer.
+ */
+void URingFileIO::start(IORequest* request) {
+    unsigned char opcode;
+    if (fixedBuffers) {
+        opcode = request->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    } else {
+        opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    queueEntry(opcode, request);
+}
+
+/* Member function: queueEntry
+ * Usage: queueEntry(opcode, request);
+ * --------------------------------------------------------
+ * Fills in the next submission entry and tells the kernel about it.
+ * The entry is written before the tail moves past it.  There is always
+ * room, since no more requests are in flight than there are buffers.
+ * The kernel refuses new entries with EAGAIN or EBUSY while it is short
+ * of resources or the completion queue is full; then the completion
+ * thread is given the processor to reap completions before trying
+ * again.
+ */
+void URingFileIO::queueEntry(unsigned char opcode, IORequest* request) {
+    unsigned tail = *submissionTail;
+    unsigned index = tail & *submissionMask;
+    io_uring_sqe& entry = entries[index];
+    memset(&entry, 0, sizeof(entry));
+    entry.opcode = opcode;
+    entry.user_data = (unsigned long long) (size_t) request;
+    if (request != NULL) {
+        entry.fd = request->fd;
+        entry.off = request->offset;
+        entry.addr = (unsigned long long) (size_t) buffer(request->buffer);
+        entry.len = request->length;
+        if (fixedBuffers) entry.buf_index = request->buffer;
+    } else {
+        entry.fd = -1;
+    }
+    submissionArray[index] = index;
+    __sync_synchronize();
+    *submissionTail = tail + 1;
+    __sync_synchronize();
+    while (syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0) < 0) {
+        if (errno == EAGAIN || errno == EBUSY) {
+            sched_yield();
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+}
+
+/* Function: runCompletions
+ * --------------------------------------------------------
+ * The body of the completion thread: sleeps in the kernel until a
+ * request completes, then hands back every completed request, until
+ * the no-op from the destructor comes back.  The entry is copied before
+ * the head moves past it.
+ */
+void URingFileIO::runCompletions(URingFileIO& io) {
+    TRACE_THREAD_NAME("io_uring completions");
+    while (true) {
+        unsigned head = *io.completionHead;
+        __sync_synchronize();
+        if (head == *io.completionTail) {
+            syscall(__NR_io_uring_enter, io.ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            continue;
+        }
+        io_uring_cqe entry = io.completions[head & *io.completionMask];
+        __sync_synchronize();
+        *io.completionHead = head + 1;
+
+        IORequest* request = (IORequest*) (size_t) entry.user_data;
+        if (request == NULL) break;
+        request->result = entry.res;
+        io.complete(request);
+    }
+}
+
+#endif
+
+/* Function: newAsyncFileIO
+ * Usage: AsyncFileIO* io = newAsyncFileIO(lock, numBuffers, bufferSize);
+ * --------------------------------------------------------
+ * Tries io_uring first when it is compiled in.
+ */
+AsyncFileIO* newAsyncFileIO(Lock& completionLock, int numBuffers, long bufferSize) {
+#ifdef HUFFMAN_IO_URING_AVAILABLE
+    URingFileIO* ring = new URingFileIO(completionLock, numBuffers, bufferSize);
+    if (ring->isReady()) return ring;
+    delete ring;
+#endif
+    return newThreadedFileIO(completionLock, numBuffers, bufferSize, DEFAULT_IO_THREADS);
+}
@@ -0,0 +1,152 @@
+/*******************************************************
+ * File: AsyncIO.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Asynchronous reads and writes of many files at once, so that a batch
+ * of files is not compressed at the pace of one blocking read after
+ * another.  Requests are submitted and later come back completed, in
+ * whatever order the storage finishes them.  All data passes through a
+ * fixed set of buffers owned by the backend, which the kernel can pin
+ * once rather than on every request.
+ *
+ * There are two backends:
+ *
+ *   - io_uring, on Linux, when compiled with HUFFMAN_USE_IO_URING.  The
+ *     buffers are registered with the ring, requests are queued to the
+ *     kernel without a system call each, and a completion thread hands
+ *     back finished requests.
+ *
+ *   - A ThreadPool whose threads each run a blocking pread or pwrite.
+ *     This works everywhere and is used whenever io_uring is not
+ *     compiled in or the kernel refuses to set up a ring.
+ */
+
+#ifndef AsyncIO_Included
+#define AsyncIO_Included
+
+#include "thread.h"
+#include "queue.h"
+#include "vector.h"
+
+/* Type: IORequest
+ * One read or write.  The caller fills in everything but result, and
+ *   the request must stay alive until it comes back from takeCompleted.
+ */
+struct IORequest {
+    int fd;
+    bool write;
+    long long offset;     // in the file
+    int buffer;           // which of the backend's buffers holds the data
+    long length;          // at most the backend's buffer size
+    long result;          // once complete: bytes transferred, or -errno
+    void* userData;       // for the caller
+};
+
+/* Class: AsyncFileIO
+ * --------------------------------------------------------
+ * The interface both backends share.  Requests may only be submitted,
+ * and buffers taken and released, from one thread at a time.
+ */
+class AsyncFileIO {
+public:
+    virtual ~AsyncFileIO();
+
+    /* Member function: name
+     * Usage: string backend = io->name();
+     * --------------------------------------------------------
+     * Returns "io_uring" or "threads".
+     */
+    virtual const char* name() const = 0;
+
+    /* Member function: submit
+     * Usage: io->submit(request);
+     * --------------------------------------------------------
+     * Starts a request.  When it completes, it is queued for
+     * takeCompleted and the completion lock is signalled.
+     */
+    void submit(IORequest* request);
+
+    /* Member functions: takeCompleted, hasCompleted, numInFlight
+     * Usage: IORequest* done = io->takeCompleted();
+     * --------------------------------------------------------
+     * Take the oldest completed request, or return NULL if none has
+     * completed; tell whether one has; and count the requests submitted
+     * and not yet taken.  None of them waits.  To sleep until a request
+     * completes, wait on the completion lock while hasCompleted is
+     * false.
+     */
+    IORequest* takeCompleted();
+    bool hasCompleted();
+    int numInFlight() const;
+
+    /* Member functions: takeBuffer, releaseBuffer, buffer, bufferSize
+     * Usage: int index = io->takeBuffer();
+     *        memcpy(io->buffer(index), data, length);
+     *        ...
+     *        io->releaseBuffer(index);
+     * --------------------------------------------------------
+     * Hand out a free buffer's index, or -1 if all are in use; give one
+     * back; find a buffer's memory; and tell how large every buffer is.
+     */
+    int takeBuffer();
+    void releaseBuffer(int index);
+    char* buffer(int index);
+    long bufferSize() const;
+
+protected:
+    /* Constructor: AsyncFileIO
+     * --------------------------------------------------------
+     * Allocates numBuffers buffers of bufferSize bytes each, aligned to
+     * a page.  completionLock is signalled whenever a request completes.
+     */
+    AsyncFileIO(Lock& completionLock, int numBuffers, long bufferSize);
+
+    /* Member function: start
+     * --------------------------------------------------------
+     * Has the backend start a request.
+     */
+    virtual void start(IORequest* request) = 0;
+
+    /* Member function: complete
+     * --------------------------------------------------------
+     * Called by the backend, on any thread, once a request has its
+     * result.
+     */
+    void complete(IORequest* request);
+
+    Vector<char*> buffers;
+
+private:
+    Lock& completionLock;
+    Lock completedLock;               // guards completed
+    Queue<IORequest*> completed;
+    Vector<int> freeBuffers;
+    long size;
+    int inFlight;
+
+    /* A backend owns threads and buffers, so it must not be copied. */
+    AsyncFileIO(const AsyncFileIO&);
+    AsyncFileIO& operator=(const AsyncFileIO&);
+};
+
+/* Function: newAsyncFileIO
+ * Usage: AsyncFileIO* io = newAsyncFileIO(lock, numBuffers, bufferSize);
+ * --------------------------------------------------------
+ * Returns the best backend available: io_uring if it was compiled in
+ * and the kernel supports it, and threads otherwise.  The caller must
+ * delete it, once every request has been taken back.
+ */
+AsyncFileIO* newAsyncFileIO(Lock& completionLock, int numBuffers, long bufferSize);
+
+/* Function: newThreadedFileIO
+ * Usage: AsyncFileIO* io = newThreadedFileIO(lock, numBuffers, bufferSize, numThreads);
+ * --------------------------------------------------------
+ * Returns the backend that runs blocking calls on numThreads threads,
+ * whatever else is available.
+ */
+AsyncFileIO* newThreadedFileIO(Lock& completionLock, int numBuffers, long bufferSize,
+                               int numThreads);
+
+#endif
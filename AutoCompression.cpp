@@ -0,0 +1,302 @@
+/**********************************************************
+ * File: AutoCompression.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of automatic codec selection from AutoCompression.h.
+ *
+ * File format (all numbers big-endian):
+ *   - 4 bytes holding the magic number "AUTO".
+ *   - For each block: 1 byte holding its BlockCodec, 4 bytes holding
+ *     its original size, 4 bytes holding its compressed size, and then
+ *     the compressed bytes themselves.
+ *   - 1 byte holding END_OF_BLOCKS.
+ */
+
+#include <sstream>
+#include "AutoCompression.h"
+#include "HuffmanEncoding.h"
+#include "LZWEncoding.h"
+#include "RunLengthEncoding.h"
+#include "BinaryIO.h"
+#include "error.h"
+
+/* Constants: AUTO_MAGIC, END_OF_BLOCKS
+ * The magic number at the start of the file and the byte that takes
+ *   the place of a codec after the last block.
+ */
+static const unsigned long AUTO_MAGIC = 0x4155544F;   // "AUTO"
+static const int END_OF_BLOCKS = 0xFF;
+
+/* Constants: LZW_SAMPLE_SLICES, LZW_SAMPLE_SLICE_BYTES
+ * The LZW estimate compresses this many evenly spaced slices of the
+ *   block, each this long.  Blocks no longer than all of the slices put
+ *   together are simply compressed whole.
+ */
+static const int LZW_SAMPLE_SLICES = 4;
+static const long LZW_SAMPLE_SLICE_BYTES = 8 * 1024;
+
+/* Constants: RLE_THROUGHPUT, HUFFMAN_THROUGHPUT, LZW_THROUGHPUT
+ * Compression speeds, in megabytes of input per second, measured on
+ *   tomSawyer, spl.jar and dikdik.jpg from test/encodeDecode and rounded
+ *   down.  Both Huffman encoding and LZW write their output a bit at a
+ *   time through obstream, which is what limits their speed.
+ */
+static const double RLE_THROUGHPUT = 150;
+static const double HUFFMAN_THROUGHPUT = 1.2;
+static const double LZW_THROUGHPUT = 1.5;
+
+/* Constructor: AutoCompressionOptions
+ * --------------------------------------------------------
+ * Defaults to medium-sized blocks and no speed limit.
+ */
+AutoCompressionOptions::AutoCompressionOptions() {
+    blockSize = AUTO_DEFAULT_BLOCK_SIZE;
+    minMegabytesPerSecond = 0;
+}
+
+/* Function: blockCodecName
+ * Usage: string name = blockCodecName(codec);
+ * --------------------------------------------------------
+ * Returns a short name for the codec, such as "huffman".
+ */
+std::string blockCodecName(BlockCodec codec) {
+    switch (codec) {
+        case CODEC_STORED: return "stored";
+        case CODEC_RLE: return "rle";
+        case CODEC_HUFFMAN: return "huffman";
+        case CODEC_LZW: return "lzw";
+    }
+    return "unknown";
+}
+
+/* Function: codecThroughput
+ * Usage: double mbPerSecond = codecThroughput(codec);
+ * --------------------------------------------------------
+ * Looks up the measured speeds above.  Storing only copies bytes, so
+ * it is treated as unlimited.
+ */
+double codecThroughput(BlockCodec codec) {
+    switch (codec) {
+        case CODEC_STORED: return 1e9;
+        case CODEC_RLE: return RLE_THROUGHPUT;
+        case CODEC_HUFFMAN: return HUFFMAN_THROUGHPUT;
+        case CODEC_LZW: return LZW_THROUGHPUT;
+    }
+    return 0;
+}
+
+/* Function: numDigits
+ * Usage: int digits = numDigits(value);
+ * --------------------------------------------------------
+ * Returns how many characters it takes to write a non-negative value
+ *   in decimal.
+ */
+static int numDigits(long value) {
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+/* Function: huffmanCompressedSize
+ * Usage: long size = huffmanCompressedSize(block);
+ * --------------------------------------------------------
+ * Builds the same tree compress would from the block's histogram and
+ *   adds up the bits each byte will take, plus the size of the header
+ *   writeFileHeader writes: the number of distinct bytes, then for each
+ *   one the byte, its count and a space.
+ */
+static long huffmanCompressedSize(const std::string& block) {
+    long counts[256] = { 0 };
+    for (long i = 0; i < block.length(); i++) {
+        counts[(unsigned char)block[i]]++;
+    }
+
+    Map<ext_char, int> frequencies;
+    long headerBytes = 0;
+    for (int ch = 0; ch < 256; ch++) {
+        if (counts[ch] == 0) continue;
+        frequencies.put(ch, counts[ch]);
+        headerBytes += 1 + numDigits(counts[ch]) + 1;
+    }
+    headerBytes += numDigits(frequencies.size()) + 1;
+    frequencies.put(PSEUDO_EOF, 1);
+
+    Node* encodingTree = buildEncodingTree(frequencies);
+    Map<ext_char, int> lengths;
+    encTreeToCodeLengths(encodingTree, lengths, 0);
+    freeTree(encodingTree);
+
+    long long numBits = 0;
+    foreach (ext_char ch in frequencies) {
+        numBits += (long long)frequencies.get(ch) * lengths.get(ch);
+    }
+    return headerBytes + long((numBits + 7) / 8);
+}
+
+/* Function: lzwEstimatedSize
+ * Usage: long size = lzwEstimatedSize(block);
+ * --------------------------------------------------------
+ * Compresses a sample of the block and scales the result up to the
+ *   size of the whole block.  LZW does better the more input it has
+ *   seen, so the estimate leans towards the pessimistic.
+ */
+static long lzwEstimatedSize(const std::string& block) {
+    if (block.length() <= LZW_SAMPLE_SLICES * LZW_SAMPLE_SLICE_BYTES) {
+        return lzwCompress(block).length();
+    }
+
+    std::string sample;
+    long spacing = (block.length() - LZW_SAMPLE_SLICE_BYTES) / (LZW_SAMPLE_SLICES - 1);
+    for (int i = 0; i < LZW_SAMPLE_SLICES; i++) {
+        sample.append(block, i * spacing, LZW_SAMPLE_SLICE_BYTES);
+    }
+    double ratio = double(lzwCompress(sample).length()) / sample.length();
+    return long(ratio * block.length());
+}
+
+/* Function: estimateCompressedSize
+ * Usage: long size = estimateCompressedSize(block, codec);
+ * --------------------------------------------------------
+ * Dispatches to the estimate for each codec.
+ */
+long estimateCompressedSize(const std::string& block, BlockCodec codec) {
+    switch (codec) {
+        case CODEC_STORED: return block.length();
+        case CODEC_RLE: return rleCompressedSize(block);
+        case CODEC_HUFFMAN: return huffmanCompressedSize(block);
+        case CODEC_LZW: return lzwEstimatedSize(block);
+    }
+    error("Unknown block codec.");
+    return 0;
+}
+
+/* Function: chooseBlockCodec
+ * Usage: BlockCodec codec = chooseBlockCodec(block, options);
+ * --------------------------------------------------------
+ * Estimates every codec fast enough for the options, cheapest first,
+ * and keeps the smallest.  Ties go to the faster codec.
+ */
+BlockCodec chooseBlockCodec(const std::string& block,
+                            const AutoCompressionOptions& options) {
+    BlockCodec best = CODEC_STORED;
+    long bestSize = block.length();
+    for (int i = 0; i < NUM_BLOCK_CODECS; i++) {
+        BlockCodec codec = BlockCodec(i);
+        if (codec != CODEC_STORED && codecThroughput(codec) < options.minMegabytesPerSecond) continue;
+
+        long size = estimateCompressedSize(block, codec);
+        if (size < bestSize) {
+            best = codec;
+            bestSize = size;
+        }
+    }
+    return best;
+}
+
+/* Function: compressBlock
+ * Usage: string payload = compressBlock(block, codec);
+ * --------------------------------------------------------
+ * The Huffman codec goes through the bit streams compress expects.
+ */
+std::string compressBlock(const std::string& block, BlockCodec codec) {
+    switch (codec) {
+        case CODEC_STORED: return block;
+        case CODEC_RLE: return rleCompress(block);
+        case CODEC_LZW: return lzwCompress(block);
+        case CODEC_HUFFMAN: {
+            istringbstream infile(block);
+            ostringbstream outfile;
+            compress(infile, outfile);
+            return outfile.str();
+        }
+    }
+    error("Unknown block codec.");
+    return "";
+}
+
+/* Function: decompressBlock
+ * Usage: string block = decompressBlock(payload, codec);
+ * --------------------------------------------------------
+ * The Huffman codec goes through the bit streams decompress expects.
+ */
+std::string decompressBlock(const std::string& payload, BlockCodec codec) {
+    switch (codec) {
+        case CODEC_STORED: return payload;
+        case CODEC_RLE: return rleDecompress(payload);
+        case CODEC_LZW: return lzwDecompress(payload);
+        case CODEC_HUFFMAN: {
+            istringbstream infile(payload);
+            ostringstream outfile;
+            decompress(infile, outfile);
+            return outfile.str();
+        }
+    }
+    error("Unknown block codec.");
+    return "";
+}
+
+/* Function: autoCompress
+ * Usage: autoCompress(infile, outfile, options);
+ * --------------------------------------------------------
+ * Reads, compresses and writes one block at a time, so only a single
+ * block is ever held in memory.
+ */
+void autoCompress(istream& infile, ostream& outfile,
+                  const AutoCompressionOptions& options) {
+    if (options.blockSize < 1 || options.blockSize > 0x7FFFFFFFL) {
+        error("Block size is out of range.");
+    }
+    writeNumber(outfile, AUTO_MAGIC, 4);
+
+    std::string block;
+    while (infile) {
+        block.resize(options.blockSize);
+        infile.read(&block[0], options.blockSize);
+        block.resize(infile.gcount());
+        if (block.empty()) break;
+
+        BlockCodec codec = chooseBlockCodec(block, options);
+        std::string payload = compressBlock(block, codec);
+        if (payload.length() >= block.length()) {
+            codec = CODEC_STORED;
+            payload = block;
+        }
+
+        writeNumber(outfile, codec, 1);
+        writeNumber(outfile, block.length(), 4);
+        writeNumber(outfile, payload.length(), 4);
+        outfile.write(payload.data(), payload.length());
+    }
+    writeNumber(outfile, END_OF_BLOCKS, 1);
+}
+
+/* Function: autoDecompress
+ * Usage: autoDecompress(infile, outfile);
+ * --------------------------------------------------------
+ * Reads one block header at a time and decompresses the block with
+ * the codec it names, checking that it comes out the recorded size.
+ */
+void autoDecompress(istream& infile, ostream& outfile) {
+    if (readNumber(infile, 4) != AUTO_MAGIC) error("File was not written by autoCompress.");
+
+    while (true) {
+        int codec = int(readNumber(infile, 1));
+        if (codec == END_OF_BLOCKS) break;
+        if (codec >= NUM_BLOCK_CODECS) error("Compressed block uses an unknown codec.");
+
+        long originalSize = long(readNumber(infile, 4));
+        long payloadSize = long(readNumber(infile, 4));
+        std::string payload(payloadSize, '\0');
+        if (payloadSize > 0) infile.read(&payload[0], payloadSize);
+        if (infile.gcount() != payloadSize) error("Compressed file is truncated.");
+
+        std::string block = decompressBlock(payload, BlockCodec(codec));
+        if (block.length() != originalSize) error("Compressed block has the wrong size.");
+        outfile.write(block.data(), block.length());
+    }
+}
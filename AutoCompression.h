@@ -0,0 +1,137 @@
+/*******************************************************
+ * File: AutoCompression.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Automatic codec selection.  Rather than asking the user whether a
+ * file should be compressed with Huffman encoding or with LZW, the
+ * input is cut into blocks and each block is cheaply probed to guess
+ * which codec (Huffman, LZW, run-length encoding, or none at all) will
+ * make it smallest.  The codec chosen for each block is recorded in the
+ * block's header, so files with a mix of text and binary data get close
+ * to the best ratio without any tuning.
+ */
+
+#ifndef AutoCompression_Included
+#define AutoCompression_Included
+
+#include <iostream>
+#include <string>
+
+/* Type: BlockCodec
+ * The ways a single block can be stored.  The values are written to
+ *   block headers and must not change.
+ *
+ *   CODEC_STORED  - the bytes as they are.
+ *   CODEC_RLE     - run-length encoded (RunLengthEncoding.h).
+ *   CODEC_HUFFMAN - Huffman encoded with compress (HuffmanEncoding.h).
+ *   CODEC_LZW     - LZW with default options (LZWEncoding.h).
+ */
+enum BlockCodec {
+    CODEC_STORED = 0,
+    CODEC_RLE = 1,
+    CODEC_HUFFMAN = 2,
+    CODEC_LZW = 3
+};
+
+/* Constant: NUM_BLOCK_CODECS
+ * The number of values of BlockCodec.
+ */
+const int NUM_BLOCK_CODECS = 4;
+
+/* Constant: AUTO_DEFAULT_BLOCK_SIZE
+ * The default number of input bytes per block.
+ */
+const long AUTO_DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+/* Type: AutoCompressionOptions
+ * Settings that control automatic compression.
+ */
+struct AutoCompressionOptions {
+    /* The number of input bytes per block. */
+    long blockSize;
+
+    /* The slowest codec speed, in megabytes of input per second, that is
+     * acceptable.  Codecs whose typical speed (see codecThroughput) falls
+     * short are never chosen; storing a block is always allowed.  Zero
+     * allows every codec.
+     */
+    double minMegabytesPerSecond;
+
+    /* Sets blockSize to AUTO_DEFAULT_BLOCK_SIZE and minMegabytesPerSecond
+     * to zero.
+     */
+    AutoCompressionOptions();
+};
+
+/* Function: blockCodecName
+ * Usage: string name = blockCodecName(codec);
+ * --------------------------------------------------------
+ * Returns a short name for the codec, such as "huffman".
+ */
+std::string blockCodecName(BlockCodec codec);
+
+/* Function: codecThroughput
+ * Usage: double mbPerSecond = codecThroughput(codec);
+ * --------------------------------------------------------
+ * Returns the typical compression speed of the codec in megabytes of
+ * input per second, as measured on a single core.
+ */
+double codecThroughput(BlockCodec codec);
+
+/* Function: estimateCompressedSize
+ * Usage: long size = estimateCompressedSize(block, codec);
+ * --------------------------------------------------------
+ * Predicts how many bytes the codec will turn the block into, without
+ * compressing all of it.  The estimates for storing, run-length encoding
+ * and Huffman encoding are exact: the Huffman estimate comes from the
+ * code lengths of a tree built on the block's byte histogram.  The LZW
+ * estimate extrapolates from the ratio LZW achieves on a few slices of
+ * the block.
+ */
+long estimateCompressedSize(const std::string& block, BlockCodec codec);
+
+/* Function: chooseBlockCodec
+ * Usage: BlockCodec codec = chooseBlockCodec(block, options);
+ * --------------------------------------------------------
+ * Returns the codec with the smallest estimated output among those fast
+ * enough for the options.
+ */
+BlockCodec chooseBlockCodec(const std::string& block,
+                            const AutoCompressionOptions& options = AutoCompressionOptions());
+
+/* Function: compressBlock
+ * Usage: string payload = compressBlock(block, codec);
+ * --------------------------------------------------------
+ * Compresses the block with the given codec.
+ */
+std::string compressBlock(const std::string& block, BlockCodec codec);
+
+/* Function: decompressBlock
+ * Usage: string block = decompressBlock(payload, codec);
+ * --------------------------------------------------------
+ * Reverses compressBlock.  Reports an error if the payload is damaged.
+ */
+std::string decompressBlock(const std::string& payload, BlockCodec codec);
+
+/* Function: autoCompress
+ * Usage: autoCompress(infile, outfile, options);
+ * --------------------------------------------------------
+ * Main entry point for automatic compression.  Compresses everything
+ * remaining in infile a block at a time, choosing a codec for each block
+ * with chooseBlockCodec, and writes the result to outfile.  A block the
+ * chosen codec fails to shrink is stored instead.
+ */
+void autoCompress(std::istream& infile, std::ostream& outfile,
+                  const AutoCompressionOptions& options = AutoCompressionOptions());
+
+/* Function: autoDecompress
+ * Usage: autoDecompress(infile, outfile);
+ * --------------------------------------------------------
+ * Main entry point for automatic decompression.  Decompresses a file
+ * written by autoCompress.  Reports an error if the file is damaged.
+ */
+void autoDecompress(std::istream& infile, std::ostream& outfile);
+
+#endif
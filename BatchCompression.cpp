@@ -0,0 +1,646 @@
+/**********************************************************
+ * File: BatchCompression.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the batch compression from BatchCompression.h.  A
+ * LevelBatch cuts the files into the blocks of CompressionLevelsInternal.h
+ * and has a pool compress each with compressLevelBlockAlone, so every
+ * block gets a table of its own, while it reads and writes them through
+ * an AsyncFileIO.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BatchCompression.h"
+#include "CompressionLevelsInternal.h"
+#include "AsyncIO.h"
+#include "BinaryIO.h"
+#include "Checksum.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
+#include "error.h"
+#include "queue.h"
+
+/* Constants: IO_BUFFER_SIZE, MIN_IO_BUFFERS, MAX_IO_BUFFERS
+ * compressFiles reads and writes through buffers of IO_BUFFER_SIZE
+ *   bytes, one for each request in flight.  There are enough of them to
+ *   hold the bytes the options allow to be buffered, within these
+ *   bounds.
+ */
+static const long IO_BUFFER_SIZE = 256 * 1024;
+static const int MIN_IO_BUFFERS = 8;
+static const int MAX_IO_BUFFERS = 256;
+
+/* Type: LevelFile
+ * A file going through a LevelBatch.  It is opened when it is reached
+ *   and closed as soon as it is finished with and has no requests in
+ *   flight, so that only a few files are open at a time.
+ */
+struct LevelFile {
+    const std::string* inputName;
+    const std::string* outputName;
+    int inputFd;                 // -1 while not open
+    int outputFd;
+    long long size;              // of the input, once open
+    long long readOffset;        // where the next block starts
+    long long bytesRequested;    // how much of the input reads were submitted for
+    long long outputStart;       // where the output starts
+    long long writeOffset;       // where the next output goes
+    int readsInFlight;
+    int writesInFlight;
+    bool opened;                 // whether opening the input was tried
+    bool written;                // whether every write was submitted
+    bool failed;
+    std::string errorMessage;
+    unsigned long checksum;      // of the blocks written so far
+    CompressionStats* stats;     // NULL if none are wanted
+};
+
+/* Type: LevelWrite
+ * Compressed output waiting to be written.  It keeps the bytes of its
+ *   block counted as buffered until the last of it has been handed to
+ *   the I/O backend.
+ */
+struct LevelWrite {
+    int file;
+    int fd;
+    long long offset;
+    std::string data;
+    long submitted;
+    long size;
+    bool last;
+};
+
+/* Type: LevelBlockTask
+ * Blocks for a pool thread to compress on their own: one block of a
+ *   large file, or the whole of several small ones.
+ */
+struct LevelBlockTask : public ThreadPoolTask {
+    const LevelSettings* settings;
+    Lock* doneLock;
+    Vector<LevelBlock*> blocks;
+    long size;
+
+    void run() {
+        for (int i = 0; i < blocks.size(); i++) {
+            compressLevelBlockAlone(*blocks[i], *settings);
+        }
+        synchronized (*doneLock) {
+            for (int i = 0; i < blocks.size(); i++) {
+                blocks[i]->done = true;
+            }
+            doneLock->signal();
+        }
+    }
+};
+
+/* Function: isLevelBlockDone
+ * Usage: if (isLevelBlockDone(block, doneLock)) ...
+ * --------------------------------------------------------
+ * Reads the block's done flag under the lock the tasks set it under.
+ */
+static bool isLevelBlockDone(const LevelBlock* block, Lock& doneLock) {
+    bool done = false;
+    synchronized (doneLock) {
+        done = block->done;
+    }
+    return done;
+}
+
+/* Class: LevelBatch
+ * --------------------------------------------------------
+ * Compresses many files on a pool of threads, with every read and
+ * write going through an AsyncFileIO, so that the reads of many files
+ * and blocks are in flight at once.  The calling thread runs the whole
+ * batch: it starts reading blocks while fewer than maxBufferedBytes are
+ * buffered, hands each block to the pool once all of it has arrived,
+ * and writes out every finished block in the order the blocks were
+ * started, which keeps each file's output in order too.  Whole files
+ * smaller than a block are gathered into a single task until the task
+ * holds a block's worth, or until there is nothing else to do, so that
+ * tiny files do not each pay for a trip through the pool.  Buffers go
+ * to writes before reads, so that output drains before more input
+ * comes in.  When there is nothing to do, the thread sleeps until a
+ * task finishes or a request completes, both of which signal doneLock.
+ * Normally each file has an output of its own, but the outputs can all
+ * go into one file instead, each starting where the last one ended.
+ */
+class LevelBatch {
+public:
+    LevelBatch(Vector<LevelFile>& files, const LevelSettings& settings, int level, int numThreads,
+               long long maxBufferedBytes);
+    ~LevelBatch();
+
+    /* Member function: run
+     * Usage: batch.run();
+     * --------------------------------------------------------
+     * Compresses every file, recording the errors in the files.
+     */
+    void run();
+
+    /* Member functions: writeInto, outputEnd
+     * Usage: batch.writeInto(fd, offset);
+     *        batch.run();
+     *        long long end = batch.outputEnd();
+     * --------------------------------------------------------
+     * Have run write every output into fd, one after another from
+     * offset, and checksum each file's input; and tell where the
+     * outputs ended.
+     */
+    void writeInto(int fd, long long offset);
+    long long outputEnd() const;
+
+private:
+    Vector<LevelFile>& files;
+    const LevelSettings& settings;
+    int level;
+    long long maxBufferedBytes;
+
+    // the lock and the tasks are declared first so that they outlive the
+    //   pool, whose destructor waits for any tasks still running
+    Lock doneLock;
+    Vector<LevelBlockTask*> tasks;
+    Queue<LevelBlock*> pending;          // started and not yet written, in order
+    Queue<LevelWrite*> writes;           // not yet handed to the backend, in order
+    long long bufferedBytes;
+    LevelBlockTask* smallFiles;          // small files not yet submitted
+    LevelBlock* reading;                 // the block whose reads are being submitted
+    int current;                         // the file to start the next block in
+    int sharedFd;                        // where every output goes, or -1
+    long long sharedOffset;              // where the next output starts in it
+    AsyncFileIO* io;
+    ThreadPool pool;
+
+    bool finishRequests();
+    bool writeBlocks();
+    bool submitRequests();
+    LevelBlock* startBlock();
+    void compressBlock(LevelBlock* block);
+    void failFile(LevelFile& file, const std::string& message);
+    void closeIfIdle(LevelFile& file);
+};
+
+/* Constructor: LevelBatch
+ * --------------------------------------------------------
+ * Makes the I/O backend, with enough buffers to hold what may be
+ * buffered, and the pool.
+ */
+LevelBatch::LevelBatch(Vector<LevelFile>& files, const LevelSettings& settings, int level,
+                       int numThreads, long long maxBufferedBytes)
+    : files(files), settings(settings), pool(numThreads) {
+    this->level = level;
+    this->maxBufferedBytes = maxBufferedBytes;
+    bufferedBytes = 0;
+    smallFiles = NULL;
+    reading = NULL;
+    current = 0;
+    sharedFd = -1;
+    sharedOffset = 0;
+    long long numBuffers = maxBufferedBytes / IO_BUFFER_SIZE;
+    if (numBuffers < MIN_IO_BUFFERS) numBuffers = MIN_IO_BUFFERS;
+    if (numBuffers > MAX_IO_BUFFERS) numBuffers = MAX_IO_BUFFERS;
+    io = newAsyncFileIO(doneLock, int(numBuffers), IO_BUFFER_SIZE);
+}
+
+/* Destructor: ~LevelBatch
+ * --------------------------------------------------------
+ * run leaves no requests in flight, so the backend can go at once; the
+ * tasks go once the pool has finished them.
+ */
+LevelBatch::~LevelBatch() {
+    delete io;
+    pool.waitForAll();
+    for (int i = 0; i < tasks.size(); i++) {
+        delete tasks[i];
+    }
+}
+
+/* Member functions: writeInto, outputEnd
+ * --------------------------------------------------------
+ * Record the file shared by every output, and report how far it got.
+ */
+void LevelBatch::writeInto(int fd, long long offset) {
+    sharedFd = fd;
+    sharedOffset = offset;
+}
+
+long long LevelBatch::outputEnd() const {
+    return sharedOffset;
+}
+
+/* Member function: run
+ * --------------------------------------------------------
+ * Takes back completed requests, writes finished blocks and submits
+ * new requests for as long as any of them gets anywhere, and sleeps
+ * when none does.  Before sleeping, the small files gathered so far are
+ * submitted, since no more may be coming for a while.
+ */
+void LevelBatch::run() {
+    while (true) {
+        bool progress = finishRequests();
+        if (writeBlocks()) progress = true;
+        if (submitRequests()) progress = true;
+        if (!progress && smallFiles != NULL) {
+            pool.submit(smallFiles);
+            smallFiles = NULL;
+            progress = true;
+        }
+        if (current == files.size() && reading == NULL && pending.isEmpty() &&
+            writes.isEmpty() && io->numInFlight() == 0) {
+            break;
+        }
+        if (progress) continue;
+
+        TRACE_SCOPE("wait");
+        synchronized (doneLock) {
+            while (!io->hasCompleted() && (pending.isEmpty() || !pending.peek()->done)) {
+                doneLock.wait();
+            }
+        }
+    }
+}
+
+/* Member function: finishRequests
+ * Usage: if (finishRequests()) ...
+ * --------------------------------------------------------
+ * Takes back every completed request and frees its buffer.  A read is
+ * copied into its block, which goes on to be compressed once the last
+ * of it arrives; a write may let its file be closed.  Returns whether
+ * any request had completed.
+ */
+bool LevelBatch::finishRequests() {
+    bool progress = false;
+    for (IORequest* request = io->takeCompleted(); request != NULL; request = io->takeCompleted()) {
+        progress = true;
+        if (request->write) {
+            LevelFile& file = *(LevelFile*) request->userData;
+            file.writesInFlight--;
+            if (request->result != request->length) failFile(file, "Cannot write the output.");
+            closeIfIdle(file);
+        } else {
+            LevelBlock* block = (LevelBlock*) request->userData;
+            LevelFile& file = files[block->file];
+            file.readsInFlight--;
+            if (request->result != request->length) {
+                block->errorMessage = "Cannot read the file.";
+            } else {
+                memcpy(&block->input[request->offset - block->start], io->buffer(request->buffer),
+                       request->length);
+            }
+            block->readsLeft--;
+            if (block->readsLeft == 0 && block->submitted == block->size) compressBlock(block);
+            closeIfIdle(file);
+        }
+        io->releaseBuffer(request->buffer);
+        delete request;
+    }
+    return progress;
+}
+
+/* Member function: writeBlocks
+ * Usage: if (writeBlocks()) ...
+ * --------------------------------------------------------
+ * Turns every finished block at the front of pending into a write,
+ * opening its file's output before the first block and adding the file
+ * header and end marker around the first and last.  Blocks of files
+ * that have failed are dropped.  Returns whether any block was.
+ */
+bool LevelBatch::writeBlocks() {
+    bool progress = false;
+    while (!pending.isEmpty() && isLevelBlockDone(pending.peek(), doneLock)) {
+        progress = true;
+        LevelBlock* block = pending.dequeue();
+        LevelFile& file = files[block->file];
+        if (!block->errorMessage.empty()) failFile(file, block->errorMessage);
+        if (!file.failed && block->first && sharedFd >= 0) {
+            file.outputStart = file.writeOffset = sharedOffset;
+        } else if (!file.failed && block->first) {
+            file.outputFd = open(file.outputName->c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (file.outputFd < 0) failFile(file, "Cannot create " + *file.outputName + ".");
+        }
+        if (file.failed) {
+            bufferedBytes -= block->size;
+            delete block;
+            continue;
+        }
+
+        StageTimer timer(file.stats);
+        timer.start(STATS_FLUSH);
+        std::ostringstream data;
+        if (block->first) {
+            writeNumber(data, LEVELS_MAGIC, 4);
+            data.put(char(level));
+        }
+        data.write(block->output.data(), block->output.length());
+        if (block->last) data.put(char(BLOCK_END));
+        if (file.stats != NULL) file.stats->add(block->stats);
+        if (block->wantChecksum) file.checksum = crc32Combine(file.checksum, block->checksum, block->size);
+
+        LevelWrite* write = new LevelWrite;
+        write->file = block->file;
+        write->fd = (sharedFd >= 0) ? sharedFd : file.outputFd;
+        write->offset = file.writeOffset;
+        write->data = data.str();
+        write->submitted = 0;
+        write->size = block->size;
+        write->last = block->last;
+        file.writeOffset += write->data.length();
+        if (sharedFd >= 0) sharedOffset = file.writeOffset;
+        writes.enqueue(write);
+        timer.stop();
+        delete block;
+    }
+    return progress;
+}
+
+/* Member function: submitRequests
+ * Usage: if (submitRequests()) ...
+ * --------------------------------------------------------
+ * Submits a request for every free buffer: first the waiting writes,
+ * then reads of the block being read, starting new blocks while there
+ * is room.  A block is only started in a file that has not failed, and
+ * a block still being read when its file fails is abandoned, so that no
+ * read is ever submitted on a file that may have been closed.  Returns
+ * whether anything was submitted or started.
+ */
+bool LevelBatch::submitRequests() {
+    bool progress = false;
+    while (true) {
+        if (!writes.isEmpty() && files[writes.peek()->file].failed) {
+            bufferedBytes -= writes.peek()->size;
+            delete writes.dequeue();
+            progress = true;
+            continue;
+        }
+        if (writes.isEmpty() && reading != NULL && files[reading->file].failed) {
+            reading->submitted = reading->size;
+            if (reading->readsLeft == 0) compressBlock(reading);
+            reading = NULL;
+            progress = true;
+            continue;
+        }
+        if (writes.isEmpty() && reading == NULL) {
+            if (current == files.size()) break;
+            if (!pending.isEmpty() && bufferedBytes >= maxBufferedBytes) break;
+            reading = startBlock();
+            progress = true;
+            if (reading != NULL && reading->size == 0) reading = NULL;
+            continue;
+        }
+
+        int buffer = io->takeBuffer();
+        if (buffer < 0) break;
+        IORequest* request = new IORequest;
+        request->buffer = buffer;
+        request->result = 0;
+        if (!writes.isEmpty()) {
+            LevelWrite* write = writes.peek();
+            LevelFile& file = files[write->file];
+            long length = write->data.length() - write->submitted;
+            if (length > io->bufferSize()) length = io->bufferSize();
+            memcpy(io->buffer(buffer), write->data.data() + write->submitted, length);
+            request->fd = write->fd;
+            request->write = true;
+            request->offset = write->offset + write->submitted;
+            request->length = length;
+            request->userData = &file;
+            write->submitted += length;
+            file.writesInFlight++;
+            if (write->submitted == (long) write->data.length()) {
+                if (write->last) file.written = true;
+                bufferedBytes -= write->size;
+                delete writes.dequeue();
+            }
+        } else {
+            LevelFile& file = files[reading->file];
+            long length = reading->size - reading->submitted;
+            if (length > io->bufferSize()) length = io->bufferSize();
+            request->fd = file.inputFd;
+            request->write = false;
+            request->offset = reading->start + reading->submitted;
+            request->length = length;
+            request->userData = reading;
+            reading->submitted += length;
+            reading->readsLeft++;
+            file.readsInFlight++;
+            file.bytesRequested += length;
+            if (reading->submitted == reading->size) reading = NULL;
+        }
+        io->submit(request);
+        progress = true;
+    }
+    return progress;
+}
+
+/* Member function: startBlock
+ * Usage: LevelBlock* block = startBlock();
+ * --------------------------------------------------------
+ * Starts the next block of the current file, opening the file first if
+ * need be, and moves on to the next file after its last block.  An
+ * empty block is done at once.  Returns NULL, having moved on, if the
+ * file cannot be opened or has failed.
+ */
+LevelBlock* LevelBatch::startBlock() {
+    LevelFile& file = files[current];
+    if (!file.opened) {
+        file.opened = true;
+        file.inputFd = open(file.inputName->c_str(), O_RDONLY);
+        struct stat status;
+        if (file.inputFd < 0 || fstat(file.inputFd, &status) != 0) {
+            failFile(file, "Cannot open the file.");
+        } else {
+            file.size = status.st_size;
+        }
+    }
+    if (file.failed) {
+        current++;
+        return NULL;
+    }
+
+    LevelBlock* block = new LevelBlock;
+    long long left = file.size - file.readOffset;
+    block->file = current;
+    block->start = file.readOffset;
+    block->size = long(left < settings.blockSize ? left : settings.blockSize);
+    block->first = (block->start == 0);
+    block->last = (block->start + block->size == file.size);
+    block->submitted = 0;
+    block->readsLeft = 0;
+    block->input.resize(block->size);
+    block->wantStats = (file.stats != NULL);
+    block->wantChecksum = (sharedFd >= 0);
+    block->checksum = 0;
+    block->done = (block->size == 0);
+    file.readOffset += block->size;
+    if (block->last) current++;
+    pending.enqueue(block);
+    bufferedBytes += block->size;
+    closeIfIdle(file);
+    return block;
+}
+
+/* Member function: compressBlock
+ * Usage: compressBlock(block);
+ * --------------------------------------------------------
+ * Hands a block that has arrived to the pool, on its own or with other
+ * small files.  A block that could not be read, or whose file has
+ * failed, is done without being compressed.
+ */
+void LevelBatch::compressBlock(LevelBlock* block) {
+    if (!block->errorMessage.empty() || files[block->file].failed) {
+        block->done = true;
+        return;
+    }
+    bool small = block->first && block->last && block->size < settings.blockSize;
+    LevelBlockTask* task = small ? smallFiles : NULL;
+    if (task == NULL) {
+        task = new LevelBlockTask;
+        task->settings = &settings;
+        task->doneLock = &doneLock;
+        task->size = 0;
+        tasks.add(task);
+    }
+    task->blocks.add(block);
+    task->size += block->size;
+    if (small && task->size < settings.blockSize) {
+        smallFiles = task;
+    } else {
+        if (task == smallFiles) smallFiles = NULL;
+        pool.submit(task);
+    }
+}
+
+/* Member function: failFile
+ * Usage: failFile(file, message);
+ * --------------------------------------------------------
+ * Records the first error in a file and removes its output, which is
+ * closed once no writes to it are in flight.
+ */
+void LevelBatch::failFile(LevelFile& file, const std::string& message) {
+    if (file.failed) return;
+    file.failed = true;
+    file.errorMessage = message;
+    if (file.outputFd >= 0) unlink(file.outputName->c_str());
+    closeIfIdle(file);
+}
+
+/* Member function: closeIfIdle
+ * Usage: closeIfIdle(file);
+ * --------------------------------------------------------
+ * Closes the input once every read was submitted and has completed,
+ * and the output once every write has, or either as soon as it is idle
+ * if the file has failed.
+ */
+void LevelBatch::closeIfIdle(LevelFile& file) {
+    if (file.inputFd >= 0 && file.readsInFlight == 0 &&
+        (file.failed || file.bytesRequested == file.size)) {
+        close(file.inputFd);
+        file.inputFd = -1;
+    }
+    if (file.outputFd >= 0 && file.writesInFlight == 0 && (file.failed || file.written)) {
+        bool closed = (close(file.outputFd) == 0);
+        file.outputFd = -1;
+        if (!closed) failFile(file, "Cannot write the output.");
+    }
+}
+
+/* Constructor: FileCompressionJob
+ * --------------------------------------------------------
+ * A job has not succeeded until it has been done.
+ */
+FileCompressionJob::FileCompressionJob() {
+    succeeded = false;
+    outputOffset = outputSize = 0;
+    checksum = 0;
+}
+
+/* Function: compressJobs
+ * Usage: int numFailed = compressJobs(jobs, options, sharedFd, offset);
+ * --------------------------------------------------------
+ * Runs every job through a LevelBatch, into sharedFd from offset unless
+ * sharedFd is -1, then records how each one went and moves offset past
+ * the outputs.  Returns how many jobs failed.
+ */
+static int compressJobs(Vector<FileCompressionJob>& jobs, const CompressionOptions& options,
+                        int sharedFd, long long& offset) {
+    int numThreads;
+    long long maxBufferedBytes;
+    LevelSettings settings = checkCompressionOptions(options, numThreads, maxBufferedBytes);
+
+    Vector<LevelFile> files(jobs.size());
+    for (int i = 0; i < jobs.size(); i++) {
+        LevelFile& file = files[i];
+        file.inputName = &jobs[i].inputName;
+        file.outputName = &jobs[i].outputName;
+        file.inputFd = file.outputFd = -1;
+        file.size = file.readOffset = file.bytesRequested = 0;
+        file.outputStart = file.writeOffset = 0;
+        file.readsInFlight = file.writesInFlight = 0;
+        file.opened = file.written = file.failed = false;
+        file.checksum = 0;
+        jobs[i].stats = CompressionStats();
+        file.stats = &jobs[i].stats;
+    }
+    LevelBatch batch(files, settings, options.level, numThreads, maxBufferedBytes);
+    if (sharedFd >= 0) batch.writeInto(sharedFd, offset);
+    batch.run();
+    if (sharedFd >= 0) offset = batch.outputEnd();
+
+    int numFailed = 0;
+    for (int i = 0; i < jobs.size(); i++) {
+        FileCompressionJob& job = jobs[i];
+        job.succeeded = !files[i].failed;
+        job.errorMessage = files[i].errorMessage;
+        job.outputOffset = files[i].outputStart;
+        job.outputSize = files[i].writeOffset - files[i].outputStart;
+        job.checksum = files[i].checksum;
+        if (job.succeeded) {
+            job.stats.compressedBytes += FILE_HEADER_BYTES;
+            job.stats.headerBytes += FILE_HEADER_BYTES;
+            finishCompressionStats(STATS_COMPRESSION, &job.stats);
+        } else {
+            numFailed++;
+        }
+    }
+    return numFailed;
+}
+
+/* Function: compressFiles
+ * Usage: int numFailed = compressFiles(jobs, options);
+ * --------------------------------------------------------
+ * Compresses each job into its own output.
+ */
+int compressFiles(Vector<FileCompressionJob>& jobs, const CompressionOptions& options) {
+    long long ignored = 0;
+    return compressJobs(jobs, options, -1, ignored);
+}
+
+/* Function: compressFilesInto
+ * Usage: long long end = compressFilesInto(jobs, outputName, offset, options);
+ * --------------------------------------------------------
+ * Opens the shared output, without truncating it, and compresses every
+ * job into it.  The output is closed even if compressing fails.
+ */
+long long compressFilesInto(Vector<FileCompressionJob>& jobs, const std::string& outputName,
+                            long long offset, const CompressionOptions& options) {
+    // check the options before anything is created
+    int numThreads;
+    long long maxBufferedBytes;
+    checkCompressionOptions(options, numThreads, maxBufferedBytes);
+    int fd = open(outputName.c_str(), O_WRONLY | O_CREAT, 0666);
+    if (fd < 0) error("Cannot create " + outputName + ".");
+    try {
+        compressJobs(jobs, options, fd, offset);
+    } catch (ErrorException&) {
+        close(fd);
+        throw;
+    }
+    if (close(fd) != 0) error("Cannot write the output.");
+    return offset;
+}
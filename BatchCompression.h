@@ -0,0 +1,91 @@
+/*******************************************************
+ * File: BatchCompression.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Compressing many files at once, each as compress with options of
+ * CompressionLevels.h does.  One pool of threads is shared among the
+ * blocks of all the files, and the reads and writes of many files are
+ * kept in flight at once through AsyncIO.h, so that neither the threads
+ * nor the storage wait on one file at a time.
+ */
+
+#ifndef BatchCompression_Included
+#define BatchCompression_Included
+
+#include "CompressionLevels.h"
+#include "CompressionStats.h"
+#include "vector.h"
+#include <string>
+
+/* Type: FileCompressionJob
+ * One file for compressFiles or compressFilesInto to compress, and what
+ *   came of it.
+ */
+struct FileCompressionJob {
+    /* The file to read and the file to write.  compressFilesInto ignores
+     * outputName, which archives use as the name of the entry.
+     */
+    std::string inputName;
+    std::string outputName;
+
+    /* Whether the file was compressed, and if not, why. */
+    bool succeeded;
+    std::string errorMessage;
+
+    /* Statistics about the compression, as compress fills in. */
+    CompressionStats stats;
+
+    /* Where the output starts in the file written, how long it is, and
+     * the CRC-32 (see Checksum.h) of the input, for compressFilesInto.
+     * compressFiles sets only outputSize.
+     */
+    long long outputOffset;
+    long long outputSize;
+    unsigned long checksum;
+
+    /* Sets succeeded to false and the sizes to 0. */
+    FileCompressionJob();
+};
+
+/* Function: compressFiles
+ * Usage: int numFailed = compressFiles(jobs, options);
+ * --------------------------------------------------------
+ * Compresses the input file of each job into its output file as
+ * compress with options does on several threads, sharing one pool of
+ * options.numThreads threads among all of them.  The files are cut into
+ * blocks in order, but every read and write is asynchronous, through
+ * io_uring where it is available, so the reads of many blocks and files
+ * and the writes of finished ones all wait on the storage together
+ * rather than one after another.  The blocks of a large file are
+ * spread over the threads, while small files are compressed several to
+ * a task, so neither a few huge files nor thousands of tiny ones leave
+ * threads idle.  Each output is written in order, and no more than
+ * options.maxBufferedBytes of input are held at once.  Every block gets
+ * a table of its own, even with a single thread.
+ *
+ * A file that cannot be read, written or compressed does not stop the
+ * others: its job records the error and its output is removed.  Returns
+ * how many jobs failed.  Reports an error if the options are out of
+ * range.
+ */
+int compressFiles(Vector<FileCompressionJob>& jobs, const CompressionOptions& options);
+
+/* Function: compressFilesInto
+ * Usage: long long end = compressFilesInto(jobs, outputName, offset, options);
+ * --------------------------------------------------------
+ * Compresses the input file of each job as compressFiles does, but
+ * writes every output one after another into the single file
+ * outputName, starting offset bytes in and leaving what comes before
+ * alone.  Each output is complete in itself, as compress with options
+ * writes it, and each job records where it went and the checksum of its
+ * input.  A file that fails partway through leaves its partial output
+ * behind in the file, where nothing refers to it.  Returns the offset
+ * just past the last output.  Reports an error if the options are out
+ * of range or outputName cannot be opened.
+ */
+long long compressFilesInto(Vector<FileCompressionJob>& jobs, const std::string& outputName,
+                            long long offset, const CompressionOptions& options);
+
+#endif
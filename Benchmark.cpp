@@ -0,0 +1,770 @@
+/**********************************************************
+ * File: Benchmark.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the throughput benchmark from Benchmark.h.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include "Benchmark.h"
+#include "BinaryIO.h"
+#include "HuffmanEncoding.h"
+#include "CompressionLevels.h"
+#include "LZWEncoding.h"
+#include "MemoryDiagnostics.h"
+#include "Timing.h"
+#include "filelib.h"
+#include "error.h"
+
+/* Type: Stage
+ * The stages that can be benchmarked, in the order they are run.
+ */
+enum Stage {
+    STAGE_FREQUENCY,
+    STAGE_TREE,
+    STAGE_ENCODE,
+    STAGE_DECODE,
+    STAGE_COMPRESS,
+    STAGE_DECOMPRESS,
+    STAGE_LEVEL_MIN,
+    STAGE_LEVEL_DEFAULT,
+    STAGE_LEVEL_MAX,
+    STAGE_LEVEL_DECOMPRESS,
+    STAGE_LZW_COMPRESS,
+    STAGE_LZW_DECOMPRESS,
+    NUM_STAGES
+};
+
+/* Constant: STAGE_NAMES
+ * The name of each Stage, as it appears in the results.
+ */
+static const char* const STAGE_NAMES[NUM_STAGES] = {
+    "frequency", "tree", "encode", "decode", "compress", "decompress",
+    "level1-compress", "level6-compress", "level9-compress", "level6-decompress",
+    "lzw-compress", "lzw-decompress"
+};
+
+/* Constants: COUNTER_JSON_NAMES, COUNTER_CSV_NAMES
+ * The field names of each PerfCounter per byte in the results.
+ */
+static const char* const COUNTER_JSON_NAMES[NUM_PERF_COUNTERS] = {
+    "cyclesPerByte", "instructionsPerByte", "branchMissesPerByte", "l1dMissesPerByte",
+    "llcMissesPerByte"
+};
+static const char* const COUNTER_CSV_NAMES[NUM_PERF_COUNTERS] = {
+    "cycles_per_byte", "instructions_per_byte", "branch_misses_per_byte", "l1d_misses_per_byte",
+    "llc_misses_per_byte"
+};
+
+/* Constant: MIN_REPETITION_SECONDS
+ * A repetition makes as many passes over the input as it takes to run
+ *   at least this long, judging by the last warmup run.
+ */
+static const double MIN_REPETITION_SECONDS = 0.01;
+
+/* Type: StageInput
+ * An input together with what the later stages start from: its
+ *   frequency table and tree, and its encoded and compressed forms.
+ *   Each is made the first time a stage needs it.
+ */
+struct StageInput {
+    std::string data;
+    Map<ext_char, int> frequencies;
+    Node* tree;
+    std::string encoded;
+    std::string compressed;
+    std::string leveled;
+    std::string lzw;
+};
+
+/* Constructor: BenchmarkOptions
+ * --------------------------------------------------------
+ * Benchmarks the whole test corpus and generated inputs of 1 MB.
+ */
+BenchmarkOptions::BenchmarkOptions() {
+    corpusDirectory = "test/encodeDecode";
+    generatedSize = 1024 * 1024;
+    streamedSize = 0;
+    warmupRuns = 1;
+    repetitions = 5;
+    stageFilter = "";
+    perfCounters = false;
+    countAllocations = false;
+}
+
+/* Function: benchmarkStageNames
+ * Usage: Vector<string> stages = benchmarkStageNames();
+ * --------------------------------------------------------
+ * Copies STAGE_NAMES into a Vector.
+ */
+Vector<std::string> benchmarkStageNames() {
+    Vector<std::string> names;
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        names.add(STAGE_NAMES[stage]);
+    }
+    return names;
+}
+
+/* Function: levelOptions
+ * Usage: compress(infile, outfile, levelOptions(level));
+ * --------------------------------------------------------
+ * Returns compression options for the given level.
+ */
+static CompressionOptions levelOptions(int level) {
+    CompressionOptions options;
+    options.level = level;
+    return options;
+}
+
+/* Function: prepareStage
+ * Usage: prepareStage(stage, input);
+ * --------------------------------------------------------
+ * Makes whatever the stage starts from that the input does not have yet.
+ */
+static void prepareStage(Stage stage, StageInput& input) {
+    if (input.tree == NULL) {
+        std::istringstream source(input.data);
+        input.frequencies = getFrequencyTable(source);
+        input.tree = buildEncodingTree(input.frequencies);
+    }
+    if (stage == STAGE_DECODE && input.encoded.empty()) {
+        std::istringstream source(input.data);
+        ostringbstream encoded;
+        encodeFile(source, input.tree, encoded);
+        input.encoded = encoded.str();
+    }
+    if (stage == STAGE_DECOMPRESS && input.compressed.empty()) {
+        istringbstream source(input.data);
+        ostringbstream compressed;
+        compress(source, compressed);
+        input.compressed = compressed.str();
+    }
+    if (stage == STAGE_LEVEL_DECOMPRESS && input.leveled.empty()) {
+        istringbstream source(input.data);
+        ostringbstream compressed;
+        compress(source, compressed, levelOptions(COMPRESSION_DEFAULT_LEVEL));
+        input.leveled = compressed.str();
+    }
+    if (stage == STAGE_LZW_DECOMPRESS && input.lzw.empty()) {
+        input.lzw = lzwCompress(input.data);
+    }
+}
+
+/* Function: runStage
+ * Usage: runStage(stage, input, verify);
+ * --------------------------------------------------------
+ * Runs the stage once on the input.  If verify is true, the stages that
+ * decode check that they got back the original data.
+ */
+static void runStage(Stage stage, StageInput& input, bool verify) {
+    std::string result;
+    switch (stage) {
+    case STAGE_FREQUENCY: {
+        std::istringstream source(input.data);
+        getFrequencyTable(source);
+        return;
+    }
+    case STAGE_TREE:
+        freeTree(buildEncodingTree(input.frequencies));
+        return;
+    case STAGE_ENCODE: {
+        std::istringstream source(input.data);
+        ostringbstream encoded;
+        encodeFile(source, input.tree, encoded);
+        return;
+    }
+    case STAGE_DECODE: {
+        istringbstream source(input.encoded);
+        std::ostringstream decoded;
+        decodeFile(source, input.tree, decoded);
+        result = decoded.str();
+        break;
+    }
+    case STAGE_COMPRESS:
+    case STAGE_LEVEL_MIN:
+    case STAGE_LEVEL_DEFAULT:
+    case STAGE_LEVEL_MAX: {
+        istringbstream source(input.data);
+        ostringbstream compressed;
+        if (stage == STAGE_COMPRESS) {
+            compress(source, compressed);
+        } else {
+            int level = (stage == STAGE_LEVEL_MIN) ? COMPRESSION_MIN_LEVEL :
+                        (stage == STAGE_LEVEL_DEFAULT) ? COMPRESSION_DEFAULT_LEVEL : COMPRESSION_MAX_LEVEL;
+            compress(source, compressed, levelOptions(level));
+        }
+        return;
+    }
+    case STAGE_DECOMPRESS:
+    case STAGE_LEVEL_DECOMPRESS: {
+        istringbstream source(stage == STAGE_DECOMPRESS ? input.compressed : input.leveled);
+        std::ostringstream decompressed;
+        decompress(source, decompressed);
+        result = decompressed.str();
+        break;
+    }
+    case STAGE_LZW_COMPRESS:
+        lzwCompress(input.data);
+        return;
+    case STAGE_LZW_DECOMPRESS:
+        result = lzwDecompress(input.lzw);
+        break;
+    default:
+        error("Unknown benchmark stage.");
+    }
+    if (verify && result != input.data) {
+        error(std::string("Benchmark stage ") + STAGE_NAMES[stage] + " did not get back its input.");
+    }
+}
+
+/* Function: percentile
+ * Usage: double p90 = percentile(sortedTimes, 90);
+ * --------------------------------------------------------
+ * Returns the nearest-rank percentile of the sorted times.
+ */
+static double percentile(const std::vector<double>& sortedTimes, double percent) {
+    int rank = int(ceil(percent / 100 * sortedTimes.size()));
+    if (rank < 1) rank = 1;
+    return sortedTimes[rank - 1];
+}
+
+/* Function: summarizeTimes
+ * Usage: BenchmarkResult result = summarizeTimes(stage, name, bytes, passes, times);
+ * --------------------------------------------------------
+ * Sorts the times of the repetitions and fills in a result from them.
+ */
+static BenchmarkResult summarizeTimes(const std::string& stage, const std::string& name,
+                                      long long inputBytes, int passes, std::vector<double>& times) {
+    std::sort(times.begin(), times.end());
+
+    BenchmarkResult result;
+    result.stage = stage;
+    result.input = name;
+    result.inputBytes = inputBytes;
+    result.repetitions = times.size();
+    result.passesPerRepetition = passes;
+    result.minSeconds = times.front();
+    result.medianSeconds = percentile(times, 50);
+    result.p90Seconds = percentile(times, 90);
+    result.p99Seconds = percentile(times, 99);
+    result.maxSeconds = times.back();
+    double total = 0;
+    for (int i = 0; i < times.size(); i++) {
+        total += times[i];
+    }
+    result.meanSeconds = total / times.size();
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        result.countersPerByte[i] = -1;
+    }
+    result.allocationsPerPass = -1;
+    result.allocatedBytesPerPass = -1;
+    result.peakLiveBytes = -1;
+    return result;
+}
+
+/* Type: CounterTotals
+ * The counts of each PerfCounter summed over the timed runs, or -1 for
+ *   counters that are not being counted.
+ */
+struct CounterTotals {
+    long long counts[NUM_PERF_COUNTERS];
+
+    CounterTotals() {
+        for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+            counts[i] = -1;
+        }
+    }
+};
+
+/* Functions: startCounting, stopCounting
+ * Usage: startCounting(counters);
+ *        ...
+ *        stopCounting(counters, totals, first);
+ * --------------------------------------------------------
+ * Start the counters and stop them again, adding what they counted to
+ * the totals, or replacing the totals on the first run.  Both do nothing
+ * when counters is NULL.  A counter that fails to read once stays at -1
+ * for the whole stage, so that its total is never an undercount.
+ */
+static void startCounting(PerfCounters* counters) {
+    if (counters != NULL) counters->start();
+}
+
+static void stopCounting(PerfCounters* counters, CounterTotals& totals, bool first) {
+    if (counters == NULL) return;
+    counters->stop();
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        long long count = counters->value(PerfCounter(i));
+        if (first) {
+            totals.counts[i] = count;
+        } else if (count < 0 || totals.counts[i] < 0) {
+            totals.counts[i] = -1;
+        } else {
+            totals.counts[i] += count;
+        }
+    }
+}
+
+/* Function: recordCounters
+ * Usage: recordCounters(result, totals);
+ * --------------------------------------------------------
+ * Divides the totals by the number of bytes the timed passes went
+ * through and stores them in the result.
+ */
+static void recordCounters(BenchmarkResult& result, const CounterTotals& totals) {
+    double bytes = double(result.inputBytes) * result.passesPerRepetition * result.repetitions;
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (totals.counts[i] >= 0 && bytes > 0) {
+            result.countersPerByte[i] = totals.counts[i] / bytes;
+        }
+    }
+}
+
+/* Functions: startAllocationCount, recordAllocations
+ * Usage: bool counting = startAllocationCount(options);
+ *        ...
+ *        recordAllocations(result, counting);
+ * --------------------------------------------------------
+ * Start tracking allocations if the options ask for it and the hook is
+ * there to see them, returning whether tracking started; and stop
+ * tracking, storing what was allocated per pass in the result.
+ */
+static bool startAllocationCount(const BenchmarkOptions& options) {
+    if (!options.countAllocations || !allocationHookInstalled()) return false;
+    startAllocationTracking();
+    return true;
+}
+
+static void recordAllocations(BenchmarkResult& result, bool counting) {
+    if (!counting) return;
+    stopAllocationTracking();
+    AllocationStats stats = totalAllocationStats();
+    double passes = double(result.passesPerRepetition) * result.repetitions;
+    result.allocationsPerPass = stats.allocations / passes;
+    result.allocatedBytesPerPass = stats.bytes / passes;
+    result.peakLiveBytes = stats.peakLiveBytes;
+}
+
+/* Function: timeStage
+ * Usage: BenchmarkResult result = timeStage(stage, input, name, options, counters);
+ * --------------------------------------------------------
+ * Runs the warmup passes, the first of which verifies the output, works
+ * out how many passes make up a repetition from the last of them, and
+ * then times the repetitions, counting events during them unless
+ * counters is NULL, and allocations if the options ask for them.
+ */
+static BenchmarkResult timeStage(Stage stage, StageInput& input, const std::string& name,
+                                 const BenchmarkOptions& options, PerfCounters* counters) {
+    prepareStage(stage, input);
+
+    double lastTime = 0;
+    for (int i = 0; i < options.warmupRuns; i++) {
+        double start = currentTime();
+        runStage(stage, input, i == 0);
+        lastTime = currentTime() - start;
+    }
+    int passes = 1;
+    if (options.warmupRuns > 0 && lastTime < MIN_REPETITION_SECONDS) {
+        passes = (lastTime > 0) ? int(ceil(MIN_REPETITION_SECONDS / lastTime)) : 1000;
+    }
+
+    std::vector<double> times;
+    CounterTotals totals;
+    bool countingAllocations = startAllocationCount(options);
+    for (int i = 0; i < options.repetitions; i++) {
+        startCounting(counters);
+        double start = currentTime();
+        for (int pass = 0; pass < passes; pass++) {
+            runStage(stage, input, options.warmupRuns == 0 && i == 0 && pass == 0);
+        }
+        times.push_back((currentTime() - start) / passes);
+        stopCounting(counters, totals, i == 0);
+    }
+    BenchmarkResult result = summarizeTimes(STAGE_NAMES[stage], name, input.data.length(),
+                                            passes, times);
+    recordCounters(result, totals);
+    recordAllocations(result, countingAllocations);
+    return result;
+}
+
+/* Functions: megabytesPerSecond, nanosecondsPerByte
+ * Usage: double speed = megabytesPerSecond(result);
+ * --------------------------------------------------------
+ * Derive the reported rates from the median, or return 0 when they are
+ * undefined.
+ */
+static double megabytesPerSecond(const BenchmarkResult& result) {
+    if (result.medianSeconds <= 0) return 0;
+    return result.inputBytes / result.medianSeconds / 1e6;
+}
+
+static double nanosecondsPerByte(const BenchmarkResult& result) {
+    if (result.inputBytes == 0) return 0;
+    return result.medianSeconds * 1e9 / result.inputBytes;
+}
+
+/* Function: reportProgress
+ * Usage: reportProgress(progress, result);
+ * --------------------------------------------------------
+ * Writes a line with the result's throughput, unless progress is NULL,
+ * followed by the cycles and instructions per byte and the allocations
+ * per pass if they were counted.
+ */
+static void reportProgress(std::ostream* progress, const BenchmarkResult& result) {
+    if (progress == NULL) return;
+    std::ostringstream line;
+    line << std::setw(20) << std::left << result.input << std::setw(18) << result.stage
+         << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+         << megabytesPerSecond(result) << " MB/s";
+    if (result.countersPerByte[PERF_CYCLES] >= 0) {
+        line << std::setw(10) << result.countersPerByte[PERF_CYCLES] << " cycles/B";
+    }
+    if (result.countersPerByte[PERF_INSTRUCTIONS] >= 0) {
+        line << std::setw(10) << result.countersPerByte[PERF_INSTRUCTIONS] << " instr/B";
+    }
+    if (result.allocationsPerPass >= 0) {
+        line << std::setw(12) << result.allocationsPerPass << " allocs/pass";
+    }
+    *progress << line.str() << std::endl;
+}
+
+/* Function: openCounters
+ * Usage: PerfCounters* counters = openCounters(options);
+ * --------------------------------------------------------
+ * Returns a new set of counters if the options ask for them and at least
+ * one can be used, or NULL otherwise.  The caller deletes them.
+ */
+static PerfCounters* openCounters(const BenchmarkOptions& options) {
+    if (!options.perfCounters) return NULL;
+    PerfCounters* counters = new PerfCounters;
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (counters->isAvailable(PerfCounter(i))) return counters;
+    }
+    delete counters;
+    return NULL;
+}
+
+/* Function: benchmarkInput
+ * Usage: Vector<BenchmarkResult> results = benchmarkInput(name, data, options);
+ * --------------------------------------------------------
+ * Times each selected stage in turn on the one input.
+ */
+Vector<BenchmarkResult> benchmarkInput(const std::string& name, const std::string& data,
+                                       const BenchmarkOptions& options, std::ostream* progress) {
+    if (options.repetitions < 1) error("A benchmark needs at least one repetition.");
+    StageInput input;
+    input.data = data;
+    input.tree = NULL;
+
+    PerfCounters* counters = openCounters(options);
+    Vector<BenchmarkResult> results;
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        std::string stageName = STAGE_NAMES[stage];
+        if (stageName.compare(0, options.stageFilter.length(), options.stageFilter) != 0) continue;
+        try {
+            results.add(timeStage(Stage(stage), input, name, options, counters));
+        } catch (ErrorException&) {
+            freeTree(input.tree);
+            delete counters;
+            throw;
+        }
+        reportProgress(progress, results[results.size() - 1]);
+    }
+    freeTree(input.tree);
+    delete counters;
+    return results;
+}
+
+/* Function: readWholeFile
+ * Usage: string contents = readWholeFile(filename);
+ * --------------------------------------------------------
+ * Returns the contents of the file.
+ */
+static std::string readWholeFile(const std::string& filename) {
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.is_open()) error("Cannot open benchmark input " + filename);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+/* Constant: STREAMED_STAGES
+ * The stages benchmarkCorpus runs, in order.
+ */
+static const Stage STREAMED_STAGES[] = {
+    STAGE_FREQUENCY, STAGE_COMPRESS, STAGE_LEVEL_MIN, STAGE_LEVEL_DEFAULT, STAGE_LEVEL_MAX,
+    STAGE_LZW_COMPRESS
+};
+static const int NUM_STREAMED_STAGES = sizeof STREAMED_STAGES / sizeof STREAMED_STAGES[0];
+
+/* Function: runStreamedStage
+ * Usage: runStreamedStage(stage, spec);
+ * --------------------------------------------------------
+ * Runs the stage once on a fresh stream of the corpus, or just drains
+ * the stream when stage is NUM_STAGES.
+ */
+static void runStreamedStage(int stage, const CorpusSpec& spec) {
+    CorpusStream source(spec);
+    DiscardStream sink;
+    switch (stage) {
+    case STAGE_FREQUENCY:
+        getFrequencyTable(source);
+        break;
+    case STAGE_COMPRESS:
+        compress(source, sink);
+        break;
+    case STAGE_LEVEL_MIN:
+        compress(source, sink, levelOptions(COMPRESSION_MIN_LEVEL));
+        break;
+    case STAGE_LEVEL_DEFAULT:
+        compress(source, sink, levelOptions(COMPRESSION_DEFAULT_LEVEL));
+        break;
+    case STAGE_LEVEL_MAX:
+        compress(source, sink, levelOptions(COMPRESSION_MAX_LEVEL));
+        break;
+    case STAGE_LZW_COMPRESS:
+        lzwCompress(source, sink);
+        break;
+    default:
+        sink << source.rdbuf();
+        break;
+    }
+}
+
+/* Function: timeStreamedStage
+ * Usage: BenchmarkResult result = timeStreamedStage(stage, stageName, name, spec,
+ *                                                   options, counters);
+ * --------------------------------------------------------
+ * Runs the warmup runs and then times the repetitions, counting events
+ * during them unless counters is NULL, and allocations if the options ask
+ * for them.
+ */
+static BenchmarkResult timeStreamedStage(int stage, const std::string& stageName,
+                                         const std::string& name, const CorpusSpec& spec,
+                                         const BenchmarkOptions& options, PerfCounters* counters) {
+    for (int run = 0; run < options.warmupRuns; run++) {
+        runStreamedStage(stage, spec);
+    }
+    std::vector<double> times;
+    CounterTotals totals;
+    bool countingAllocations = startAllocationCount(options);
+    for (int run = 0; run < options.repetitions; run++) {
+        startCounting(counters);
+        double start = currentTime();
+        runStreamedStage(stage, spec);
+        times.push_back(currentTime() - start);
+        stopCounting(counters, totals, run == 0);
+    }
+    BenchmarkResult result = summarizeTimes(stageName, name, spec.size, 1, times);
+    recordCounters(result, totals);
+    recordAllocations(result, countingAllocations);
+    return result;
+}
+
+/* Function: benchmarkCorpus
+ * Usage: Vector<BenchmarkResult> results = benchmarkCorpus(spec, options);
+ * --------------------------------------------------------
+ * Times "generate" first, then each selected streamed stage.
+ */
+Vector<BenchmarkResult> benchmarkCorpus(const CorpusSpec& spec, const BenchmarkOptions& options,
+                                        std::ostream* progress) {
+    if (options.repetitions < 1) error("A benchmark needs at least one repetition.");
+    std::string name = corpusDistributionName(spec.distribution) + "-stream";
+    PerfCounters* counters = openCounters(options);
+    Vector<BenchmarkResult> results;
+    for (int i = -1; i < NUM_STREAMED_STAGES; i++) {
+        int stage = (i < 0) ? int(NUM_STAGES) : int(STREAMED_STAGES[i]);
+        std::string stageName = (i < 0) ? "generate" : STAGE_NAMES[stage];
+        if (stageName.compare(0, options.stageFilter.length(), options.stageFilter) != 0) continue;
+        try {
+            results.add(timeStreamedStage(stage, stageName, name, spec, options, counters));
+        } catch (ErrorException&) {
+            delete counters;
+            throw;
+        }
+        reportProgress(progress, results[results.size() - 1]);
+    }
+    delete counters;
+    return results;
+}
+
+/* Function: runBenchmarks
+ * Usage: Vector<BenchmarkResult> results = runBenchmarks(options, &cout);
+ * --------------------------------------------------------
+ * Benchmarks the corpus files one by one, then the corpus repeated up to
+ * the generated size, one generated input of each distribution, and
+ * finally the streamed inputs.
+ */
+Vector<BenchmarkResult> runBenchmarks(const BenchmarkOptions& options, std::ostream* progress) {
+    if (options.perfCounters && progress != NULL) {
+        PerfCounters counters;
+        std::string reason = counters.unavailableReason();
+        if (!reason.empty()) *progress << "Some performance counters are unavailable: " << reason << std::endl;
+    }
+    Vector<BenchmarkResult> results;
+    std::string corpus;
+    if (!options.corpusDirectory.empty()) {
+        Vector<std::string> files;
+        listDirectory(options.corpusDirectory, files);
+        foreach (std::string file in files) {
+            std::string path = options.corpusDirectory + getDirectoryPathSeparator() + file;
+            if (!isFile(path) || file[0] == '.') continue;
+            std::string data = readWholeFile(path);
+            corpus += data;
+            results += benchmarkInput(file, data, options, progress);
+        }
+    }
+    if (options.generatedSize > 0) {
+        if (!corpus.empty()) {
+            std::string repeated;
+            repeated.reserve(options.generatedSize);
+            while (long(repeated.length()) < options.generatedSize) {
+                repeated.append(corpus, 0, options.generatedSize - repeated.length());
+            }
+            results += benchmarkInput("generated-corpus", repeated, options, progress);
+        }
+        for (int distribution = 0; distribution < NUM_CORPUS_DISTRIBUTIONS; distribution++) {
+            CorpusSpec spec;
+            spec.distribution = CorpusDistribution(distribution);
+            spec.size = options.generatedSize;
+            results += benchmarkInput(corpusDistributionName(spec.distribution), generateCorpus(spec),
+                                      options, progress);
+        }
+    }
+    if (options.streamedSize > 0) {
+        for (int distribution = 0; distribution < NUM_CORPUS_DISTRIBUTIONS; distribution++) {
+            CorpusSpec spec;
+            spec.distribution = CorpusDistribution(distribution);
+            spec.size = options.streamedSize;
+            results += benchmarkCorpus(spec, options, progress);
+        }
+    }
+    return results;
+}
+
+/* Function: jsonString
+ * Usage: outfile << jsonString(name);
+ * --------------------------------------------------------
+ * Quotes the string for JSON, escaping quotes, backslashes and control
+ * characters.
+ */
+static std::string jsonString(const std::string& text) {
+    std::ostringstream quoted;
+    quoted << '"';
+    for (int i = 0; i < text.length(); i++) {
+        unsigned char ch = text[i];
+        if (ch == '"' || ch == '\\') {
+            quoted << '\\' << ch;
+        } else if (ch < 0x20) {
+            quoted << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(ch)
+                   << std::dec << std::setfill(' ');
+        } else {
+            quoted << ch;
+        }
+    }
+    quoted << '"';
+    return quoted.str();
+}
+
+/* Function: writeBenchmarkJSON
+ * Usage: writeBenchmarkJSON(outfile, results);
+ * --------------------------------------------------------
+ * Writes one object per line inside the results array, so the file is
+ * also easy to read and to diff.
+ */
+void writeBenchmarkJSON(std::ostream& outfile, const Vector<BenchmarkResult>& results) {
+    outfile << "{\"results\": [" << std::endl;
+    outfile << std::setprecision(9);
+    for (int i = 0; i < results.size(); i++) {
+        const BenchmarkResult& result = results[i];
+        outfile << "  {\"stage\": " << jsonString(result.stage)
+                << ", \"input\": " << jsonString(result.input)
+                << ", \"bytes\": " << result.inputBytes
+                << ", \"repetitions\": " << result.repetitions
+                << ", \"passes\": " << result.passesPerRepetition
+                << ", \"mbPerSecond\": " << megabytesPerSecond(result)
+                << ", \"nsPerByte\": " << nanosecondsPerByte(result)
+                << ", \"minSeconds\": " << result.minSeconds
+                << ", \"medianSeconds\": " << result.medianSeconds
+                << ", \"p90Seconds\": " << result.p90Seconds
+                << ", \"p99Seconds\": " << result.p99Seconds
+                << ", \"maxSeconds\": " << result.maxSeconds
+                << ", \"meanSeconds\": " << result.meanSeconds;
+        for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+            outfile << ", \"" << COUNTER_JSON_NAMES[counter] << "\": ";
+            if (result.countersPerByte[counter] < 0) {
+                outfile << "null";
+            } else {
+                outfile << result.countersPerByte[counter];
+            }
+        }
+        if (result.allocationsPerPass < 0) {
+            outfile << ", \"allocationsPerPass\": null, \"allocatedBytesPerPass\": null"
+                    << ", \"peakLiveBytes\": null";
+        } else {
+            outfile << ", \"allocationsPerPass\": " << result.allocationsPerPass
+                    << ", \"allocatedBytesPerPass\": " << result.allocatedBytesPerPass
+                    << ", \"peakLiveBytes\": " << result.peakLiveBytes;
+        }
+        outfile << "}"
+                << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    outfile << "]}" << std::endl;
+}
+
+/* Function: csvField
+ * Usage: outfile << csvField(name);
+ * --------------------------------------------------------
+ * Quotes the field if it contains a comma, quote or line break.
+ */
+static std::string csvField(const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) return text;
+    std::string quoted = "\"";
+    for (int i = 0; i < text.length(); i++) {
+        if (text[i] == '"') quoted += '"';
+        quoted += text[i];
+    }
+    return quoted + "\"";
+}
+
+/* Function: writeBenchmarkCSV
+ * Usage: writeBenchmarkCSV(outfile, results);
+ * --------------------------------------------------------
+ * Writes a header row, then one row per result.
+ */
+void writeBenchmarkCSV(std::ostream& outfile, const Vector<BenchmarkResult>& results) {
+    outfile << "stage,input,bytes,repetitions,passes,mb_per_second,ns_per_byte,"
+            << "min_seconds,median_seconds,p90_seconds,p99_seconds,max_seconds,mean_seconds";
+    for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+        outfile << ',' << COUNTER_CSV_NAMES[counter];
+    }
+    outfile << ",allocations_per_pass,allocated_bytes_per_pass,peak_live_bytes" << std::endl;
+    outfile << std::setprecision(9);
+    foreach (BenchmarkResult result in results) {
+        outfile << csvField(result.stage) << ',' << csvField(result.input) << ','
+                << result.inputBytes << ',' << result.repetitions << ','
+                << result.passesPerRepetition << ',' << megabytesPerSecond(result) << ','
+                << nanosecondsPerByte(result) << ',' << result.minSeconds << ','
+                << result.medianSeconds << ',' << result.p90Seconds << ','
+                << result.p99Seconds << ',' << result.maxSeconds << ','
+                << result.meanSeconds;
+        for (int counter = 0; counter < NUM_PERF_COUNTERS; counter++) {
+            outfile << ',';
+            if (result.countersPerByte[counter] >= 0) outfile << result.countersPerByte[counter];
+        }
+        if (result.allocationsPerPass < 0) {
+            outfile << ",,,";
+        } else {
+            outfile << ',' << result.allocationsPerPass << ',' << result.allocatedBytesPerPass
+                    << ',' << result.peakLiveBytes;
+        }
+        outfile << std::endl;
+    }
+}
@@ -0,0 +1,168 @@
+/*******************************************************
+ * File: Benchmark.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A throughput benchmark for the compressor.  Each stage of Huffman
+ * encoding (counting frequencies, building the tree, encoding, decoding),
+ * the complete compress and decompress, the compression levels and LZW
+ * are timed separately on every file in the test corpus and on larger
+ * generated inputs (see CorpusGenerator.h).  Each measurement is repeated
+ * after a warmup run, and the results are reported as throughput, time
+ * per byte and percentiles of the repetitions, in JSON or CSV so that
+ * runs can be compared over time.  On Linux, hardware performance
+ * counters can also be recorded for each stage and reported per byte,
+ * and the allocations each pass makes can be counted (see
+ * MemoryDiagnostics.h), so that a hot loop that starts allocating shows
+ * up as a regression.
+ */
+
+#ifndef Benchmark_Included
+#define Benchmark_Included
+
+#include "CorpusGenerator.h"
+#include "PerfCounters.h"
+#include "vector.h"
+#include <iostream>
+#include <string>
+
+/* Type: BenchmarkOptions
+ * Settings for runBenchmarks.
+ */
+struct BenchmarkOptions {
+    /* The directory whose files are benchmarked, or "" for none. */
+    std::string corpusDirectory;
+
+    /* The size in bytes of each generated input held in memory, or 0
+     * for none.  One input of each CorpusDistribution is benchmarked,
+     * along with the test corpus repeated up to this size.
+     */
+    long generatedSize;
+
+    /* The size in bytes of each generated input streamed through the
+     * stages that read a stream, or 0 for none.  These inputs are never
+     * held in memory, so they can be far larger than generatedSize.
+     */
+    long long streamedSize;
+
+    /* How many untimed runs come before the timed ones, and how many
+     * timed runs there are.
+     */
+    int warmupRuns;
+    int repetitions;
+
+    /* Only stages whose names start with this are run; "" runs them all. */
+    std::string stageFilter;
+
+    /* Whether to count hardware events (see PerfCounters.h) during the
+     * timed runs.
+     */
+    bool perfCounters;
+
+    /* Whether to track allocations during the timed runs.  Has no effect
+     * if the allocation hook is not compiled in.
+     */
+    bool countAllocations;
+
+    /* Sets corpusDirectory to "test/encodeDecode", generatedSize to
+     * 1 MB, streamedSize to 0, warmupRuns to 1, repetitions to 5,
+     * stageFilter to "", and perfCounters and countAllocations to false.
+     */
+    BenchmarkOptions();
+};
+
+/* Type: BenchmarkResult
+ * The timings of one stage on one input.  Each repetition's time is the
+ * time for one pass over the input; for small inputs a repetition makes
+ * several passes and is divided by their number, so that the timer's
+ * resolution does not dominate.
+ */
+struct BenchmarkResult {
+    std::string stage;
+    std::string input;
+    long long inputBytes;
+    int repetitions;
+    int passesPerRepetition;
+
+    /* The fastest, median, 90th and 99th percentile, slowest and mean
+     * time of a pass, in seconds.
+     */
+    double minSeconds;
+    double medianSeconds;
+    double p90Seconds;
+    double p99Seconds;
+    double maxSeconds;
+    double meanSeconds;
+
+    /* The count of each PerfCounter per byte of input, over all timed
+     * passes, or -1 if it was not counted.
+     */
+    double countersPerByte[NUM_PERF_COUNTERS];
+
+    /* The allocations made and bytes allocated per pass, and the most
+     * bytes live at once during the timed passes, or -1 if allocations
+     * were not tracked.
+     */
+    double allocationsPerPass;
+    double allocatedBytesPerPass;
+    long long peakLiveBytes;
+};
+
+/* Function: benchmarkStageNames
+ * Usage: Vector<string> stages = benchmarkStageNames();
+ * --------------------------------------------------------
+ * Returns the names of the stages in the order they are run.
+ */
+Vector<std::string> benchmarkStageNames();
+
+/* Function: runBenchmarks
+ * Usage: Vector<BenchmarkResult> results = runBenchmarks(options, &cout);
+ * --------------------------------------------------------
+ * Runs every selected stage on every input and returns the timings.  If
+ * progress is not NULL, a line is written to it as each stage finishes,
+ * and if performance counters were asked for but some cannot be used,
+ * the reason is written to it first.
+ * Reports an error if an input cannot be read or a stage does not get
+ * back the original data.
+ */
+Vector<BenchmarkResult> runBenchmarks(const BenchmarkOptions& options = BenchmarkOptions(),
+                                      std::ostream* progress = NULL);
+
+/* Function: benchmarkInput
+ * Usage: Vector<BenchmarkResult> results = benchmarkInput(name, data, options);
+ * --------------------------------------------------------
+ * Runs every selected stage on the given data, recording name as the
+ * input's name.
+ */
+Vector<BenchmarkResult> benchmarkInput(const std::string& name, const std::string& data,
+                                       const BenchmarkOptions& options = BenchmarkOptions(),
+                                       std::ostream* progress = NULL);
+
+/* Function: benchmarkCorpus
+ * Usage: Vector<BenchmarkResult> results = benchmarkCorpus(spec, options);
+ * --------------------------------------------------------
+ * Streams the generated corpus through each selected stage that reads a
+ * stream (the frequency count, compress, the compression levels and LZW
+ * compression) and discards the output.  The "generate" stage times the
+ * generator alone, so that its share can be subtracted.  Each run
+ * generates the corpus afresh, so a repetition is always a single pass.
+ */
+Vector<BenchmarkResult> benchmarkCorpus(const CorpusSpec& spec,
+                                        const BenchmarkOptions& options = BenchmarkOptions(),
+                                        std::ostream* progress = NULL);
+
+/* Functions: writeBenchmarkJSON, writeBenchmarkCSV
+ * Usage: writeBenchmarkJSON(outfile, results);
+ *        writeBenchmarkCSV(outfile, results);
+ * --------------------------------------------------------
+ * Write the results with their throughput in megabytes (10^6 bytes) per
+ * second and time in nanoseconds per byte, both from the median, as a
+ * JSON object holding an array of results or as CSV with a header row.
+ * Counters that were not counted are written as null in JSON and left
+ * empty in CSV.
+ */
+void writeBenchmarkJSON(std::ostream& outfile, const Vector<BenchmarkResult>& results);
+void writeBenchmarkCSV(std::ostream& outfile, const Vector<BenchmarkResult>& results);
+
+#endif
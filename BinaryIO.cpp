@@ -0,0 +1,87 @@
+/**********************************************************
+ * File: BinaryIO.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the number helpers and the discarding stream from
+ * BinaryIO.h.
+ */
+
+#include "BinaryIO.h"
+#include "error.h"
+#include <cstdio>
+
+/* Function: writeNumber
+ * Usage: writeNumber(outfile, value, numBytes);
+ * --------------------------------------------------------
+ * Writes the low numBytes bytes of value, most significant first.
+ */
+void writeNumber(std::ostream& outfile, unsigned long long value, int numBytes) {
+    for (int i = numBytes - 1; i >= 0; i--) {
+        outfile.put(char((value >> (8 * i)) & 0xFF));
+    }
+}
+
+/* Function: readNumber
+ * Usage: unsigned long long value = readNumber(infile, numBytes);
+ * --------------------------------------------------------
+ * Reads a numBytes-byte number written by writeNumber.  Reports an
+ * error if the file ends first.
+ */
+unsigned long long readNumber(std::istream& infile, int numBytes) {
+    unsigned long long value = 0;
+    for (int i = 0; i < numBytes; i++) {
+        int ch = infile.get();
+        if (ch == EOF) error("File ended in the middle of a number.");
+        value = (value << 8) | (unsigned char)ch;
+    }
+    return value;
+}
+
+/* Constructor: DiscardBuffer
+ * --------------------------------------------------------
+ * Starts at position 0.
+ */
+DiscardBuffer::DiscardBuffer() : position(0) {}
+
+/* Member functions: overflow, xsputn
+ * --------------------------------------------------------
+ * Move the position past what would have been written.
+ */
+DiscardBuffer::int_type DiscardBuffer::overflow(int_type ch) {
+    position++;
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize DiscardBuffer::xsputn(const char*, std::streamsize count) {
+    position += count;
+    return count;
+}
+
+/* Member functions: seekoff, seekpos
+ * --------------------------------------------------------
+ * Move the position as asked.
+ */
+DiscardBuffer::pos_type DiscardBuffer::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                               std::ios_base::openmode) {
+    if (direction == std::ios_base::beg) {
+        position = offset;
+    } else {
+        position += offset;
+    }
+    return pos_type(off_type(position));
+}
+
+DiscardBuffer::pos_type DiscardBuffer::seekpos(pos_type target, std::ios_base::openmode) {
+    position = off_type(target);
+    return target;
+}
+
+/* Constructor: DiscardStream
+ * --------------------------------------------------------
+ * Attaches the stream to its buffer.
+ */
+DiscardStream::DiscardStream() {
+    init(&buffer);
+}
@@ -0,0 +1,67 @@
+/*******************************************************
+ * File: BinaryIO.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Helpers for reading and writing the fixed-width numbers used in the
+ * headers and indexes of the block-based file formats.  Numbers are
+ * written a byte at a time, most significant byte first, so the files
+ * are the same on every machine.  Also a stream that throws away what is
+ * written to it, for running the compressor without keeping its output.
+ */
+
+#ifndef BinaryIO_Included
+#define BinaryIO_Included
+
+#include "bstream.h"
+#include <iostream>
+
+/* Function: writeNumber
+ * Usage: writeNumber(outfile, value, numBytes);
+ * --------------------------------------------------------
+ * Writes the low numBytes bytes of value, most significant first.
+ */
+void writeNumber(std::ostream& outfile, unsigned long long value, int numBytes);
+
+/* Function: readNumber
+ * Usage: unsigned long long value = readNumber(infile, numBytes);
+ * --------------------------------------------------------
+ * Reads a numBytes-byte number written by writeNumber.  Reports an
+ * error if the file ends first.
+ */
+unsigned long long readNumber(std::istream& infile, int numBytes);
+
+/* Class: DiscardBuffer
+ * --------------------------------------------------------
+ * A stream buffer that throws away what is written to it but keeps
+ * track of the position, since obstream::writeBit seeks back to rewrite
+ * the last byte.
+ */
+class DiscardBuffer : public std::streambuf {
+public:
+    DiscardBuffer();
+
+protected:
+    int_type overflow(int_type ch);
+    std::streamsize xsputn(const char* data, std::streamsize count);
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode);
+    pos_type seekpos(pos_type target, std::ios_base::openmode);
+
+private:
+    long long position;
+};
+
+/* Class: DiscardStream
+ * --------------------------------------------------------
+ * An obstream that writes to a DiscardBuffer.
+ */
+class DiscardStream : public obstream {
+public:
+    DiscardStream();
+
+private:
+    DiscardBuffer buffer;
+};
+
+#endif
@@ -0,0 +1,326 @@
+/**********************************************************
+ * File: Checksum.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the CRC-32 checksums from Checksum.h.  Bytes are
+ * taken four at a time through four tables ("slicing by four"), and
+ * checksums are combined the way zlib's crc32_combine does, by treating
+ * appending a zero byte as a linear map on the CRC and squaring its
+ * matrix to append many at once.  ContentHash is XXH64, so its values
+ * match those of the reference xxHash.
+ */
+
+#include "Checksum.h"
+
+/* Constant: CRC_POLYNOMIAL
+ * The CRC-32 polynomial, with its bits reversed.
+ */
+static const unsigned long CRC_POLYNOMIAL = 0xEDB88320UL;
+
+/* Variables: crcTables, crcTablesBuilt
+ * crcTables[0] is the usual table of the CRCs of single bytes, and
+ *   crcTables[k] advances crcTables[k - 1] by one more zero byte.  They
+ *   are built on first use; building them twice at once is harmless,
+ *   since both builds write the same values.
+ */
+static unsigned long crcTables[4][256];
+static volatile bool crcTablesBuilt = false;
+
+/* Function: buildCrcTables
+ * Usage: buildCrcTables();
+ * --------------------------------------------------------
+ * Fills in crcTables.
+ */
+static void buildCrcTables() {
+    for (int n = 0; n < 256; n++) {
+        unsigned long crc = n;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC_POLYNOMIAL : crc >> 1;
+        }
+        crcTables[0][n] = crc;
+    }
+    for (int n = 0; n < 256; n++) {
+        for (int k = 1; k < 4; k++) {
+            unsigned long previous = crcTables[k - 1][n];
+            crcTables[k][n] = (previous >> 8) ^ crcTables[0][previous & 0xFF];
+        }
+    }
+    __sync_synchronize();
+    crcTablesBuilt = true;
+}
+
+/* Function: crc32
+ * Usage: unsigned long crc = crc32(data, length);
+ * --------------------------------------------------------
+ * Runs the bytes through the tables, four at a time where it can.
+ */
+unsigned long crc32(const char* data, long length, unsigned long crc) {
+    if (!crcTablesBuilt) buildCrcTables();
+    const unsigned char* next = (const unsigned char*) data;
+    crc = ~crc & 0xFFFFFFFFUL;
+    while (length >= 4) {
+        crc ^= next[0] | (next[1] << 8) | (next[2] << 16) | ((unsigned long) next[3] << 24);
+        crc = crcTables[3][crc & 0xFF] ^ crcTables[2][(crc >> 8) & 0xFF] ^
+              crcTables[1][(crc >> 16) & 0xFF] ^ crcTables[0][(crc >> 24) & 0xFF];
+        next += 4;
+        length -= 4;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ crcTables[0][(crc ^ *next++) & 0xFF];
+    }
+    return ~crc & 0xFFFFFFFFUL;
+}
+
+/* Function: multiplyCrcMatrix
+ * Usage: unsigned long result = multiplyCrcMatrix(matrix, vector);
+ * --------------------------------------------------------
+ * Multiplies a 32-by-32 matrix over GF(2), stored a column per word, by
+ * a vector of 32 bits.
+ */
+static unsigned long multiplyCrcMatrix(const unsigned long* matrix, unsigned long vector) {
+    unsigned long result = 0;
+    for (int i = 0; vector != 0; i++, vector >>= 1) {
+        if (vector & 1) result ^= matrix[i];
+    }
+    return result;
+}
+
+/* Function: squareCrcMatrix
+ * Usage: squareCrcMatrix(square, matrix);
+ * --------------------------------------------------------
+ * Sets square to matrix times itself.
+ */
+static void squareCrcMatrix(unsigned long* square, const unsigned long* matrix) {
+    for (int i = 0; i < 32; i++) {
+        square[i] = multiplyCrcMatrix(matrix, matrix[i]);
+    }
+}
+
+/* Function: crc32Combine
+ * Usage: unsigned long crc = crc32Combine(crcA, crcB, lengthB);
+ * --------------------------------------------------------
+ * Advances crcA past lengthB zero bytes, which is what appending b does
+ * to it apart from b's own contribution, and adds crcB.  The operator
+ * for one zero bit is squared up to one for a byte, then repeatedly
+ * squared and applied for each bit set in lengthB.
+ */
+unsigned long crc32Combine(unsigned long crcA, unsigned long crcB, long long lengthB) {
+    if (lengthB <= 0) return crcA;
+    unsigned long even[32], odd[32];
+    odd[0] = CRC_POLYNOMIAL;
+    unsigned long row = 1;
+    for (int i = 1; i < 32; i++) {
+        odd[i] = row;
+        row <<= 1;
+    }
+    squareCrcMatrix(even, odd);   // two zero bits
+    squareCrcMatrix(odd, even);   // four zero bits
+
+    do {
+        squareCrcMatrix(even, odd);
+        if (lengthB & 1) crcA = multiplyCrcMatrix(even, crcA);
+        lengthB >>= 1;
+        if (lengthB == 0) break;
+        squareCrcMatrix(odd, even);
+        if (lengthB & 1) crcA = multiplyCrcMatrix(odd, crcA);
+        lengthB >>= 1;
+    } while (lengthB != 0);
+    return (crcA ^ crcB) & 0xFFFFFFFFUL;
+}
+
+/* Constants: HASH_PRIME_1 to HASH_PRIME_5
+ * The multipliers of XXH64.
+ */
+static const unsigned long long HASH_PRIME_1 = 11400714785074694791ULL;
+static const unsigned long long HASH_PRIME_2 = 14029467366897019727ULL;
+static const unsigned long long HASH_PRIME_3 = 1609587929392839161ULL;
+static const unsigned long long HASH_PRIME_4 = 9650029242287828579ULL;
+static const unsigned long long HASH_PRIME_5 = 2870177450012600261ULL;
+
+/* Functions: rotateLeft, readLittle64, readLittle32
+ * --------------------------------------------------------
+ * Rotate a 64-bit word, and read little-endian words, whatever the
+ * machine's own order.
+ */
+static inline unsigned long long rotateLeft(unsigned long long value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline unsigned long long readLittle64(const unsigned char* bytes) {
+    unsigned long long value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+static inline unsigned long long readLittle32(const unsigned char* bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned long long) bytes[3] << 24);
+}
+
+/* Functions: hashRound, mergeHashRound
+ * --------------------------------------------------------
+ * Mix a word into a lane, and a lane into the final hash.
+ */
+static inline unsigned long long hashRound(unsigned long long lane, unsigned long long word) {
+    return rotateLeft(lane + word * HASH_PRIME_2, 31) * HASH_PRIME_1;
+}
+
+static inline unsigned long long mergeHashRound(unsigned long long hash, unsigned long long lane) {
+    return (hash ^ hashRound(0, lane)) * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+/* Constructor: ContentHash
+ * --------------------------------------------------------
+ * Seeds the four lanes.
+ */
+ContentHash::ContentHash(unsigned long long seed) : seed(seed), numPending(0), total(0) {
+    lanes[0] = seed + HASH_PRIME_1 + HASH_PRIME_2;
+    lanes[1] = seed + HASH_PRIME_2;
+    lanes[2] = seed;
+    lanes[3] = seed - HASH_PRIME_1;
+}
+
+/* Member function: update
+ * --------------------------------------------------------
+ * Completes any partial stripe, runs whole 32-byte stripes through the
+ * lanes, and keeps what is left for next time.
+ */
+void ContentHash::update(const char* data, long length) {
+    const unsigned char* next = (const unsigned char*) data;
+    total += length;
+    if (numPending > 0) {
+        while (numPending < 32 && length > 0) {
+            pending[numPending++] = *next++;
+            length--;
+        }
+        if (numPending < 32) return;
+        for (int i = 0; i < 4; i++) {
+            lanes[i] = hashRound(lanes[i], readLittle64(pending + 8 * i));
+        }
+        numPending = 0;
+    }
+    while (length >= 32) {
+        for (int i = 0; i < 4; i++) {
+            lanes[i] = hashRound(lanes[i], readLittle64(next + 8 * i));
+        }
+        next += 32;
+        length -= 32;
+    }
+    while (length-- > 0) {
+        pending[numPending++] = *next++;
+    }
+}
+
+/* Member function: digest
+ * --------------------------------------------------------
+ * Merges the lanes, mixes in the length and the bytes short of a
+ * stripe, and scrambles the result.
+ */
+unsigned long long ContentHash::digest() const {
+    unsigned long long hash;
+    if (total >= 32) {
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+               rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = mergeHashRound(hash, lanes[i]);
+        }
+    } else {
+        hash = seed + HASH_PRIME_5;
+    }
+    hash += (unsigned long long) total;
+
+    int position = 0;
+    for (; position + 8 <= numPending; position += 8) {
+        hash ^= hashRound(0, readLittle64(pending + position));
+        hash = rotateLeft(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (position + 4 <= numPending) {
+        hash ^= readLittle32(pending + position) * HASH_PRIME_1;
+        hash = rotateLeft(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        position += 4;
+    }
+    for (; position < numPending; position++) {
+        hash ^= pending[position] * HASH_PRIME_5;
+        hash = rotateLeft(hash, 11) * HASH_PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/* Member function: length
+ * --------------------------------------------------------
+ * Returns how many bytes have been hashed.
+ */
+long long ContentHash::length() const {
+    return total;
+}
+
+/* Constructor: ChecksumBuffer
+ * --------------------------------------------------------
+ * Starts with nothing written.
+ */
+ChecksumBuffer::ChecksumBuffer(std::streambuf* target) : target(target), crc(0), count(0) {}
+
+/* Member functions: checksum, length
+ * --------------------------------------------------------
+ * Return what has been kept.
+ */
+unsigned long ChecksumBuffer::checksum() const {
+    return crc;
+}
+
+long long ChecksumBuffer::length() const {
+    return count;
+}
+
+/* Member functions: overflow, xsputn, sync
+ * --------------------------------------------------------
+ * Pass the data on, checksumming whatever the target took.
+ */
+ChecksumBuffer::int_type ChecksumBuffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+    char byte = traits_type::to_char_type(ch);
+    return (xsputn(&byte, 1) == 1) ? ch : traits_type::eof();
+}
+
+std::streamsize ChecksumBuffer::xsputn(const char* data, std::streamsize length) {
+    std::streamsize written = target->sputn(data, length);
+    if (written > 0) {
+        crc = crc32(data, long(written), crc);
+        count += written;
+    }
+    return written;
+}
+
+int ChecksumBuffer::sync() {
+    return target->pubsync();
+}
+
+/* Constructor: ChecksumStream
+ * --------------------------------------------------------
+ * Attaches the stream to a buffer writing to target's.
+ */
+ChecksumStream::ChecksumStream(std::ostream& target)
+    : std::ostream(NULL), buffer(target.rdbuf()) {
+    init(&buffer);
+}
+
+/* Member functions: checksum, length
+ * --------------------------------------------------------
+ * Ask the buffer.
+ */
+unsigned long ChecksumStream::checksum() const {
+    return buffer.checksum();
+}
+
+long long ChecksumStream::length() const {
+    return buffer.length();
+}
@@ -0,0 +1,116 @@
+/*******************************************************
+ * File: Checksum.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * CRC-32 checksums, as used by zip and gzip, for checking that what
+ * comes out of an archive is what went in.  Checksums of consecutive
+ * pieces can be combined without the data, so blocks compressed on
+ * different threads can each be checksummed where they are compressed.
+ * Also a stream that checksums what is written through it, and a fast
+ * 64-bit hash for telling contents apart by.
+ */
+
+#ifndef Checksum_Included
+#define Checksum_Included
+
+#include <iostream>
+
+/* Function: crc32
+ * Usage: unsigned long crc = crc32(data, length);
+ *        crc = crc32(more, moreLength, crc);
+ * --------------------------------------------------------
+ * Returns the CRC-32 of length bytes of data.  Passing the CRC of what
+ * came before continues it, so crc32(a + b) is crc32(b, crc32(a)).
+ */
+unsigned long crc32(const char* data, long length, unsigned long crc = 0);
+
+/* Function: crc32Combine
+ * Usage: unsigned long crc = crc32Combine(crcA, crcB, lengthB);
+ * --------------------------------------------------------
+ * Returns the CRC-32 of a followed by b, given the CRC of each and the
+ * length of b, in time logarithmic in that length.
+ */
+unsigned long crc32Combine(unsigned long crcA, unsigned long crcB, long long lengthB);
+
+/* Class: ContentHash
+ * --------------------------------------------------------
+ * The 64-bit xxHash of data fed in any number of pieces, which runs at
+ * several bytes a cycle, far faster than crc32.  Unlike a CRC it is not
+ * meant for catching damage but for naming contents: two different
+ * inputs are vanishingly unlikely to share a hash.
+ */
+class ContentHash {
+public:
+    /* Constructor: ContentHash
+     * Usage: ContentHash hash;
+     * --------------------------------------------------------
+     * Starts a hash of nothing, with the given seed.
+     */
+    explicit ContentHash(unsigned long long seed = 0);
+
+    /* Member functions: update, digest, length
+     * Usage: hash.update(data, length);
+     *        unsigned long long value = hash.digest();
+     * --------------------------------------------------------
+     * Add the next piece of the data; return the hash of everything
+     * added so far, which does not stop more from being added; and
+     * return how many bytes that is.
+     */
+    void update(const char* data, long length);
+    unsigned long long digest() const;
+    long long length() const;
+
+private:
+    unsigned long long seed;
+    unsigned long long lanes[4];
+    unsigned char pending[32];        // bytes not yet a full stripe
+    int numPending;
+    long long total;
+};
+
+/* Class: ChecksumBuffer
+ * --------------------------------------------------------
+ * A stream buffer that passes what is written to it on to another one,
+ * keeping the CRC-32 and length of everything that was accepted.
+ */
+class ChecksumBuffer : public std::streambuf {
+public:
+    explicit ChecksumBuffer(std::streambuf* target);
+
+    /* Member functions: checksum, length
+     * Usage: if (buffer.checksum() != expected) ...
+     * --------------------------------------------------------
+     * Return the CRC-32 and the number of the bytes written so far.
+     */
+    unsigned long checksum() const;
+    long long length() const;
+
+protected:
+    int_type overflow(int_type ch);
+    std::streamsize xsputn(const char* data, std::streamsize count);
+    int sync();
+
+private:
+    std::streambuf* target;
+    unsigned long crc;
+    long long count;
+};
+
+/* Class: ChecksumStream
+ * --------------------------------------------------------
+ * An ostream that writes through a ChecksumBuffer to another stream.
+ */
+class ChecksumStream : public std::ostream {
+public:
+    explicit ChecksumStream(std::ostream& target);
+
+    unsigned long checksum() const;
+    long long length() const;
+
+private:
+    ChecksumBuffer buffer;
+};
+
+#endif
@@ -0,0 +1,81 @@
+/**********************************************************
+ * File: Chunking.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the FastCDC chunker from Chunking.h.  The gear hash
+ * is shifted left a bit per byte, so its top bits depend on the most
+ * bytes; the masks therefore test the top bits.  The gear table is
+ * generated from a fixed seed, since changing it would move every cut
+ * and spoil deduplication against chunks stored before.
+ */
+
+#include "Chunking.h"
+
+/* Constants: HARD_MASK_BITS, EASY_MASK_BITS
+ * How many bits must be zero for a cut before and after
+ *   CHUNK_AVERAGE_SIZE: two more and two fewer than the sixteen that
+ *   would give the average on their own.
+ */
+static const int HARD_MASK_BITS = 18;
+static const int EASY_MASK_BITS = 14;
+
+/* Constant: GEAR_SEED
+ * The seed the gear table is generated from.
+ */
+static const unsigned long long GEAR_SEED = 0x9E3779B97F4A7C15ULL;
+
+/* Variables: gearTable, gearTableBuilt
+ * A random 64-bit number for each byte value, built on first use.
+ *   Building it twice at once is harmless, since both builds write the
+ *   same values.
+ */
+static unsigned long long gearTable[256];
+static volatile bool gearTableBuilt = false;
+
+/* Function: buildGearTable
+ * Usage: buildGearTable();
+ * --------------------------------------------------------
+ * Fills in gearTable with the output of splitmix64.
+ */
+static void buildGearTable() {
+    unsigned long long state = GEAR_SEED;
+    for (int i = 0; i < 256; i++) {
+        state += 0x9E3779B97F4A7C15ULL;
+        unsigned long long value = state;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        gearTable[i] = value ^ (value >> 31);
+    }
+    __sync_synchronize();
+    gearTableBuilt = true;
+}
+
+/* Function: findChunkEnd
+ * Usage: long length = findChunkEnd(data, available);
+ * --------------------------------------------------------
+ * Skips the minimum, then rolls the hash through the bytes, testing the
+ * hard mask up to the average size and the easy one after it.
+ */
+long findChunkEnd(const char* data, long available) {
+    if (available <= CHUNK_MIN_SIZE) return available;
+    if (!gearTableBuilt) buildGearTable();
+    const unsigned char* bytes = (const unsigned char*) data;
+    long limit = (available < CHUNK_MAX_SIZE) ? available : CHUNK_MAX_SIZE;
+    long middle = (limit < CHUNK_AVERAGE_SIZE) ? limit : CHUNK_AVERAGE_SIZE;
+    const unsigned long long hardMask = ~0ULL << (64 - HARD_MASK_BITS);
+    const unsigned long long easyMask = ~0ULL << (64 - EASY_MASK_BITS);
+
+    unsigned long long hash = 0;
+    long position = CHUNK_MIN_SIZE;
+    for (; position < middle; position++) {
+        hash = (hash << 1) + gearTable[bytes[position]];
+        if ((hash & hardMask) == 0) return position + 1;
+    }
+    for (; position < limit; position++) {
+        hash = (hash << 1) + gearTable[bytes[position]];
+        if ((hash & easyMask) == 0) return position + 1;
+    }
+    return limit;
+}
@@ -0,0 +1,43 @@
+/*******************************************************
+ * File: Chunking.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Content-defined chunking, so that identical regions of different
+ * files, or of one file, are cut into identical chunks that need only
+ * be stored once.  Cutting at fixed offsets would not do: one byte
+ * inserted near the start of a file would shift every later chunk.
+ * Instead a rolling "gear" hash is kept over the last 64 bytes, and a
+ * chunk ends wherever the hash has a pattern of zero bits, which
+ * depends only on the bytes just before the cut, so the same content
+ * is cut in the same places wherever it appears.
+ *
+ * This is FastCDC: no cut is looked for in the first CHUNK_MIN_SIZE
+ * bytes of a chunk, which are skipped without hashing, and the pattern
+ * is harder to match before CHUNK_AVERAGE_SIZE and easier after it, so
+ * that chunk sizes cluster around the average instead of spreading out
+ * geometrically.  No chunk is longer than CHUNK_MAX_SIZE.
+ */
+
+#ifndef Chunking_Included
+#define Chunking_Included
+
+/* Constants: CHUNK_MIN_SIZE, CHUNK_AVERAGE_SIZE, CHUNK_MAX_SIZE
+ * The bounds on chunk sizes, and the size they cluster around.
+ */
+const long CHUNK_MIN_SIZE = 16 * 1024;
+const long CHUNK_AVERAGE_SIZE = 64 * 1024;
+const long CHUNK_MAX_SIZE = 256 * 1024;
+
+/* Function: findChunkEnd
+ * Usage: long length = findChunkEnd(data, available);
+ * --------------------------------------------------------
+ * Returns the length of the chunk that starts at data, given the bytes
+ * available from there.  Unless they are the last bytes of the input,
+ * at least CHUNK_MAX_SIZE bytes must be available, so that the cut
+ * does not depend on how much happened to be read.
+ */
+long findChunkEnd(const char* data, long available);
+
+#endif
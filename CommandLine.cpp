@@ -0,0 +1,712 @@
+/**********************************************************
+ * File: CommandLine.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the huff command-line tool from CommandLine.h.
+ *
+ * Each file is handled on its own: an error in one is reported, its
+ * partial output is removed, and the rest are still processed.  When
+ * several files are compressed on several threads, they go to
+ * compressFiles together, so that the threads are shared among all of
+ * their blocks rather than used on one file at a time.  Files
+ * written by compress without options can only be decompressed from a
+ * bstream, so when one arrives on standard input it is read into memory
+ * first; files written with options are streamed.  The archive commands
+ * hand everything to Archive.h, which reports each entry the same way.
+ * With --cache, each file is compressed through a ResultCache instead,
+ * one at a time, since most of them should need no compressing at all.
+ * With --ref, each file is compressed or decompressed as a delta (see
+ * Delta.h) against the one reference.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+#include "CommandLine.h"
+#include "Archive.h"
+#include "BatchCompression.h"
+#include "BinaryIO.h"
+#include "CompressionLevels.h"
+#include "CompressionStats.h"
+#include "Delta.h"
+#include "ResultCache.h"
+#include "HuffmanEncoding.h"
+#include "Timing.h"
+#include "bstream.h"
+#include "error.h"
+
+/* Type: Command
+ * What huff was asked to do.
+ */
+enum Command {
+    COMMAND_COMPRESS,
+    COMMAND_DECOMPRESS,
+    COMMAND_TEST,
+    COMMAND_BENCH,
+    COMMAND_ARCHIVE,
+    COMMAND_EXTRACT,
+    COMMAND_LIST
+};
+
+/* Type: ToolOptions
+ * The parsed command line.
+ */
+struct ToolOptions {
+    Command command;
+    CompressionOptions compression;
+    bool manyFiles;        // -m: every operand is an input
+    bool showStats;        // --stats
+    std::string cacheDirectory;   // --cache, or "" for none
+    long long cacheBytes;         // --cache-size
+    bool deduplicate;             // --dedup
+    std::string referenceName;    // --ref, or "" for none
+    Vector<std::string> files;
+};
+
+/* Constant: BENCH_RUNS
+ * How many times bench compresses and decompresses each file; the
+ *   fastest run is reported.
+ */
+static const int BENCH_RUNS = 3;
+
+/* Constant: MAX_THREADS
+ * The most threads -T may ask for.
+ */
+static const int MAX_THREADS = 256;
+
+/* Constant: DEFAULT_CACHE_BYTES
+ * How large the cache may grow unless --cache-size says otherwise.
+ */
+static const long long DEFAULT_CACHE_BYTES = 1024LL * 1024 * 1024;
+
+/* Constant: MAX_COUNT
+ * The largest number parseCount accepts.
+ */
+static const long long MAX_COUNT = 1LL << 50;
+
+/* Constant: USAGE
+ * What huff prints for -h or a wrong command line.
+ */
+static const char* const USAGE =
+    "usage: huff c|d|t|bench [-l level] [-T threads] [-b blocksize] [-m] [--stats] files\n"
+    "       huff a|x|l [-l level] [-T threads] [-b blocksize] [--stats] archive files\n"
+    "       huff c [--cache dir] [--cache-size size] ...\n"
+    "       huff a --dedup ...\n"
+    "       huff c|d|t --ref reference ...\n"
+    "  c        compress in to out\n"
+    "  d        decompress in to out\n"
+    "  t        check that each file decompresses\n"
+    "  bench    time compressing and decompressing each file in memory\n"
+    "  a        pack the files, and everything in the directories, into archive\n"
+    "  x        extract the named entries of archive, or all of them\n"
+    "  l        list the entries of archive\n"
+    "  -l       compression level, 1 (fastest) to 9 (smallest); default 6\n"
+    "  -T       threads to compress with, 0 for one per processor; default 1\n"
+    "  -b       block size in bytes, with an optional K or M suffix\n"
+    "  -m       treat every file as an input and name each output after it\n"
+    "  --stats  report the sizes, ratio and speed of each file\n"
+    "  --cache  reuse the results in dir of compressing the same data before,\n"
+    "           keeping at most --cache-size bytes (K, M or G suffix; default 1G)\n"
+    "  --dedup  store each run of data the files share only once in archive\n"
+    "  --ref    compress each file as a delta against reference, an older\n"
+    "           version of it, or decompress such a delta\n"
+    "c and d take \"in out\".  With one file, or with -m, the output of\n"
+    "in is in.huf when compressing, and in without .huf when decompressing.\n"
+    "With no files they read standard input and write standard output, and\n"
+    "a file named - is standard input or output.\n";
+
+/* Function: parseCount
+ * Usage: if (parseCount(text, allowSuffix, value)) ...
+ * --------------------------------------------------------
+ * Reads a non-negative whole number, followed by K, M or G to multiply
+ * it by 1024, 1024 * 1024 or 1024 * 1024 * 1024 if allowSuffix is set.
+ * Returns whether the text was such a number, no larger than MAX_COUNT.
+ */
+static bool parseCount(const std::string& text, bool allowSuffix, long long& value) {
+    if (text.empty() || text[0] < '0' || text[0] > '9') return false;
+    char* end;
+    long long number = strtoll(text.c_str(), &end, 10);
+    std::string suffix = end;
+    long long multiplier = 1;
+    if (allowSuffix && (suffix == "K" || suffix == "k")) {
+        multiplier = 1024;
+    } else if (allowSuffix && (suffix == "M" || suffix == "m")) {
+        multiplier = 1024 * 1024;
+    } else if (allowSuffix && (suffix == "G" || suffix == "g")) {
+        multiplier = 1024 * 1024 * 1024;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    if (number > MAX_COUNT / multiplier) return false;
+    value = number * multiplier;
+    return true;
+}
+
+/* Function: parseCommandLine
+ * Usage: if (parseCommandLine(args, options, messages)) ...
+ * --------------------------------------------------------
+ * Fills in the options from the arguments.  Options may come before or
+ * among the files; "--" ends them.  Returns false, having said why, if
+ * the arguments are wrong.
+ */
+static bool parseCommandLine(const Vector<std::string>& args, ToolOptions& options,
+                             std::ostream& messages) {
+    if (args.isEmpty()) {
+        messages << "huff: no command given" << std::endl;
+        return false;
+    }
+    std::string command = args[0];
+    if (command == "c") {
+        options.command = COMMAND_COMPRESS;
+    } else if (command == "d") {
+        options.command = COMMAND_DECOMPRESS;
+    } else if (command == "t") {
+        options.command = COMMAND_TEST;
+    } else if (command == "bench") {
+        options.command = COMMAND_BENCH;
+    } else if (command == "a") {
+        options.command = COMMAND_ARCHIVE;
+    } else if (command == "x") {
+        options.command = COMMAND_EXTRACT;
+    } else if (command == "l") {
+        options.command = COMMAND_LIST;
+    } else {
+        messages << "huff: unknown command " << command << std::endl;
+        return false;
+    }
+    options.manyFiles = false;
+    options.showStats = false;
+    options.cacheBytes = DEFAULT_CACHE_BYTES;
+    options.deduplicate = false;
+
+    bool optionsEnded = false;
+    for (int i = 1; i < args.size(); i++) {
+        std::string arg = args[i];
+        if (optionsEnded || arg == "-" || arg[0] != '-') {
+            options.files.add(arg);
+        } else if (arg == "--") {
+            optionsEnded = true;
+        } else if (arg == "-m") {
+            options.manyFiles = true;
+        } else if (arg == "--stats") {
+            options.showStats = true;
+        } else if (arg == "--dedup") {
+            options.deduplicate = true;
+        } else if (arg == "--cache" || arg == "--cache-size" || arg == "--ref") {
+            if (i + 1 == args.size()) {
+                messages << "huff: " << arg << " needs a value" << std::endl;
+                return false;
+            }
+            std::string text = args[++i];
+            if (arg == "--ref") {
+                options.referenceName = text;
+            } else if (arg == "--cache") {
+                options.cacheDirectory = text;
+            } else if (!parseCount(text, true, options.cacheBytes) || options.cacheBytes == 0) {
+                messages << "huff: " << text << " is not a valid cache size" << std::endl;
+                return false;
+            }
+        } else if (arg[1] == 'l' || arg[1] == 'T' || arg[1] == 'b') {
+            // the value may follow the option directly, as in -l9
+            std::string text = arg.substr(2);
+            if (text.empty()) {
+                if (i + 1 == args.size()) {
+                    messages << "huff: " << arg << " needs a value" << std::endl;
+                    return false;
+                }
+                text = args[++i];
+            }
+            long long value;
+            if (!parseCount(text, arg[1] == 'b', value)) {
+                messages << "huff: " << text << " is not a valid value for " << arg.substr(0, 2)
+                         << std::endl;
+                return false;
+            }
+            if (arg[1] == 'l') {
+                if (value < COMPRESSION_MIN_LEVEL || value > COMPRESSION_MAX_LEVEL) {
+                    messages << "huff: the level must be from " << COMPRESSION_MIN_LEVEL
+                             << " to " << COMPRESSION_MAX_LEVEL << std::endl;
+                    return false;
+                }
+                options.compression.level = int(value);
+            } else if (arg[1] == 'T') {
+                if (value > MAX_THREADS) {
+                    messages << "huff: at most " << MAX_THREADS << " threads can be used"
+                             << std::endl;
+                    return false;
+                }
+                options.compression.numThreads = int(value);
+            } else {
+                if (value < 1 || value > MAX_LEVEL_BLOCK_SIZE) {
+                    messages << "huff: the block size must be from 1 to "
+                             << MAX_LEVEL_BLOCK_SIZE << std::endl;
+                    return false;
+                }
+                options.compression.blockSize = long(value);
+            }
+        } else {
+            messages << "huff: unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    bool namesOutputs = (options.command == COMMAND_COMPRESS ||
+                         options.command == COMMAND_DECOMPRESS);
+    if (namesOutputs && !options.manyFiles && options.files.size() > 2) {
+        messages << "huff: too many files; use -m to process several" << std::endl;
+        return false;
+    }
+    bool archives = (options.command == COMMAND_ARCHIVE || options.command == COMMAND_EXTRACT ||
+                     options.command == COMMAND_LIST);
+    if (archives && options.files.isEmpty()) {
+        messages << "huff: no archive given" << std::endl;
+        return false;
+    }
+    if (options.command == COMMAND_ARCHIVE && options.files.size() == 1) {
+        messages << "huff: no files to archive" << std::endl;
+        return false;
+    }
+    if (!options.cacheDirectory.empty() && options.command != COMMAND_COMPRESS) {
+        messages << "huff: --cache only applies to c" << std::endl;
+        return false;
+    }
+    bool takesReference = (options.command == COMMAND_COMPRESS ||
+                           options.command == COMMAND_DECOMPRESS || options.command == COMMAND_TEST);
+    if (!options.referenceName.empty() && (!takesReference || !options.cacheDirectory.empty())) {
+        messages << "huff: --ref only applies to c, d and t, without --cache" << std::endl;
+        return false;
+    }
+    if (options.deduplicate && options.command != COMMAND_ARCHIVE) {
+        messages << "huff: --dedup only applies to a" << std::endl;
+        return false;
+    }
+    if (options.command == COMMAND_LIST && options.files.size() > 1) {
+        messages << "huff: l takes only the archive" << std::endl;
+        return false;
+    }
+    if (options.files.isEmpty()) options.files.add("-");
+    return true;
+}
+
+/* Function: outputName
+ * Usage: string name = outputName(command, inputName);
+ * --------------------------------------------------------
+ * Returns the name of the output written for an input when none is
+ * given: the input plus COMPRESSED_SUFFIX when compressing, or the input
+ * without it when decompressing.  Standard input goes to standard
+ * output.  Reports an error if a file to decompress lacks the suffix.
+ */
+static std::string outputName(Command command, const std::string& inputName) {
+    if (inputName == "-") return "-";
+    if (command == COMMAND_COMPRESS) return inputName + COMPRESSED_SUFFIX;
+    std::string suffix = COMPRESSED_SUFFIX;
+    if (inputName.length() <= suffix.length() ||
+        inputName.compare(inputName.length() - suffix.length(), suffix.length(), suffix) != 0) {
+        error("Name does not end in " + suffix + ", so there is no name for the output.");
+    }
+    return inputName.substr(0, inputName.length() - suffix.length());
+}
+
+/* Function: decompressStream
+ * Usage: decompressStream(source, sink, stats);
+ * --------------------------------------------------------
+ * Decompresses either format from any stream, reading a file written by
+ * compress without options into memory first unless it is already a
+ * bstream.  Files in that format start with a decimal digit, which
+ * catches most files that were never compressed before they are decoded
+ * into garbage.
+ */
+static void decompressStream(std::istream& source, std::ostream& sink, CompressionStats* stats) {
+    if (isLeveledCompression(source)) {
+        decompressLeveled(source, sink, stats);
+        return;
+    }
+    int first = source.peek();
+    if (first < '0' || first > '9') error("Not a compressed file.");
+    ibstream* bitSource = dynamic_cast<ibstream*>(&source);
+    if (bitSource != NULL) {
+        decompress(*bitSource, sink, stats);
+        return;
+    }
+    std::ostringstream contents;
+    contents << source.rdbuf();
+    istringbstream buffered(contents.str());
+    decompress(buffered, sink, stats);
+}
+
+/* Function: reportStats
+ * Usage: reportStats(messages, name, stats, seconds);
+ * --------------------------------------------------------
+ * Writes the line --stats asks for: the sizes in the order the data
+ * went, the compressed size over the uncompressed one, and the speed in
+ * megabytes of uncompressed data per second.
+ */
+static void reportStats(std::ostream& messages, Command command, const std::string& name,
+                        const CompressionStats& stats, double seconds) {
+    long long from = (command == COMMAND_COMPRESS) ? stats.uncompressedBytes : stats.compressedBytes;
+    long long to = (command == COMMAND_COMPRESS) ? stats.compressedBytes : stats.uncompressedBytes;
+    double ratio = (stats.uncompressedBytes == 0) ? 0 : double(stats.compressedBytes) / stats.uncompressedBytes;
+    double speed = (seconds <= 0) ? 0 : stats.uncompressedBytes / seconds / 1e6;
+    std::ostringstream line;
+    line << (name == "-" ? "(stdin)" : name) << ": " << from << " -> " << to << " bytes, ratio "
+         << std::fixed << std::setprecision(3) << ratio << ", " << std::setprecision(1)
+         << speed << " MB/s";
+    messages << line.str() << std::endl;
+}
+
+/* Function: reportCacheStats
+ * Usage: reportCacheStats(messages, stats);
+ * --------------------------------------------------------
+ * Writes the line --stats adds when a cache was used.
+ */
+static void reportCacheStats(std::ostream& messages, const ResultCacheStats& stats) {
+    messages << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+             << stats.evictions << " evicted, " << stats.numEntries << " results in "
+             << stats.bytes << " bytes" << std::endl;
+}
+
+/* Function: isSameFile
+ * Usage: if (isSameFile(inputName, outputName)) ...
+ * --------------------------------------------------------
+ * Returns whether the two names are the same file, under whatever
+ * names.  A name that does not exist is not the same as any other.
+ */
+static bool isSameFile(const std::string& first, const std::string& second) {
+    if (first == second) return true;
+    struct stat firstStatus, secondStatus;
+    if (stat(first.c_str(), &firstStatus) != 0 || stat(second.c_str(), &secondStatus) != 0) {
+        return false;
+    }
+    return firstStatus.st_dev == secondStatus.st_dev && firstStatus.st_ino == secondStatus.st_ino;
+}
+
+/* Function: processFile
+ * Usage: processFile(options, cache, inputName, outputName, input, output, messages);
+ * --------------------------------------------------------
+ * Compresses, decompresses or tests one file, compressing through the
+ * cache unless it is NULL, or against the reference if one was given.
+ * Reports an error before opening anything if the output is the input
+ * or the reference, since opening it would empty them.  Errors are left
+ * for the caller, after removing the output file if one was started.
+ */
+static void processFile(const ToolOptions& options, ResultCache* cache,
+                        const std::string& inputName, const std::string& outputName,
+                        std::istream& input, std::ostream& output, std::ostream& messages) {
+    if (!outputName.empty() && outputName != "-") {
+        if (inputName != "-" && isSameFile(inputName, outputName)) {
+            error("The output would overwrite the input.");
+        }
+        if (!options.referenceName.empty() && isSameFile(options.referenceName, outputName)) {
+            error("The output would overwrite the reference.");
+        }
+    }
+    if (cache != NULL && inputName != "-" && outputName != "-") {
+        // file to file, so that a cached result can be reflinked
+        CompressionStats stats;
+        double start = currentTime();
+        cache->compressFile(inputName, outputName, options.compression, &stats);
+        double seconds = currentTime() - start;
+        if (options.showStats) reportStats(messages, options.command, inputName, stats, seconds);
+        return;
+    }
+
+    ifbstream inputFile;
+    if (inputName != "-") {
+        inputFile.open(inputName.c_str());
+        if (!inputFile.is_open()) error("Cannot open the file.");
+    }
+    std::istream& source = (inputName == "-") ? input : inputFile;
+
+    DiscardStream discardStream;
+    std::ofstream outputFile;
+    bool toFile = (options.command != COMMAND_TEST && outputName != "-");
+    if (toFile) {
+        outputFile.open(outputName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!outputFile.is_open()) error("Cannot create " + outputName + ".");
+    }
+    std::ostream& sink = (options.command == COMMAND_TEST) ? (std::ostream&) discardStream
+                       : toFile ? (std::ostream&) outputFile : output;
+
+    CompressionStats stats;
+    double start = currentTime();
+    try {
+        if (!options.referenceName.empty()) {
+            std::ifstream reference(options.referenceName.c_str(), std::ios::binary);
+            if (!reference.is_open()) error("Cannot open " + options.referenceName + ".");
+            if (options.command == COMMAND_COMPRESS) {
+                compressDelta(reference, source, sink, options.compression, &stats);
+            } else {
+                decompressDelta(reference, source, sink, &stats);
+            }
+        } else if (options.command == COMMAND_COMPRESS && cache != NULL) {
+            cache->compress(source, sink, options.compression, &stats);
+        } else if (options.command == COMMAND_COMPRESS) {
+            compress(source, sink, options.compression, &stats);
+        } else {
+            decompressStream(source, sink, &stats);
+        }
+        sink.flush();
+        if (!sink) error("Cannot write the output.");
+    } catch (...) {
+        if (toFile) {
+            outputFile.close();
+            remove(outputName.c_str());
+        }
+        throw;
+    }
+    double seconds = currentTime() - start;
+    if (options.showStats) reportStats(messages, options.command, inputName, stats, seconds);
+}
+
+/* Function: readWholeInput
+ * Usage: string data = readWholeInput(name, input);
+ * --------------------------------------------------------
+ * Returns the contents of the named file, or of input for "-".
+ */
+static std::string readWholeInput(const std::string& name, std::istream& input) {
+    std::ostringstream contents;
+    if (name == "-") {
+        contents << input.rdbuf();
+    } else {
+        std::ifstream file(name.c_str(), std::ios::binary);
+        if (!file.is_open()) error("Cannot open the file.");
+        contents << file.rdbuf();
+    }
+    return contents.str();
+}
+
+/* Function: benchFile
+ * Usage: benchFile(options, name, input, output);
+ * --------------------------------------------------------
+ * Compresses and decompresses the file BENCH_RUNS times, checks that it
+ * comes back unchanged, and writes a line with its size, ratio and the
+ * fastest speed of each direction.
+ */
+static void benchFile(const ToolOptions& options, const std::string& name, std::istream& input,
+                      std::ostream& output) {
+    std::string data = readWholeInput(name, input);
+    double compressSeconds = 0, decompressSeconds = 0;
+    std::string compressed;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        std::istringstream source(data);
+        std::ostringstream sink;
+        double start = currentTime();
+        compress(source, sink, options.compression);
+        double seconds = currentTime() - start;
+        if (run == 0 || seconds < compressSeconds) compressSeconds = seconds;
+        compressed = sink.str();
+
+        std::istringstream compressedSource(compressed);
+        std::ostringstream decompressed;
+        start = currentTime();
+        decompressLeveled(compressedSource, decompressed);
+        seconds = currentTime() - start;
+        if (run == 0 || seconds < decompressSeconds) decompressSeconds = seconds;
+        if (decompressed.str() != data) error("Decompressing did not give back the original.");
+    }
+
+    double ratio = data.empty() ? 0 : double(compressed.length()) / data.length();
+    std::ostringstream line;
+    line << (name == "-" ? "(stdin)" : name) << ": " << data.length() << " bytes, ratio "
+         << std::fixed << std::setprecision(3) << ratio << std::setprecision(1)
+         << ", compress " << (compressSeconds <= 0 ? 0 : data.length() / compressSeconds / 1e6)
+         << " MB/s, decompress "
+         << (decompressSeconds <= 0 ? 0 : data.length() / decompressSeconds / 1e6) << " MB/s";
+    output << line.str() << std::endl;
+}
+
+/* Function: compressManyFiles
+ * Usage: int status = compressManyFiles(options, messages);
+ * --------------------------------------------------------
+ * Compresses every file at once with compressFiles, then reports each
+ * in turn.  The speed --stats gives is the file's share of the time the
+ * threads spent.
+ */
+static int compressManyFiles(const ToolOptions& options, std::ostream& messages) {
+    Vector<FileCompressionJob> jobs(options.files.size());
+    for (int i = 0; i < jobs.size(); i++) {
+        jobs[i].inputName = options.files[i];
+        jobs[i].outputName = outputName(COMMAND_COMPRESS, options.files[i]);
+    }
+    int numFailed;
+    try {
+        numFailed = compressFiles(jobs, options.compression);
+    } catch (ErrorException& ex) {
+        messages << "huff: " << ex.getMessage() << std::endl;
+        return EXIT_FAILED;
+    } catch (std::exception& ex) {
+        messages << "huff: " << ex.what() << std::endl;
+        return EXIT_FAILED;
+    }
+    for (int i = 0; i < jobs.size(); i++) {
+        const FileCompressionJob& job = jobs[i];
+        if (!job.succeeded) {
+            messages << "huff: " << job.inputName << ": " << job.errorMessage << std::endl;
+        } else if (options.showStats) {
+            reportStats(messages, COMMAND_COMPRESS, job.inputName, job.stats,
+                        job.stats.totalSeconds());
+        }
+    }
+    return (numFailed == 0) ? EXIT_OK : EXIT_FAILED;
+}
+
+/* Function: reportArchiveJobs
+ * Usage: int status = reportArchiveJobs(options, command, jobs, messages);
+ * --------------------------------------------------------
+ * Reports each entry that failed and, with --stats, each that did not,
+ * and returns the exit status they add up to.
+ */
+static int reportArchiveJobs(const ToolOptions& options, Command command,
+                             const Vector<FileCompressionJob>& jobs, std::ostream& messages) {
+    int status = EXIT_OK;
+    for (int i = 0; i < jobs.size(); i++) {
+        const FileCompressionJob& job = jobs[i];
+        if (!job.succeeded) {
+            messages << "huff: " << job.inputName << ": " << job.errorMessage << std::endl;
+            status = EXIT_FAILED;
+        } else if (options.showStats) {
+            reportStats(messages, command, job.inputName, job.stats, job.stats.totalSeconds());
+        }
+    }
+    return status;
+}
+
+/* Function: runArchiveCommand
+ * Usage: int status = runArchiveCommand(options, output, messages);
+ * --------------------------------------------------------
+ * Creates, extracts or lists the archive named by the first file.  When
+ * creating, the other files are walked for the files to pack, each
+ * stored under the name it was found by; when extracting, they name the
+ * entries wanted, each extracted to a file of the same name.
+ */
+static int runArchiveCommand(const ToolOptions& options, std::ostream& output,
+                             std::ostream& messages) {
+    std::string archiveName = options.files[0];
+    try {
+        Vector<FileCompressionJob> jobs;
+        if (options.command == COMMAND_ARCHIVE) {
+            Vector<std::string> inputs;
+            for (int i = 1; i < options.files.size(); i++) {
+                listArchiveInputs(options.files[i], inputs);
+            }
+            foreach (std::string input in inputs) {
+                FileCompressionJob job;
+                job.inputName = job.outputName = input;
+                jobs.add(job);
+            }
+            createArchive(archiveName, jobs, options.compression, options.deduplicate);
+            return reportArchiveJobs(options, COMMAND_COMPRESS, jobs, messages);
+        }
+
+        Vector<ArchiveEntry> entries;
+        readArchiveDirectory(archiveName, entries);
+        if (options.command == COMMAND_LIST) {
+            foreach (ArchiveEntry entry in entries) {
+                output << entry.size << " " << entry.compressedSize << " " << entry.name
+                       << std::endl;
+            }
+            return EXIT_OK;
+        }
+        if (options.files.size() == 1) {
+            foreach (ArchiveEntry entry in entries) {
+                FileCompressionJob job;
+                job.inputName = job.outputName = entry.name;
+                jobs.add(job);
+            }
+        } else {
+            for (int i = 1; i < options.files.size(); i++) {
+                FileCompressionJob job;
+                job.inputName = job.outputName = options.files[i];
+                jobs.add(job);
+            }
+        }
+        extractArchive(archiveName, jobs, options.compression.numThreads);
+        return reportArchiveJobs(options, COMMAND_DECOMPRESS, jobs, messages);
+    } catch (ErrorException& ex) {
+        messages << "huff: " << archiveName << ": " << ex.getMessage() << std::endl;
+        return EXIT_FAILED;
+    } catch (std::exception& ex) {
+        messages << "huff: " << archiveName << ": " << ex.what() << std::endl;
+        return EXIT_FAILED;
+    }
+}
+
+/* Function: runCommandLine
+ * Usage: int status = runCommandLine(args, cin, cout, cerr);
+ * --------------------------------------------------------
+ * Parses the arguments, then works through the files one at a time,
+ * carrying on past files that fail, unless compressManyFiles can take
+ * them all together.
+ */
+int runCommandLine(const Vector<std::string>& args, std::istream& input, std::ostream& output,
+                   std::ostream& messages) {
+    if (!args.isEmpty() && (args[0] == "-h" || args[0] == "--help")) {
+        output << USAGE;
+        return EXIT_OK;
+    }
+    ToolOptions options;
+    if (!parseCommandLine(args, options, messages)) {
+        messages << "Try huff -h for help." << std::endl;
+        return EXIT_USAGE;
+    }
+
+    if (options.command == COMMAND_ARCHIVE || options.command == COMMAND_EXTRACT ||
+        options.command == COMMAND_LIST) {
+        return runArchiveCommand(options, output, messages);
+    }
+    bool together = options.command == COMMAND_COMPRESS && options.manyFiles
+                    && options.files.size() > 1 && options.compression.numThreads != 1
+                    && options.cacheDirectory.empty() && options.referenceName.empty();
+    for (int i = 0; i < options.files.size(); i++) {
+        if (options.files[i] == "-") together = false;
+    }
+    if (together) return compressManyFiles(options, messages);
+
+    ResultCache* cache = NULL;
+    if (!options.cacheDirectory.empty()) {
+        try {
+            cache = new ResultCache(options.cacheDirectory, options.cacheBytes);
+        } catch (ErrorException& ex) {
+            messages << "huff: " << options.cacheDirectory << ": " << ex.getMessage() << std::endl;
+            return EXIT_FAILED;
+        } catch (std::exception& ex) {
+            messages << "huff: " << options.cacheDirectory << ": " << ex.what() << std::endl;
+            return EXIT_FAILED;
+        }
+    }
+
+    bool pairs = (options.command == COMMAND_COMPRESS || options.command == COMMAND_DECOMPRESS)
+                 && !options.manyFiles && options.files.size() == 2;
+    int status = EXIT_OK;
+    for (int i = 0; i < options.files.size(); i++) {
+        std::string inputName = options.files[i];
+        try {
+            if (options.command == COMMAND_BENCH) {
+                benchFile(options, inputName, input, output);
+            } else if (options.command == COMMAND_TEST) {
+                processFile(options, NULL, inputName, "", input, output, messages);
+            } else {
+                std::string target = pairs ? options.files[++i]
+                                           : outputName(options.command, inputName);
+                processFile(options, cache, inputName, target, input, output, messages);
+            }
+        } catch (ErrorException& ex) {
+            messages << "huff: " << (inputName == "-" ? "(stdin)" : inputName) << ": "
+                     << ex.getMessage() << std::endl;
+            status = EXIT_FAILED;
+        } catch (std::exception& ex) {
+            messages << "huff: " << (inputName == "-" ? "(stdin)" : inputName) << ": "
+                     << ex.what() << std::endl;
+            status = EXIT_FAILED;
+        }
+    }
+    if (cache != NULL && options.showStats) reportCacheStats(messages, cache->getStats());
+    delete cache;
+    return status;
+}
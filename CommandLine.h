@@ -0,0 +1,60 @@
+/*******************************************************
+ * File: CommandLine.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * The huff command-line tool, so that the compressor can be run from
+ * scripts and pipelines instead of through the menus of the test
+ * harness:
+ *
+ *   huff c|d|t|bench [-l level] [-T threads] [-b blocksize] [-m] [--stats] files
+ *   huff a|x|l [-l level] [-T threads] [-b blocksize] [--stats] archive files
+ *
+ * c compresses with compress and options (see CompressionLevels.h), d
+ * decompresses anything decompress reads, t checks that files
+ * decompress, and bench times compressing and decompressing each file
+ * in memory.  a, x and l create, extract from and list the archives of
+ * Archive.h; a --dedup stores the data the files share only once.
+ * c --cache dir reuses earlier results through a ResultCache (see
+ * ResultCache.h), and c, d and t --ref reference work on deltas against
+ * an older version of the file (see Delta.h).  A file named "-" is
+ * standard input or output, so huff works in a pipe.  The exit status is
+ * EXIT_OK if every file succeeded, EXIT_FAILED if any failed, and
+ * EXIT_USAGE if the command line itself was wrong.
+ *
+ * The work is done by runCommandLine, which HuffmanTool.cpp calls from
+ * main and the tests call directly.
+ */
+
+#ifndef CommandLine_Included
+#define CommandLine_Included
+
+#include "vector.h"
+#include <iostream>
+#include <string>
+
+/* Constants: EXIT_OK, EXIT_FAILED, EXIT_USAGE
+ * The exit statuses of runCommandLine.
+ */
+const int EXIT_OK = 0;
+const int EXIT_FAILED = 1;
+const int EXIT_USAGE = 2;
+
+/* Constant: COMPRESSED_SUFFIX
+ * What huff adds to the name of a file it compresses, and removes from
+ *   the name of a file it decompresses, when it names the output itself.
+ */
+const char* const COMPRESSED_SUFFIX = ".huf";
+
+/* Function: runCommandLine
+ * Usage: int status = runCommandLine(args, cin, cout, cerr);
+ * --------------------------------------------------------
+ * Runs huff with the given arguments, not counting the program name.
+ * Standard input and output are read from input and written to output;
+ * usage, errors and statistics go to messages.  Returns the exit status.
+ */
+int runCommandLine(const Vector<std::string>& args, std::istream& input, std::ostream& output,
+                   std::ostream& messages);
+
+#endif
@@ -0,0 +1,409 @@
+/**********************************************************
+ * File: CompressedSearch.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the search from CompressedSearch.h.  It reads the
+ * blocks of the format in CompressionLevelsInternal.h with the same
+ * table reader and bit reader as decompressLeveled, but steps over
+ * codes instead of producing their bytes wherever it can.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "CompressedSearch.h"
+#include "CompressionLevels.h"
+#include "CompressionLevelsInternal.h"
+#include "LZWEncoding.h"
+#include "BinaryIO.h"
+#include "error.h"
+
+/* Constant: MIN_SEARCH_BITS
+ * The fewest bits an encoded pattern may have to be searched for in the
+ *   compressed streams.  With fewer, some alignment leaves no whole byte
+ *   of the pattern to look for, so the streams are decoded instead.
+ */
+static const int MIN_SEARCH_BITS = 15;
+
+/* Constructor: SearchStats
+ * --------------------------------------------------------
+ * Starts every count at zero.
+ */
+SearchStats::SearchStats() {
+    bytesScanned = 0;
+    codesSkipped = 0;
+    bytesDecoded = 0;
+}
+
+/* Type: EncodedPattern
+ * The pattern encoded with one block's table, at each of the eight bit
+ *   alignments it may have in a stream.  At alignment a, the pattern's
+ *   first bit is bit a of a byte, counting from the most significant;
+ *   values holds its bits in place and masks marks which bits are its.
+ *   anchors gives, for each byte value, the alignments whose first whole
+ *   byte it is.
+ */
+struct EncodedPattern {
+    bool codable;                // whether every byte of it has a code
+    long numBits;
+    std::vector<unsigned char> values[8];
+    std::vector<unsigned char> masks[8];
+    unsigned char anchors[NUM_SYMBOLS];
+};
+
+/* Function: encodePattern
+ * Usage: encodePattern(pattern, table, encoded);
+ * --------------------------------------------------------
+ * Encodes the pattern with the table, at every alignment.
+ */
+static void encodePattern(const std::string& pattern, const CodeTable& table,
+                          EncodedPattern& encoded) {
+    encoded.codable = true;
+    encoded.numBits = 0;
+    for (size_t i = 0; i < pattern.length(); i++) {
+        int length = table.lengths[(unsigned char) pattern[i]];
+        if (length == 0) encoded.codable = false;
+        encoded.numBits += length;
+    }
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        encoded.anchors[symbol] = 0;
+    }
+    if (!encoded.codable || encoded.numBits < MIN_SEARCH_BITS) return;
+
+    for (int a = 0; a < 8; a++) {
+        long numBytes = (a + encoded.numBits + 7) / 8;
+        encoded.values[a].assign(numBytes, 0);
+        encoded.masks[a].assign(numBytes, 0);
+        long bit = a;
+        for (size_t i = 0; i < pattern.length(); i++) {
+            unsigned char symbol = pattern[i];
+            for (int j = table.lengths[symbol] - 1; j >= 0; j--, bit++) {
+                unsigned char place = (unsigned char) (0x80 >> (bit % 8));
+                encoded.masks[a][bit / 8] |= place;
+                if ((table.codes[symbol] >> j) & 1) encoded.values[a][bit / 8] |= place;
+            }
+        }
+        int first = (a == 0) ? 0 : 1;
+        encoded.anchors[encoded.values[a][first]] |= (unsigned char) (1 << a);
+    }
+}
+
+/* Function: findEncodedPattern
+ * Usage: findEncodedPattern(data, size, encoded, candidates);
+ * --------------------------------------------------------
+ * Adds to candidates, in increasing order, every bit position in the
+ * size bytes at data where the encoded pattern occurs.  Each byte is
+ * looked up once among the anchors, and only the alignments it anchors
+ * are compared in full.
+ */
+static void findEncodedPattern(const unsigned char* data, long size, const EncodedPattern& encoded,
+                               std::vector<long long>& candidates) {
+    for (long p = 0; p < size; p++) {
+        unsigned hits = encoded.anchors[data[p]];
+        if (hits == 0) continue;
+        for (int a = 0; a < 8; a++) {
+            if ((hits & (1u << a)) == 0) continue;
+            long start = p - ((a == 0) ? 0 : 1);
+            long numBytes = long(encoded.values[a].size());
+            if (start < 0 || start + numBytes > size) continue;
+            long j = 0;
+            while (j < numBytes && (data[start + j] & encoded.masks[a][j]) == encoded.values[a][j]) {
+                j++;
+            }
+            if (j == numBytes) candidates.push_back(8LL * start + a);
+        }
+    }
+    // an alignment anchored a byte later may start a byte earlier
+    std::sort(candidates.begin(), candidates.end());
+}
+
+/* Function: skipCodes
+ * Usage: skipCodes(reader, decodeTable, count);
+ * --------------------------------------------------------
+ * Steps over count codes without producing their bytes.
+ */
+static void skipCodes(BitReader& reader, const unsigned short decodeTable[], long count) {
+    for (long i = 0; i < count; i++) {
+        unsigned short entry = decodeTable[reader.peek()];
+        if (entry == 0) error("Compressed file contains an invalid code.");
+        reader.skip(entry >> 8);
+    }
+}
+
+/* Class: LevelSearch
+ * --------------------------------------------------------
+ * Searches the pieces of a file in order: blocks and streams whose
+ * bytes it has, and Huffman streams it searches compressed.  It keeps
+ * the last patternLength - 1 bytes before the next piece, where a match
+ * crossing into that piece starts.  When the piece before was a stream
+ * searched compressed, those bytes are only decoded if the start of the
+ * next piece shows they could be needed; until then, the stream is
+ * remembered, along with its whole payload and table once its block is
+ * done.
+ */
+class LevelSearch {
+public:
+    LevelSearch(const std::string& pattern, Vector<long long>& matches, SearchStats& stats);
+
+    /* Member functions: searchBytes, searchHuffmanBlock
+     * Usage: search.searchBytes(data);
+     *        search.searchHuffmanBlock(payload, position, table, decodeTable, originalSize);
+     * --------------------------------------------------------
+     * Search the next piece of the file, given either its bytes or the
+     * payload of a Huffman block, whose streams start after position.
+     * searchHuffmanBlock may take over the payload.
+     */
+    void searchBytes(const std::string& data);
+    void searchHuffmanBlock(std::string& payload, long position, const CodeTable& table,
+                            const unsigned short decodeTable[], long originalSize);
+
+private:
+    const std::string& pattern;
+    long patternLength;
+    Vector<long long>& matches;
+    SearchStats& stats;
+    long long offset;                     // of the next piece
+    std::string context;                  // the bytes before it, unless tailPending
+
+    bool tailPending;                     // whether the context is the end of this stream
+    const std::string* tailSource;
+    std::string tailPayload;              // its payload, once its block is done
+    long tailStart, tailSize, tailSymbols;
+    const unsigned short* tailDecodeTable; // its table while its block is searched,
+    CodeTable tailTable;                  //   and after that
+
+    void searchStream(const std::string& payload, long start, long size, long numSymbols,
+                      const EncodedPattern& encoded, const unsigned short decodeTable[]);
+    void resolveTail();
+};
+
+/* Constructor: LevelSearch
+ * --------------------------------------------------------
+ * Starts at the beginning of the file, with nothing before it.
+ */
+LevelSearch::LevelSearch(const std::string& pattern, Vector<long long>& matches,
+                         SearchStats& stats)
+    : pattern(pattern), matches(matches), stats(stats) {
+    patternLength = long(pattern.length());
+    offset = 0;
+    tailPending = false;
+    tailSource = NULL;
+    tailDecodeTable = NULL;
+}
+
+/* Member function: searchBytes
+ * --------------------------------------------------------
+ * Searches the bytes with the context in front of them, and keeps the
+ * end of both as the next context.
+ */
+void LevelSearch::searchBytes(const std::string& data) {
+    if (tailPending) resolveTail();
+    std::string text = context + data;
+    long long textOffset = offset - long(context.length());
+    for (size_t found = text.find(pattern); found != std::string::npos;
+         found = text.find(pattern, found + 1)) {
+        matches.add(textOffset + found);
+    }
+    long keep = (long(text.length()) < patternLength - 1) ? long(text.length()) : patternLength - 1;
+    context = text.substr(text.length() - keep);
+    offset += data.length();
+}
+
+/* Member function: searchHuffmanBlock
+ * --------------------------------------------------------
+ * Encodes the pattern with the block's table and searches each stream.
+ * If the context is still to come from the last stream, the payload
+ * and table are kept for it.
+ */
+void LevelSearch::searchHuffmanBlock(std::string& payload, long position, const CodeTable& table,
+                                     const unsigned short decodeTable[], long originalSize) {
+    long streamSizes[MAX_STREAMS];
+    int numStreams = readStreamSizes(payload, position, streamSizes);
+    EncodedPattern encoded;
+    encodePattern(pattern, table, encoded);
+    for (int i = 0; i < numStreams; i++) {
+        searchStream(payload, position, streamSizes[i], segmentLength(originalSize, numStreams, i),
+                     encoded, decodeTable);
+        position += streamSizes[i];
+    }
+    if (tailPending && tailSource == &payload) {
+        tailPayload.swap(payload);
+        tailSource = &tailPayload;
+        tailTable = table;
+        tailDecodeTable = NULL;
+    }
+}
+
+/* Member function: searchStream
+ * --------------------------------------------------------
+ * Decodes a stream too short to hold patternLength - 1 bytes, or one
+ * the pattern's codes are too short to search for, and searches its
+ * bytes.  Otherwise decodes only its first patternLength - 1 bytes, to
+ * look for matches that cross into it, searches its bits for those in
+ * it, and leaves its last bytes for later.
+ */
+void LevelSearch::searchStream(const std::string& payload, long start, long size, long numSymbols,
+                               const EncodedPattern& encoded, const unsigned short decodeTable[]) {
+    const unsigned char* data = (const unsigned char*) payload.data() + start;
+    BitReader reader;
+    reader.init(data, data + size);
+    bool searchable = encoded.codable && encoded.numBits >= MIN_SEARCH_BITS;
+    if (numSymbols < patternLength - 1 || (encoded.codable && !searchable)) {
+        std::string bytes(numSymbols, '\0');
+        for (long j = 0; j < numSymbols; j++) {
+            bytes[j] = char(decodeSymbol(reader, decodeTable));
+        }
+        if (reader.overran()) error("Compressed file has a truncated block.");
+        stats.bytesDecoded += numSymbols;
+        searchBytes(bytes);
+        return;
+    }
+
+    // a match crossing into the stream ends in its first bytes with a
+    //   proper suffix of the pattern, which few of them start with
+    std::string head(patternLength - 1, '\0');
+    for (long j = 0; j < patternLength - 1; j++) {
+        head[j] = char(decodeSymbol(reader, decodeTable));
+    }
+    stats.bytesDecoded += patternLength - 1;
+    long before = tailPending ? patternLength - 1 : long(context.length());
+    bool mayCross = false;
+    for (long k = 1; k <= before && !mayCross; k++) {
+        mayCross = pattern.compare(k, patternLength - k, head, 0, patternLength - k) == 0;
+    }
+    if (mayCross) {
+        if (tailPending) resolveTail();
+        std::string text = context + head;
+        for (size_t i = 0; i < context.length(); i++) {
+            if (text.compare(i, patternLength, pattern) == 0) {
+                matches.add(offset - long(context.length()) + long(i));
+            }
+        }
+    }
+
+    if (searchable) {
+        std::vector<long long> candidates;
+        findEncodedPattern(data, size, encoded, candidates);
+        stats.bytesScanned += size;
+        reader.init(data, data + size);
+        long long bit = 0;
+        long count = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            while (bit < candidates[i] && count < numSymbols) {
+                unsigned short entry = decodeTable[reader.peek()];
+                if (entry == 0) error("Compressed file contains an invalid code.");
+                reader.skip(entry >> 8);
+                bit += entry >> 8;
+                count++;
+            }
+            if (bit == candidates[i] && count + patternLength <= numSymbols) {
+                matches.add(offset + count);
+            }
+        }
+        stats.codesSkipped += count;
+    }
+
+    tailPending = true;
+    tailSource = &payload;
+    tailStart = start;
+    tailSize = size;
+    tailSymbols = numSymbols;
+    tailDecodeTable = decodeTable;
+    context.clear();
+    offset += numSymbols;
+}
+
+/* Member function: resolveTail
+ * --------------------------------------------------------
+ * Steps over all but the last patternLength - 1 codes of the stream
+ * whose end is the context, and decodes those.
+ */
+void LevelSearch::resolveTail() {
+    tailPending = false;
+    context.clear();
+    long keep = patternLength - 1;
+    if (keep == 0) return;
+    std::vector<unsigned short> rebuilt;
+    const unsigned short* decodeTable = tailDecodeTable;
+    if (decodeTable == NULL) {
+        rebuilt.resize(1 << LEVEL_MAX_CODE_LENGTH);
+        buildDecodeTable(tailTable, &rebuilt[0]);
+        decodeTable = &rebuilt[0];
+    }
+    const unsigned char* data = (const unsigned char*) tailSource->data() + tailStart;
+    BitReader reader;
+    reader.init(data, data + tailSize);
+    skipCodes(reader, decodeTable, tailSymbols - keep);
+    stats.codesSkipped += tailSymbols - keep;
+    context.assign(keep, '\0');
+    for (long j = 0; j < keep; j++) {
+        context[j] = char(decodeSymbol(reader, decodeTable));
+    }
+    stats.bytesDecoded += keep;
+    if (reader.overran()) error("Compressed file has a truncated block.");
+}
+
+/* Function: searchCompressed
+ * --------------------------------------------------------
+ * Reads the blocks one at a time, as decompressLeveled does, and hands
+ * each to a LevelSearch.
+ */
+Vector<long long> searchCompressed(std::istream& infile, const std::string& pattern,
+                                   SearchStats* stats) {
+    if (pattern.empty()) error("Cannot search for an empty pattern.");
+    if (readNumber(infile, 4) != LEVELS_MAGIC) error("File was not written by compress with options.");
+    int level = infile.get();
+    if (level < COMPRESSION_MIN_LEVEL || level > COMPRESSION_MAX_LEVEL) {
+        error("Compressed file has an invalid level.");
+    }
+    SearchStats local;
+    SearchStats& counts = (stats != NULL) ? *stats : local;
+    counts = SearchStats();
+    Vector<long long> matches;
+    LevelSearch search(pattern, matches, counts);
+
+    CodeTable table;
+    unsigned short decodeTable[1 << LEVEL_MAX_CODE_LENGTH];
+    bool haveTable = false;
+    while (true) {
+        int type = infile.get();
+        if (type == BLOCK_END) break;
+        if (type == EOF) error("Compressed file is truncated.");
+        long originalSize = long(readNumber(infile, 4));
+        long payloadSize = long(readNumber(infile, 4));
+        std::string payload(payloadSize, '\0');
+        if (payloadSize > 0) infile.read(&payload[0], payloadSize);
+        if (infile.gcount() != payloadSize) error("Compressed file is truncated.");
+
+        long position = 0;
+        std::string block;
+        switch (type) {
+        case BLOCK_STORED:
+            if (payloadSize != originalSize) error("Compressed file has a block of the wrong size.");
+            counts.bytesScanned += payloadSize;
+            search.searchBytes(payload);
+            break;
+        case BLOCK_HUFFMAN:
+            readTable(payload, position, table, decodeTable);
+            haveTable = true;
+            search.searchHuffmanBlock(payload, position, table, decodeTable, originalSize);
+            break;
+        case BLOCK_HUFFMAN_REPEAT:
+            if (!haveTable) error("Compressed file reuses a table it never sent.");
+            search.searchHuffmanBlock(payload, position, table, decodeTable, originalSize);
+            break;
+        case BLOCK_LZW:
+            block = lzwDecompress(payload);
+            if (block.length() != originalSize) error("Compressed file has a block of the wrong size.");
+            counts.bytesDecoded += originalSize;
+            search.searchBytes(block);
+            break;
+        default:
+            error("Compressed file has a block of unknown type.");
+        }
+    }
+    return matches;
+}
@@ -0,0 +1,69 @@
+/*******************************************************
+ * File: CompressedSearch.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Searching a file written by compress with options for a pattern
+ * without decompressing it.  The tables of the compression levels are
+ * canonical Huffman codes, so the pattern's bytes have fixed codes in
+ * each block, and the pattern can be looked for as a string of bits in
+ * the compressed streams.  Only where those bits occur does anything
+ * need decoding, and then only far enough to tell whether a code starts
+ * there.  On data where the pattern is rare, this is many times faster
+ * than decompressing and searching the output.
+ */
+
+#ifndef CompressedSearch_Included
+#define CompressedSearch_Included
+
+#include "vector.h"
+#include <iostream>
+#include <string>
+
+/* Type: SearchStats
+ * How much work searchCompressed did, to show how much of a file it
+ *   searched without decompressing it.
+ */
+struct SearchStats {
+    /* The compressed bytes searched for the pattern's codes. */
+    long long bytesScanned;
+
+    /* The codes stepped over, without producing their bytes, to find
+     * where candidates start and where streams end.
+     */
+    long long codesSkipped;
+
+    /* The bytes decompressed: whole blocks that could not be searched
+     * compressed, and the ends of streams, where matches may cross.
+     */
+    long long bytesDecoded;
+
+    /* Sets every count to zero. */
+    SearchStats();
+};
+
+/* Function: searchCompressed
+ * Usage: Vector<long long> offsets = searchCompressed(infile, pattern);
+ * --------------------------------------------------------
+ * Returns where pattern occurs in the decompressed contents of a file
+ * written by compress with options, overlapping occurrences included,
+ * in increasing order, mostly without decompressing it.  The pattern is
+ * encoded with each Huffman block's table and the block's streams are
+ * searched for the encoded bits at all eight alignments; a place where
+ * they occur is a match only if a code starts there, which is found by
+ * stepping over the codes before it.  A pattern with a byte the block
+ * never uses cannot occur inside it at all.  Only the few bytes at each
+ * end of a stream are decoded, to find matches that cross from one
+ * stream or block into the next, and the stream before is only stepped
+ * through when the start of the next could finish a match.  Stored
+ * blocks are searched as they are, and LZW blocks and patterns whose
+ * codes are shorter than two bytes are searched by decoding.  Reports
+ * an error if the pattern is empty or the file is damaged, though
+ * damage in what it does not decode may go unnoticed.  If stats is not
+ * NULL, it is filled in with how much work was done.
+ */
+Vector<long long> searchCompressed(std::istream& infile, const std::string& pattern,
+                                   SearchStats* stats = NULL);
+
+#endif
@@ -0,0 +1,933 @@
+/**********************************************************
+ * File: CompressionLevels.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of compression levels from CompressionLevels.h: the
+ * codec itself, compressing one stream at a time, and the
+ * deadline-driven compressor.  The file format, and what this file
+ * shares with BatchCompression.cpp and CompressedSearch.cpp, are in
+ * CompressionLevelsInternal.h.
+ */
+
+#include <cstdio>
+#include <exception>
+#include <sstream>
+#include <string>
+#include "CompressionLevels.h"
+#include "CompressionLevelsInternal.h"
+#include "HuffmanEncoding.h"
+#include "LZWEncoding.h"
+#include "BinaryIO.h"
+#include "Checksum.h"
+#include "SPSCRing.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+#include "Tracing.h"
+#include "error.h"
+
+/* Constant: LEVEL_SETTINGS
+ * The settings for each level, starting at COMPRESSION_MIN_LEVEL.
+ */
+static const LevelSettings LEVEL_SETTINGS[COMPRESSION_MAX_LEVEL] = {
+    { 1024 * 1024, 16, 1, false, false },
+    { 1024 * 1024, 8, 1, false, false },
+    { 1024 * 1024, 4, 1, false, false },
+    { 1024 * 1024, 1, 4, false, false },
+    { 256 * 1024, 1, 4, false, false },
+    { 128 * 1024, 1, 4, true, false },
+    { 128 * 1024, 1, 4, true, true },
+    { 256 * 1024, 1, 4, true, true },
+    { 1024 * 1024, 1, 4, true, true }
+};
+
+/* Constant: LEVEL_THROUGHPUT
+ * The compression speed of each level in megabytes of input per second,
+ *   from the measurements on text in CompressionLevels.h, rounded down.
+ *   compressWithDeadline starts from these and refines them as it goes.
+ */
+static const double LEVEL_THROUGHPUT[COMPRESSION_MAX_LEVEL] = {
+    150, 150, 150, 150, 140, 130, 3, 3, 3
+};
+
+/* Constants: DEADLINE_BLOCK_SIZE, DEADLINE_SAFETY_FACTOR
+ * compressWithDeadline works in blocks of this many bytes, so that it
+ *   can change level often, and plans to use only this fraction of the
+ *   time left, since the speeds it projects with are only estimates.
+ */
+static const long DEADLINE_BLOCK_SIZE = 128 * 1024;
+static const double DEADLINE_SAFETY_FACTOR = 0.8;
+
+/* Class: BitWriter
+ * --------------------------------------------------------
+ * Appends codes to a string most significant bit first, four bytes at a
+ * time, without going through obstream.
+ */
+class BitWriter {
+public:
+    BitWriter(std::string& output) : output(output), buffer(0), numBits(0) {}
+
+    void write(unsigned long code, int length) {
+        buffer = (buffer << length) | code;
+        numBits += length;
+        if (numBits >= 32) {
+            numBits -= 32;
+            char bytes[4] = { char(buffer >> (numBits + 24)), char(buffer >> (numBits + 16)),
+                              char(buffer >> (numBits + 8)), char(buffer >> numBits) };
+            output.append(bytes, 4);
+        }
+    }
+
+    void flush() {
+        while (numBits >= 8) {
+            numBits -= 8;
+            output += char(buffer >> numBits);
+        }
+        if (numBits > 0) output += char(buffer << (8 - numBits));
+        numBits = 0;
+    }
+
+private:
+    std::string& output;
+    unsigned long long buffer;   // the low numBits bits are pending
+    int numBits;
+};
+
+/* Constructor: CompressionOptions
+ * --------------------------------------------------------
+ * Defaults to the middle of the range.
+ */
+CompressionOptions::CompressionOptions() {
+    level = COMPRESSION_DEFAULT_LEVEL;
+    blockSize = 0;
+    numThreads = 1;
+    maxBufferedBytes = 0;
+}
+
+/* Function: countSymbols
+ * Usage: countSymbols(block, step, counts);
+ * --------------------------------------------------------
+ * Counts every step-th byte of the block into counts.
+ */
+static void countSymbols(const std::string& block, int step, long counts[]) {
+    for (int i = 0; i < NUM_SYMBOLS; i++) {
+        counts[i] = 0;
+    }
+    const unsigned char* data = (const unsigned char*) block.data();
+    for (long i = 0; i < long(block.length()); i += step) {
+        counts[data[i]]++;
+    }
+}
+
+/* Function: assignCodes
+ * Usage: assignCodes(table);
+ * --------------------------------------------------------
+ * Hands out canonical prefixes for the lengths in the table, in order of
+ * increasing length and then of increasing byte value, the same way
+ * buildCanonicalTree does.
+ */
+static void assignCodes(CodeTable& table) {
+    unsigned long code = 0;
+    for (int length = 1; length <= LEVEL_MAX_CODE_LENGTH; length++) {
+        for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+            if (table.lengths[symbol] == length) table.codes[symbol] = code++;
+        }
+        code <<= 1;
+    }
+}
+
+/* Function: buildCodeTable
+ * Usage: buildCodeTable(counts, table);
+ * --------------------------------------------------------
+ * Builds a Huffman tree on the counts, reads off its code lengths and
+ * limits them to LEVEL_MAX_CODE_LENGTH bits.  At least one count must be
+ * nonzero.
+ */
+static void buildCodeTable(const long counts[], CodeTable& table) {
+    Map<ext_char, int> frequencies;
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        if (counts[symbol] > 0) frequencies[symbol] = int(counts[symbol]);
+    }
+    Node* tree = buildEncodingTree(frequencies);
+    Map<ext_char, int> lengths;
+    encTreeToCodeLengths(tree, lengths, 0);
+    freeTree(tree);
+    limitCodeLengths(lengths, frequencies, LEVEL_MAX_CODE_LENGTH);
+
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        table.lengths[symbol] = lengths.containsKey(symbol) ? lengths[symbol] : 0;
+    }
+    assignCodes(table);
+}
+
+/* Function: encodedBits
+ * Usage: long long bits = encodedBits(counts, table);
+ * --------------------------------------------------------
+ * Returns how many bits the table needs for bytes with the given counts,
+ * or -1 if one of them has no prefix in the table.
+ */
+static long long encodedBits(const long counts[], const CodeTable& table) {
+    long long bits = 0;
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        if (counts[symbol] == 0) continue;
+        if (table.lengths[symbol] == 0) return -1;
+        bits += (long long) counts[symbol] * table.lengths[symbol];
+    }
+    return bits;
+}
+
+/* Function: segmentLength
+ * Usage: long length = segmentLength(blockSize, numStreams, i);
+ * --------------------------------------------------------
+ * Rounds the segment length up, so that only the last segment is short.
+ */
+long segmentLength(long blockSize, int numStreams, int i) {
+    long segment = (blockSize + numStreams - 1) / numStreams;
+    long start = segment * i;
+    if (start >= blockSize) return 0;
+    return (blockSize - start < segment) ? blockSize - start : segment;
+}
+
+/* Function: encodeHuffmanPayload
+ * Usage: string payload = encodeHuffmanPayload(block, table, numStreams, withTable);
+ * --------------------------------------------------------
+ * Encodes the block with the table as described at the top of this file.
+ */
+static std::string encodeHuffmanPayload(const std::string& block, const CodeTable& table,
+                                        int numStreams, bool withTable) {
+    std::ostringstream payload;
+    if (withTable) {
+        for (int symbol = 0; symbol < NUM_SYMBOLS; symbol += 2) {
+            payload.put(char((table.lengths[symbol] << 4) | table.lengths[symbol + 1]));
+        }
+    }
+    payload.put(char(numStreams));
+
+    const unsigned char* data = (const unsigned char*) block.data();
+    std::string streams[MAX_STREAMS];
+    long start = 0;
+    for (int i = 0; i < numStreams; i++) {
+        long length = segmentLength(block.length(), numStreams, i);
+        streams[i].reserve(length);
+        BitWriter writer(streams[i]);
+        for (long j = start; j < start + length; j++) {
+            writer.write(table.codes[data[j]], table.lengths[data[j]]);
+        }
+        writer.flush();
+        start += length;
+    }
+    for (int i = 0; i < numStreams - 1; i++) {
+        writeNumber(payload, streams[i].length(), 4);
+    }
+    for (int i = 0; i < numStreams; i++) {
+        payload << streams[i];
+    }
+    return payload.str();
+}
+
+/* Function: writeBlock
+ * Usage: writeBlock(outfile, type, originalSize, payload);
+ * --------------------------------------------------------
+ * Writes one block header followed by its payload.
+ */
+static void writeBlock(std::ostream& outfile, BlockType type, long originalSize,
+                       const std::string& payload) {
+    outfile.put(char(type));
+    writeNumber(outfile, originalSize, 4);
+    writeNumber(outfile, payload.length(), 4);
+    outfile << payload;
+}
+
+/* Type: TableState
+ * The encoder's record of the last table the decoder has been sent,
+ *   which later blocks may reuse.
+ */
+struct TableState {
+    CodeTable previous;
+    bool havePrevious;
+};
+
+/* Function: recordBlockStats
+ * Usage: recordBlockStats(block, type, table, numStreams, payload, stats);
+ * --------------------------------------------------------
+ * Adds a block to the statistics: its bytes, its codes if it was Huffman
+ * coded with the given table, and its size, of which the block header
+ * and, for Huffman blocks, the code table and the stream sizes count as
+ * header.
+ */
+static void recordBlockStats(const std::string& block, int type, const CodeTable& table,
+                             int numStreams, const std::string& payload, CompressionStats& stats) {
+    long counts[NUM_SYMBOLS];
+    countSymbols(block, 1, counts);
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        stats.symbolCounts[symbol] += counts[symbol];
+        if (type == BLOCK_HUFFMAN || type == BLOCK_HUFFMAN_REPEAT) {
+            stats.addCodes(counts[symbol], table.lengths[symbol]);
+        }
+    }
+    stats.uncompressedBytes += block.length();
+    stats.compressedBytes += BLOCK_HEADER_BYTES + payload.length();
+    stats.headerBytes += BLOCK_HEADER_BYTES;
+    if (type == BLOCK_HUFFMAN) stats.headerBytes += TABLE_BYTES;
+    if (type == BLOCK_HUFFMAN || type == BLOCK_HUFFMAN_REPEAT) {
+        stats.headerBytes += 1 + 4 * (numStreams - 1);
+    }
+}
+
+/* Function: compressLevelBlock
+ * Usage: compressLevelBlock(block, settings, state, outfile, stats);
+ * --------------------------------------------------------
+ * Writes one block, as whichever of the encodings the settings allow
+ * comes out smallest:
+ *
+ *   - At the sampling levels, the sampled counts predict the size of the
+ *     encoded block, and blocks predicted not to shrink are stored
+ *     without being encoded at all.
+ *
+ *   - When tables may be reused, the previous table is kept if the block
+ *     takes no more bits with it than with its own table plus the cost
+ *     of sending that table.
+ *
+ *   - Any block whose encoding does not come out smaller is stored.
+ *
+ * The block size in the settings is ignored; the caller decides it.
+ * If stats is not NULL, the block's stages are timed and it is added to
+ * the statistics.
+ */
+static void compressLevelBlock(const std::string& block, const LevelSettings& settings,
+                               TableState& state, std::ostream& outfile,
+                               CompressionStats* stats) {
+    StageTimer timer(stats);
+    timer.start(STATS_HISTOGRAM);
+    long blockSize = block.length();
+    long counts[NUM_SYMBOLS];
+    countSymbols(block, settings.sampleStep, counts);
+    if (settings.sampleStep > 1) {
+        // every byte must have a prefix, even those the sample missed
+        for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+            if (counts[symbol] == 0) counts[symbol] = 1;
+        }
+    }
+    timer.start(STATS_TREE);
+    CodeTable table;
+    buildCodeTable(counts, table);
+
+    timer.start(STATS_TABLE);
+    BlockType type = BLOCK_HUFFMAN;
+    std::string payload;
+    if (settings.sampleStep > 1) {
+        long long predictedBytes = encodedBits(counts, table) * settings.sampleStep / 8;
+        if (predictedBytes + TABLE_BYTES >= blockSize) type = BLOCK_STORED;
+    }
+    if (type != BLOCK_STORED && settings.reuseTables && state.havePrevious) {
+        long long ownBits = encodedBits(counts, table) + TABLE_BYTES * 8;
+        long long previousBits = encodedBits(counts, state.previous);
+        if (previousBits >= 0 && previousBits <= ownBits) type = BLOCK_HUFFMAN_REPEAT;
+    }
+
+    timer.start(STATS_ENCODE);
+    if (type == BLOCK_HUFFMAN) {
+        payload = encodeHuffmanPayload(block, table, settings.numStreams, true);
+        state.previous = table;
+        state.havePrevious = true;
+    } else if (type == BLOCK_HUFFMAN_REPEAT) {
+        payload = encodeHuffmanPayload(block, state.previous, settings.numStreams, false);
+    }
+
+    if (type != BLOCK_STORED && settings.tryLZW) {
+        LZWOptions lzwOptions;
+        lzwOptions.huffmanCodes = true;
+        std::string lzwPayload = lzwCompress(block, lzwOptions);
+        if (lzwPayload.length() < payload.length()) {
+            // the decoder only remembers tables it has been sent, so a
+            //   new table that is not sent after all must be forgotten
+            if (type == BLOCK_HUFFMAN) state.havePrevious = false;
+            type = BLOCK_LZW;
+            payload = lzwPayload;
+        }
+    }
+    if (type == BLOCK_STORED || payload.length() >= blockSize) {
+        if (type == BLOCK_HUFFMAN) state.havePrevious = false;
+        type = BLOCK_STORED;
+        payload = block;
+    }
+    timer.start(STATS_FLUSH);
+    writeBlock(outfile, type, blockSize, payload);
+    timer.stop();
+
+    if (stats != NULL) recordBlockStats(block, type, state.previous, settings.numStreams, payload, *stats);
+}
+
+/* Function: readInputBlock
+ * Usage: if (readInputBlock(infile, blockSize, block)) ...
+ * --------------------------------------------------------
+ * Reads up to blockSize bytes into block.  Returns false once the input
+ * is used up.
+ */
+static bool readInputBlock(std::istream& infile, long blockSize, std::string& block) {
+    if (!infile) return false;
+    block.resize(blockSize);
+    infile.read(&block[0], blockSize);
+    block.resize(infile.gcount());
+    return !block.empty();
+}
+
+/* Constant: BLOCKS_PER_THREAD
+ * How many blocks of input are read ahead for each thread unless the
+ *   options say otherwise, so that a slow block holds up fewer of the
+ *   rest.
+ */
+static const int BLOCKS_PER_THREAD = 2;
+
+/* Function: compressLevelBlockAlone
+ * Usage: compressLevelBlockAlone(block, settings);
+ * --------------------------------------------------------
+ * Starts compressLevelBlock with no previous table, catching any error.
+ */
+void compressLevelBlockAlone(LevelBlock& block, const LevelSettings& settings) {
+    TRACE_SCOPE("level-compress");
+    TableState state;
+    state.havePrevious = false;
+    if (block.wantChecksum) block.checksum = crc32(block.input.data(), block.input.length());
+    std::ostringstream blockOutput;
+    try {
+        compressLevelBlock(block.input, settings, state, blockOutput,
+                           block.wantStats ? &block.stats : NULL);
+        block.output = blockOutput.str();
+    } catch (ErrorException& ex) {
+        block.errorMessage = ex.getMessage();
+    } catch (std::exception& ex) {
+        block.errorMessage = ex.what();
+    }
+    std::string().swap(block.input);
+}
+
+/* Type: LevelPipeline
+ * What the stages of compressInPipeline share.  Block n of the input
+ *   goes to worker n % numWorkers through toWorkers[n % numWorkers] and
+ *   comes back through fromWorkers[n % numWorkers], so that every ring
+ *   has one thread pushing and one popping, and the writer gets the
+ *   blocks back in order by visiting the workers in turn.  A NULL block
+ *   follows the last one through every ring.
+ */
+struct LevelPipeline {
+    std::istream* input;
+    const LevelSettings* settings;
+    bool wantStats;
+    Vector<SPSCRing<LevelBlock*>*> toWorkers;
+    Vector<SPSCRing<LevelBlock*>*> fromWorkers;
+    CompressionStats readStats;   // the reader's time, charged to counting
+    std::string readError;        // set before the reader's NULL blocks
+};
+
+/* Type: LevelPipelineWorker
+ * Which worker an encode thread of a LevelPipeline is.
+ */
+struct LevelPipelineWorker {
+    LevelPipeline* pipeline;
+    int index;
+};
+
+/* Function: runPipelineReader
+ * Usage: Thread reader = fork(runPipelineReader, pipeline);
+ * --------------------------------------------------------
+ * The reader stage: reads the input a block at a time and deals the
+ * blocks out to the workers, waiting whenever the next worker's ring is
+ * full.
+ */
+static void runPipelineReader(LevelPipeline& pipeline) {
+    TRACE_THREAD_NAME("pipeline reader");
+    StageTimer timer(pipeline.wantStats ? &pipeline.readStats : NULL);
+    int numWorkers = pipeline.toWorkers.size();
+    for (long n = 0; true; n++) {
+        LevelBlock* block = new LevelBlock;
+        timer.start(STATS_HISTOGRAM);
+        bool more;
+        {
+            TRACE_SCOPE("read");
+            more = readInputBlock(*pipeline.input, pipeline.settings->blockSize, block->input);
+        }
+        timer.stop();
+        if (!more) {
+            delete block;
+            if (pipeline.input->bad()) pipeline.readError = "Cannot read the input.";
+            break;
+        }
+        block->size = block->input.length();
+        block->wantStats = pipeline.wantStats;
+        block->wantChecksum = false;
+        pipeline.toWorkers[n % numWorkers]->push(block);
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        pipeline.toWorkers[i]->push(NULL);
+    }
+}
+
+/* Function: runPipelineWorker
+ * Usage: Thread thread = fork(runPipelineWorker, worker);
+ * --------------------------------------------------------
+ * An encode stage: compresses each block from its ring and passes it
+ * on, waiting whenever the writer has fallen behind.
+ */
+static void runPipelineWorker(LevelPipelineWorker& worker) {
+    TRACE_THREAD_NAME("pipeline worker");
+    LevelPipeline& pipeline = *worker.pipeline;
+    while (true) {
+        LevelBlock* block = pipeline.toWorkers[worker.index]->pop();
+        if (block != NULL) compressLevelBlockAlone(*block, *pipeline.settings);
+        pipeline.fromWorkers[worker.index]->push(block);
+        if (block == NULL) break;
+    }
+}
+
+/* Function: compressInPipeline
+ * Usage: compressInPipeline(infile, outfile, settings, level, numThreads, maxBufferedBytes, stats);
+ * --------------------------------------------------------
+ * Compresses one stream in three stages that overlap: a reader thread
+ * cutting the input into blocks, numThreads workers compressing them,
+ * and the calling thread writing them out in order.  The stages are
+ * joined by SPSCRings sized so that about maxBufferedBytes of blocks are
+ * in the rings at once; once they fill up, the fastest stage waits for
+ * the slowest, so throughput is that of the slowest of reading,
+ * compressing and writing.  Errors are reported once every stage has
+ * finished.
+ */
+static void compressInPipeline(std::istream& infile, std::ostream& outfile,
+                               const LevelSettings& settings, int level, int numThreads,
+                               long long maxBufferedBytes, CompressionStats* stats) {
+    // every block in flight sits in one of the two rings of its worker
+    long long ringBlocks = maxBufferedBytes / settings.blockSize / (2 * numThreads);
+    int capacity = int(ringBlocks < 1 ? 1 : ringBlocks > 1024 ? 1024 : ringBlocks);
+
+    LevelPipeline pipeline;
+    pipeline.input = &infile;
+    pipeline.settings = &settings;
+    pipeline.wantStats = (stats != NULL);
+    Vector<LevelPipelineWorker> workers(numThreads);
+    for (int i = 0; i < numThreads; i++) {
+        pipeline.toWorkers.add(new SPSCRing<LevelBlock*>(capacity));
+        pipeline.fromWorkers.add(new SPSCRing<LevelBlock*>(capacity));
+        workers[i].pipeline = &pipeline;
+        workers[i].index = i;
+    }
+    Thread reader = fork(runPipelineReader, pipeline);
+    Vector<Thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.add(fork(runPipelineWorker, workers[i]));
+    }
+
+    StageTimer timer(stats);
+    timer.start(STATS_FLUSH);
+    writeNumber(outfile, LEVELS_MAGIC, 4);
+    outfile.put(char(level));
+    timer.stop();
+    std::string message;
+    for (long n = 0; true; n++) {
+        LevelBlock* block;
+        {
+            TRACE_SCOPE("wait");
+            block = pipeline.fromWorkers[n % numThreads]->pop();
+        }
+        if (block == NULL) break;
+        // after an error the rest of the blocks are only drained, so that
+        //   every stage can finish
+        if (message.empty()) message = block->errorMessage;
+        if (message.empty()) {
+            TRACE_SCOPE("write");
+            timer.start(STATS_FLUSH);
+            outfile.write(block->output.data(), block->output.length());
+            if (stats != NULL) stats->add(block->stats);
+            timer.stop();
+        }
+        delete block;
+    }
+    outfile.put(char(BLOCK_END));
+
+    join(reader);
+    for (int i = 0; i < numThreads; i++) {
+        join(threads[i]);
+        delete pipeline.toWorkers[i];
+        delete pipeline.fromWorkers[i];
+    }
+    if (stats != NULL) stats->add(pipeline.readStats);
+    if (message.empty()) message = pipeline.readError;
+    if (!message.empty()) error(message);
+}
+
+/* Function: checkCompressionOptions
+ * Usage: LevelSettings settings = checkCompressionOptions(options, numThreads, maxBufferedBytes);
+ * --------------------------------------------------------
+ * Unless the options say otherwise, buffers BLOCKS_PER_THREAD blocks
+ * for each thread.
+ */
+LevelSettings checkCompressionOptions(const CompressionOptions& options, int& numThreads,
+                                      long long& maxBufferedBytes) {
+    if (options.level < COMPRESSION_MIN_LEVEL || options.level > COMPRESSION_MAX_LEVEL) {
+        error("Compression level is out of range.");
+    }
+    if (options.blockSize < 0 || options.blockSize > MAX_LEVEL_BLOCK_SIZE) {
+        error("Compression block size is out of range.");
+    }
+    if (options.numThreads < 0) error("Number of compression threads is out of range.");
+    if (options.maxBufferedBytes < 0) error("Compression buffer size is out of range.");
+    LevelSettings settings = LEVEL_SETTINGS[options.level - COMPRESSION_MIN_LEVEL];
+    if (options.blockSize != 0) settings.blockSize = options.blockSize;
+    numThreads = (options.numThreads == 0) ? defaultThreadCount() : options.numThreads;
+    maxBufferedBytes = options.maxBufferedBytes;
+    if (maxBufferedBytes == 0) {
+        maxBufferedBytes = (long long) settings.blockSize * numThreads * BLOCKS_PER_THREAD;
+    }
+    return settings;
+}
+
+/* Function: compress
+ * Usage: compress(infile, outfile, options);
+ * --------------------------------------------------------
+ * Cuts the input into blocks of the level's size, or the size the
+ * options ask for, and compresses each with compressLevelBlock, either
+ * in turn or in a pipeline of threads.
+ */
+void compress(std::istream& infile, std::ostream& outfile, const CompressionOptions& options,
+              CompressionStats* stats) {
+    int numThreads;
+    long long maxBufferedBytes;
+    LevelSettings settings = checkCompressionOptions(options, numThreads, maxBufferedBytes);
+
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(stats, local);
+    StageTimer timer(active);
+
+    if (numThreads > 1) {
+        compressInPipeline(infile, outfile, settings, options.level, numThreads,
+                           maxBufferedBytes, active);
+    } else {
+        writeNumber(outfile, LEVELS_MAGIC, 4);
+        outfile.put(char(options.level));
+        TableState state;
+        state.havePrevious = false;
+        std::string block;
+        while (true) {
+            // reading the input is charged to counting it, as in compress
+            //   without options
+            timer.start(STATS_HISTOGRAM);
+            bool more;
+            {
+                TRACE_SCOPE("read");
+                more = readInputBlock(infile, settings.blockSize, block);
+            }
+            timer.stop();
+            if (!more) break;
+            compressLevelBlock(block, settings, state, outfile, active);
+        }
+        outfile.put(char(BLOCK_END));
+    }
+
+    if (active != NULL) {
+        active->compressedBytes += FILE_HEADER_BYTES;
+        active->headerBytes += FILE_HEADER_BYTES;
+        finishCompressionStats(STATS_COMPRESSION, active);
+    }
+}
+
+/* Constructor: DeadlineStats
+ * --------------------------------------------------------
+ * Starts every count at zero.
+ */
+DeadlineStats::DeadlineStats() {
+    level = 0;
+    for (int i = 0; i <= COMPRESSION_MAX_LEVEL; i++) {
+        bytesAtLevel[i] = 0;
+    }
+    bytesIn = 0;
+    bytesOut = 0;
+    seconds = 0;
+    metDeadline = true;
+}
+
+/* Function: compressWithDeadline
+ * Usage: compressWithDeadline(infile, outfile, budgetSeconds, &stats);
+ * --------------------------------------------------------
+ * Before each block, divides the bytes still to come by each level's
+ * expected speed to project how long the rest of the input would take
+ * at that level.  The level moves up one step at a time while the next
+ * level's projection fits in the time left, and back down while the
+ * current one's does not.  When not even the lowest level fits, the
+ * block is stored.  After each block, the level's expected speed is
+ * averaged with the speed just measured, so the projections adapt to
+ * the machine and the data.
+ */
+void compressWithDeadline(ibstream& infile, obstream& outfile, double budgetSeconds,
+                          DeadlineStats* stats) {
+    double start = currentTime();
+    DeadlineStats result;
+
+    // bytes per second at each level, starting from LEVEL_THROUGHPUT
+    double speed[COMPRESSION_MAX_LEVEL + 1];
+    for (int level = COMPRESSION_MIN_LEVEL; level <= COMPRESSION_MAX_LEVEL; level++) {
+        speed[level] = LEVEL_THROUGHPUT[level - COMPRESSION_MIN_LEVEL] * 1e6;
+    }
+
+    // the bytes still to come are known when the input is seekable; when
+    //   it is not, the projection only covers the block at hand
+    long long totalSize = -1;
+    std::streampos position = infile.tellg();
+    if (position != std::streampos(-1)) {
+        infile.seekg(0, std::ios::end);
+        totalSize = (long long) (infile.tellg() - position);
+        infile.seekg(position);
+    }
+    infile.clear();
+
+    writeNumber(outfile, LEVELS_MAGIC, 4);
+    outfile.put(char(COMPRESSION_MIN_LEVEL));
+    long long bytesOut = 5;
+
+    // there is no CompressionStats parameter, but the global registry
+    //   still sees the blocks
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(NULL, local);
+
+    TableState state;
+    state.havePrevious = false;
+    int level = COMPRESSION_MIN_LEVEL;
+    std::string block;
+    while (readInputBlock(infile, DEADLINE_BLOCK_SIZE, block)) {
+        double blockStart = currentTime();
+        double timeLeft = (budgetSeconds - (blockStart - start)) * DEADLINE_SAFETY_FACTOR;
+        double bytesLeft = (totalSize >= 0) ? double(totalSize - result.bytesIn) : double(block.length());
+
+        while (level < COMPRESSION_MAX_LEVEL && bytesLeft / speed[level + 1] <= timeLeft) {
+            level++;
+        }
+        while (level > COMPRESSION_MIN_LEVEL && bytesLeft / speed[level] > timeLeft) {
+            level--;
+        }
+        int blockLevel = (bytesLeft / speed[level] <= timeLeft) ? level : 0;
+
+        std::ostringstream encoded;
+        if (blockLevel == 0) {
+            writeBlock(encoded, BLOCK_STORED, block.length(), block);
+            if (active != NULL) recordBlockStats(block, BLOCK_STORED, state.previous, 1, block, *active);
+        } else {
+            compressLevelBlock(block, LEVEL_SETTINGS[blockLevel - COMPRESSION_MIN_LEVEL],
+                               state, encoded, active);
+            double elapsed = currentTime() - blockStart;
+            if (elapsed > 0) speed[blockLevel] = (speed[blockLevel] + block.length() / elapsed) / 2;
+        }
+        outfile << encoded.str();
+        bytesOut += encoded.str().length();
+        result.bytesAtLevel[blockLevel] += block.length();
+        result.bytesIn += block.length();
+    }
+    outfile.put(char(BLOCK_END));
+
+    for (int i = 0; i <= COMPRESSION_MAX_LEVEL; i++) {
+        if (result.bytesAtLevel[i] > result.bytesAtLevel[result.level]) result.level = i;
+    }
+    result.bytesOut = bytesOut + 1;
+    result.seconds = currentTime() - start;
+    result.metDeadline = result.seconds <= budgetSeconds;
+    if (stats != NULL) *stats = result;
+    if (active != NULL) {
+        active->compressedBytes += FILE_HEADER_BYTES;
+        active->headerBytes += FILE_HEADER_BYTES;
+        finishCompressionStats(STATS_COMPRESSION, active);
+    }
+}
+
+/* Function: isLeveledCompression
+ * Usage: if (isLeveledCompression(infile)) ...
+ * --------------------------------------------------------
+ * Peeks at the first byte of the magic number.
+ */
+bool isLeveledCompression(std::istream& infile) {
+    return infile.peek() == int(LEVELS_MAGIC >> 24);
+}
+
+/* Function: buildDecodeTable
+ * Usage: buildDecodeTable(table, decodeTable);
+ * --------------------------------------------------------
+ * Fills the run of entries each prefix reaches, which is as long as the
+ * prefix is short.
+ */
+void buildDecodeTable(const CodeTable& table, unsigned short decodeTable[]) {
+    for (int i = 0; i < (1 << LEVEL_MAX_CODE_LENGTH); i++) {
+        decodeTable[i] = 0;
+    }
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        int length = table.lengths[symbol];
+        if (length == 0) continue;
+        int shift = LEVEL_MAX_CODE_LENGTH - length;
+        unsigned first = table.codes[symbol] << shift;
+        for (unsigned i = first; i < first + (1u << shift); i++) {
+            decodeTable[i] = (unsigned short) ((length << 8) | symbol);
+        }
+    }
+}
+
+/* Function: readTable
+ * Usage: readTable(payload, position, table, decodeTable);
+ * --------------------------------------------------------
+ * Unpacks the lengths, two to a byte, and checks that the prefixes they
+ * give do not take up more than the whole lookup table (Kraft's
+ * inequality) before assigning the canonical codes.
+ */
+void readTable(const std::string& payload, long& position, CodeTable& table,
+               unsigned short decodeTable[]) {
+    if (position + TABLE_BYTES > long(payload.length())) {
+        error("Compressed file has a truncated code table.");
+    }
+    long used = 0;
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol += 2) {
+        int packed = (unsigned char) payload[position++];
+        table.lengths[symbol] = packed >> 4;
+        table.lengths[symbol + 1] = packed & 0xF;
+    }
+    for (int symbol = 0; symbol < NUM_SYMBOLS; symbol++) {
+        int length = table.lengths[symbol];
+        if (length > LEVEL_MAX_CODE_LENGTH) error("Compressed file has an invalid code table.");
+        if (length > 0) used += 1L << (LEVEL_MAX_CODE_LENGTH - length);
+    }
+    if (used > (1L << LEVEL_MAX_CODE_LENGTH)) error("Compressed file has an invalid code table.");
+    assignCodes(table);
+    buildDecodeTable(table, decodeTable);
+}
+
+/* Function: readStreamSizes
+ * Usage: int numStreams = readStreamSizes(payload, position, streamSizes);
+ * --------------------------------------------------------
+ * The last stream's size is not written; it is whatever remains of the
+ * payload.
+ */
+int readStreamSizes(const std::string& payload, long& position, long streamSizes[]) {
+    if (position >= long(payload.length())) error("Compressed file has a truncated block.");
+    int numStreams = (unsigned char) payload[position++];
+    if (numStreams < 1 || numStreams > MAX_STREAMS) error("Compressed file has an invalid block.");
+
+    std::istringstream sizes(payload.substr(position, 4 * (numStreams - 1)));
+    long total = 0;
+    for (int i = 0; i < numStreams - 1; i++) {
+        streamSizes[i] = long(readNumber(sizes, 4));
+        total += streamSizes[i];
+    }
+    position += 4 * (numStreams - 1);
+    if (position + total > long(payload.length())) error("Compressed file has a truncated block.");
+    streamSizes[numStreams - 1] = payload.length() - position - total;
+    return numStreams;
+}
+
+/* Function: decodeHuffmanPayload
+ * Usage: string block = decodeHuffmanPayload(payload, position, decodeTable, originalSize);
+ * --------------------------------------------------------
+ * Decodes the streams that follow the table, if any.  The streams are
+ * decoded side by side, a byte from each in turn, so that the lookups
+ * for different streams do not have to wait on one another.
+ */
+static std::string decodeHuffmanPayload(const std::string& payload, long position,
+                                        const unsigned short decodeTable[], long originalSize) {
+    long streamSizes[MAX_STREAMS];
+    int numStreams = readStreamSizes(payload, position, streamSizes);
+
+    BitReader readers[MAX_STREAMS];
+    unsigned char* outputs[MAX_STREAMS];
+    long lengths[MAX_STREAMS];
+    std::string block(originalSize, '\0');
+    const unsigned char* data = (const unsigned char*) payload.data() + position;
+    long start = 0;
+    for (int i = 0; i < numStreams; i++) {
+        readers[i].init(data, data + streamSizes[i]);
+        data += streamSizes[i];
+        lengths[i] = segmentLength(originalSize, numStreams, i);
+        outputs[i] = (unsigned char*) &block[0] + start;
+        start += lengths[i];
+    }
+
+    // all segments but the last have the same length, so the last one
+    //   bounds how far the streams can be decoded together
+    long together = lengths[numStreams - 1];
+    for (long j = 0; j < together; j++) {
+        for (int i = 0; i < numStreams; i++) {
+            outputs[i][j] = decodeSymbol(readers[i], decodeTable);
+        }
+    }
+    for (int i = 0; i < numStreams; i++) {
+        for (long j = together; j < lengths[i]; j++) {
+            outputs[i][j] = decodeSymbol(readers[i], decodeTable);
+        }
+        if (readers[i].overran()) error("Compressed file has a truncated block.");
+    }
+    return block;
+}
+
+/* Function: decompressLeveled
+ * Usage: decompressLeveled(infile, outfile);
+ * --------------------------------------------------------
+ * Reads the blocks one at a time, remembering the last table sent for
+ * the blocks that reuse it.
+ */
+void decompressLeveled(std::istream& infile, std::ostream& outfile, CompressionStats* stats) {
+    if (readNumber(infile, 4) != LEVELS_MAGIC) error("File was not written by compress with options.");
+    int level = infile.get();
+    if (level < COMPRESSION_MIN_LEVEL || level > COMPRESSION_MAX_LEVEL) {
+        error("Compressed file has an invalid level.");
+    }
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(stats, local);
+    StageTimer timer(active);
+
+    CodeTable table;
+    unsigned short decodeTable[1 << LEVEL_MAX_CODE_LENGTH];
+    bool haveTable = false;
+    while (true) {
+        timer.start(STATS_DECODE);
+        int type = infile.get();
+        if (type == BLOCK_END) break;
+        if (type == EOF) error("Compressed file is truncated.");
+        long originalSize = long(readNumber(infile, 4));
+        long payloadSize = long(readNumber(infile, 4));
+        std::string payload(payloadSize, '\0');
+        if (payloadSize > 0) infile.read(&payload[0], payloadSize);
+        if (infile.gcount() != payloadSize) error("Compressed file is truncated.");
+
+        std::string block;
+        long position = 0;
+        switch (type) {
+        case BLOCK_STORED:
+            block = payload;
+            break;
+        case BLOCK_HUFFMAN:
+            timer.start(STATS_TABLE);
+            readTable(payload, position, table, decodeTable);
+            haveTable = true;
+            timer.start(STATS_DECODE);
+            block = decodeHuffmanPayload(payload, position, decodeTable, originalSize);
+            break;
+        case BLOCK_HUFFMAN_REPEAT:
+            if (!haveTable) error("Compressed file reuses a table it never sent.");
+            block = decodeHuffmanPayload(payload, position, decodeTable, originalSize);
+            break;
+        case BLOCK_LZW:
+            block = lzwDecompress(payload);
+            break;
+        default:
+            error("Compressed file has a block of unknown type.");
+        }
+        if (block.length() != originalSize) error("Compressed file has a block of the wrong size.");
+        timer.start(STATS_FLUSH);
+        outfile << block;
+        timer.stop();
+
+        if (active != NULL) {
+            int numStreams = (position < payloadSize) ? (unsigned char) payload[position] : 1;
+            recordBlockStats(block, type, table, numStreams, payload, *active);
+        }
+    }
+    timer.stop();
+
+    if (active != NULL) {
+        active->compressedBytes += FILE_HEADER_BYTES;
+        active->headerBytes += FILE_HEADER_BYTES;
+        finishCompressionStats(STATS_DECOMPRESSION, active);
+    }
+}
@@ -0,0 +1,188 @@
+/*******************************************************
+ * File: CompressionLevels.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Compression levels for the Huffman compressor.  Like gzip's -1 to -9,
+ * a single number trades speed for ratio:
+ *
+ *   - Levels 1 to 3 count only a sample of each block's bytes to build
+ *     its table, store blocks that would not shrink without encoding
+ *     them, and use large blocks with a single bit stream each.
+ *
+ *   - Levels 4 to 6 count every byte and write each block as four
+ *     independent bit streams that can be decoded side by side.  Level 6
+ *     also lets a block reuse the previous block's table when that costs
+ *     less than sending a new one.
+ *
+ *   - Levels 7 to 9 also try LZW with Huffman-coded output on every
+ *     block and keep whichever result is smaller.  Level 7 uses blocks
+ *     small enough for the tables to follow changes in the data; levels
+ *     8 and 9 use larger blocks that give LZW's dictionary more room.
+ *
+ * Blocks can also be compressed on several threads at once.  Each block
+ * then gets a table of its own, since no block may depend on another, so
+ * the output of levels 6 to 9 depends on the number of threads.  One
+ * thread reads the input ahead and the calling thread writes the output
+ * behind, so that reading, compressing and writing all overlap.  Many
+ * files can be compressed together by compressFiles, in
+ * BatchCompression.h, which shares one pool of threads among the blocks
+ * of all of them.
+ *
+ * Every level uses canonical Huffman codes limited to
+ * LEVEL_MAX_CODE_LENGTH bits, so a table is just a list of code lengths
+ * and is decoded a whole prefix at a time by table lookup rather than
+ * one bit at a time down the tree.  The same tables let searchCompressed,
+ * in CompressedSearch.h, look for a pattern's codes in the compressed
+ * bits themselves.
+ *
+ * Measured on one core at -O2, on eight copies of tomSawyer and of
+ * spl.jar from test/encodeDecode and on 3 MB of random bytes:
+ *
+ *   level   text (3092008 bytes)     binary (3303480 bytes)   random
+ *     1      1818850 at 175 MB/s      3285956 at 157 MB/s      820 MB/s
+ *     6      1770020 at 150 MB/s      3276446 at 118 MB/s      120 MB/s
+ *     9      1315722 at 3.9 MB/s      3281391 at 1.3 MB/s      1.2 MB/s
+ *
+ * compress without options gives 1766736 bytes for the text at about
+ * 2.6 MB/s.  Counting bytes is cheap next to encoding them, so sampling
+ * gains little on data that compresses; the low levels pay off on data
+ * that does not, which they store without encoding.  Huffman blocks of
+ * any level decompress at 130 to 210 MB/s, LZW blocks at LZW's speed.
+ */
+
+#ifndef CompressionLevels_Included
+#define CompressionLevels_Included
+
+#include "CompressionStats.h"
+#include "bstream.h"
+#include "vector.h"
+#include <iostream>
+#include <string>
+
+/* Constants: COMPRESSION_MIN_LEVEL, COMPRESSION_MAX_LEVEL, COMPRESSION_DEFAULT_LEVEL
+ * The range of compression levels and the level used by default.
+ */
+const int COMPRESSION_MIN_LEVEL = 1;
+const int COMPRESSION_MAX_LEVEL = 9;
+const int COMPRESSION_DEFAULT_LEVEL = 6;
+
+/* Constant: LEVEL_MAX_CODE_LENGTH
+ * The longest prefix any level will assign to a byte.  Decoders look
+ *   prefixes up in a table with 2^LEVEL_MAX_CODE_LENGTH entries.
+ */
+const int LEVEL_MAX_CODE_LENGTH = 12;
+
+/* Constant: MAX_LEVEL_BLOCK_SIZE
+ * The largest block size CompressionOptions may ask for.
+ */
+const long MAX_LEVEL_BLOCK_SIZE = 64L * 1024 * 1024;
+
+/* Type: CompressionOptions
+ * Settings for compress when called with options.
+ */
+struct CompressionOptions {
+    /* How hard to work, from COMPRESSION_MIN_LEVEL (fastest) to
+     * COMPRESSION_MAX_LEVEL (smallest output).
+     */
+    int level;
+
+    /* The number of input bytes per block, from 1 to
+     * MAX_LEVEL_BLOCK_SIZE, or 0 for the level's own block size.
+     */
+    long blockSize;
+
+    /* How many threads compress blocks at once, or 0 for one per
+     * processor.  With 1, blocks are compressed on the calling thread.
+     */
+    int numThreads;
+
+    /* With more than one thread, how many bytes of input may be read
+     * ahead of the output, or 0 for two blocks per thread.  One block
+     * is always read, however large.
+     */
+    long long maxBufferedBytes;
+
+    /* Sets level to COMPRESSION_DEFAULT_LEVEL, blockSize to 0,
+     * numThreads to 1 and maxBufferedBytes to 0.
+     */
+    CompressionOptions();
+};
+
+/* Function: compress
+ * Usage: compress(infile, outfile, options);
+ * --------------------------------------------------------
+ * Compresses everything remaining in infile at the level given by the
+ * options and writes the result to outfile.  The output is not in the
+ * format written by compress(infile, outfile), but decompress recognizes
+ * both.  Reports an error if the level, block size, number of threads or
+ * buffer size is out of range.  If stats is not NULL, it is filled in with
+ * statistics about the compression.  Unlike compress without options, it
+ * needs neither stream to seek, so it works on pipes.
+ */
+void compress(std::istream& infile, std::ostream& outfile, const CompressionOptions& options,
+              CompressionStats* stats = NULL);
+
+/* Type: DeadlineStats
+ * What compressWithDeadline did.
+ */
+struct DeadlineStats {
+    /* The level most of the input was compressed at, or 0 if most of it
+     * had to be stored for lack of time.
+     */
+    int level;
+
+    /* How many input bytes were compressed at each level, with index 0
+     * counting the bytes stored for lack of time.
+     */
+    long long bytesAtLevel[COMPRESSION_MAX_LEVEL + 1];
+
+    /* The number of bytes read and written. */
+    long long bytesIn;
+    long long bytesOut;
+
+    /* The time spent, in seconds, and whether it was within the budget. */
+    double seconds;
+    bool metDeadline;
+
+    /* Sets every count to zero. */
+    DeadlineStats();
+};
+
+/* Function: compressWithDeadline
+ * Usage: compressWithDeadline(infile, outfile, budgetSeconds, &stats);
+ * --------------------------------------------------------
+ * Compresses everything remaining in infile as well as it can within
+ * budgetSeconds.  Starts at the lowest level and moves to higher levels
+ * only while the time the rest of the input is projected to take at
+ * that level, from the speeds measured so far, stays within the budget.
+ * Once even the lowest level would run over, the remaining blocks are
+ * stored.  The output is read by decompress like that of compress with
+ * options.  If stats is not NULL, it is filled in with the levels chosen
+ * and the time taken.  Its compression statistics only go to the global
+ * registry (see CompressionStats.h).
+ */
+void compressWithDeadline(ibstream& infile, obstream& outfile, double budgetSeconds,
+                          DeadlineStats* stats = NULL);
+
+/* Function: isLeveledCompression
+ * Usage: if (isLeveledCompression(infile)) ...
+ * --------------------------------------------------------
+ * Returns whether the next byte of infile starts a file written by
+ * compress with options.  Nothing is consumed from the stream.
+ */
+bool isLeveledCompression(std::istream& infile);
+
+/* Function: decompressLeveled
+ * Usage: decompressLeveled(infile, outfile);
+ * --------------------------------------------------------
+ * Decompresses a file written by compress with options, whatever its
+ * level.  decompress calls this itself when it sees such a file.
+ * Reports an error if the file is damaged.  If stats is not NULL, it is
+ * filled in with statistics about the decompression.
+ */
+void decompressLeveled(std::istream& infile, std::ostream& outfile,
+                       CompressionStats* stats = NULL);
+
+#endif
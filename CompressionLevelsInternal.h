@@ -0,0 +1,260 @@
+/*******************************************************
+ * File: CompressionLevelsInternal.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * The parts of the compressor of CompressionLevels.h that its modules
+ * share: the file format, the code tables and the bit reader, and the
+ * functions that read tables and compress blocks.  CompressionLevels.cpp
+ * holds the codec itself, BatchCompression.cpp compresses many files at
+ * once with it, and CompressedSearch.cpp searches its output.  Nothing
+ * else should include this file.
+ *
+ * File format (all numbers big-endian):
+ *   - 4 bytes holding the magic number "HUFL".
+ *   - 1 byte holding the level the file was compressed at, or
+ *     COMPRESSION_MIN_LEVEL for compressWithDeadline, which changes level
+ *     from block to block.
+ *   - For each block: 1 byte holding its BlockType, 4 bytes holding its
+ *     original size, 4 bytes holding its payload size, and the payload.
+ *   - 1 byte holding BLOCK_END.
+ *
+ * The payload of a Huffman block is:
+ *   - For BLOCK_HUFFMAN only, 128 bytes holding the code length of each
+ *     of the 256 byte values in 4 bits, high nibble first; 0 means the
+ *     byte does not occur.  BLOCK_HUFFMAN_REPEAT blocks use the table of
+ *     the last BLOCK_HUFFMAN block instead.
+ *   - 1 byte holding the number of streams, n.
+ *   - 4 bytes holding the size of each of the first n - 1 streams.
+ *   - The streams.  The block is cut into n segments of equal length
+ *     (the last may be shorter) and stream i holds the canonical codes
+ *     of segment i, most significant bit first, padded with zeros to a
+ *     whole byte.
+ */
+
+#ifndef CompressionLevelsInternal_Included
+#define CompressionLevelsInternal_Included
+
+#include "CompressionLevels.h"
+#include "CompressionStats.h"
+#include "error.h"
+#include <cstddef>
+#include <string>
+
+/* Constant: LEVELS_MAGIC
+ * The magic number at the start of the file.  Files written by compress
+ *   without options start with a decimal digit, so the first byte alone
+ *   tells the two formats apart.
+ */
+const unsigned long LEVELS_MAGIC = 0x4855464C;   // "HUFL"
+
+/* Type: BlockType
+ * How a block is stored.  The values are written to block headers and
+ *   must not change.
+ */
+enum BlockType {
+    BLOCK_STORED = 0,
+    BLOCK_HUFFMAN = 1,
+    BLOCK_HUFFMAN_REPEAT = 2,
+    BLOCK_LZW = 3,
+    BLOCK_END = 0xFF
+};
+
+/* Constants: NUM_SYMBOLS, TABLE_BYTES, MAX_STREAMS
+ * The number of byte values, the size of a code length table, and the
+ *   most streams a block may be split into.
+ */
+const int NUM_SYMBOLS = 256;
+const int TABLE_BYTES = NUM_SYMBOLS / 2;
+const int MAX_STREAMS = 4;
+
+/* Constants: FILE_HEADER_BYTES, BLOCK_HEADER_BYTES
+ * The size of the magic number, level and end marker together, and the
+ *   size of a block header.
+ */
+const int FILE_HEADER_BYTES = 4 + 1 + 1;
+const int BLOCK_HEADER_BYTES = 1 + 4 + 4;
+
+/* Type: LevelSettings
+ * What each level does.
+ *
+ *   blockSize   - input bytes per block.
+ *   sampleStep  - only every sampleStep-th byte is counted when building
+ *                 a table; 1 counts them all.
+ *   numStreams  - how many bit streams each Huffman block is split into.
+ *   reuseTables - whether a block may reuse the previous table.
+ *   tryLZW      - whether LZW is tried on each block as well.
+ */
+struct LevelSettings {
+    long blockSize;
+    int sampleStep;
+    int numStreams;
+    bool reuseTables;
+    bool tryLZW;
+};
+
+/* Type: CodeTable
+ * A canonical code: the length of each byte's prefix (0 if the byte has
+ *   none) and the prefix itself in the low bits of code.
+ */
+struct CodeTable {
+    int lengths[NUM_SYMBOLS];
+    unsigned long codes[NUM_SYMBOLS];
+};
+
+/* Class: BitReader
+ * --------------------------------------------------------
+ * Reads bits from a range of bytes most significant bit first.  The
+ * pending bits are kept at the top of a 64-bit buffer so that the next
+ * LEVEL_MAX_CODE_LENGTH bits can be used directly as a table index.
+ * Reading past the end yields zeros and is counted, so that a damaged
+ * stream can be detected afterwards.
+ */
+class BitReader {
+public:
+    BitReader() : next(NULL), end(NULL), buffer(0), numBits(0), overrun(0) {}
+
+    void init(const unsigned char* start, const unsigned char* finish) {
+        next = start;
+        end = finish;
+        buffer = 0;
+        numBits = 0;
+        overrun = 0;
+    }
+
+    unsigned peek() {
+        if (numBits < LEVEL_MAX_CODE_LENGTH) refill();
+        return unsigned(buffer >> (64 - LEVEL_MAX_CODE_LENGTH));
+    }
+
+    void skip(int length) {
+        buffer <<= length;
+        numBits -= length;
+    }
+
+    bool overran() const {
+        return overrun > numBits;
+    }
+
+private:
+    const unsigned char* next;
+    const unsigned char* end;
+    unsigned long long buffer;
+    int numBits;
+    int overrun;                 // zero bits supplied past the end
+
+    void refill() {
+        while (numBits <= 56) {
+            unsigned long long byte = 0;
+            if (next < end) {
+                byte = *next++;
+            } else {
+                overrun += 8;
+            }
+            buffer |= byte << (56 - numBits);
+            numBits += 8;
+        }
+    }
+};
+
+/* Type: LevelBlock
+ * A block that has been read, or is being read, and has not yet been
+ *   written.  The first and last blocks of a file also start and end its
+ *   output; an empty file has a single block that is both.  In a
+ *   LevelBatch, the block is read in pieces of at most IO_BUFFER_SIZE,
+ *   and once done is set, under the lock the tasks share, its output,
+ *   error and statistics are ready.
+ */
+struct LevelBlock {
+    int file;
+    bool first;
+    bool last;
+    long long start;             // where it starts in the file
+    long size;
+    long submitted;              // how much of it reads were submitted for
+    int readsLeft;               // reads submitted and not yet complete
+    std::string input;
+    std::string output;
+    std::string errorMessage;
+    bool wantStats;
+    CompressionStats stats;
+    bool wantChecksum;
+    unsigned long checksum;      // of the input
+    bool done;
+};
+
+/* Function: segmentLength
+ * Usage: long length = segmentLength(blockSize, numStreams, i);
+ * --------------------------------------------------------
+ * Returns how many bytes of a block go into stream i.
+ */
+long segmentLength(long blockSize, int numStreams, int i);
+
+/* Function: buildDecodeTable
+ * Usage: buildDecodeTable(table, decodeTable);
+ * --------------------------------------------------------
+ * Fills in the lookup table for a code: every entry whose index starts
+ * with a byte's prefix holds the byte in its low 8 bits and the prefix
+ * length above them.  Entries no prefix reaches stay zero.  The table
+ * has 2^LEVEL_MAX_CODE_LENGTH entries.
+ */
+void buildDecodeTable(const CodeTable& table, unsigned short decodeTable[]);
+
+/* Function: readTable
+ * Usage: readTable(payload, position, table, decodeTable);
+ * --------------------------------------------------------
+ * Reads a code length table from the payload at position, moving
+ * position past it, and fills in the codes and the lookup table.
+ * Reports an error if the table is truncated or the lengths do not form
+ * a prefix code.
+ */
+void readTable(const std::string& payload, long& position, CodeTable& table,
+               unsigned short decodeTable[]);
+
+/* Function: readStreamSizes
+ * Usage: int numStreams = readStreamSizes(payload, position, streamSizes);
+ * --------------------------------------------------------
+ * Reads the number of streams that follow the table, if any, and their
+ * sizes into streamSizes, which must have room for MAX_STREAMS, and
+ * moves position to the first of them.  Returns the number of streams.
+ * Reports an error if they do not fit in the payload.
+ */
+int readStreamSizes(const std::string& payload, long& position, long streamSizes[]);
+
+/* Function: decodeSymbol
+ * Usage: output[i] = decodeSymbol(reader, decodeTable);
+ * --------------------------------------------------------
+ * Decodes one byte with a single table lookup.  Reports an error if no
+ * code starts with the next bits.
+ */
+inline unsigned char decodeSymbol(BitReader& reader, const unsigned short decodeTable[]) {
+    unsigned short entry = decodeTable[reader.peek()];
+    if (entry == 0) error("Compressed file contains an invalid code.");
+    reader.skip(entry >> 8);
+    return (unsigned char) (entry & 0xFF);
+}
+
+/* Function: compressLevelBlockAlone
+ * Usage: compressLevelBlockAlone(block, settings);
+ * --------------------------------------------------------
+ * Compresses a block's input into its output with a table of its own,
+ * so that it depends on no other block, and fills in its checksum and
+ * statistics if they are wanted.  An error in the block is recorded in
+ * it rather than reported.  The input is freed once it is no longer
+ * needed.
+ */
+void compressLevelBlockAlone(LevelBlock& block, const LevelSettings& settings);
+
+/* Function: checkCompressionOptions
+ * Usage: LevelSettings settings = checkCompressionOptions(options, numThreads, maxBufferedBytes);
+ * --------------------------------------------------------
+ * Reports an error if any of the options is out of range.  Otherwise
+ * returns the settings of the level with the block size the options
+ * ask for, and sets numThreads and maxBufferedBytes to the values the
+ * options stand for.
+ */
+LevelSettings checkCompressionOptions(const CompressionOptions& options, int& numThreads,
+                                      long long& maxBufferedBytes);
+
+#endif
@@ -0,0 +1,296 @@
+/**********************************************************
+ * File: CompressionStats.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the compression statistics from CompressionStats.h.
+ *
+ * The registry's on/off switch is read without taking the lock, so that
+ * a program that never turns it on pays only for reading one flag per
+ * call.  The totals themselves are only touched under the lock.
+ */
+
+#include "CompressionStats.h"
+#include "MemoryDiagnostics.h"
+#include "Timing.h"
+#include "Tracing.h"
+#include "thread.h"
+#include <cmath>
+#include <cstddef>
+
+/* Constant: STAGE_NAMES
+ * The name of each CompressionStage.
+ */
+static const char* const STAGE_NAMES[NUM_COMPRESSION_STAGES] = {
+    "histogram", "tree", "table", "encode", "decode", "flush"
+};
+
+/* Variables: registryEnabled, compressionTotals, decompressionTotals
+ * The state of the global registry.
+ */
+static volatile bool registryEnabled = false;
+static CompressionStats compressionTotals;
+static CompressionStats decompressionTotals;
+
+/* Function: registryLock
+ * Usage: synchronized (registryLock()) ...
+ * --------------------------------------------------------
+ * Returns the lock guarding the totals.  It is made the first time it
+ * is needed rather than at startup, since Locks need the thread library
+ * to be running.
+ */
+static Lock& registryLock() {
+    static Lock lock;
+    return lock;
+}
+
+/* Function: compressionStageName
+ * Usage: string name = compressionStageName(stage);
+ * --------------------------------------------------------
+ * Looks the name up in STAGE_NAMES.
+ */
+const char* compressionStageName(CompressionStage stage) {
+    return STAGE_NAMES[stage];
+}
+
+/* Constructor: CompressionStats
+ * --------------------------------------------------------
+ * Sets every count and time to zero.
+ */
+CompressionStats::CompressionStats() {
+    operations = 0;
+    uncompressedBytes = 0;
+    compressedBytes = 0;
+    headerBytes = 0;
+    for (int i = 0; i < NUM_COMPRESSION_STAGES; i++) {
+        stageSeconds[i] = 0;
+    }
+    for (int i = 0; i < 256; i++) {
+        symbolCounts[i] = 0;
+    }
+    codedSymbols = 0;
+    codedBits = 0;
+    minCodeLength = 0;
+    maxCodeLength = 0;
+}
+
+/* Member function: addCodes
+ * --------------------------------------------------------
+ * Adds to the coded counts and widens the range of lengths.
+ */
+void CompressionStats::addCodes(long long count, int length) {
+    if (count <= 0 || length <= 0) return;
+    codedSymbols += count;
+    codedBits += count * length;
+    if (minCodeLength == 0 || length < minCodeLength) minCodeLength = length;
+    if (length > maxCodeLength) maxCodeLength = length;
+}
+
+/* Member function: distinctSymbols
+ * --------------------------------------------------------
+ * Counts the byte values that occur.
+ */
+int CompressionStats::distinctSymbols() const {
+    int distinct = 0;
+    for (int i = 0; i < 256; i++) {
+        if (symbolCounts[i] > 0) distinct++;
+    }
+    return distinct;
+}
+
+/* Member function: averageCodeLength
+ * --------------------------------------------------------
+ * Divides the coded bits by the coded symbols.
+ */
+double CompressionStats::averageCodeLength() const {
+    if (codedSymbols == 0) return 0;
+    return double(codedBits) / codedSymbols;
+}
+
+/* Member function: entropyBitsPerSymbol
+ * --------------------------------------------------------
+ * Sums -p log2 p over the byte values that occur.
+ */
+double CompressionStats::entropyBitsPerSymbol() const {
+    double total = 0;
+    for (int i = 0; i < 256; i++) {
+        total += symbolCounts[i];
+    }
+    double entropy = 0;
+    for (int i = 0; i < 256; i++) {
+        if (symbolCounts[i] == 0) continue;
+        double probability = symbolCounts[i] / total;
+        entropy -= probability * log(probability) / log(2.0);
+    }
+    return entropy;
+}
+
+/* Member function: achievedBitsPerSymbol
+ * --------------------------------------------------------
+ * Divides the compressed bits by the uncompressed bytes.
+ */
+double CompressionStats::achievedBitsPerSymbol() const {
+    if (uncompressedBytes == 0) return 0;
+    return 8.0 * compressedBytes / uncompressedBytes;
+}
+
+/* Member function: totalSeconds
+ * --------------------------------------------------------
+ * Adds up the stage times.
+ */
+double CompressionStats::totalSeconds() const {
+    double total = 0;
+    for (int i = 0; i < NUM_COMPRESSION_STAGES; i++) {
+        total += stageSeconds[i];
+    }
+    return total;
+}
+
+/* Member function: add
+ * --------------------------------------------------------
+ * Everything but the code lengths simply adds up.  A length of 0 means
+ * no codes were used, so it does not narrow the range.
+ */
+void CompressionStats::add(const CompressionStats& other) {
+    operations += other.operations;
+    uncompressedBytes += other.uncompressedBytes;
+    compressedBytes += other.compressedBytes;
+    headerBytes += other.headerBytes;
+    for (int i = 0; i < NUM_COMPRESSION_STAGES; i++) {
+        stageSeconds[i] += other.stageSeconds[i];
+    }
+    for (int i = 0; i < 256; i++) {
+        symbolCounts[i] += other.symbolCounts[i];
+    }
+    codedSymbols += other.codedSymbols;
+    codedBits += other.codedBits;
+    if (other.minCodeLength > 0 && (minCodeLength == 0 || other.minCodeLength < minCodeLength)) {
+        minCodeLength = other.minCodeLength;
+    }
+    if (other.maxCodeLength > maxCodeLength) maxCodeLength = other.maxCodeLength;
+}
+
+/* Constructor: StageTimer
+ * --------------------------------------------------------
+ * Remembers where to charge the time.
+ */
+StageTimer::StageTimer(CompressionStats* stats) {
+    this->stats = stats;
+    current = -1;
+    since = 0;
+}
+
+/* Member function: start
+ * --------------------------------------------------------
+ * Reads the clock once, both to end the last stage and to start the
+ * next.  Stages are also recorded in the trace while tracing is on, and
+ * allocations charged to them while allocations are tracked.
+ */
+void StageTimer::start(CompressionStage stage) {
+    if (isTrackingAllocations()) setAllocationStage(stage);
+    if (stats == NULL && !TRACE_ACTIVE()) return;
+    double now = currentTime();
+    charge(now);
+    current = stage;
+    since = now;
+}
+
+/* Member function: stop
+ * --------------------------------------------------------
+ * Ends the stage being timed, charging later allocations to no stage.
+ */
+void StageTimer::stop() {
+    if (isTrackingAllocations()) setAllocationStage(OTHER_ALLOCATION_STAGE);
+    if (current < 0) return;
+    charge(currentTime());
+    current = -1;
+}
+
+/* Member function: charge
+ * --------------------------------------------------------
+ * Charges the time from since to now to the stage being timed, if any.
+ */
+void StageTimer::charge(double now) {
+    if (current < 0) return;
+    if (stats != NULL) stats->stageSeconds[current] += now - since;
+    TRACE_EVENT(STAGE_NAMES[current], since, now);
+}
+
+/* Function: activeCompressionStats
+ * Usage: CompressionStats* active = activeCompressionStats(stats, local);
+ * --------------------------------------------------------
+ * The caller's statistics take priority; they are still recorded in the
+ * registry if it is on.
+ */
+CompressionStats* activeCompressionStats(CompressionStats* stats, CompressionStats& local) {
+    if (stats != NULL) {
+        *stats = CompressionStats();
+        return stats;
+    }
+    return registryEnabled ? &local : NULL;
+}
+
+/* Function: finishCompressionStats
+ * Usage: finishCompressionStats(STATS_COMPRESSION, active);
+ * --------------------------------------------------------
+ * Sets the count of calls, then hands the statistics to the registry.
+ */
+void finishCompressionStats(StatsDirection direction, CompressionStats* active) {
+    if (active == NULL) return;
+    active->operations = 1;
+    recordCompressionStats(direction, *active);
+}
+
+/* Functions: setCompressionStatsEnabled, compressionStatsEnabled
+ * --------------------------------------------------------
+ * Flip and read the switch.
+ */
+void setCompressionStatsEnabled(bool enabled) {
+    registryEnabled = enabled;
+}
+
+bool compressionStatsEnabled() {
+    return registryEnabled;
+}
+
+/* Function: recordCompressionStats
+ * Usage: recordCompressionStats(STATS_COMPRESSION, stats);
+ * --------------------------------------------------------
+ * Adds to the totals for the direction under the lock.
+ */
+void recordCompressionStats(StatsDirection direction, const CompressionStats& stats) {
+    if (!registryEnabled) return;
+    synchronized (registryLock()) {
+        if (direction == STATS_COMPRESSION) {
+            compressionTotals.add(stats);
+        } else {
+            decompressionTotals.add(stats);
+        }
+    }
+}
+
+/* Function: globalCompressionStats
+ * Usage: CompressionStats totals = globalCompressionStats(STATS_COMPRESSION);
+ * --------------------------------------------------------
+ * Copies the totals under the lock, so the copy is consistent.
+ */
+CompressionStats globalCompressionStats(StatsDirection direction) {
+    CompressionStats totals;
+    synchronized (registryLock()) {
+        totals = (direction == STATS_COMPRESSION) ? compressionTotals : decompressionTotals;
+    }
+    return totals;
+}
+
+/* Function: resetCompressionStats
+ * Usage: resetCompressionStats();
+ * --------------------------------------------------------
+ * Replaces both totals with zeros.
+ */
+void resetCompressionStats() {
+    synchronized (registryLock()) {
+        compressionTotals = CompressionStats();
+        decompressionTotals = CompressionStats();
+    }
+}
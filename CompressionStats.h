@@ -0,0 +1,248 @@
+/*******************************************************
+ * File: CompressionStats.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Statistics about what compress and decompress did: how many bytes went
+ * in and out, how long each stage took, and how well the Huffman codes
+ * fit the data.  A caller can ask for the statistics of a single call by
+ * passing a CompressionStats, and a whole program can turn on a global
+ * registry that adds up the statistics of every call, for export to a
+ * metrics system.  While the registry is off, and no CompressionStats is
+ * passed, nothing is measured at all.
+ *
+ * Comparing the achieved bits per symbol against the entropy of the
+ * input is the quickest way to spot inputs the compressor handles badly:
+ * the gap is the price of whole-bit codes, of the header and, at the
+ * faster levels, of sampling and of length-limited codes.
+ */
+
+#ifndef CompressionStats_Included
+#define CompressionStats_Included
+
+/* Type: CompressionStage
+ * The stages whose time is measured.
+ *
+ *   STATS_HISTOGRAM - reading the input and counting its bytes.
+ *   STATS_TREE      - building the Huffman tree and the codes from it.
+ *   STATS_TABLE     - choosing which table to use, and writing or
+ *                     reading the table in the header.
+ *   STATS_ENCODE    - encoding the input.
+ *   STATS_DECODE    - reading and decoding the compressed data.
+ *   STATS_FLUSH     - writing out what has been encoded or decoded.
+ */
+enum CompressionStage {
+    STATS_HISTOGRAM,
+    STATS_TREE,
+    STATS_TABLE,
+    STATS_ENCODE,
+    STATS_DECODE,
+    STATS_FLUSH
+};
+
+/* Constant: NUM_COMPRESSION_STAGES
+ * The number of values of CompressionStage.
+ */
+const int NUM_COMPRESSION_STAGES = 6;
+
+/* Type: StatsDirection
+ * Whether statistics describe compression or decompression.  The global
+ *   registry keeps the two apart.
+ */
+enum StatsDirection {
+    STATS_COMPRESSION,
+    STATS_DECOMPRESSION
+};
+
+/* Function: compressionStageName
+ * Usage: string name = compressionStageName(stage);
+ * --------------------------------------------------------
+ * Returns a short name for the stage, such as "histogram".
+ */
+const char* compressionStageName(CompressionStage stage);
+
+/* Type: CompressionStats
+ * The statistics of one or more calls to compress or decompress.  The
+ *   symbols are the bytes of the uncompressed data; in files written by
+ *   compress without options, the PSEUDO_EOF marker is also a coded
+ *   symbol.
+ */
+struct CompressionStats {
+    /* How many calls these statistics cover. */
+    long long operations;
+
+    /* The uncompressed and compressed sizes, whichever way the data
+     * went, and how many of the compressed bytes are headers and code
+     * tables rather than encoded data.
+     */
+    long long uncompressedBytes;
+    long long compressedBytes;
+    long long headerBytes;
+
+    /* The time spent in each CompressionStage, in seconds. */
+    double stageSeconds[NUM_COMPRESSION_STAGES];
+
+    /* How often each byte value occurs in the uncompressed data. */
+    long long symbolCounts[256];
+
+    /* How many symbols were Huffman coded, how many bits their codes
+     * took, and the shortest and longest code used (0 if none were).
+     * Blocks that were stored or compressed with LZW are not counted.
+     */
+    long long codedSymbols;
+    long long codedBits;
+    int minCodeLength;
+    int maxCodeLength;
+
+    /* Sets everything to zero. */
+    CompressionStats();
+
+    /* Member function: addCodes
+     * Usage: stats.addCodes(count, length);
+     * --------------------------------------------------------
+     * Records that count symbols were coded with codes of the given
+     * length.
+     */
+    void addCodes(long long count, int length);
+
+    /* Member function: distinctSymbols
+     * Usage: int n = stats.distinctSymbols();
+     * --------------------------------------------------------
+     * Returns how many different byte values the data contains.
+     */
+    int distinctSymbols() const;
+
+    /* Member function: averageCodeLength
+     * Usage: double bits = stats.averageCodeLength();
+     * --------------------------------------------------------
+     * Returns the average length of the codes of the coded symbols,
+     * weighted by how often each was used, or 0 if none were coded.
+     */
+    double averageCodeLength() const;
+
+    /* Member function: entropyBitsPerSymbol
+     * Usage: double bits = stats.entropyBitsPerSymbol();
+     * --------------------------------------------------------
+     * Returns the order-0 entropy of the uncompressed bytes: the fewest
+     * bits per byte any code for single bytes could average.
+     */
+    double entropyBitsPerSymbol() const;
+
+    /* Member function: achievedBitsPerSymbol
+     * Usage: double bits = stats.achievedBitsPerSymbol();
+     * --------------------------------------------------------
+     * Returns the compressed size in bits, headers included, per
+     * uncompressed byte, or 0 if there were none.
+     */
+    double achievedBitsPerSymbol() const;
+
+    /* Member function: totalSeconds
+     * Usage: double seconds = stats.totalSeconds();
+     * --------------------------------------------------------
+     * Returns the sum of the stage times.
+     */
+    double totalSeconds() const;
+
+    /* Member function: add
+     * Usage: total.add(stats);
+     * --------------------------------------------------------
+     * Adds other's counts and times to these, and widens the range of
+     * code lengths to include other's.
+     */
+    void add(const CompressionStats& other);
+};
+
+/* Class: StageTimer
+ * --------------------------------------------------------
+ * Charges elapsed time to the stages of a CompressionStats, records the
+ * stages in the trace while tracing is on (see Tracing.h), and charges
+ * the thread's allocations to them while allocations are tracked (see
+ * MemoryDiagnostics.h).  A timer for NULL statistics does nothing while
+ * both are off, not even read the clock, so code can time its stages
+ * unconditionally.
+ */
+class StageTimer {
+public:
+    /* Constructor: StageTimer
+     * Usage: StageTimer timer(stats);
+     * --------------------------------------------------------
+     * Creates a timer that is not yet timing any stage.
+     */
+    StageTimer(CompressionStats* stats);
+
+    /* Member function: start
+     * Usage: timer.start(STATS_ENCODE);
+     * --------------------------------------------------------
+     * Charges the time since the last call to the stage being timed, if
+     * any, and starts timing the given stage.
+     */
+    void start(CompressionStage stage);
+
+    /* Member function: stop
+     * Usage: timer.stop();
+     * --------------------------------------------------------
+     * Charges the time since the last call to the stage being timed, and
+     * stops timing.
+     */
+    void stop();
+
+private:
+    CompressionStats* stats;
+    int current;      // the stage being timed, or -1
+    double since;     // when it started
+
+    void charge(double now);
+};
+
+/* Function: activeCompressionStats
+ * Usage: CompressionStats* active = activeCompressionStats(stats, local);
+ * --------------------------------------------------------
+ * Returns where compress and decompress should keep their statistics:
+ * the caller's stats if given, local if only the global registry wants
+ * them, or NULL if nobody does.
+ */
+CompressionStats* activeCompressionStats(CompressionStats* stats, CompressionStats& local);
+
+/* Function: finishCompressionStats
+ * Usage: finishCompressionStats(STATS_COMPRESSION, active);
+ * --------------------------------------------------------
+ * Marks the statistics as covering one call and records them in the
+ * registry.  Does nothing if active is NULL.
+ */
+void finishCompressionStats(StatsDirection direction, CompressionStats* active);
+
+/* Functions: setCompressionStatsEnabled, compressionStatsEnabled
+ * Usage: setCompressionStatsEnabled(true);
+ *        if (compressionStatsEnabled()) ...
+ * --------------------------------------------------------
+ * Turn the global registry on or off, and tell whether it is on.  It is
+ * off to begin with.
+ */
+void setCompressionStatsEnabled(bool enabled);
+bool compressionStatsEnabled();
+
+/* Function: recordCompressionStats
+ * Usage: recordCompressionStats(STATS_COMPRESSION, stats);
+ * --------------------------------------------------------
+ * Adds the statistics of one call to the registry's totals, if the
+ * registry is on.  Safe to call from several threads at once.
+ */
+void recordCompressionStats(StatsDirection direction, const CompressionStats& stats);
+
+/* Function: globalCompressionStats
+ * Usage: CompressionStats totals = globalCompressionStats(STATS_COMPRESSION);
+ * --------------------------------------------------------
+ * Returns the totals of every call recorded in the given direction since
+ * the registry was last reset.
+ */
+CompressionStats globalCompressionStats(StatsDirection direction);
+
+/* Function: resetCompressionStats
+ * Usage: resetCompressionStats();
+ * --------------------------------------------------------
+ * Sets the registry's totals back to zero.
+ */
+void resetCompressionStats();
+
+#endif
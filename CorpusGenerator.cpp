@@ -0,0 +1,355 @@
+/**********************************************************
+ * File: CorpusGenerator.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the corpus generator from CorpusGenerator.h.
+ *
+ * All randomness comes from a xorshift64* generator seeded from the
+ * spec, so the output depends only on the spec and not on the platform's
+ * rand().  The vocabulary and weight tables are built once from the same
+ * generator, and its state afterwards is remembered so that restarting
+ * does not have to build them again.
+ */
+
+#include "CorpusGenerator.h"
+#include "error.h"
+#include <algorithm>
+#include <cmath>
+
+/* Constants: ZIPF_VOCABULARY, FIBONACCI_SYMBOLS, MEAN_RUN_LENGTH
+ * The number of distinct words in Zipf text, the number of byte values
+ *   with Fibonacci weights, and the average length of a run.
+ */
+static const int ZIPF_VOCABULARY = 8192;
+static const int FIBONACCI_SYMBOLS = 40;
+static const int MEAN_RUN_LENGTH = 64;
+
+/* Constant: GUIDE_SIZE
+ * The number of entries in a guide table.  Entry k of the guide table
+ *   for a list of running totals is the first index whose total exceeds
+ *   k / GUIDE_SIZE of the overall total.
+ */
+static const int GUIDE_SIZE = 1024;
+
+/* Constants: MIN_SEGMENT, MAX_SEGMENT
+ * The range of segment lengths in mixed corpora.
+ */
+static const long long MIN_SEGMENT = 16 * 1024;
+static const long long MAX_SEGMENT = 1024 * 1024;
+
+/* Constant: STREAM_CHUNK_SIZE
+ * How many bytes a CorpusStream generates at a time.
+ */
+static const long STREAM_CHUNK_SIZE = 64 * 1024;
+
+/* Constructor: CorpusSpec
+ * --------------------------------------------------------
+ * Defaults to a megabyte of text-like data.
+ */
+CorpusSpec::CorpusSpec() {
+    distribution = CORPUS_ZIPF;
+    size = 1024 * 1024;
+    seed = 1;
+}
+
+/* Function: corpusDistributionName
+ * Usage: string name = corpusDistributionName(distribution);
+ * --------------------------------------------------------
+ * Returns a short name for the distribution, such as "zipf".
+ */
+std::string corpusDistributionName(CorpusDistribution distribution) {
+    switch (distribution) {
+    case CORPUS_UNIFORM: return "uniform";
+    case CORPUS_ZIPF: return "zipf";
+    case CORPUS_FIBONACCI: return "fibonacci";
+    case CORPUS_RUNS: return "runs";
+    case CORPUS_MIXED: return "mixed";
+    }
+    return "unknown";
+}
+
+/* Function: generateCorpus
+ * Usage: string data = generateCorpus(spec);
+ * --------------------------------------------------------
+ * Generates straight into a string of the right size.
+ */
+std::string generateCorpus(const CorpusSpec& spec) {
+    std::string data(spec.size, '\0');
+    CorpusGenerator generator(spec);
+    long long done = 0;
+    while (done < spec.size) {
+        long chunk = (spec.size - done < STREAM_CHUNK_SIZE) ? long(spec.size - done) : STREAM_CHUNK_SIZE;
+        done += generator.generate(&data[done], chunk);
+    }
+    return data;
+}
+
+/* Function: buildGuide
+ * Usage: buildGuide(weights, guide);
+ * --------------------------------------------------------
+ * Fills in the guide table for the running totals.
+ */
+static void buildGuide(const std::vector<double>& weights, std::vector<int>& guide) {
+    guide.clear();
+    for (int k = 0; k < GUIDE_SIZE; k++) {
+        double target = weights.back() * k / GUIDE_SIZE;
+        guide.push_back(int(std::upper_bound(weights.begin(), weights.end(), target) - weights.begin()));
+    }
+}
+
+/* Constructor: CorpusGenerator
+ * --------------------------------------------------------
+ * Builds the vocabulary and the running totals of the Zipf and
+ * Fibonacci weights, then remembers the random state.
+ */
+CorpusGenerator::CorpusGenerator(const CorpusSpec& spec) : spec(spec) {
+    if (spec.size < 0) error("A corpus cannot have a negative size.");
+
+    // xorshift must not start from zero
+    state = 0x9E3779B97F4A7C15ULL ^ spec.seed;
+
+    for (int i = 0; i < ZIPF_VOCABULARY; i++) {
+        int length = 1 + int(nextRandom() % 5) + int(nextRandom() % 5);
+        std::string word;
+        for (int j = 0; j < length; j++) {
+            word += char('a' + nextRandom() % 26);
+        }
+        vocabulary.push_back(word);
+    }
+    double total = 0;
+    for (int rank = 1; rank <= ZIPF_VOCABULARY; rank++) {
+        total += 1.0 / rank;
+        zipfWeights.push_back(total);
+    }
+    double previous = 0, weight = 1;
+    total = 0;
+    for (int i = 0; i < FIBONACCI_SYMBOLS; i++) {
+        total += weight;
+        fibonacciWeights.push_back(total);
+        double next = previous + weight;
+        previous = weight;
+        weight = next;
+    }
+
+    buildGuide(zipfWeights, zipfGuide);
+    buildGuide(fibonacciWeights, fibonacciGuide);
+
+    startState = state;
+    restart();
+}
+
+/* Member function: restart
+ * --------------------------------------------------------
+ * Puts back the random state from just after the setup and clears the
+ * state of the current word, run and segment.
+ */
+void CorpusGenerator::restart() {
+    state = startState;
+    produced = 0;
+    current = spec.distribution;
+    segmentLeft = 0;
+    shift = 0;
+    pending = "";
+    pendingNext = 0;
+    runLeft = 0;
+    runByte = 0;
+}
+
+/* Member functions: position, size
+ * --------------------------------------------------------
+ * Report progress through the corpus.
+ */
+long long CorpusGenerator::position() const {
+    return produced;
+}
+
+long long CorpusGenerator::size() const {
+    return spec.size;
+}
+
+/* Member function: nextRandom
+ * --------------------------------------------------------
+ * Advances the xorshift64* generator and returns 64 random bits.
+ */
+unsigned long long CorpusGenerator::nextRandom() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+/* Member function: nextUniform
+ * --------------------------------------------------------
+ * Returns a random number in [0, 1) from the top 53 bits.
+ */
+double CorpusGenerator::nextUniform() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Member function: pick
+ * --------------------------------------------------------
+ * Returns an index chosen with probability proportional to its weight,
+ * given the running totals of the weights and their guide table.  The
+ * guide table says where to start looking, so only a step or two of
+ * searching is left.
+ */
+int CorpusGenerator::pick(const std::vector<double>& weights, const std::vector<int>& guide) {
+    double uniform = nextUniform();
+    double target = uniform * weights.back();
+    int index = guide[int(uniform * GUIDE_SIZE)];
+    int last = int(weights.size()) - 1;
+    while (index < last && weights[index] <= target) {
+        index++;
+    }
+    return index;
+}
+
+/* Member function: nextByte
+ * --------------------------------------------------------
+ * Produces one byte of the current kind of data.  In mixed corpora, a
+ * new segment of a randomly chosen other kind, with a new shift, starts
+ * whenever the current one runs out.
+ */
+unsigned char CorpusGenerator::nextByte() {
+    if (spec.distribution == CORPUS_MIXED) {
+        if (segmentLeft == 0) {
+            current = CorpusDistribution(nextRandom() % CORPUS_MIXED);
+            segmentLeft = MIN_SEGMENT + nextRandom() % (MAX_SEGMENT - MIN_SEGMENT + 1);
+            shift = int(nextRandom() % 256);
+            pending = "";
+            pendingNext = 0;
+            runLeft = 0;
+        }
+        segmentLeft--;
+    }
+
+    switch (current) {
+    case CORPUS_ZIPF:
+        if (pendingNext == int(pending.length())) {
+            pending = vocabulary[pick(zipfWeights, zipfGuide)];
+            int separator = int(nextRandom() % 16);
+            if (separator == 0) {
+                pending += ".\n";
+            } else if (separator == 1) {
+                pending += ", ";
+            } else {
+                pending += ' ';
+            }
+            pendingNext = 0;
+        }
+        // the shift drifts the letters of mixed corpora up the alphabet
+        return (unsigned char) (pending[pendingNext++] + shift % 8);
+    case CORPUS_FIBONACCI:
+        return (unsigned char) (FIBONACCI_SYMBOLS - 1 - pick(fibonacciWeights, fibonacciGuide) + shift);
+    case CORPUS_RUNS:
+        if (runLeft == 0) {
+            runByte = int(nextRandom() % 256);
+            runLeft = 1 + long(-log(1 - nextUniform()) * MEAN_RUN_LENGTH);
+        }
+        runLeft--;
+        return (unsigned char) runByte;
+    default:
+        return (unsigned char) (nextRandom() >> 56);
+    }
+}
+
+/* Member function: generate
+ * --------------------------------------------------------
+ * Produces bytes one at a time until the buffer is full or the corpus
+ * is used up.
+ */
+long CorpusGenerator::generate(char* buffer, long maxBytes) {
+    long count = 0;
+    while (count < maxBytes && produced < spec.size) {
+        buffer[count++] = char(nextByte());
+        produced++;
+    }
+    return count;
+}
+
+/* Constructor: CorpusStream
+ * --------------------------------------------------------
+ * Wires the stream up to a buffer that reads from the generator, the
+ * same way ifbstream wires itself up to a filebuf.
+ */
+CorpusStream::CorpusStream(const CorpusSpec& spec) : buffer(spec) {
+    init(&buffer);
+}
+
+/* Constructor: CorpusBuffer
+ * --------------------------------------------------------
+ * Starts with an empty get area, so the first read generates a chunk.
+ */
+CorpusStream::CorpusBuffer::CorpusBuffer(const CorpusSpec& spec)
+    : generator(spec), chunk(STREAM_CHUNK_SIZE), chunkStart(0), atEnd(false) {
+    setg(&chunk[0], &chunk[0], &chunk[0]);
+}
+
+/* Member function: underflow
+ * --------------------------------------------------------
+ * Generates the next chunk once the current one has been read.
+ */
+CorpusStream::CorpusBuffer::int_type CorpusStream::CorpusBuffer::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (atEnd) return traits_type::eof();
+
+    chunkStart = generator.position();
+    long count = generator.generate(&chunk[0], STREAM_CHUNK_SIZE);
+    setg(&chunk[0], &chunk[0], &chunk[0] + count);
+    if (count == 0) return traits_type::eof();
+    return traits_type::to_int_type(*gptr());
+}
+
+/* Member function: seekoff
+ * --------------------------------------------------------
+ * Turns a relative position into an absolute one for seekpos.  Seeking
+ * to the end just notes that the stream is there, so that finding the
+ * size of the stream does not generate the whole corpus.
+ */
+CorpusStream::CorpusBuffer::pos_type
+CorpusStream::CorpusBuffer::seekoff(off_type offset, std::ios_base::seekdir direction,
+                                    std::ios_base::openmode which) {
+    long long current = atEnd ? generator.size() : chunkStart + (gptr() - eback());
+    long long target = offset;
+    if (direction == std::ios_base::cur) {
+        if (offset == 0) return pos_type(off_type(current));
+        target = current + offset;
+    } else if (direction == std::ios_base::end) {
+        target = generator.size() + offset;
+    }
+    return seekpos(pos_type(off_type(target)), which);
+}
+
+/* Member function: seekpos
+ * --------------------------------------------------------
+ * Moves within the current chunk when possible.  Otherwise restarts the
+ * generator if the target lies behind it, then generates and throws away
+ * everything before the target.
+ */
+CorpusStream::CorpusBuffer::pos_type
+CorpusStream::CorpusBuffer::seekpos(pos_type position, std::ios_base::openmode) {
+    long long target = off_type(position);
+    if (target < 0 || target > generator.size()) return pos_type(off_type(-1));
+
+    if (!atEnd && target >= chunkStart && target <= chunkStart + (egptr() - eback())) {
+        setg(eback(), eback() + (target - chunkStart), egptr());
+        return position;
+    }
+    if (target == generator.size()) {
+        atEnd = true;
+        setg(&chunk[0], &chunk[0], &chunk[0]);
+        return position;
+    }
+
+    if (atEnd || target < generator.position()) generator.restart();
+    atEnd = false;
+    while (generator.position() < target) {
+        long long left = target - generator.position();
+        generator.generate(&chunk[0], (left < STREAM_CHUNK_SIZE) ? long(left) : STREAM_CHUNK_SIZE);
+    }
+    chunkStart = target;
+    setg(&chunk[0], &chunk[0], &chunk[0]);
+    return position;
+}
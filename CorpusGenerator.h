@@ -0,0 +1,180 @@
+/*******************************************************
+ * File: CorpusGenerator.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A generator of synthetic test data for benchmarks.  The files in
+ * test/encodeDecode are at most a few hundred kilobytes, which says
+ * little about how the compressor behaves on large inputs.  The generator
+ * produces any amount of data, from a few bytes to tens of gigabytes,
+ * with a chosen distribution, and always produces the same bytes for the
+ * same seed.  It can be read through CorpusStream like a file, so a large
+ * corpus can be fed straight into the compressor without ever being
+ * written to disk or held in memory.
+ */
+
+#ifndef CorpusGenerator_Included
+#define CorpusGenerator_Included
+
+#include "bstream.h"
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/* Type: CorpusDistribution
+ * The kinds of data the generator produces.
+ *
+ *   CORPUS_UNIFORM   - every byte equally likely; does not compress.
+ *   CORPUS_ZIPF      - text-like: words from a fixed vocabulary, chosen
+ *                      with Zipf's law, separated by spaces, periods and
+ *                      line breaks.
+ *   CORPUS_FIBONACCI - the i-th of 40 byte values is chosen with weight
+ *                      proportional to the i-th Fibonacci number, which
+ *                      makes Huffman trees as deep as they can get.
+ *   CORPUS_RUNS      - runs of a single byte with lengths averaging 64.
+ *   CORPUS_MIXED     - segments of 16 KB to 1 MB of the other kinds in
+ *                      turn, with the byte values drifting from one
+ *                      segment to the next.
+ */
+enum CorpusDistribution {
+    CORPUS_UNIFORM,
+    CORPUS_ZIPF,
+    CORPUS_FIBONACCI,
+    CORPUS_RUNS,
+    CORPUS_MIXED
+};
+
+/* Constant: NUM_CORPUS_DISTRIBUTIONS
+ * The number of values of CorpusDistribution.
+ */
+const int NUM_CORPUS_DISTRIBUTIONS = 5;
+
+/* Type: CorpusSpec
+ * Describes a generated corpus completely: two generators made from
+ *   equal specs produce the same bytes.
+ */
+struct CorpusSpec {
+    CorpusDistribution distribution;
+    long long size;
+    unsigned long seed;
+
+    /* Sets distribution to CORPUS_ZIPF, size to 1 MB and seed to 1. */
+    CorpusSpec();
+};
+
+/* Function: corpusDistributionName
+ * Usage: string name = corpusDistributionName(distribution);
+ * --------------------------------------------------------
+ * Returns a short name for the distribution, such as "zipf".
+ */
+std::string corpusDistributionName(CorpusDistribution distribution);
+
+/* Function: generateCorpus
+ * Usage: string data = generateCorpus(spec);
+ * --------------------------------------------------------
+ * Returns the whole corpus as a string.  Only suitable for corpora that
+ * fit in memory.
+ */
+std::string generateCorpus(const CorpusSpec& spec);
+
+/* Class: CorpusGenerator
+ * --------------------------------------------------------
+ * Produces the bytes of a corpus in order, a buffer at a time.
+ */
+class CorpusGenerator {
+public:
+    /* Constructor: CorpusGenerator
+     * Usage: CorpusGenerator generator(spec);
+     * --------------------------------------------------------
+     * Prepares to produce the corpus from its first byte.
+     */
+    CorpusGenerator(const CorpusSpec& spec);
+
+    /* Member function: generate
+     * Usage: long count = generator.generate(buffer, maxBytes);
+     * --------------------------------------------------------
+     * Fills buffer with the next bytes of the corpus, up to maxBytes of
+     * them, and returns how many it produced; 0 means the corpus is used
+     * up.
+     */
+    long generate(char* buffer, long maxBytes);
+
+    /* Member function: restart
+     * Usage: generator.restart();
+     * --------------------------------------------------------
+     * Goes back to the first byte of the corpus.
+     */
+    void restart();
+
+    /* Member functions: position, size
+     * Usage: long long done = generator.position();
+     * --------------------------------------------------------
+     * Return how many bytes have been produced so far, and how many the
+     * corpus has in all.
+     */
+    long long position() const;
+    long long size() const;
+
+private:
+    CorpusSpec spec;
+    unsigned long long startState;   // random state after the setup
+    unsigned long long state;        // current random state
+    long long produced;
+
+    std::vector<std::string> vocabulary;
+    std::vector<double> zipfWeights;        // running totals, by rank
+    std::vector<double> fibonacciWeights;   // running totals, by symbol
+    std::vector<int> zipfGuide;             // where pick starts looking
+    std::vector<int> fibonacciGuide;
+
+    CorpusDistribution current;      // kind of the current segment
+    long long segmentLeft;           // bytes left in the current segment
+    int shift;                       // added to byte values while drifting
+    std::string pending;             // rest of the current word
+    int pendingNext;
+    int runByte;
+    long runLeft;
+
+    unsigned long long nextRandom();
+    double nextUniform();
+    int pick(const std::vector<double>& weights, const std::vector<int>& guide);
+    unsigned char nextByte();
+};
+
+/* Class: CorpusStream
+ * --------------------------------------------------------
+ * An input stream whose contents are a generated corpus.  It can be
+ * passed anywhere an ibstream is expected, including to compress, which
+ * reads its input twice: seeking back to the start simply restarts the
+ * generator.  Seeking elsewhere regenerates up to the new position.
+ */
+class CorpusStream : public ibstream {
+public:
+    CorpusStream(const CorpusSpec& spec);
+
+private:
+    /* Class: CorpusBuffer
+     * The stream buffer that refills itself from the generator.
+     */
+    class CorpusBuffer : public std::streambuf {
+    public:
+        CorpusBuffer(const CorpusSpec& spec);
+
+    protected:
+        int_type underflow();
+        pos_type seekoff(off_type offset, std::ios_base::seekdir direction,
+                         std::ios_base::openmode which);
+        pos_type seekpos(pos_type position, std::ios_base::openmode which);
+
+    private:
+        CorpusGenerator generator;
+        std::vector<char> chunk;
+        long long chunkStart;   // corpus position of the first byte in chunk
+        bool atEnd;             // positioned at the end without generating
+    };
+
+    CorpusBuffer buffer;
+};
+
+#endif
@@ -0,0 +1,491 @@
+/**********************************************************
+ * File: Delta.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the delta compression from Delta.h.  The index of
+ * the reference is a hash table with open addressing that holds the
+ * offset of every DELTA_BLOCK_SIZE-th block under the top bits of its
+ * fingerprint.  The fingerprint is a polynomial hash, so the one of the
+ * block at the next position of the new version follows from the
+ * current one by removing the byte that leaves and adding the byte
+ * that enters.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Delta.h"
+#include "BinaryIO.h"
+#include "Checksum.h"
+#include "error.h"
+
+/* Constants: DELTA_MAGIC, DELTA_VERSION
+ * The number that starts every delta ("HUFD"), and the version of the
+ *   format, which follows it.
+ */
+static const unsigned long DELTA_MAGIC = 0x48554644UL;
+static const int DELTA_VERSION = 1;
+
+/* Constant: DELTA_HEADER_BYTES
+ * The size of the header: the magic number (4 bytes), the version (1),
+ *   and the size (8) and CRC-32 (4) of each of the two files.
+ */
+static const int DELTA_HEADER_BYTES = 29;
+
+/* Constant: FINGERPRINT_MULTIPLIER
+ * The base of the polynomial fingerprint, an odd number with well
+ *   mixed bits, so that every byte affects the top bits of the result.
+ */
+static const unsigned long long FINGERPRINT_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+/* Constant: NO_BLOCK
+ * Marks an empty slot of the index.
+ */
+static const long NO_BLOCK = -1;
+
+/* Function: readRest
+ * Usage: string data = readRest(infile);
+ * --------------------------------------------------------
+ * Returns everything remaining in infile.  Reports an error if it
+ * cannot be read.
+ */
+static std::string readRest(std::istream& infile) {
+    std::ostringstream contents;
+    if (infile.peek() != EOF) contents << infile.rdbuf();
+    if (infile.bad()) error("Cannot read the file.");
+    return contents.str();
+}
+
+/* Function: fingerprint
+ * Usage: unsigned long long hash = fingerprint(data);
+ * --------------------------------------------------------
+ * Returns the fingerprint of the DELTA_BLOCK_SIZE bytes at data.
+ */
+static unsigned long long fingerprint(const unsigned char* data) {
+    unsigned long long hash = 0;
+    for (int i = 0; i < DELTA_BLOCK_SIZE; i++) {
+        hash = hash * FINGERPRINT_MULTIPLIER + data[i];
+    }
+    return hash;
+}
+
+/* Class: DeltaIndex
+ * --------------------------------------------------------
+ * The blocks of the reference, by fingerprint.  The table has at least
+ * twice as many slots as there are blocks, so that the probes for a
+ * fingerprint that is not there end quickly.  Of several blocks with
+ * the same contents, only the first is kept.
+ */
+class DeltaIndex {
+public:
+    DeltaIndex(const std::string& reference);
+
+    /* Member function: find
+     * Usage: long offset = index.find(hash, data);
+     * --------------------------------------------------------
+     * Returns the offset of a block of the reference whose fingerprint
+     * is hash and whose bytes match those at data, or NO_BLOCK.
+     */
+    long find(unsigned long long hash, const unsigned char* data) const;
+
+private:
+    const std::string& reference;
+    std::vector<long> slots;
+    int shift;                   // 64 minus the bits of a slot number
+};
+
+/* Constructor: DeltaIndex
+ * --------------------------------------------------------
+ * Fingerprints the blocks that start at every multiple of
+ * DELTA_BLOCK_SIZE.
+ */
+DeltaIndex::DeltaIndex(const std::string& reference) : reference(reference) {
+    long numBlocks = long(reference.length() / DELTA_BLOCK_SIZE);
+    int bits = 4;
+    while ((1L << bits) < 2 * numBlocks) bits++;
+    shift = 64 - bits;
+    slots.assign(1L << bits, NO_BLOCK);
+    const unsigned char* bytes = (const unsigned char*) reference.data();
+    for (long block = 0; block < numBlocks; block++) {
+        long offset = block * DELTA_BLOCK_SIZE;
+        unsigned long long hash = fingerprint(bytes + offset);
+        if (find(hash, bytes + offset) != NO_BLOCK) continue;
+        long slot = long(hash >> shift);
+        while (slots[slot] != NO_BLOCK) {
+            slot = (slot + 1) & (long(slots.size()) - 1);
+        }
+        slots[slot] = offset;
+    }
+}
+
+/* Member function: find
+ * --------------------------------------------------------
+ * Probes from the fingerprint's slot to the first empty one, comparing
+ * the bytes of each block met.
+ */
+long DeltaIndex::find(unsigned long long hash, const unsigned char* data) const {
+    const unsigned char* bytes = (const unsigned char*) reference.data();
+    long slot = long(hash >> shift);
+    while (slots[slot] != NO_BLOCK) {
+        long offset = slots[slot];
+        if (memcmp(bytes + offset, data, DELTA_BLOCK_SIZE) == 0) return offset;
+        slot = (slot + 1) & (long(slots.size()) - 1);
+    }
+    return NO_BLOCK;
+}
+
+/* Function: writeVarNumber
+ * Usage: writeVarNumber(out, value);
+ * --------------------------------------------------------
+ * Appends value to out 7 bits a byte, least significant first, with
+ * the top bit of every byte but the last set.
+ */
+static void writeVarNumber(std::string& out, unsigned long long value) {
+    while (value >= 0x80) {
+        out += char(0x80 | (value & 0x7F));
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+/* Function: readVarNumber
+ * Usage: unsigned long long value = readVarNumber(data, position);
+ * --------------------------------------------------------
+ * Reads a number written by writeVarNumber at position in data, and
+ * moves position past it.  Reports an error if data ends first or the
+ * number is too long.
+ */
+static unsigned long long readVarNumber(const std::string& data, size_t& position) {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position == data.length()) error("Delta is damaged.");
+        unsigned char byte = data[position++];
+        value |= (unsigned long long) (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return value;
+    }
+    error("Delta is damaged.");
+    return 0;
+}
+
+/* Type: DeltaEncoder
+ * The instructions and inserted bytes written so far, and where the
+ *   last copy ended in the reference.
+ */
+struct DeltaEncoder {
+    std::string instructions;
+    std::string inserted;
+    long long copyEnd;
+
+    /* Member functions: insert, copy
+     * Usage: encoder.insert(data, length);
+     *        encoder.copy(offset, length);
+     * --------------------------------------------------------
+     * Add an instruction.  Inserting nothing adds nothing.
+     */
+    void insert(const char* data, long length) {
+        if (length == 0) return;
+        writeVarNumber(instructions, (unsigned long long) length << 1);
+        inserted.append(data, length);
+    }
+
+    void copy(long long offset, long length) {
+        writeVarNumber(instructions, ((unsigned long long) length << 1) | 1);
+        long long distance = offset - copyEnd;
+        // zigzag, so that short distances backward are small numbers too
+        writeVarNumber(instructions, ((unsigned long long) distance << 1) ^
+                                     (unsigned long long) (distance >> 63));
+        copyEnd = offset + length;
+    }
+};
+
+/* Constant: WINDOW_READ_SIZE
+ * How much of the new version is read at a time.  The encoder inserts
+ *   bytes it has found no copy for once this many are waiting, so that
+ *   the window holds at most a few times this much, however long the
+ *   new version is.
+ */
+static const long WINDOW_READ_SIZE = 1L << 20;
+
+/* Class: TargetWindow
+ * --------------------------------------------------------
+ * The part of the new version the encoder still needs, read from the
+ * input as the search reaches it.  Offsets are from the start of the
+ * new version.  The bytes before the mark given to release are
+ * dropped when more are read, and the size and CRC-32 of everything
+ * read are kept for the header.
+ */
+class TargetWindow {
+public:
+    TargetWindow(std::istream& infile);
+
+    /* Member function: ensure
+     * Usage: if (window.ensure(end)) ...
+     * --------------------------------------------------------
+     * Reads until the bytes before offset end are held, and returns
+     * whether they are, which they are not if the input ends first.
+     * Pointers from at are not valid after a call.
+     */
+    bool ensure(long long end);
+
+    /* Member function: at
+     * Usage: const unsigned char* bytes = window.at(offset);
+     * --------------------------------------------------------
+     * Returns the byte at offset, which must be held.
+     */
+    const unsigned char* at(long long offset) const {
+        return (const unsigned char*) data.data() + (offset - base);
+    }
+
+    /* Member function: release
+     * Usage: window.release(offset);
+     * --------------------------------------------------------
+     * Says that the bytes before offset are no longer needed.
+     */
+    void release(long long offset) {
+        keepFrom = offset;
+    }
+
+    /* Member functions: length, checksum
+     * Usage: long long length = window.length();
+     *        unsigned long crc = window.checksum();
+     * --------------------------------------------------------
+     * Return the size and CRC-32 of what has been read so far, which
+     * once ensure has returned false is the whole new version.
+     */
+    long long length() const {
+        return base + (long long) data.length();
+    }
+
+    unsigned long checksum() const {
+        return crc;
+    }
+
+private:
+    std::istream& infile;
+    std::string data;
+    long long base;              // the offset of the first byte of data
+    long long keepFrom;
+    unsigned long crc;
+    bool ended;
+};
+
+/* Constructor: TargetWindow
+ * --------------------------------------------------------
+ * Starts with nothing read.
+ */
+TargetWindow::TargetWindow(std::istream& infile)
+    : infile(infile), base(0), keepFrom(0), crc(0), ended(false) {
+}
+
+/* Member function: ensure
+ * --------------------------------------------------------
+ * Drops the released bytes before a read once they are at least half
+ * of what is held, so each byte is moved a bounded number of times.
+ */
+bool TargetWindow::ensure(long long end) {
+    while (length() < end && !ended) {
+        if (keepFrom > base && keepFrom - base >= (long long) data.length() / 2) {
+            data.erase(0, size_t(keepFrom - base));
+            base = keepFrom;
+        }
+        size_t size = data.length();
+        data.resize(size + WINDOW_READ_SIZE);
+        infile.read(&data[size], WINDOW_READ_SIZE);
+        long count = long(infile.gcount());
+        data.resize(size + count);
+        crc = crc32(data.data() + size, count, crc);
+        if (count < WINDOW_READ_SIZE) {
+            if (infile.bad()) error("Cannot read the file.");
+            ended = true;
+        }
+    }
+    return length() >= end;
+}
+
+/* Function: encodeDelta
+ * Usage: encodeDelta(reference, target, encoder);
+ * --------------------------------------------------------
+ * Finds the runs target shares with reference and gives the encoder
+ * the instructions that build target from them.  A block found is
+ * extended backward over bytes not yet encoded and forward as far as
+ * the two agree, and the search goes on from the end of the copy.
+ */
+static void encodeDelta(const std::string& reference, TargetWindow& target,
+                        DeltaEncoder& encoder) {
+    const unsigned char* ref = (const unsigned char*) reference.data();
+    long referenceLength = long(reference.length());
+    encoder.copyEnd = 0;
+
+    // the factor that takes the byte leaving the window out of the hash
+    unsigned long long leaving = 1;
+    for (int i = 1; i < DELTA_BLOCK_SIZE; i++) {
+        leaving *= FINGERPRINT_MULTIPLIER;
+    }
+
+    DeltaIndex index(reference);
+    long long pending = 0;       // the first byte not yet encoded
+    long long position = 0;
+    unsigned long long hash = 0;
+    if (target.ensure(DELTA_BLOCK_SIZE)) hash = fingerprint(target.at(0));
+    while (target.ensure(position + DELTA_BLOCK_SIZE)) {
+        long offset = index.find(hash, target.at(position));
+        if (offset == NO_BLOCK) {
+            if (target.ensure(position + DELTA_BLOCK_SIZE + 1)) {
+                const unsigned char* bytes = target.at(position);
+                hash = (hash - bytes[0] * leaving) * FINGERPRINT_MULTIPLIER
+                       + bytes[DELTA_BLOCK_SIZE];
+            }
+            position++;
+            if (position - pending >= WINDOW_READ_SIZE) {
+                // a copy found later can no longer extend back this far
+                encoder.insert((const char*) target.at(pending), long(position - pending));
+                pending = position;
+                target.release(pending);
+            }
+            continue;
+        }
+
+        long long start = position;
+        while (start > pending && offset > 0 && *target.at(start - 1) == ref[offset - 1]) {
+            start--;
+            offset--;
+        }
+        encoder.insert((const char*) target.at(pending), long(start - pending));
+        long long end = position + DELTA_BLOCK_SIZE;
+        long referenceEnd = offset + long(end - start);
+        while (referenceEnd < referenceLength && target.ensure(end + 1) &&
+               *target.at(end) == ref[referenceEnd]) {
+            end++;
+            referenceEnd++;
+            target.release(end);
+        }
+        encoder.copy(offset, long(end - start));
+        pending = position = end;
+        target.release(pending);
+        if (target.ensure(position + DELTA_BLOCK_SIZE)) hash = fingerprint(target.at(position));
+    }
+    encoder.insert((const char*) target.at(pending), long(target.length() - pending));
+}
+
+/* Function: compressDelta
+ * --------------------------------------------------------
+ * Reads the reference whole and the input through a window, encodes
+ * the delta in memory, then writes the header and the two compressed
+ * streams.
+ */
+void compressDelta(std::istream& reference, std::istream& infile, std::ostream& outfile,
+                   const CompressionOptions& options, CompressionStats* stats) {
+    std::string referenceData = readRest(reference);
+    TargetWindow target(infile);
+    DeltaEncoder encoder;
+    encodeDelta(referenceData, target, encoder);
+
+    std::ostringstream streams;
+    std::istringstream instructions(encoder.instructions);
+    compress(instructions, streams, options);
+    std::istringstream inserted(encoder.inserted);
+    compress(inserted, streams, options);
+
+    writeNumber(outfile, DELTA_MAGIC, 4);
+    outfile.put(char(DELTA_VERSION));
+    writeNumber(outfile, referenceData.length(), 8);
+    writeNumber(outfile, crc32(referenceData.data(), referenceData.length()), 4);
+    writeNumber(outfile, target.length(), 8);
+    writeNumber(outfile, target.checksum(), 4);
+    std::string compressed = streams.str();
+    outfile.write(compressed.data(), compressed.length());
+    if (!outfile) error("Cannot write the output.");
+
+    if (stats != NULL) {
+        *stats = CompressionStats();
+        stats->operations = 1;
+        stats->uncompressedBytes = target.length();
+        stats->compressedBytes = DELTA_HEADER_BYTES + compressed.length();
+        stats->headerBytes = DELTA_HEADER_BYTES;
+    }
+}
+
+/* Function: readDeltaStream
+ * Usage: string data = readDeltaStream(infile, stats);
+ * --------------------------------------------------------
+ * Returns the next of the two compressed streams of a delta, adding
+ * the statistics of decompressing it to stats.
+ */
+static std::string readDeltaStream(std::istream& infile, CompressionStats& stats) {
+    if (!isLeveledCompression(infile)) error("Delta is damaged.");
+    std::ostringstream data;
+    CompressionStats streamStats;
+    decompressLeveled(infile, data, &streamStats);
+    stats.compressedBytes += streamStats.compressedBytes;
+    return data.str();
+}
+
+/* Function: decompressDelta
+ * --------------------------------------------------------
+ * Checks the header against the reference, then follows the
+ * instructions, writing each run as it goes and checking every copy
+ * against the bounds of the reference and the size and checksum of
+ * the result against the header.
+ */
+void decompressDelta(std::istream& reference, std::istream& infile, std::ostream& outfile,
+                     CompressionStats* stats) {
+    if (infile.peek() == EOF || readNumber(infile, 4) != DELTA_MAGIC) error("Not a delta.");
+    if (infile.get() != DELTA_VERSION) error("Delta is of an unknown version.");
+    long long referenceLength = readNumber(infile, 8);
+    unsigned long referenceChecksum = (unsigned long) readNumber(infile, 4);
+    long long length = readNumber(infile, 8);
+    unsigned long checksum = (unsigned long) readNumber(infile, 4);
+
+    std::string referenceData = readRest(reference);
+    if ((long long) referenceData.length() != referenceLength ||
+        crc32(referenceData.data(), referenceData.length()) != referenceChecksum) {
+        error("Delta was made against a different reference.");
+    }
+
+    CompressionStats local;
+    local.compressedBytes = DELTA_HEADER_BYTES;
+    std::string instructions = readDeltaStream(infile, local);
+    std::string inserted = readDeltaStream(infile, local);
+
+    size_t position = 0, insertedUsed = 0;
+    long long written = 0, copyEnd = 0;
+    unsigned long crc = 0;
+    while (position < instructions.length()) {
+        unsigned long long code = readVarNumber(instructions, position);
+        unsigned long long runLength = code >> 1;
+        if (runLength > (unsigned long long) (length - written)) error("Delta is damaged.");
+        if (code & 1) {
+            unsigned long long zigzag = readVarNumber(instructions, position);
+            long long offset = copyEnd + (long long) ((zigzag >> 1) ^ -(zigzag & 1));
+            if (offset < 0 || offset > referenceLength ||
+                runLength > (unsigned long long) (referenceLength - offset)) {
+                error("Delta is damaged.");
+            }
+            const char* run = referenceData.data() + offset;
+            outfile.write(run, runLength);
+            crc = crc32(run, long(runLength), crc);
+            copyEnd = offset + runLength;
+        } else {
+            if (runLength > inserted.length() - insertedUsed) error("Delta is damaged.");
+            const char* run = inserted.data() + insertedUsed;
+            outfile.write(run, runLength);
+            crc = crc32(run, long(runLength), crc);
+            insertedUsed += runLength;
+        }
+        written += runLength;
+    }
+    if (!outfile) error("Cannot write the output.");
+    if (written != length || insertedUsed != inserted.length() || crc != checksum) {
+        error("Delta is damaged.");
+    }
+
+    if (stats != NULL) {
+        *stats = local;
+        stats->operations = 1;
+        stats->uncompressedBytes = length;
+        stats->headerBytes = DELTA_HEADER_BYTES;
+    }
+}
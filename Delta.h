@@ -0,0 +1,85 @@
+/*******************************************************
+ * File: Delta.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Delta compression: a new version of a file is encoded against an
+ * older version of it, the reference, as a list of instructions to
+ * copy runs of the reference and to insert new bytes between them.
+ * When the two versions differ by a few kilobytes, the delta is about
+ * that size, however large the files are, whereas compressing the new
+ * version alone costs as much as the first time.
+ *
+ * The encoder indexes the reference by the fingerprints of its blocks
+ * of DELTA_BLOCK_SIZE bytes, then slides a rolling fingerprint along
+ * the new version looking them up.  Each block found is extended in
+ * both directions as far as the bytes agree and becomes a copy; the
+ * bytes between copies are inserted.  The instructions and the
+ * inserted bytes go in two separate streams, each compressed as
+ * compress with options writes it, so each gets Huffman tables suited
+ * to it.  A delta file is laid out as
+ *
+ *   - a header: DELTA_MAGIC and the format version, the size and
+ *     CRC-32 of the reference, and the size and CRC-32 of the new
+ *     version,
+ *   - the compressed instructions: for each, its length shifted left
+ *     one bit with the low bit set for a copy, and for a copy the
+ *     distance of its start from the end of the copy before it, both
+ *     as variable-length numbers of 7 bits a byte,
+ *   - the compressed inserted bytes, in order.
+ *
+ * Copies are mostly taken in order from nearby places in the
+ * reference, so the distances are small numbers that compress well.
+ *
+ * Copies may come from anywhere in the reference, so it is held in
+ * memory whole, by both the encoder and the decoder: a reference
+ * larger than the memory available cannot be used.  The new version
+ * is read through a window of a few megabytes and the output written
+ * as it is built, but the two streams are held whole, uncompressed,
+ * on both sides, so a new version that shares little with the
+ * reference costs about its own size again.
+ */
+
+#ifndef Delta_Included
+#define Delta_Included
+
+#include "CompressionLevels.h"
+#include "CompressionStats.h"
+#include <iostream>
+
+/* Constant: DELTA_BLOCK_SIZE
+ * The length of the blocks of the reference that are fingerprinted,
+ *   and so the shortest run of it the encoder looks for.  Any run of
+ *   twice this length or more that the two versions share is found.
+ */
+const int DELTA_BLOCK_SIZE = 16;
+
+/* Function: compressDelta
+ * Usage: compressDelta(reference, infile, outfile, options);
+ * --------------------------------------------------------
+ * Encodes everything remaining in infile against everything remaining
+ * in reference, compressing the result with the options, and writes it
+ * to outfile.  Reports an error if the options are out of range.  If
+ * stats is not NULL, it is filled in with the size of the input and of
+ * the delta; the registry of CompressionStats.h sees the compression of
+ * the two streams instead.
+ */
+void compressDelta(std::istream& reference, std::istream& infile, std::ostream& outfile,
+                   const CompressionOptions& options, CompressionStats* stats = NULL);
+
+/* Function: decompressDelta
+ * Usage: decompressDelta(reference, infile, outfile);
+ * --------------------------------------------------------
+ * Applies the delta in infile to everything remaining in reference and
+ * writes the result to outfile.  Reports an error if infile is not a
+ * delta, if it was made against a different reference, or if it is
+ * damaged.  Damage found by the checksum at the end is reported after
+ * the output has been written, so the caller should discard the output
+ * on an error.  If stats is not NULL, it is filled in with the size of
+ * the delta and of the output; again the registry sees the two streams.
+ */
+void decompressDelta(std::istream& reference, std::istream& infile, std::ostream& outfile,
+                     CompressionStats* stats = NULL);
+
+#endif
@@ -13,6 +13,7 @@
  */
 
 #include "HuffmanEncoding.h"
+#include "CompressionLevels.h"
 
 /* Function: getFrequencyTable
  * Usage: Map<ext_char, int> freq = getFrequencyTable(file);
@@ -244,6 +245,170 @@ void writeEncodingPrefix(string prefix, obstream& outfile) {
     }
 }
 
+/* Function: encTreeToCodeLengths
+ * Usage: encTreeToCodeLengths(encodingTree, lengths, 0);
+ * --------------------------------------------------------
+ * Walks the tree exactly like encTreeToBinaryPrefixes, but only keeps
+ *   track of how deep each leaf is rather than the path to it.
+ */
+void encTreeToCodeLengths(Node* encodingTree,
+                          Map<ext_char, int>& lengths,
+                          int depth) {
+    if (encodingTree->one == NULL && encodingTree->zero == NULL) {
+        // Base Case: a leaf, whose depth is the length of its prefix
+        lengths.put(encodingTree->character, depth);
+    } else {
+        // Recursive Case: each branch is one bit deeper
+        if (encodingTree->zero != NULL) {
+            encTreeToCodeLengths(encodingTree->zero, lengths, depth + 1);
+        }
+        if (encodingTree->one != NULL) {
+            encTreeToCodeLengths(encodingTree->one, lengths, depth + 1);
+        }
+    }
+}
+
+/* Function: limitCodeLengths
+ * Usage: limitCodeLengths(lengths, frequencies, maxLength);
+ * --------------------------------------------------------
+ * Keeps track of the Kraft sum of the lengths in units of 2^-maxLength:
+ *   a prefix of length n uses up 2^(maxLength - n) units out of a total
+ *   of 2^maxLength, and the lengths form a prefix code exactly when the
+ *   sum fits.  Lengthening the longest prefix that is still short enough
+ *   frees the fewest units, so it changes the code the least.  The work
+ *   is done on copies in Vectors, since it looks at every symbol many
+ *   times over.
+ */
+void limitCodeLengths(Map<ext_char, int>& lengths,
+                      Map<ext_char, int>& frequencies,
+                      int maxLength) {
+    Vector<ext_char> symbols;
+    Vector<int> length, weight;
+    long capacity = 1L << maxLength;
+    long used = 0;
+    foreach (ext_char symbol in lengths) {
+        int n = lengths[symbol];
+        if (n > maxLength) n = maxLength;
+        if (n < 1) n = 1;
+        symbols.add(symbol);
+        length.add(n);
+        weight.add(frequencies[symbol]);
+        used += 1L << (maxLength - n);
+    }
+
+    // Step 1: lengthen prefixes until the code fits again, picking the
+    //   longest prefix below the limit and, among those, the least
+    //   frequent symbol
+    while (used > capacity) {
+        int best = -1;
+        for (int i = 0; i < symbols.size(); i++) {
+            if (length[i] >= maxLength) continue;
+            if (best < 0 || length[i] > length[best] ||
+                (length[i] == length[best] && weight[i] < weight[best])) {
+                best = i;
+            }
+        }
+        length[best]++;
+        used -= 1L << (maxLength - length[best]);
+    }
+
+    // Step 2: spend any units left over on the most frequent symbols
+    while (true) {
+        int best = -1;
+        for (int i = 0; i < symbols.size(); i++) {
+            if (length[i] <= 1 || used + (1L << (maxLength - length[i])) > capacity) continue;
+            if (best < 0 || weight[i] > weight[best]) best = i;
+        }
+        if (best < 0) break;
+        used += 1L << (maxLength - length[best]);
+        length[best]--;
+    }
+
+    for (int i = 0; i < symbols.size(); i++) {
+        lengths[symbols[i]] = length[i];
+    }
+}
+
+/* Function: buildCanonicalTree
+ * Usage: Node* tree = buildCanonicalTree(lengths);
+ * --------------------------------------------------------
+ * Prefixes are handed out in order of increasing length, and in order
+ *   of increasing symbol among symbols of the same length (the order the
+ *   Map iterates in).  Each prefix is one more than the previous one,
+ *   shifted left by however many bits longer it is.  The tree is then
+ *   grown by following each prefix down from the root.
+ */
+Node* buildCanonicalTree(Map<ext_char, int>& lengths) {
+    Node* root = new Node;
+    root->character = NOT_A_CHAR;
+    root->zero = NULL;
+    root->one = NULL;
+    root->weight = 0;
+
+    int maxLength = 0;
+    foreach (ext_char symbol in lengths) {
+        int length = lengths.get(symbol);
+        if (length < 1 || length > 31) {
+            freeTree(root);
+            return NULL;
+        }
+        if (length > maxLength) maxLength = length;
+    }
+
+    unsigned long prefix = 0;
+    int prevLength = 0;
+    for (int length = 1; length <= maxLength; length++) {
+        foreach (ext_char symbol in lengths) {
+            if (lengths.get(symbol) != length) continue;
+
+            prefix <<= (length - prevLength);
+            prevLength = length;
+
+            // a prefix that no longer fits in length bits means the
+            //   lengths describe more leaves than a binary tree can hold
+            if (prefix >> length != 0) {
+                freeTree(root);
+                return NULL;
+            }
+
+            // walk down the prefix, most significant bit first, creating
+            //   internal nodes as needed
+            Node* current = root;
+            for (int bit = length - 1; bit >= 0; bit--) {
+                Node*& child = ((prefix >> bit) & 1) ? current->one : current->zero;
+                if (child == NULL) {
+                    child = new Node;
+                    child->character = NOT_A_CHAR;
+                    child->zero = NULL;
+                    child->one = NULL;
+                    child->weight = 0;
+                }
+                current = child;
+            }
+            current->character = symbol;
+            prefix++;
+        }
+    }
+    return root;
+}
+
+/* Function: readEncodedSymbol
+ * Usage: ext_char symbol = readEncodedSymbol(infile, encodingTree);
+ * --------------------------------------------------------
+ * Follows one bit at a time down the tree until reaching a leaf.
+ */
+ext_char readEncodedSymbol(ibstream& infile, Node* encodingTree) {
+    Node* current = encodingTree;
+    while (current->zero != NULL || current->one != NULL) {
+        int bit = infile.readBit();
+        if (bit == EOF) return EOF;
+
+        current = (bit == 0) ? current->zero : current->one;
+        if (current == NULL) return EOF;
+    }
+    return current->character;
+}
+
 /* Function: encodeFile
  * Usage: encodeFile(source, encodingTree, output);
  * --------------------------------------------------------
@@ -541,6 +706,26 @@ Map<ext_char, int> readFileHeader(ibstream& infile) {
 	return result;
 }
 
+/* Function: recordTreeStats
+ * Usage: recordTreeStats(frequencies, encodingTree, stats);
+ * --------------------------------------------------------
+ * Records the byte counts and the code lengths of the tree built from
+ *   the (unscrambled) frequency table.  Every symbol in the table,
+ *   PSEUDO_EOF included, is coded once per occurrence.
+ */
+static void recordTreeStats(Map<ext_char, int>& frequencies, Node* encodingTree,
+                            CompressionStats& stats) {
+    Map<ext_char, int> lengths;
+    encTreeToCodeLengths(encodingTree, lengths, 0);
+    foreach (ext_char symbol in frequencies) {
+        if (symbol >= 0 && symbol < 256) {
+            stats.symbolCounts[symbol] += frequencies[symbol];
+            stats.uncompressedBytes += frequencies[symbol];
+        }
+        stats.addCodes(frequencies[symbol], lengths[symbol]);
+    }
+}
+
 /* Function: compress
  * Usage: compress(infile, outfile);
  * --------------------------------------------------------
@@ -552,16 +737,31 @@ Map<ext_char, int> readFileHeader(ibstream& infile) {
  * which should not require much logic of its own and should
  * primarily be glue code.
  */
-void compress(ibstream& infile, obstream& outfile) {
+void compress(ibstream& infile, obstream& outfile, CompressionStats* stats) {
+    // only measure anything if the caller or the global registry asks
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(stats, local);
+    StageTimer timer(active);
+    std::streampos outStart = (active != NULL) ? outfile.tellp() : std::streampos(0);
+
     // generate a table showing the frequency of each char
+    timer.start(STATS_HISTOGRAM);
 	Map<ext_char, int> freqTable = getFrequencyTable(infile);
     
     // create the encoding tree based upon the character frequency table
+    timer.start(STATS_TREE);
     Node* encodingTree = buildEncodingTree(freqTable);
+    timer.stop();
+
+    // the header scrambles the frequency table, so the code lengths must
+    //   be recorded before it is written
+    if (active != NULL) recordTreeStats(freqTable, encodingTree, *active);
     
     // write the encoding tree into the header of the output file so
     //   other clients can decode
+    timer.start(STATS_TABLE);
     writeFileHeader(outfile, freqTable);
+    if (active != NULL) active->headerBytes = outfile.tellp() - outStart;
 
     // rewind the file pointer to the beginning of the input file as
     //   this input file has been read through once to calculate the
@@ -569,10 +769,19 @@ void compress(ibstream& infile, obstream& outfile) {
     infile.rewind();
     
     // using the encoding tree, read through the input file and encode it
+    timer.start(STATS_ENCODE);
     encodeFile(infile, encodingTree, outfile);
+    timer.start(STATS_FLUSH);
+    outfile.flush();
+    timer.stop();
     
     // free the memory allocated in creating the encoding tree
     freeTree(encodingTree);
+
+    if (active != NULL) {
+        active->compressedBytes = outfile.tellp() - outStart;
+        finishCompressionStats(STATS_COMPRESSION, active);
+    }
 }
 
 /* Function: decompress
@@ -587,18 +796,44 @@ void compress(ibstream& infile, obstream& outfile) {
  * which should not require much logic of its own and should
  * primarily be glue code.
  */
-void decompress(ibstream& infile, ostream& outfile) {
+void decompress(ibstream& infile, ostream& outfile, CompressionStats* stats) {
+    // files written by compress with options have a format of their own
+    if (isLeveledCompression(infile)) {
+        decompressLeveled(infile, outfile, stats);
+        return;
+    }
+
+    // only measure anything if the caller or the global registry asks
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(stats, local);
+    StageTimer timer(active);
+    std::streampos inStart = (active != NULL) ? infile.tellg() : std::streampos(0);
+
     // in order to decompress, we must have the encryption table;
     //   read the encryption table in the header of the encrypted file
+    timer.start(STATS_TABLE);
     Map<ext_char, int> encodeTable = readFileHeader(infile);
+    if (active != NULL) active->headerBytes = infile.tellg() - inStart;
     
     // take the encoding table and build the encoding tree
+    timer.start(STATS_TREE);
     Node* encodingTree = buildEncodingTree(encodeTable);
+    timer.stop();
+    if (active != NULL) recordTreeStats(encodeTable, encodingTree, *active);
     
     // using the encoding tree, decode the encoded file and write it
     //   out to an output file
+    timer.start(STATS_DECODE);
     decodeFile(infile, encodingTree, outfile);
+    timer.start(STATS_FLUSH);
+    outfile.flush();
+    timer.stop();
     
     // free the memory allocated in creating the encoding tree
     freeTree(encodingTree);
+
+    if (active != NULL) {
+        active->compressedBytes = infile.size() - inStart;
+        finishCompressionStats(STATS_DECOMPRESSION, active);
+    }
 }
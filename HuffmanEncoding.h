@@ -12,6 +12,7 @@
 #define HuffmanEncoding_Included
 
 #include "HuffmanTypes.h"
+#include "CompressionStats.h"
 #include "map.h"
 #include "bstream.h"
 #include "pqueue.h"
@@ -129,8 +130,11 @@ Map<ext_char, int> readFileHeader(ibstream& infile);
  * previous functions together to implement this function,
  * which should not require much logic of its own and should
  * primarily be glue code.
+ *
+ * If stats is not NULL, it is filled in with statistics about the
+ * compression (see CompressionStats.h).
  */
-void compress(ibstream& infile, obstream& outfile);
+void compress(ibstream& infile, obstream& outfile, CompressionStats* stats = NULL);
 
 /* Function: decompress
  * Usage: decompress(infile, outfile);
@@ -143,8 +147,11 @@ void compress(ibstream& infile, obstream& outfile);
  * previous functions together to implement this function,
  * which should not require much logic of its own and should
  * primarily be glue code.
+ *
+ * If stats is not NULL, it is filled in with statistics about the
+ * decompression.
  */
-void decompress(ibstream& infile, ostream& outfile);
+void decompress(ibstream& infile, ostream& outfile, CompressionStats* stats = NULL);
 
 ////////// ADDED HELPER FUNCTIONS //////////
 
@@ -181,6 +188,56 @@ void encTreeToBinaryPrefixes(Node* encodingTree,
  */
 void writeEncodingPrefix(string prefix, obstream& outfile);
 
+/* Function: encTreeToCodeLengths
+ * Usage: encTreeToCodeLengths(encodingTree, lengths, 0);
+ * --------------------------------------------------------
+ * Take a binary tree, which represents the encoding prefixes used
+ *   to encode a set of symbols, and create a map from each symbol to
+ *   the length of its prefix (its depth in the tree).  Symbols are not
+ *   limited to bytes; any ext_char may appear at a leaf.
+ */
+void encTreeToCodeLengths(Node* encodingTree,
+                          Map<ext_char, int>& lengths,
+                          int depth);
+
+/* Function: limitCodeLengths
+ * Usage: limitCodeLengths(lengths, frequencies, maxLength);
+ * --------------------------------------------------------
+ * Adjusts the prefix lengths produced by encTreeToCodeLengths so that
+ *   none is longer than maxLength, while still forming a prefix code.
+ *   Overlong prefixes are cut down to maxLength and the prefixes that
+ *   cost least to lengthen pay for it; any room left over then goes to
+ *   shortening the prefixes of the most frequent symbols.  Capping the
+ *   length lets a decoder look prefixes up in a table of 2^maxLength
+ *   entries instead of walking the tree a bit at a time.
+ */
+void limitCodeLengths(Map<ext_char, int>& lengths,
+                      Map<ext_char, int>& frequencies,
+                      int maxLength);
+
+/* Function: buildCanonicalTree
+ * Usage: Node* tree = buildCanonicalTree(lengths);
+ * --------------------------------------------------------
+ * Given the prefix length of every symbol, builds the encoding tree of
+ *   the canonical Huffman code with those lengths: shorter prefixes come
+ *   first and symbols of equal length are numbered in increasing order.
+ *   Since the prefixes follow from the lengths alone, a compressed file
+ *   only has to store the lengths.  Returns NULL if the lengths cannot
+ *   form a prefix code.
+ */
+Node* buildCanonicalTree(Map<ext_char, int>& lengths);
+
+/* Function: readEncodedSymbol
+ * Usage: ext_char symbol = readEncodedSymbol(infile, encodingTree);
+ * --------------------------------------------------------
+ * Reads bits from the input file, walking down the encoding tree, until
+ *   a leaf is reached and returns the symbol stored there.  Returns
+ *   EOF if the file ends first or the bits lead off the tree; NOT_A_CHAR
+ *   cannot signal this, since it may itself be a symbol when the tree
+ *   encodes an alphabet wider than bytes.
+ */
+ext_char readEncodedSymbol(ibstream& infile, Node* encodingTree);
+
 /* Function: scrambleTable
  * Usage: scrambleTable(frequencies);
  * --------------------------------------------------------
@@ -12,7 +12,13 @@
 #include <sstream>
 #include <iomanip>
 #include <limits>
+#include <stdexcept>
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <dirent.h>
 #include "console.h"
 #include "simpio.h"
 #include "strlib.h"
@@ -22,7 +28,27 @@
 #include "MemoryDiagnostics.h"
 #include "LZWWrapper.h"
 #include "LZWLibrary.h"
+#include "LZWEncoding.h"
+#include "LZWBlocks.h"
+#include "RunLengthEncoding.h"
+#include "AutoCompression.h"
+#include "CompressionLevels.h"
+#include "BatchCompression.h"
+#include "CompressedSearch.h"
+#include "Benchmark.h"
+#include "Tracing.h"
+#include "CommandLine.h"
+#include "ThreadPool.h"
+#include "SPSCRing.h"
+#include "AsyncIO.h"
+#include "Archive.h"
+#include "Chunking.h"
+#include "Delta.h"
+#include "Checksum.h"
+#include "ResultCache.h"
+#include "thread.h"
 #include "random.h"
+#include "error.h"
 
 using namespace std;
 
@@ -43,6 +69,7 @@ enum MenuEntry {
     MANUAL_TEST_COMPRESS_LZW,
     MANUAL_TEST_DECOMPRESS_LZW,
     AUTOMATIC_TEST_LZW,
+    BENCHMARK,
 	QUIT,
 };
 
@@ -854,7 +881,7 @@ void testAutomaticLZW() {
         compressString(randomStr, std::back_inserter(compressed));
         
         // STEP 3: Write compressed string onto file
-        ofstream outFile;
+        ofbstream outFile;
         string filename = "/Users/ebeach/test" +
                           convertInt(randomInteger(500, 999)) +
                           "random.txt";
@@ -870,7 +897,7 @@ void testAutomaticLZW() {
         outFile.close();
         
         // STEP 4: Read compressed file into a vector
-        ifstream inputFile;
+        ifbstream inputFile;
         inputFile.open(filename.c_str());
         if (!inputFile.is_open()) {
             checkCondition(false, "Opening compressed file for reading");
@@ -945,26 +972,2119 @@ void testBasicLZW() {
     
     checkVectors(actual2, expected2, "Converting string to integers");
     
-    // STEP 3: Test writing the file to disk
-    ofstream outFile3;
+    // STEP 3: Test packing the codes into binary and reading them back
+    logInfo("Testing binary packing of LZW codes");
+    {
+        ostringbstream packed;
+        writeToFile(packed, actual2);
+        
+        // 8 bits of width, 32 bits of count, then 14 codes of 9 bits each
+        checkCondition(packed.size() == (8 + 32 + 14 * 9 + 7) / 8,
+                       "Codes are packed into 9-bit binary fields");
+        
+        istringbstream unpacked(packed.str());
+        vector<unsigned long> roundTrip = readFileIntoCompressedVector(unpacked);
+        checkCondition(roundTrip.size() == actual2.size(),
+                       "Reading packed codes returns every code");
+        checkVectors(roundTrip, actual2, "Reading packed codes returns the same codes");
+    }
+    
+    // STEP 4: Test writing the file to disk
+    ofbstream outFile3;
     string filename = "/Users/ebeach/testA101.txt";
     outFile3.open(filename.c_str());
     if (!outFile3.is_open()) {
         checkCondition(false, "Writing file to disk");
         outFile3.clear();
+        return;
     }
     
-    // STEP 4-A: Write a file to disk
+    // STEP 5-A: Write a file to disk
     writeToFile(outFile3, actual2);
     outFile3.close();
     
-    // STEP 4-B: Read the file from disk
+    // STEP 5-B: Read the file from disk
     int statusDel = remove(filename.c_str());
     if (statusDel != 0) {
         checkCondition(false, "Delete the file used to temporarily store compressed data");
     }
 }
 
+/* Function: checkLZWRoundTrip
+ * --------------------------------------------------------
+ * Compresses the given data with the bounded LZW encoder, decompresses it
+ *   again and checks that the original data comes back.
+ */
+void checkLZWRoundTrip(const string& data, const LZWOptions& options,
+                       string message) {
+    ostringbstream compressed;
+    lzwCompress(data, compressed, options);
+    
+    istringbstream toDecompress(compressed.str());
+    ostringstream decompressed;
+    lzwDecompress(toDecompress, decompressed, options.preset);
+    checkCondition(decompressed.str() == data, message);
+}
+
+/* Function: testBoundedLZW
+ * --------------------------------------------------------
+ * Perform end-to-end tests on the bounded-memory LZW encoder, using small
+ *   dictionaries so that the larger test files force the dictionary to be
+ *   cleared many times over.
+ */
+void testBoundedLZW() {
+    LZWOptions whenFull;
+    whenFull.maxCodeBits = LZW_SMALLEST_MAX_CODE_BITS;
+    whenFull.resetPolicy = LZW_RESET_WHEN_FULL;
+    
+    LZWOptions onRatioDrop;
+    onRatioDrop.maxCodeBits = LZW_SMALLEST_MAX_CODE_BITS;
+    onRatioDrop.resetPolicy = LZW_RESET_ON_RATIO_DROP;
+    
+    LZWOptions defaults;
+    
+    checkLZWRoundTrip("", defaults, "Empty input survives bounded LZW");
+    
+    Vector<string> files;
+    files += "singleChar", "nonRepeated", "allRepeated", "poem", "allCharsOnce", "tomSawyer", "dikdik.jpg", "random";
+    foreach (string file in files) {
+        logInfo("Testing bounded LZW on file test/encodeDecode/" + file);
+        ifbstream input("test/encodeDecode/" + file);
+        assertCondition(input.is_open(), ("Cannot open file test/encodeDecode/" + file + " for reading!"));
+        ostringstream contents;
+        contents << input.rdbuf();
+        
+        checkLZWRoundTrip(contents.str(), whenFull, "12-bit dictionary cleared when full");
+        checkLZWRoundTrip(contents.str(), onRatioDrop, "12-bit dictionary cleared when the ratio drops");
+        checkLZWRoundTrip(contents.str(), defaults, "16-bit dictionary with default options");
+    }
+    
+    /* A long run of one character repeatedly hits the entry that is being
+     * defined by the current code, which is the trickiest case to decode.
+     */
+    checkLZWRoundTrip(string(100000, 'a'), whenFull, "Long run of one character");
+}
+
+/* Function: testStreamingLZW
+ * --------------------------------------------------------
+ * Checks that compressing a stream chunk by chunk gives exactly the same
+ *   result as compressing the whole input at once, and that decoding into
+ *   small buffers reassembles the original bytes.
+ */
+void testStreamingLZW() {
+    LZWOptions options;
+    
+    Vector<string> files;
+    files += "poem", "tomSawyer", "dikdik.jpg", "spl.jar";
+    foreach (string file in files) {
+        logInfo("Testing streaming LZW on file test/encodeDecode/" + file);
+        ifbstream input("test/encodeDecode/" + file);
+        assertCondition(input.is_open(), ("Cannot open file test/encodeDecode/" + file + " for reading!"));
+        ostringstream contents;
+        contents << input.rdbuf();
+        input.rewind();
+        
+        ostringbstream fromString, fromStream;
+        lzwCompress(contents.str(), fromString, options);
+        lzwCompress(input, fromStream, options);
+        checkCondition(fromString.str() == fromStream.str(),
+                       "Chunked encoding matches whole-input encoding");
+        
+        /* Pull the output through a buffer that splits most entries. */
+        istringbstream toDecompress(fromStream.str());
+        LZWDecoder decoder(toDecompress);
+        string decoded;
+        char buffer[7];
+        long length;
+        while ((length = decoder.decode(buffer, sizeof buffer)) > 0) {
+            decoded.append(buffer, length);
+        }
+        checkCondition(decoded == contents.str(), "Decoding in small pieces gets back the original file");
+    }
+    
+    /* Line endings and a trailing newline must survive untouched. */
+    string lineEndings = "one\r\ntwo\n\nthree\r\n";
+    istringstream lineInput(lineEndings);
+    ostringbstream compressed;
+    lzwCompress(lineInput, compressed, options);
+    istringbstream toDecompress(compressed.str());
+    ostringstream decompressed;
+    lzwDecompress(toDecompress, decompressed);
+    checkCondition(decompressed.str() == lineEndings, "CRLF and trailing newlines are preserved");
+}
+
+/* Function: testLZWLibraryAPI
+ * --------------------------------------------------------
+ * Exercises the non-interactive LZW entry points: the buffer variants,
+ *   mixing buffers with streams, and the errors reported for bad options
+ *   and damaged input.
+ */
+void testLZWLibraryAPI() {
+    string text = "TOBEORNOTTOBEORTOBEORNOT#TOBEORNOTTOBEORTOBEORNOT";
+    
+    logInfo("Testing the buffer variants of lzwCompress / lzwDecompress");
+    string compressed = lzwCompress(text);
+    checkCondition(compressed.length() < text.length(), "Repetitive text gets smaller");
+    checkCondition(lzwDecompress(compressed) == text, "Buffer round trip gets back the original");
+    checkCondition(lzwDecompress(lzwCompress("")) == "", "Empty buffer round trip");
+    
+    logInfo("Testing that buffers and streams produce the same format");
+    istringstream textStream(text);
+    ostringbstream streamed;
+    lzwCompress(textStream, streamed);
+    checkCondition(streamed.str() == compressed, "Stream and buffer compression agree");
+    
+    logInfo("Testing error reporting");
+    bool reported = false;
+    try {
+        LZWOptions tooWide;
+        tooWide.maxCodeBits = LZW_LARGEST_MAX_CODE_BITS + 1;
+        lzwCompress(text, tooWide);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Unsupported code width is reported");
+    
+    reported = false;
+    try {
+        lzwDecompress(compressed.substr(0, compressed.length() / 2));
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Truncated stream is reported");
+}
+
+/* Function: testHybridLZW
+ * --------------------------------------------------------
+ * Tests the canonical Huffman helpers over a wide alphabet and the LZW
+ *   mode that Huffman codes its output codes block by block.
+ */
+void testHybridLZW() {
+    logInfo("Testing buildCanonicalTree");
+    Map<ext_char, int> lengths;
+    lengths.put(LZW_STOP_CODE, 1);
+    lengths.put(300, 2);
+    lengths.put('a', 2);
+    Node* tree = buildCanonicalTree(lengths);
+    assertCondition(tree != NULL, "Valid lengths produce a tree");
+    Map<ext_char, string> prefixes;
+    encTreeToBinaryPrefixes(tree, prefixes, "");
+    checkCondition(prefixes.get(LZW_STOP_CODE) == "0", "Shortest prefix comes first");
+    checkCondition(prefixes.get('a') == "10", "Smaller symbol of equal length comes first");
+    checkCondition(prefixes.get(300) == "11", "Symbols wider than a byte get prefixes");
+    Map<ext_char, int> roundTrip;
+    encTreeToCodeLengths(tree, roundTrip, 0);
+    checkCondition(roundTrip.size() == 3 && roundTrip.get(LZW_STOP_CODE) == 1 &&
+                   roundTrip.get('a') == 2 && roundTrip.get(300) == 2,
+                   "Code lengths can be recovered from the tree");
+    
+    ostringbstream bits;
+    writeEncodingPrefix("11", bits);
+    writeEncodingPrefix("0", bits);
+    istringbstream readBack(bits.str());
+    checkCondition(readEncodedSymbol(readBack, tree) == 300, "Decodes a wide symbol");
+    checkCondition(readEncodedSymbol(readBack, tree) == LZW_STOP_CODE, "Decodes a symbol equal to NOT_A_CHAR");
+    freeTree(tree);
+    
+    lengths.put('b', 1);
+    checkCondition(buildCanonicalTree(lengths) == NULL, "Too many short prefixes are rejected");
+    
+    LZWOptions hybrid;
+    hybrid.huffmanCodes = true;
+    LZWOptions smallHybrid = hybrid;
+    smallHybrid.maxCodeBits = LZW_SMALLEST_MAX_CODE_BITS;
+    smallHybrid.resetPolicy = LZW_RESET_WHEN_FULL;
+    LZWOptions plain;
+    
+    checkLZWRoundTrip("", hybrid, "Empty input survives LZW+Huffman");
+    checkLZWRoundTrip(string(100000, 'a'), hybrid, "Long run of one character survives LZW+Huffman");
+    
+    Vector<string> files;
+    files += "singleChar", "nonRepeated", "allCharsOnce", "tomSawyer", "dikdik.jpg", "random", "spl.jar";
+    foreach (string file in files) {
+        logInfo("Testing LZW+Huffman on file test/encodeDecode/" + file);
+        ifbstream input("test/encodeDecode/" + file);
+        assertCondition(input.is_open(), ("Cannot open file test/encodeDecode/" + file + " for reading!"));
+        ostringstream contents;
+        contents << input.rdbuf();
+        
+        checkLZWRoundTrip(contents.str(), hybrid, "16-bit dictionary with Huffman coded codes");
+        checkLZWRoundTrip(contents.str(), smallHybrid, "12-bit dictionary with Huffman coded codes");
+    }
+    
+    logInfo("Comparing LZW+Huffman against plain LZW on test/encodeDecode/dikdik.jpg");
+    ifbstream input("test/encodeDecode/dikdik.jpg");
+    assertCondition(input.is_open(), "Cannot open file test/encodeDecode/dikdik.jpg for reading!");
+    ostringstream contents;
+    contents << input.rdbuf();
+    checkCondition(lzwCompress(contents.str(), hybrid).length() <
+                   lzwCompress(contents.str(), plain).length(),
+                   "Huffman coding the codes makes binary data smaller");
+}
+
+/* Function: testPresetLZW
+ * --------------------------------------------------------
+ * Trains a preset dictionary on one text and checks that it helps small
+ *   inputs, survives dictionary resets and being saved to a file, and
+ *   that decoding with a missing or different preset is reported.
+ */
+void testPresetLZW() {
+    ifbstream input("test/encodeDecode/tomSawyer");
+    assertCondition(input.is_open(), "Cannot open file test/encodeDecode/tomSawyer for reading!");
+    ostringstream contents;
+    contents << input.rdbuf();
+    string sample = contents.str();
+    
+    logInfo("Training a preset on test/encodeDecode/tomSawyer");
+    LZWPreset preset = trainLZWPreset(sample);
+    checkCondition(preset.prefixes.size() == LZW_DEFAULT_PRESET_ENTRIES, "Preset is filled up to its size");
+    checkCondition(preset.id != 0, "Preset has an ID");
+    
+    ifbstream poemInput("test/encodeDecode/poem");
+    assertCondition(poemInput.is_open(), "Cannot open file test/encodeDecode/poem for reading!");
+    ostringstream poemContents;
+    poemContents << poemInput.rdbuf();
+    string poem = poemContents.str();
+    
+    LZWOptions withPreset;
+    withPreset.preset = &preset;
+    LZWOptions plain;
+    checkCondition(lzwCompress(poem, withPreset).length() < lzwCompress(poem, plain).length(),
+                   "Preset makes a small text smaller");
+    checkLZWRoundTrip(poem, withPreset, "Small text survives LZW with a preset");
+    checkLZWRoundTrip("", withPreset, "Empty input survives LZW with a preset");
+    
+    LZWOptions smallWhenFull = withPreset;
+    smallWhenFull.maxCodeBits = LZW_SMALLEST_MAX_CODE_BITS;
+    smallWhenFull.resetPolicy = LZW_RESET_WHEN_FULL;
+    checkLZWRoundTrip(sample, smallWhenFull, "Preset is restored after every reset");
+    LZWOptions hybridPreset = withPreset;
+    hybridPreset.huffmanCodes = true;
+    checkLZWRoundTrip(sample, hybridPreset, "Preset works with Huffman coded codes");
+    
+    logInfo("Saving and loading the preset");
+    ostringbstream presetFile;
+    writeLZWPreset(presetFile, preset);
+    istringbstream presetInput(presetFile.str());
+    LZWPreset loaded = readLZWPreset(presetInput);
+    checkCondition(loaded.id == preset.id, "Loaded preset has the same ID");
+    string compressed = lzwCompress(poem, withPreset);
+    checkCondition(lzwDecompress(compressed, &loaded) == poem, "Loaded preset decodes the stream");
+    
+    logInfo("Testing error reporting");
+    bool reported = false;
+    try {
+        lzwDecompress(compressed);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Missing preset is reported");
+    
+    reported = false;
+    try {
+        LZWPreset other = trainLZWPreset(poem);
+        lzwDecompress(compressed, &other);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Different preset is reported");
+    
+    reported = false;
+    try {
+        LZWPreset tooLarge = trainLZWPreset(sample, 4000);
+        LZWOptions small;
+        small.maxCodeBits = LZW_SMALLEST_MAX_CODE_BITS;
+        small.preset = &tooLarge;
+        lzwCompress(poem, small);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Preset too large for the dictionary is reported");
+}
+
+/* Function: testBlockLZW
+ * --------------------------------------------------------
+ * Tests block-mode LZW: parallel round trips, identical output for any
+ *   number of threads, random access to single blocks through the index,
+ *   and rejection of damaged files.
+ */
+void testBlockLZW() {
+    const long blockSize = 64 * 1024;
+    
+    Vector<string> files;
+    files += "singleChar", "poem", "tomSawyer", "spl.jar";
+    foreach (string file in files) {
+        logInfo("Testing block-mode LZW on file test/encodeDecode/" + file);
+        ifbstream input("test/encodeDecode/" + file);
+        assertCondition(input.is_open(), ("Cannot open file test/encodeDecode/" + file + " for reading!"));
+        ostringstream contents;
+        contents << input.rdbuf();
+        string original = contents.str();
+        
+        istringstream forOneThread(original), forFourThreads(original);
+        ostringstream oneThread, fourThreads;
+        lzwCompressBlocks(forOneThread, oneThread, LZWOptions(), blockSize, 1);
+        lzwCompressBlocks(forFourThreads, fourThreads, LZWOptions(), blockSize, 4);
+        checkCondition(oneThread.str() == fourThreads.str(), "Output does not depend on the number of threads");
+        
+        istringstream compressed(fourThreads.str());
+        ostringstream decompressed;
+        lzwDecompressBlocks(compressed, decompressed, NULL, 4);
+        checkCondition(decompressed.str() == original, "Parallel round trip gets back the original file");
+        
+        Vector<LZWBlockInfo> blocks = readLZWBlockIndex(compressed);
+        checkCondition(blocks.size() == (original.length() + blockSize - 1) / blockSize,
+                       "Index has one entry per block");
+        if (!blocks.isEmpty()) {
+            int last = blocks.size() - 1;
+            checkCondition(lzwDecompressBlock(compressed, blocks[last]) == original.substr(last * blockSize),
+                           "Last block can be decompressed on its own");
+        }
+    }
+    
+    logInfo("Testing block-mode LZW with a preset and Huffman coded codes");
+    LZWPreset preset = trainLZWPreset("TOBEORNOTTOBEORTOBEORNOT");
+    LZWOptions options;
+    options.preset = &preset;
+    options.huffmanCodes = true;
+    string text;
+    for (int i = 0; i < 2000; i++) {
+        text += "TOBEORNOT" + integerToString(i);
+    }
+    istringstream textInput(text);
+    ostringstream textCompressed;
+    lzwCompressBlocks(textInput, textCompressed, options, 1000, 3);
+    istringstream toDecompress(textCompressed.str());
+    ostringstream textDecompressed;
+    lzwDecompressBlocks(toDecompress, textDecompressed, &preset, 3);
+    checkCondition(textDecompressed.str() == text, "Small blocks with a preset round trip");
+    
+    logInfo("Testing error reporting");
+    bool reported = false;
+    try {
+        string damaged = textCompressed.str().substr(0, textCompressed.str().length() - 1);
+        istringstream damagedInput(damaged);
+        ostringstream ignored;
+        lzwDecompressBlocks(damagedInput, ignored, &preset, 3);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Missing block index is reported");
+    
+    reported = false;
+    try {
+        istringstream noPreset(textCompressed.str());
+        ostringstream ignored;
+        lzwDecompressBlocks(noPreset, ignored, NULL, 3);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Errors on pool threads are reported to the caller");
+}
+
+/* Function: runsOfRandomBytes
+ * --------------------------------------------------------
+ * Returns numRuns runs of runLength copies of a random byte each.
+ */
+string runsOfRandomBytes(int numRuns, int runLength) {
+    string result;
+    for (int i = 0; i < numRuns; i++) {
+        result += string(runLength, char(randomInteger(0, 255)));
+    }
+    return result;
+}
+
+/* Function: testAutoCompression
+ * --------------------------------------------------------
+ * Tests run-length encoding, the codec chosen for different kinds of
+ *   blocks, and end-to-end automatic compression of mixed input.
+ */
+void testAutoCompression() {
+    logInfo("Testing run-length encoding");
+    Vector<string> rleInputs;
+    rleInputs += "", "a", "abc", "aaa", string(1000, 'x'), runsOfRandomBytes(50, 2), runsOfRandomBytes(20, 131);
+    string literals;
+    for (int i = 0; i < 300; i++) {
+        literals += char(i);
+    }
+    rleInputs += literals, literals + string(500, '\0') + literals;
+    foreach (string input in rleInputs) {
+        string compressed = rleCompress(input);
+        checkCondition(rleDecompress(compressed) == input, "Run-length round trip gets back the original");
+        checkCondition(rleCompressedSize(input) == compressed.length(), "Size estimate matches the output");
+    }
+    checkCondition(rleCompress(string(1000, 'x')).length() < 20, "Long runs shrink");
+    bool reported = false;
+    try {
+        rleDecompress(rleCompress(literals).substr(0, 100));
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Truncated run-length data is reported");
+    
+    ifbstream textInput("test/encodeDecode/tomSawyer");
+    assertCondition(textInput.is_open(), "Cannot open file test/encodeDecode/tomSawyer for reading!");
+    ostringstream textContents;
+    textContents << textInput.rdbuf();
+    string text = textContents.str().substr(0, 100000);
+    
+    ifbstream binaryInput("test/encodeDecode/spl.jar");
+    assertCondition(binaryInput.is_open(), "Cannot open file test/encodeDecode/spl.jar for reading!");
+    ostringstream binaryContents;
+    binaryContents << binaryInput.rdbuf();
+    string binary = binaryContents.str().substr(0, 100000);
+    
+    string runs = runsOfRandomBytes(500, 200);
+    
+    logInfo("Testing codec selection");
+    AutoCompressionOptions options;
+    checkCondition(chooseBlockCodec(text, options) == CODEC_LZW, "English text is compressed with LZW");
+    checkCondition(chooseBlockCodec(binary, options) != CODEC_LZW, "Compressed data is not compressed with LZW");
+    checkCondition(chooseBlockCodec(runs, options) == CODEC_RLE, "Runs of bytes are run-length encoded");
+    checkCondition(estimateCompressedSize(text, CODEC_HUFFMAN) == compressBlock(text, CODEC_HUFFMAN).length(),
+                   "Huffman estimate is exact");
+    
+    AutoCompressionOptions fast;
+    fast.minMegabytesPerSecond = 100;
+    BlockCodec fastCodec = chooseBlockCodec(text, fast);
+    checkCondition(codecThroughput(fastCodec) >= 100, "Throughput budget rules out slow codecs");
+    
+    logInfo("Testing automatic compression of mixed input");
+    string mixed = text + binary + runs;
+    AutoCompressionOptions smallBlocks;
+    smallBlocks.blockSize = 50000;
+    istringstream mixedInput(mixed);
+    ostringstream compressed;
+    autoCompress(mixedInput, compressed, smallBlocks);
+    checkCondition(compressed.str().length() < lzwCompress(mixed).length(),
+                   "Choosing per block beats LZW on the whole input");
+    
+    istringstream toDecompress(compressed.str());
+    ostringstream decompressed;
+    autoDecompress(toDecompress, decompressed);
+    checkCondition(decompressed.str() == mixed, "Automatic round trip gets back the original");
+    
+    Vector<string> files;
+    files += "singleChar", "poem", "allCharsOnce", "dikdik.jpg", "random";
+    foreach (string file in files) {
+        ifbstream input("test/encodeDecode/" + file);
+        assertCondition(input.is_open(), ("Cannot open file test/encodeDecode/" + file + " for reading!"));
+        ostringstream contents;
+        contents << input.rdbuf();
+        istringstream fileInput(contents.str());
+        ostringstream fileCompressed, fileDecompressed;
+        autoCompress(fileInput, fileCompressed);
+        istringstream fileToDecompress(fileCompressed.str());
+        autoDecompress(fileToDecompress, fileDecompressed);
+        checkCondition(fileDecompressed.str() == contents.str(), "Automatic round trip on " + file);
+    }
+    
+    reported = false;
+    try {
+        istringstream damaged(compressed.str().substr(0, compressed.str().length() / 2));
+        ostringstream ignored;
+        autoDecompress(damaged, ignored);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Truncated file is reported");
+}
+
+/* Function: compressAtLevel
+ * --------------------------------------------------------
+ * Compresses the string at the given level and returns the result.
+ */
+string compressAtLevel(const string& input, int level) {
+    CompressionOptions options;
+    options.level = level;
+    istringbstream source(input);
+    ostringbstream compressed;
+    compress(source, compressed, options);
+    return compressed.str();
+}
+
+/* Function: decompressToString
+ * --------------------------------------------------------
+ * Decompresses the string with decompress and returns the result.
+ */
+string decompressToString(const string& compressed) {
+    istringbstream source(compressed);
+    ostringstream decompressed;
+    decompress(source, decompressed);
+    return decompressed.str();
+}
+
+/* Function: testCompressionLevels
+ * --------------------------------------------------------
+ * Tests that every compression level gets back what it was given, that
+ *   decompress still reads files written without options, and that the
+ *   levels trade speed for ratio in the expected direction.
+ */
+void testCompressionLevels() {
+    logInfo("Testing length-limited code lengths");
+    Map<ext_char, int> frequencies;
+    int fibonacci[2] = { 1, 1 };
+    for (int symbol = 0; symbol < 30; symbol++) {
+        frequencies[symbol] = fibonacci[symbol % 2];
+        fibonacci[symbol % 2] = fibonacci[0] + fibonacci[1];
+    }
+    Node* tree = buildEncodingTree(frequencies);
+    Map<ext_char, int> lengths;
+    encTreeToCodeLengths(tree, lengths, 0);
+    freeTree(tree);
+    limitCodeLengths(lengths, frequencies, 12);
+    double kraftSum = 0;
+    int longest = 0;
+    foreach (ext_char symbol in lengths) {
+        kraftSum += pow(2.0, -lengths[symbol]);
+        if (lengths[symbol] > longest) longest = lengths[symbol];
+    }
+    checkCondition(longest == 12, "Skewed frequencies are limited to 12 bits");
+    checkCondition(kraftSum <= 1.0, "Limited lengths still form a prefix code");
+    Node* canonical = buildCanonicalTree(lengths);
+    checkCondition(canonical != NULL, "Limited lengths build a canonical tree");
+    freeTree(canonical);
+
+    ifbstream textInput("test/encodeDecode/tomSawyer");
+    assertCondition(textInput.is_open(), "Cannot open file test/encodeDecode/tomSawyer for reading!");
+    ostringstream textContents;
+    textContents << textInput.rdbuf();
+    string text = textContents.str();
+
+    ifbstream binaryInput("test/encodeDecode/spl.jar");
+    assertCondition(binaryInput.is_open(), "Cannot open file test/encodeDecode/spl.jar for reading!");
+    ostringstream binaryContents;
+    binaryContents << binaryInput.rdbuf();
+    string binary = binaryContents.str().substr(0, 200000);
+
+    string randomBytes;
+    for (int i = 0; i < 100000; i++) {
+        randomBytes += char(randomInteger(0, 255));
+    }
+
+    logInfo("Testing round trips at every level");
+    Vector<string> inputs;
+    inputs += "", "a", string(5000, 'z'), text.substr(0, 50000), binary, randomBytes,
+              text.substr(0, 70000) + binary.substr(0, 70000) + text.substr(70000, 70000);
+    for (int level = COMPRESSION_MIN_LEVEL; level <= COMPRESSION_MAX_LEVEL; level++) {
+        foreach (string input in inputs) {
+            string compressed = compressAtLevel(input, level);
+            checkCondition(decompressToString(compressed) == input,
+                           "Round trip at level " + integerToString(level) + " of " +
+                           integerToString(input.length()) + " bytes");
+        }
+    }
+
+    logInfo("Testing levels against each other");
+    string lowText = compressAtLevel(text, COMPRESSION_MIN_LEVEL);
+    string defaultText = compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    string highText = compressAtLevel(text, COMPRESSION_MAX_LEVEL);
+    checkCondition(highText.length() < defaultText.length(), "Highest level beats the default on text");
+    checkCondition(defaultText.length() <= lowText.length(), "Default level beats the lowest on text");
+    checkCondition(compressAtLevel(randomBytes, COMPRESSION_MIN_LEVEL).length() < randomBytes.length() + 20,
+                   "Random bytes are stored");
+
+    istringbstream legacySource(text.substr(0, 20000));
+    ostringbstream legacyCompressed;
+    compress(legacySource, legacyCompressed);
+    checkCondition(decompressToString(legacyCompressed.str()) == text.substr(0, 20000),
+                   "Files compressed without options still decompress");
+
+    bool reported = false;
+    try {
+        CompressionOptions badLevel;
+        badLevel.level = COMPRESSION_MAX_LEVEL + 1;
+        istringbstream source(text);
+        ostringbstream ignored;
+        compress(source, ignored, badLevel);
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Out-of-range level is reported");
+
+    reported = false;
+    try {
+        decompressToString(defaultText.substr(0, defaultText.length() / 2));
+    } catch (ErrorException&) {
+        reported = true;
+    }
+    checkCondition(reported, "Truncated file is reported");
+}
+
+/* Function: testDeadlineCompression
+ * --------------------------------------------------------
+ * Tests that compression under a time budget works harder when given
+ *   more time, stores everything when given none, and always produces
+ *   output decompress can read.
+ */
+void testDeadlineCompression() {
+    ifbstream textInput("test/encodeDecode/tomSawyer");
+    assertCondition(textInput.is_open(), "Cannot open file test/encodeDecode/tomSawyer for reading!");
+    ostringstream textContents;
+    textContents << textInput.rdbuf();
+    string text = textContents.str();
+
+    logInfo("Testing a generous budget");
+    istringbstream relaxedSource(text);
+    ostringbstream relaxedOutput;
+    DeadlineStats relaxed;
+    compressWithDeadline(relaxedSource, relaxedOutput, 60, &relaxed);
+    checkCondition(decompressToString(relaxedOutput.str()) == text, "Round trip with a generous budget");
+    checkCondition(relaxed.level >= 7, "A generous budget reaches the LZW levels");
+    checkCondition(relaxed.metDeadline, "A generous budget is met");
+    checkCondition(relaxed.bytesIn == text.length(), "Stats count the bytes read");
+    checkCondition(relaxed.bytesOut == relaxedOutput.str().length(), "Stats count the bytes written");
+    checkCondition(relaxed.bytesAtLevel[0] == 0, "Nothing is stored for lack of time");
+
+    logInfo("Testing an impossible budget");
+    istringbstream rushedSource(text);
+    ostringbstream rushedOutput;
+    DeadlineStats rushed;
+    compressWithDeadline(rushedSource, rushedOutput, 0, &rushed);
+    checkCondition(decompressToString(rushedOutput.str()) == text, "Round trip with no time at all");
+    checkCondition(rushed.level == 0 && rushed.bytesAtLevel[0] == text.length(),
+                   "With no time at all everything is stored");
+
+    istringbstream emptySource("");
+    ostringbstream emptyOutput;
+    compressWithDeadline(emptySource, emptyOutput, 1);
+    checkCondition(decompressToString(emptyOutput.str()) == "", "Round trip of empty input");
+}
+
+/* Function: testBenchmark
+ * --------------------------------------------------------
+ * Runs a short benchmark and checks the shape of its reports.
+ */
+void testBenchmark() {
+    logInfo("Testing a short benchmark run");
+    BenchmarkOptions options;
+    options.corpusDirectory = "";
+    options.generatedSize = 20000;
+    options.repetitions = 3;
+    Vector<BenchmarkResult> results = runBenchmarks(options);
+    checkCondition(results.size() == NUM_CORPUS_DISTRIBUTIONS * benchmarkStageNames().size(),
+                   "Every stage is run on every generated input");
+    foreach (BenchmarkResult result in results) {
+        checkCondition(result.inputBytes == 20000 && result.repetitions == 3,
+                       "Result for " + result.stage + " describes its run");
+        checkCondition(result.minSeconds <= result.medianSeconds &&
+                       result.medianSeconds <= result.p90Seconds &&
+                       result.p90Seconds <= result.p99Seconds &&
+                       result.p99Seconds <= result.maxSeconds,
+                       "Percentiles for " + result.stage + " are in order");
+    }
+
+    options.stageFilter = "lzw";
+    Vector<BenchmarkResult> lzwResults = benchmarkInput("text", string(30000, 'a'), options);
+    checkCondition(lzwResults.size() == 2, "The stage filter selects the LZW stages");
+
+    ostringstream json, csv;
+    writeBenchmarkJSON(json, lzwResults);
+    writeBenchmarkCSV(csv, lzwResults);
+    checkCondition(json.str().find("\"stage\": \"lzw-compress\"") != string::npos, "JSON names the stage");
+    checkCondition(json.str().find("\"mbPerSecond\"") != string::npos, "JSON reports throughput");
+    int lines = 0;
+    string csvText = csv.str();
+    for (int i = 0; i < csvText.length(); i++) {
+        if (csvText[i] == '\n') lines++;
+    }
+    checkCondition(lines == 3, "CSV has a header and a row per result");
+
+    logInfo("Testing performance counters");
+    checkCondition(lzwResults[0].countersPerByte[PERF_CYCLES] == -1, "Counters are off by default");
+    checkCondition(json.str().find("\"cyclesPerByte\": null") != string::npos,
+                   "JSON reports uncounted counters as null");
+    PerfCounters counters;
+    options.perfCounters = true;
+    Vector<BenchmarkResult> countedResults = benchmarkInput("text", string(30000, 'a'), options);
+    if (counters.isAvailable(PERF_INSTRUCTIONS)) {
+        checkCondition(countedResults[0].countersPerByte[PERF_INSTRUCTIONS] > 0,
+                       "Instructions are counted per byte");
+    } else {
+        logInfo("Counters unavailable: " + counters.unavailableReason());
+        checkCondition(!counters.unavailableReason().empty(), "Unavailable counters give a reason");
+        checkCondition(countedResults[0].countersPerByte[PERF_INSTRUCTIONS] == -1,
+                       "Unavailable counters are reported as -1");
+    }
+
+    logInfo("Testing allocation counts");
+    checkCondition(lzwResults[0].allocationsPerPass == -1 &&
+                   json.str().find("\"allocationsPerPass\": null") != string::npos,
+                   "Allocations are not counted by default");
+    options.perfCounters = false;
+    options.countAllocations = true;
+    Vector<BenchmarkResult> allocationResults = benchmarkInput("text", string(30000, 'a'), options);
+    if (allocationHookInstalled()) {
+        checkCondition(allocationResults[0].allocationsPerPass > 0 &&
+                       allocationResults[0].allocatedBytesPerPass > 0 &&
+                       allocationResults[0].peakLiveBytes > 0,
+                       "Allocations are counted per pass");
+    }
+    checkCondition(!isTrackingAllocations(), "Tracking stops after the benchmark");
+}
+
+/* Function: testCorpusGenerator
+ * --------------------------------------------------------
+ * Tests that generated corpora are reproducible, have the character of
+ *   their distribution, and can be streamed into the compressor.
+ */
+void testCorpusGenerator() {
+    logInfo("Testing reproducibility");
+    CorpusSpec spec;
+    spec.size = 100000;
+    string zipf = generateCorpus(spec);
+    checkCondition(zipf.length() == 100000, "Corpus has the requested size");
+    checkCondition(generateCorpus(spec) == zipf, "Same spec gives the same corpus");
+    CorpusSpec otherSeed = spec;
+    otherSeed.seed = 2;
+    checkCondition(generateCorpus(otherSeed) != zipf, "Different seed gives a different corpus");
+
+    logInfo("Testing distributions");
+    Map<CorpusDistribution, string> corpora;
+    for (int distribution = 0; distribution < NUM_CORPUS_DISTRIBUTIONS; distribution++) {
+        CorpusSpec distributionSpec = spec;
+        distributionSpec.distribution = CorpusDistribution(distribution);
+        corpora[CorpusDistribution(distribution)] = generateCorpus(distributionSpec);
+    }
+    istringstream uniformSource(corpora[CORPUS_UNIFORM]);
+    checkCondition(getFrequencyTable(uniformSource).size() == 257, "Uniform corpus uses every byte");
+    int letters = 0;
+    for (int i = 0; i < zipf.length(); i++) {
+        if (isalpha(zipf[i]) || zipf[i] == ' ') letters++;
+    }
+    checkCondition(letters > zipf.length() * 9 / 10, "Zipf corpus is mostly words and spaces");
+    istringstream fibonacciSource(corpora[CORPUS_FIBONACCI]);
+    Map<ext_char, int> fibonacciFrequencies = getFrequencyTable(fibonacciSource);
+    Node* fibonacciTree = buildEncodingTree(fibonacciFrequencies);
+    Map<ext_char, int> fibonacciLengths;
+    encTreeToCodeLengths(fibonacciTree, fibonacciLengths, 0);
+    freeTree(fibonacciTree);
+    int deepest = 0;
+    foreach (ext_char symbol in fibonacciLengths) {
+        deepest = max(deepest, fibonacciLengths[symbol]);
+    }
+    checkCondition(deepest > 12, "Fibonacci corpus makes a deep tree");
+    checkCondition(rleCompressedSize(corpora[CORPUS_RUNS]) < 10000, "Runs corpus is mostly runs");
+    checkCondition(corpora[CORPUS_MIXED] != zipf, "Mixed corpus differs from its parts");
+
+    logInfo("Testing streaming");
+    CorpusSpec mixedSpec = spec;
+    mixedSpec.distribution = CORPUS_MIXED;
+    mixedSpec.size = 300000;
+    CorpusStream stream(mixedSpec);
+    checkCondition(stream.size() == 300000, "Stream reports the corpus size");
+    ostringstream streamed;
+    streamed << stream.rdbuf();
+    checkCondition(streamed.str() == generateCorpus(mixedSpec), "Stream produces the corpus");
+    stream.rewind();
+    stream.seekg(123456);
+    checkCondition(stream.get() == (unsigned char) streamed.str()[123456], "Seeking regenerates the corpus");
+
+    CorpusStream toCompress(mixedSpec);
+    ostringbstream compressed;
+    compress(toCompress, compressed);
+    checkCondition(decompressToString(compressed.str()) == streamed.str(),
+                   "compress reads a stream twice and round trips");
+
+    BenchmarkOptions options;
+    options.repetitions = 2;
+    options.stageFilter = "level";
+    Vector<BenchmarkResult> results = benchmarkCorpus(mixedSpec, options);
+    checkCondition(results.size() == 3, "Streamed benchmark runs the level stages");
+}
+
+/* Function: testCompressionStats
+ * --------------------------------------------------------
+ * Tests that compress and decompress report consistent statistics, with
+ *   and without options, and that the global registry adds them up only
+ *   while it is on.
+ */
+void testCompressionStats() {
+    CorpusSpec spec;
+    spec.size = 200000;
+    string text = generateCorpus(spec);
+
+    logInfo("Testing statistics of compress");
+    istringbstream source(text);
+    ostringbstream compressed;
+    CompressionStats stats;
+    compress(source, compressed, &stats);
+    checkCondition(stats.operations == 1, "Stats cover one call");
+    checkCondition(stats.uncompressedBytes == text.length(), "Stats count the bytes read");
+    checkCondition(stats.compressedBytes == compressed.str().length(), "Stats count the bytes written");
+    checkCondition(stats.headerBytes > 0 && stats.headerBytes < 2000, "Stats count the header");
+    istringstream frequencySource(text);
+    checkCondition(stats.distinctSymbols() == getFrequencyTable(frequencySource).size() - 1,
+                   "Stats count the distinct bytes");
+    checkCondition(stats.minCodeLength > 0 && stats.minCodeLength <= stats.averageCodeLength() &&
+                   stats.averageCodeLength() <= stats.maxCodeLength,
+                   "Average code length is between the shortest and longest");
+    checkCondition(stats.entropyBitsPerSymbol() <= stats.averageCodeLength() &&
+                   stats.averageCodeLength() < stats.entropyBitsPerSymbol() + 1,
+                   "Huffman codes come within a bit of the entropy");
+    checkCondition(stats.achievedBitsPerSymbol() > stats.averageCodeLength(),
+                   "Achieved bits per symbol include the header");
+
+    istringbstream compressedSource(compressed.str());
+    ostringstream decompressed;
+    CompressionStats decompressStats;
+    decompress(compressedSource, decompressed, &decompressStats);
+    checkCondition(decompressed.str() == text, "Round trip with stats");
+    checkCondition(decompressStats.uncompressedBytes == stats.uncompressedBytes &&
+                   decompressStats.compressedBytes == stats.compressedBytes &&
+                   decompressStats.headerBytes == stats.headerBytes &&
+                   decompressStats.codedBits == stats.codedBits,
+                   "Decompress sees what compress did");
+
+    logInfo("Testing statistics of compress with options");
+    for (int level = COMPRESSION_MIN_LEVEL; level <= COMPRESSION_MAX_LEVEL; level += 4) {
+        CompressionOptions options;
+        options.level = level;
+        istringbstream levelSource(text);
+        ostringbstream levelCompressed;
+        CompressionStats levelStats;
+        compress(levelSource, levelCompressed, options, &levelStats);
+        string name = "Level " + integerToString(level);
+        checkCondition(levelStats.uncompressedBytes == text.length() &&
+                       levelStats.compressedBytes == levelCompressed.str().length(),
+                       name + " stats count the bytes");
+        checkCondition(levelStats.symbolCounts['e'] == stats.symbolCounts['e'],
+                       name + " stats count every byte, sampled or not");
+        checkCondition(levelStats.maxCodeLength <= LEVEL_MAX_CODE_LENGTH,
+                       name + " codes are within the length limit");
+
+        istringbstream levelCompressedSource(levelCompressed.str());
+        ostringstream levelDecompressed;
+        CompressionStats levelDecompressStats;
+        decompress(levelCompressedSource, levelDecompressed, &levelDecompressStats);
+        checkCondition(levelDecompressStats.compressedBytes == levelStats.compressedBytes &&
+                       levelDecompressStats.headerBytes == levelStats.headerBytes &&
+                       levelDecompressStats.codedBits == levelStats.codedBits,
+                       name + " decompress sees what compress did");
+    }
+
+    logInfo("Testing the global registry");
+    resetCompressionStats();
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    checkCondition(globalCompressionStats(STATS_COMPRESSION).operations == 0,
+                   "Nothing is recorded while the registry is off");
+    setCompressionStatsEnabled(true);
+    string first = compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    string second = compressAtLevel(text.substr(0, 1000), COMPRESSION_DEFAULT_LEVEL);
+    decompressToString(first);
+    setCompressionStatsEnabled(false);
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    CompressionStats totals = globalCompressionStats(STATS_COMPRESSION);
+    checkCondition(totals.operations == 2, "Registry counts the calls");
+    checkCondition(totals.uncompressedBytes == text.length() + 1000 &&
+                   totals.compressedBytes == first.length() + second.length(),
+                   "Registry adds up the bytes");
+    checkCondition(globalCompressionStats(STATS_DECOMPRESSION).operations == 1,
+                   "Registry keeps decompression apart");
+    resetCompressionStats();
+    checkCondition(globalCompressionStats(STATS_COMPRESSION).operations == 0, "Registry resets");
+}
+
+/* Function: countOccurrences
+ * --------------------------------------------------------
+ * Returns how many times pattern occurs in text.
+ */
+int countOccurrences(const string& text, const string& pattern) {
+    int count = 0;
+    for (size_t at = text.find(pattern); at != string::npos; at = text.find(pattern, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+/* Function: testTracing
+ * --------------------------------------------------------
+ * Tests that a traced compression records its stages and threads, that
+ *   nothing is recorded once tracing stops, and that a full ring buffer
+ *   keeps only the newest events.
+ */
+void testTracing() {
+    CorpusSpec spec;
+    spec.size = 300000;
+    string text = generateCorpus(spec);
+
+    logInfo("Testing a traced compression");
+    startTracing();
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    istringstream lzwSource(text);
+    ostringstream lzwCompressed;
+    lzwCompressBlocks(lzwSource, lzwCompressed, LZWOptions(), 65536, 2);
+    stopTracing();
+    checkCondition(!isTracing(), "Tracing stops");
+
+    ostringstream trace;
+    writeTraceJSON(trace);
+    string json = trace.str();
+    checkCondition(json.find("{\"traceEvents\": [") == 0, "Trace is a trace-event object");
+    const char* stages[] = { "read", "histogram", "tree", "table", "encode", "flush",
+                             "lzw-compress", "wait", "write", "idle" };
+    for (int i = 0; i < 10; i++) {
+        checkCondition(json.find("\"name\": \"" + string(stages[i]) + "\"") != string::npos,
+                       "Trace records the " + string(stages[i]) + " stage");
+    }
+    checkCondition(countOccurrences(json, "\"name\": \"pool worker\"") == 2,
+                   "Trace names both pool threads");
+    checkCondition(droppedTraceEvents() == 0, "Nothing is dropped from a large buffer");
+
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    ostringstream after;
+    writeTraceJSON(after);
+    checkCondition(after.str() == json, "Nothing is recorded after tracing stops");
+
+    logInfo("Testing a full ring buffer");
+    startTracing(4);
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    stopTracing();
+    ostringstream small;
+    writeTraceJSON(small);
+    checkCondition(countOccurrences(small.str(), "\"ph\": \"X\"") == 4,
+                   "A full buffer keeps only as many events as it holds");
+    checkCondition(droppedTraceEvents() > 0, "Overwritten events are counted");
+}
+
+/* Function: allocateNodes
+ * --------------------------------------------------------
+ * Allocates and frees count Nodes, for running on several threads.
+ */
+void allocateNodes(int& count) {
+    for (int i = 0; i < count; i++) {
+        delete new Node;
+    }
+}
+
+/* Function: allocateEncodeBlocks
+ * --------------------------------------------------------
+ * Allocates and frees count 16-byte blocks in the encode stage, for
+ *   running on several threads.  The blocks are kept in a volatile
+ *   variable so the compiler cannot leave out the allocations.
+ */
+void allocateEncodeBlocks(int& count) {
+    setAllocationStage(STATS_ENCODE);
+    for (int i = 0; i < count; i++) {
+        char* volatile block = new char[16];
+        delete[] block;
+    }
+    setAllocationStage(OTHER_ALLOCATION_STAGE);
+}
+
+/* Function: testAllocationDiagnostics
+ * --------------------------------------------------------
+ * Tests that Node counts stay exact under threads, and that tracked
+ *   allocations are charged to the right stage.
+ */
+void testAllocationDiagnostics() {
+    const int NUM_THREADS = 4;
+    int count = 20000;
+
+    logInfo("Testing Node counts on several threads");
+    long allocations = numAllocations();
+    long deallocations = numDeallocations();
+    Vector<Thread> threads;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        threads.add(fork(allocateNodes, count));
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        join(threads[i]);
+    }
+    checkCondition(numAllocations() - allocations == NUM_THREADS * count,
+                   "Every Node allocation is counted");
+    checkCondition(numDeallocations() - deallocations == NUM_THREADS * count,
+                   "Every Node deallocation is counted");
+
+    if (!allocationHookInstalled()) {
+        logInfo("The allocation hook is not compiled in; skipping the rest");
+        return;
+    }
+
+    logInfo("Testing a single tracked block");
+    char* volatile early = new char[500];
+    startAllocationTracking();
+    checkCondition(isTrackingAllocations(), "Tracking starts");
+    setAllocationStage(STATS_TREE);
+    delete[] early;
+    setAllocationStage(STATS_ENCODE);
+    char* volatile block = new char[1000];
+    setAllocationStage(OTHER_ALLOCATION_STAGE);
+    AllocationStats live = allocationStats(STATS_ENCODE);
+    setAllocationStage(STATS_ENCODE);
+    delete[] block;
+    setAllocationStage(OTHER_ALLOCATION_STAGE);
+    AllocationStats freed = allocationStats(STATS_ENCODE);
+    checkCondition(live.allocations == 1 && live.bytes == 1000 && live.liveBytes == 1000,
+                   "The block is charged to its stage");
+    checkCondition(freed.deallocations == 1 && freed.liveBytes == 0 && freed.peakLiveBytes == 1000,
+                   "Freeing the block takes it off the live bytes but not the peak");
+    checkCondition(allocationStats(STATS_TREE).deallocations == 0,
+                   "Blocks from before tracking started are not counted");
+
+    logInfo("Testing tracked blocks on several threads");
+    count = 5000;
+    startAllocationTracking();
+    threads.clear();
+    for (int i = 0; i < NUM_THREADS; i++) {
+        threads.add(fork(allocateEncodeBlocks, count));
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        join(threads[i]);
+    }
+    AllocationStats encode = allocationStats(STATS_ENCODE);
+    checkCondition(encode.allocations == NUM_THREADS * count &&
+                   encode.deallocations == NUM_THREADS * count,
+                   "Every allocation on every thread is counted");
+    checkCondition(encode.bytes == 16LL * NUM_THREADS * count && encode.liveBytes == 0,
+                   "Bytes add up across threads");
+
+    logInfo("Testing the stages of a compression");
+    CorpusSpec spec;
+    spec.size = 200000;
+    string text = generateCorpus(spec);
+    startAllocationTracking();
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    stopAllocationTracking();
+    checkCondition(!isTrackingAllocations(), "Tracking stops");
+    AllocationStats total = totalAllocationStats();
+    long long stageAllocations = 0, stageBytes = 0;
+    int stagesUsed = 0;
+    for (int stage = 0; stage < NUM_ALLOCATION_STAGES; stage++) {
+        AllocationStats stats = allocationStats(stage);
+        stageAllocations += stats.allocations;
+        stageBytes += stats.bytes;
+        if (stats.allocations > 0) stagesUsed++;
+        checkCondition(stats.peakLiveBytes <= total.peakLiveBytes,
+                       string("No stage peaks above the total in ") + allocationStageName(stage));
+    }
+    checkCondition(total.allocations > 0 && stageAllocations == total.allocations &&
+                   stageBytes == total.bytes, "The stages add up to the total");
+    checkCondition(stagesUsed > 1, "Allocations are spread over the stages");
+    // Maps never free their comparator (see map.h), so a few bytes are
+    //   always left live
+    checkCondition(total.liveBytes >= 0 && total.liveBytes < total.peakLiveBytes,
+                   "Compression frees most of what it allocates");
+
+    compressAtLevel(text, COMPRESSION_DEFAULT_LEVEL);
+    checkCondition(totalAllocationStats().allocations == total.allocations,
+                   "Nothing is counted after tracking stops");
+}
+
+/* Function: runTool
+ * --------------------------------------------------------
+ * Runs huff with the arguments, separated by spaces, on the given
+ *   standard input, and returns its exit status along with what it
+ *   wrote to standard output and to its messages.
+ */
+int runTool(const string& line, const string& input, string& output, string& messages) {
+    Vector<string> args;
+    istringstream words(line);
+    string word;
+    while (words >> word) {
+        args.add(word);
+    }
+    istringstream inputStream(input);
+    ostringstream outputStream, messageStream;
+    int status = runCommandLine(args, inputStream, outputStream, messageStream);
+    output = outputStream.str();
+    messages = messageStream.str();
+    return status;
+}
+
+/* Function: readFileToString
+ * --------------------------------------------------------
+ * Returns the contents of a file, or "" if it cannot be read.
+ */
+string readFileToString(const string& filename) {
+    ifstream file(filename.c_str(), ios::binary);
+    ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+/* Function: testCommandLine
+ * --------------------------------------------------------
+ * Tests the huff tool's options, exit statuses, pipes and files, and
+ *   compressing on several threads.
+ */
+void testCommandLine() {
+    CorpusSpec spec;
+    spec.size = 100000;
+    string text = generateCorpus(spec);
+    string output, messages;
+
+    logInfo("Testing compressing on several threads");
+    CompressionOptions options;
+    options.numThreads = 3;
+    options.blockSize = 1000;
+    istringstream threadSource(text);
+    ostringstream threadCompressed;
+    compress(threadSource, threadCompressed, options);
+    checkCondition(decompressToString(threadCompressed.str()) == text,
+                   "Blocks compressed on several threads come back in order");
+    options.blockSize = -1;
+    bool rejected = false;
+    try {
+        istringstream source(text);
+        ostringstream sink;
+        compress(source, sink, options);
+    } catch (ErrorException&) {
+        rejected = true;
+    }
+    checkCondition(rejected, "A negative block size is rejected");
+
+    logInfo("Testing the command line");
+    checkCondition(runTool("", "", output, messages) == EXIT_USAGE, "No command is a usage error");
+    checkCondition(runTool("z", "", output, messages) == EXIT_USAGE, "An unknown command is a usage error");
+    checkCondition(runTool("c -l 10", "", output, messages) == EXIT_USAGE, "A bad level is a usage error");
+    checkCondition(runTool("c -q", "", output, messages) == EXIT_USAGE, "An unknown option is a usage error");
+    checkCondition(runTool("c a b c", "", output, messages) == EXIT_USAGE,
+                   "Three files without -m is a usage error");
+    checkCondition(runTool("-h", "", output, messages) == EXIT_OK &&
+                   output.find("usage: huff") == 0, "-h prints the usage");
+
+    logInfo("Testing standard input and output");
+    checkCondition(runTool("c -l9 -T 2 -b 16K --stats", text, output, messages) == EXIT_OK,
+                   "Compressing a pipe succeeds");
+    checkCondition(messages.find("(stdin): 100000 -> ") == 0 && messages.find("MB/s") != string::npos,
+                   "--stats reports sizes and speed");
+    string compressed = output;
+    checkCondition(runTool("d", compressed, output, messages) == EXIT_OK && output == text,
+                   "Decompressing a pipe gives back the original");
+    checkCondition(runTool("t -", compressed, output, messages) == EXIT_OK && output.empty(),
+                   "Testing a pipe succeeds and writes nothing");
+    checkCondition(runTool("t", text, output, messages) == EXIT_FAILED &&
+                   messages.find("Not a compressed file") != string::npos,
+                   "Testing data that was never compressed fails");
+    checkCondition(runTool("bench -l 1", text, output, messages) == EXIT_OK &&
+                   output.find("(stdin): 100000 bytes") == 0, "bench reports on each input");
+
+    logInfo("Testing files");
+    string name = "huffToolTest.txt";
+    {
+        ofstream file(name.c_str(), ios::binary);
+        file << text;
+    }
+    checkCondition(runTool("c -m " + name, "", output, messages) == EXIT_OK,
+                   "Compressing a file succeeds");
+    string compressedName = name + COMPRESSED_SUFFIX;
+    checkCondition(decompressToString(readFileToString(compressedName)) == text,
+                   "The output is named after the input");
+    checkCondition(runTool("d " + compressedName + " huffToolTest.out", "", output, messages) == EXIT_OK &&
+                   readFileToString("huffToolTest.out") == text, "Decompressing to a named file succeeds");
+    checkCondition(runTool("t " + compressedName + " " + name + " huffToolMissing", "", output, messages)
+                   == EXIT_FAILED, "A failing file makes the whole run fail");
+    checkCondition(messages.find(name + ": Not a compressed file") != string::npos &&
+                   messages.find("huffToolMissing: Cannot open") != string::npos,
+                   "Each failing file is reported");
+    checkCondition(runTool("d -m " + name, "", output, messages) == EXIT_FAILED,
+                   "Decompressing a file without the suffix fails");
+    checkCondition(runTool("c " + name + " ./" + name, "", output, messages) == EXIT_FAILED &&
+                   messages.find("overwrite the input") != string::npos &&
+                   readFileToString(name) == text, "Compressing a file onto itself is refused");
+    remove(name.c_str());
+    remove(compressedName.c_str());
+    remove("huffToolTest.out");
+}
+
+/* Function: produceRingValues
+ * --------------------------------------------------------
+ * Pushes the numbers 1 to RING_TEST_VALUES into a ring, then 0, for
+ *   running on its own thread.
+ */
+const int RING_TEST_VALUES = 100000;
+void produceRingValues(SPSCRing<int>& ring) {
+    for (int i = 1; i <= RING_TEST_VALUES; i++) {
+        ring.push(i);
+    }
+    ring.push(0);
+}
+
+/* Function: testPipeline
+ * --------------------------------------------------------
+ * Tests the rings joining the stages of the compression pipeline, and
+ * the pipeline itself.
+ */
+void testPipeline() {
+    logInfo("Testing a ring between two threads");
+    SPSCRing<int> ring(4);
+    checkCondition(ring.capacity() == 4, "The ring holds what it was asked to");
+    Thread producer = fork(produceRingValues, ring);
+    bool inOrder = true;
+    int expected = 1;
+    for (int value = ring.pop(); value != 0; value = ring.pop()) {
+        if (value != expected++) inOrder = false;
+    }
+    join(producer);
+    checkCondition(inOrder && expected == RING_TEST_VALUES + 1, "Every value arrives, in order");
+    int ignored;
+    checkCondition(!ring.tryPop(ignored), "The ring is empty afterwards");
+    for (int i = 0; i < 4; i++) {
+        ring.tryPush(i);
+    }
+    checkCondition(!ring.tryPush(4), "A full ring refuses more");
+
+    logInfo("Testing the compression pipeline");
+    CorpusSpec spec;
+    spec.size = 200000;
+    string text = generateCorpus(spec);
+    CompressionOptions options;
+    options.level = 7;
+    options.blockSize = 5000;
+    string previous;
+    bool sameOutput = true, roundTrips = true;
+    for (int numThreads = 2; numThreads <= 4; numThreads++) {
+        options.numThreads = numThreads;
+        options.maxBufferedBytes = (numThreads == 4) ? 1 : 0;
+        istringstream source(text);
+        ostringstream sink;
+        CompressionStats stats;
+        compress(source, sink, options, &stats);
+        if (decompressToString(sink.str()) != text) roundTrips = false;
+        if (!previous.empty() && sink.str() != previous) sameOutput = false;
+        previous = sink.str();
+        checkCondition(stats.uncompressedBytes == (long long) text.length() &&
+                       stats.compressedBytes == (long long) sink.str().length(),
+                       "Statistics cover every block on " + integerToString(numThreads) + " threads");
+    }
+    checkCondition(roundTrips, "Pipelined output decompresses");
+    checkCondition(sameOutput, "Output does not depend on the number of workers");
+
+    istringstream empty("");
+    ostringstream emptyCompressed;
+    compress(empty, emptyCompressed, options);
+    checkCondition(decompressToString(emptyCompressed.str()).empty(), "Empty input goes through the pipeline");
+}
+
+/* Class: CountingTask
+ * --------------------------------------------------------
+ * Counts how many times it runs, first submitting the given number of
+ * copies of itself, each with one fewer to submit, to test tasks that
+ * submit tasks.
+ */
+class CountingTask : public ThreadPoolTask {
+public:
+    ThreadPool* pool;
+    int toSubmit;
+    Vector<CountingTask*>* spawned;
+    static volatile long numRuns;
+
+    void run() {
+        __sync_fetch_and_add(&numRuns, 1);
+        for (int i = 0; i < toSubmit; i++) {
+            CountingTask* child = new CountingTask;
+            child->pool = pool;
+            child->toSubmit = toSubmit - 1;
+            child->spawned = spawned;
+            static Lock spawnedLock;
+            synchronized (spawnedLock) {
+                spawned->add(child);
+            }
+            pool->submit(child);
+        }
+    }
+};
+volatile long CountingTask::numRuns = 0;
+
+/* Class: ThrowingTask
+ * --------------------------------------------------------
+ * Throws something other than an ErrorException, to test that the pool
+ * catches every exception a task throws.
+ */
+class ThrowingTask : public ThreadPoolTask {
+public:
+    bool standard;
+
+    void run() {
+        if (standard) throw std::runtime_error("out of something");
+        throw 42;
+    }
+};
+
+/* Function: testBatchCompression
+ * --------------------------------------------------------
+ * Tests the work-stealing pool and compressing many files at once with
+ * compressFiles.
+ */
+void testBatchCompression() {
+    logInfo("Testing tasks that submit tasks");
+    Vector<CountingTask*> spawned;
+    {
+        ThreadPool pool(3);
+        CountingTask root;
+        root.pool = &pool;
+        root.toSubmit = 4;
+        root.spawned = &spawned;
+        CountingTask::numRuns = 0;
+        pool.submit(&root);
+        pool.waitForAll();
+        // 1 + 4 + 4 * 3 + 4 * 3 * 2 + 4 * 3 * 2 * 1 tasks in all
+        checkCondition(CountingTask::numRuns == 65, "Every task submitted by a task runs");
+        checkCondition(pool.numSteals() >= 0, "Steals are counted");
+    }
+    foreach (CountingTask* task in spawned) {
+        delete task;
+    }
+
+    logInfo("Testing tasks that throw");
+    for (int i = 0; i < 2; i++) {
+        ThreadPool pool(2);
+        ThrowingTask throwing;
+        throwing.standard = (i == 0);
+        CountingTask counting;
+        counting.pool = &pool;
+        counting.toSubmit = 0;
+        CountingTask::numRuns = 0;
+        pool.submit(&throwing);
+        pool.submit(&counting);
+        string message;
+        try {
+            pool.waitForAll();
+        } catch (ErrorException& ex) {
+            message = ex.getMessage();
+        }
+        checkCondition(CountingTask::numRuns == 1 &&
+                       message == (i == 0 ? "out of something" : "Task failed with an unknown exception."),
+                       "A task that throws something other than an error fails on its own");
+    }
+
+    logInfo("Testing compressing many files at once");
+    CorpusSpec spec;
+    spec.size = 60000;
+    Vector<string> contents;
+    contents.add(generateCorpus(spec));
+    contents.add("");
+    for (int i = 0; i < 20; i++) {
+        spec.size = 50 + 100 * i;
+        spec.seed = i + 1;
+        contents.add(generateCorpus(spec));
+    }
+    Vector<FileCompressionJob> jobs(contents.size() + 1);
+    for (int i = 0; i < contents.size(); i++) {
+        jobs[i].inputName = "huffBatchTest" + integerToString(i);
+        jobs[i].outputName = jobs[i].inputName + COMPRESSED_SUFFIX;
+        ofstream file(jobs[i].inputName.c_str(), ios::binary);
+        file << contents[i];
+    }
+    jobs[contents.size()].inputName = "huffBatchMissing";
+    jobs[contents.size()].outputName = "huffBatchMissing" + string(COMPRESSED_SUFFIX);
+
+    CompressionOptions options;
+    options.level = 4;
+    options.numThreads = 3;
+    options.blockSize = 4096;
+    options.maxBufferedBytes = 10000;
+    checkCondition(compressFiles(jobs, options) == 1, "Only the missing file fails");
+    checkCondition(!jobs[contents.size()].succeeded &&
+                   jobs[contents.size()].errorMessage.find("Cannot open") == 0,
+                   "The missing file's error is recorded");
+    checkCondition(readFileToString(jobs[contents.size()].outputName).empty(),
+                   "The missing file has no output");
+
+    bool allMatch = true, allSucceeded = true, statsMatch = true;
+    for (int i = 0; i < contents.size(); i++) {
+        string compressed = readFileToString(jobs[i].outputName);
+        istringstream source(contents[i]);
+        ostringstream alone;
+        compress(source, alone, options);
+        if (!jobs[i].succeeded) allSucceeded = false;
+        if (compressed != alone.str() || decompressToString(compressed) != contents[i]) allMatch = false;
+        if (jobs[i].stats.uncompressedBytes != (long long) contents[i].length() ||
+            jobs[i].stats.compressedBytes != (long long) compressed.length()) {
+            statsMatch = false;
+        }
+        remove(jobs[i].inputName.c_str());
+        remove(jobs[i].outputName.c_str());
+    }
+    checkCondition(allSucceeded, "Every other file succeeds");
+    checkCondition(allMatch, "Each output is what compress writes on several threads");
+    checkCondition(statsMatch, "Each file's statistics match its sizes");
+
+    logInfo("Testing compressing many files from the command line");
+    string output, messages;
+    {
+        ofstream first("huffBatchTestA", ios::binary), second("huffBatchTestB", ios::binary);
+        first << contents[0];
+        second << contents[2];
+    }
+    checkCondition(runTool("c -m -T 2 -b 4K --stats huffBatchTestA huffBatchTestB", "", output, messages)
+                   == EXIT_OK, "Several files compress together");
+    checkCondition(messages.find("huffBatchTestA: 60000 -> ") == 0 &&
+                   messages.find("huffBatchTestB: ") != string::npos, "Each file is reported in order");
+    checkCondition(decompressToString(readFileToString("huffBatchTestA.huf")) == contents[0] &&
+                   decompressToString(readFileToString("huffBatchTestB.huf")) == contents[2],
+                   "Each file comes back");
+    remove("huffBatchTestA");
+    remove("huffBatchTestB");
+    remove("huffBatchTestA.huf");
+    remove("huffBatchTestB.huf");
+}
+
+/* Function: copyThroughAsyncIO
+ * --------------------------------------------------------
+ * Writes text to a file and reads it back through a backend, a buffer
+ *   at a time with every request in flight at once, returning what was
+ *   read, or "" if any request fell short.
+ */
+string copyThroughAsyncIO(AsyncFileIO* io, Lock& lock, const string& text, const string& name) {
+    int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) return "";
+    bool complete = true;
+    string copy(text.length(), '\0');
+    for (int pass = 0; pass < 2; pass++) {
+        for (long offset = 0; offset < (long) text.length(); offset += io->bufferSize()) {
+            IORequest* request = new IORequest;
+            request->fd = fd;
+            request->write = (pass == 0);
+            request->offset = offset;
+            request->buffer = io->takeBuffer();
+            request->length = min(io->bufferSize(), (long) text.length() - offset);
+            request->userData = NULL;
+            if (request->write) memcpy(io->buffer(request->buffer), text.data() + offset, request->length);
+            io->submit(request);
+        }
+        while (io->numInFlight() > 0) {
+            synchronized (lock) {
+                while (!io->hasCompleted()) {
+                    lock.wait();
+                }
+            }
+            IORequest* request = io->takeCompleted();
+            if (request->result != request->length) complete = false;
+            if (!request->write) memcpy(&copy[request->offset], io->buffer(request->buffer), request->length);
+            io->releaseBuffer(request->buffer);
+            delete request;
+        }
+    }
+    close(fd);
+    remove(name.c_str());
+    return complete ? copy : "";
+}
+
+/* Function: testAsyncIO
+ * --------------------------------------------------------
+ * Tests both I/O backends, which compressFiles reads and writes
+ * through.
+ */
+void testAsyncIO() {
+    logInfo("Testing asynchronous file I/O");
+    CorpusSpec spec;
+    spec.size = 100000;
+    string text = generateCorpus(spec);
+    Lock lock;
+
+    AsyncFileIO* threaded = newThreadedFileIO(lock, 8, 16384, 3);
+    checkCondition(string(threaded->name()) == "threads", "The threaded backend names itself");
+    checkCondition(copyThroughAsyncIO(threaded, lock, text, "huffAsyncTest") == text,
+                   "A file round-trips through the threaded backend");
+    checkCondition(threaded->takeBuffer() >= 0, "Buffers are released");
+    delete threaded;
+
+    AsyncFileIO* best = newAsyncFileIO(lock, 8, 16384);
+    string name = best->name();
+    logInfo("Using the " + name + " backend");
+    checkCondition(name == "threads" || name == "io_uring", "The best backend is a known one");
+    checkCondition(copyThroughAsyncIO(best, lock, text, "huffAsyncTest") == text,
+                   "A file round-trips through the best backend");
+    delete best;
+}
+
+/* Function: writeStringToFile
+ * --------------------------------------------------------
+ * Replaces the contents of the named file with text.
+ */
+void writeStringToFile(const string& name, const string& text) {
+    ofstream file(name.c_str(), ios::binary | ios::trunc);
+    file << text;
+}
+
+/* Function: testArchive
+ * --------------------------------------------------------
+ * Tests the checksums archives use, and creating, listing and
+ * extracting archives, both directly and through huff.
+ */
+void testArchive() {
+    logInfo("Testing CRC-32 checksums");
+    string digits = "123456789";
+    checkCondition(crc32(digits.data(), digits.length()) == 0xCBF43926UL,
+                   "The checksum of the standard check string is right");
+    checkCondition(crc32Combine(crc32("1234", 4), crc32("56789", 5), 5) == 0xCBF43926UL &&
+                   crc32("56789", 5, crc32("1234", 4)) == 0xCBF43926UL,
+                   "Checksums of pieces combine into the checksum of the whole");
+
+    logInfo("Testing archives");
+    mkdir("huffArchiveTest", 0777);
+    mkdir("huffArchiveTest/sub", 0777);
+    Vector<string> contents;
+    CorpusSpec spec;
+    spec.size = 300000;
+    contents.add(generateCorpus(spec));
+    contents.add("");
+    contents.add("a small file");
+    writeStringToFile("huffArchiveTest/big", contents[0]);
+    writeStringToFile("huffArchiveTest/sub/empty", contents[1]);
+    writeStringToFile("huffArchiveTest/sub/small", contents[2]);
+
+    Vector<string> inputs;
+    listArchiveInputs("huffArchiveTest", inputs);
+    listArchiveInputs("huffArchiveMissing", inputs);
+    checkCondition(inputs.size() == 4 && inputs[0] == "huffArchiveTest/big" &&
+                   inputs[2] == "huffArchiveTest/sub/small", "The directory walk finds every file in order");
+
+    Vector<FileCompressionJob> jobs;
+    foreach (string input in inputs) {
+        FileCompressionJob job;
+        job.inputName = job.outputName = input;
+        jobs.add(job);
+    }
+    FileCompressionJob unsafe;
+    unsafe.inputName = "huffArchiveTest/big";
+    unsafe.outputName = "../big";
+    jobs.add(unsafe);
+    CompressionOptions options;
+    options.numThreads = 2;
+    options.blockSize = 64 * 1024;
+    checkCondition(createArchive("huffArchiveTest.hfa", jobs, options) == 2 &&
+                   jobs[0].succeeded && jobs[1].succeeded && jobs[2].succeeded &&
+                   jobs[3].errorMessage == "Cannot open the file." &&
+                   jobs[4].errorMessage == "Name cannot be stored in an archive.",
+                   "Only the missing file and the unsafe name fail");
+
+    Vector<ArchiveEntry> entries;
+    readArchiveDirectory("huffArchiveTest.hfa", entries);
+    bool sizesMatch = entries.size() == 3;
+    for (int i = 0; sizesMatch && i < 3; i++) {
+        sizesMatch = entries[i].name == inputs[i] && entries[i].size == (long long) contents[i].length();
+    }
+    checkCondition(sizesMatch, "The directory lists every file that went in");
+
+    Vector<FileCompressionJob> wanted(2);
+    wanted[0].inputName = "huffArchiveTest/sub/small";
+    wanted[0].outputName = "huffArchiveOut/small";
+    wanted[1].inputName = "huffArchiveTest/big";
+    wanted[1].outputName = "huffArchiveOut/big";
+    checkCondition(extractArchive("huffArchiveTest.hfa", wanted, 2) == 0 &&
+                   readFileToString("huffArchiveOut/small") == contents[2] &&
+                   readFileToString("huffArchiveOut/big") == contents[0],
+                   "Chosen entries are extracted in parallel");
+    wanted[0].inputName = "huffArchiveTest/nothing";
+    checkCondition(extractArchive("huffArchiveTest.hfa", wanted, 1) == 1 &&
+                   !wanted[0].succeeded && wanted[1].succeeded, "A missing entry fails on its own");
+
+    // flip a byte in the middle of the large entry
+    string archive = readFileToString("huffArchiveTest.hfa");
+    long long middle = entries[0].chunks[0].offset + entries[0].chunks[0].compressedSize / 2;
+    archive[middle] = char(archive[middle] ^ 0x55);
+    writeStringToFile("huffArchiveBad.hfa", archive);
+    wanted[0].inputName = "huffArchiveTest/sub/small";
+    checkCondition(extractArchive("huffArchiveBad.hfa", wanted, 2) == 1 && wanted[0].succeeded &&
+                   !wanted[1].succeeded && access("huffArchiveOut/big", F_OK) != 0,
+                   "A damaged entry fails and its output is removed");
+    writeStringToFile("huffArchiveBad.hfa", archive.substr(0, archive.length() - 3));
+    bool rejected = false;
+    try {
+        readArchiveDirectory("huffArchiveBad.hfa", entries);
+    } catch (ErrorException&) {
+        rejected = true;
+    }
+    checkCondition(rejected, "A truncated archive is rejected");
+
+    Vector<FileCompressionJob> named(2);
+    named[0].inputName = named[1].inputName = "huffArchiveTest/sub/small";
+    named[0].outputName = "/xx/z";
+    named[1].outputName = "xabs";
+    checkCondition(createArchive("huffArchiveNames.hfa", named, options) == 0 &&
+                   named[0].outputName == "xx/z", "An absolute name is stored without its slash");
+    string namesArchive = readFileToString("huffArchiveNames.hfa");
+    string crafted[] = { "xx/z", "../z", "xabs", "/abs" };
+    for (int i = 0; i < 4; i += 2) {
+        string damaged = namesArchive;
+        damaged.replace(damaged.rfind(crafted[i]), crafted[i].length(), crafted[i + 1]);
+        writeStringToFile("huffArchiveBad.hfa", damaged);
+        rejected = false;
+        try {
+            readArchiveDirectory("huffArchiveBad.hfa", entries);
+        } catch (ErrorException& ex) {
+            rejected = ex.getMessage() == "Archive has a damaged directory.";
+        }
+        checkCondition(rejected, "An archive with an entry named " + crafted[i + 1] + " is rejected");
+    }
+
+    logInfo("Testing archives through huff");
+    string output, messages;
+    checkCondition(runTool("a -T 2 huffArchiveTool.hfa huffArchiveTest", "", output, messages) == EXIT_OK,
+                   "huff a packs a directory");
+    checkCondition(runTool("l huffArchiveTool.hfa", "", output, messages) == EXIT_OK &&
+                   output.find(integerToString(contents[0].length()) + " ") == 0 &&
+                   output.find("huffArchiveTest/sub/small\n") != string::npos,
+                   "huff l lists the entries");
+    remove("huffArchiveTest/sub/small");
+    checkCondition(runTool("x huffArchiveTool.hfa huffArchiveTest/sub/small", "", output, messages) == EXIT_OK &&
+                   readFileToString("huffArchiveTest/sub/small") == contents[2],
+                   "huff x extracts a chosen entry");
+    checkCondition(runTool("x huffArchiveTool.hfa nothing", "", output, messages) == EXIT_FAILED &&
+                   messages.find("nothing: Archive has no entry") != string::npos,
+                   "huff x reports a missing entry");
+    checkCondition(runTool("a huffArchiveTool.hfa", "", output, messages) == EXIT_USAGE,
+                   "huff a needs files to pack");
+    checkCondition(runTool("x huffArchiveBad.hfa", "", output, messages) == EXIT_FAILED &&
+                   access("/abs", F_OK) != 0, "huff x extracts nothing from an archive with an unsafe name");
+
+    remove("huffArchiveTest/big");
+    remove("huffArchiveTest/sub/empty");
+    remove("huffArchiveTest/sub/small");
+    remove("huffArchiveTest/sub");
+    remove("huffArchiveTest");
+    remove("huffArchiveOut/small");
+    remove("huffArchiveOut");
+    remove("huffArchiveTest.hfa");
+    remove("huffArchiveBad.hfa");
+    remove("huffArchiveNames.hfa");
+    remove("huffArchiveTool.hfa");
+}
+
+/* Function: compressThroughCache
+ * --------------------------------------------------------
+ * Returns what the cache writes for text at the given level.
+ */
+string compressThroughCache(ResultCache& cache, const string& text, int level,
+                            CompressionStats* stats = NULL) {
+    CompressionOptions options;
+    options.level = level;
+    istringstream source(text);
+    ostringstream sink;
+    cache.compress(source, sink, options, stats);
+    return sink.str();
+}
+
+/* Function: testResultCache
+ * --------------------------------------------------------
+ * Tests the content hash and the cache of compressed results, directly
+ * and through huff.
+ */
+void testResultCache() {
+    logInfo("Testing the content hash");
+    ContentHash empty;
+    ContentHash abc;
+    abc.update("abc", 3);
+    checkCondition(empty.digest() == 0xEF46DB3751D8E999ULL && abc.digest() == 0x44BC2CF5AD770999ULL,
+                   "The hash matches the reference XXH64");
+    CorpusSpec spec;
+    spec.size = 200000;
+    string text = generateCorpus(spec);
+    ContentHash whole, pieces;
+    whole.update(text.data(), text.length());
+    for (long i = 0; i < (long) text.length(); i += 1000 + i % 7) {
+        pieces.update(text.data() + i, min(1000 + i % 7, (long) text.length() - i));
+    }
+    checkCondition(whole.digest() == pieces.digest() && whole.length() == (long long) text.length(),
+                   "Hashing in pieces gives the same hash");
+
+    logInfo("Testing the result cache");
+    string expected = compressAtLevel(text, 5);
+    {
+        ResultCache cache("huffCacheTest", 1 << 30);
+        checkCondition(compressThroughCache(cache, text, 5) == expected &&
+                       cache.getStats().misses == 1, "A miss compresses the input");
+        CompressionStats stats;
+        checkCondition(compressThroughCache(cache, text, 5, &stats) == expected &&
+                       cache.getStats().hits == 1, "A hit gives back the same output");
+        checkCondition(stats.uncompressedBytes == (long long) text.length() &&
+                       stats.compressedBytes == (long long) expected.length(),
+                       "A hit reports the sizes");
+        compressThroughCache(cache, text, 2);
+        compressThroughCache(cache, text.substr(1), 5);
+        checkCondition(cache.getStats().misses == 3 && cache.getStats().numEntries == 3,
+                       "Other options and other contents are cached apart");
+
+        writeStringToFile("huffCacheInput", text);
+        CompressionOptions options;
+        options.level = 5;
+        cache.compressFile("huffCacheInput", "huffCacheOutput", options);
+        checkCondition(readFileToString("huffCacheOutput") == expected &&
+                       cache.getStats().hits == 2, "Files are served from the cache");
+    }
+    ostringstream length;
+    length << "-" << hex << setw(16) << setfill('0') << text.length() << ".huf";
+    int numResults = 0;
+    bool lengthInKey = false;
+    DIR* cacheDirectory = opendir("huffCacheTest");
+    for (dirent* found = readdir(cacheDirectory); found != NULL; found = readdir(cacheDirectory)) {
+        string name = found->d_name;
+        if (name[0] == '.') continue;
+        numResults++;
+        if (name.find(length.str()) == 16) lengthInKey = true;
+    }
+    closedir(cacheDirectory);
+    checkCondition(numResults == 3 && lengthInKey, "Results are keyed by the input's length too");
+
+    {
+        // the level 5 result was used last, so it is the one that stays
+        ResultCache cache("huffCacheTest", (long long) expected.length() + 1);
+        checkCondition(cache.getStats().numEntries == 1 && cache.getStats().evictions == 2,
+                       "Reopening with a smaller limit evicts the least recently used");
+        compressThroughCache(cache, text, 5);
+        compressThroughCache(cache, text, 2);
+        checkCondition(cache.getStats().hits == 1 && cache.getStats().misses == 1 &&
+                       cache.getStats().bytes <= (long long) expected.length() + 1,
+                       "The limit holds as results are added");
+    }
+
+    logInfo("Testing the result cache through huff");
+    string output, messages;
+    checkCondition(runTool("c -l 5 --cache huffCacheTest --stats huffCacheInput huffCacheOutput", "",
+                           output, messages) == EXIT_OK &&
+                   messages.find("cache: 0 hits, 1 misses") != string::npos &&
+                   readFileToString("huffCacheOutput") == expected, "huff c fills the cache");
+    checkCondition(runTool("c -l 5 --cache huffCacheTest --stats huffCacheInput huffCacheOutput", "",
+                           output, messages) == EXIT_OK &&
+                   messages.find("cache: 1 hits, 0 misses") != string::npos &&
+                   readFileToString("huffCacheOutput") == expected, "huff c uses the cache");
+    checkCondition(runTool("d --cache huffCacheTest huffCacheOutput", "", output, messages) == EXIT_USAGE,
+                   "--cache is only for compressing");
+
+    // a one-byte limit evicts every result
+    { ResultCache cache("huffCacheTest", 1); }
+    remove("huffCacheTest");
+    remove("huffCacheInput");
+    remove("huffCacheOutput");
+}
+
+/* Function: chunkEnds
+ * --------------------------------------------------------
+ * Returns where findChunkEnd cuts text, as offsets from its start.
+ */
+Vector<long> chunkEnds(const string& text) {
+    Vector<long> ends;
+    long start = 0;
+    while (start < (long) text.length()) {
+        start += findChunkEnd(text.data() + start, text.length() - start);
+        ends.add(start);
+    }
+    return ends;
+}
+
+/* Function: testDeduplication
+ * --------------------------------------------------------
+ * Tests content-defined chunking and deduplicated archives, directly
+ * and through huff.
+ */
+void testDeduplication() {
+    logInfo("Testing content-defined chunking");
+    CorpusSpec spec;
+    spec.size = 600000;
+    string base = generateCorpus(spec);
+    Vector<long> ends = chunkEnds(base);
+    bool sizesInRange = ends.size() > 2;
+    for (int i = 0; sizesInRange && i < ends.size() - 1; i++) {
+        long size = ends[i] - (i == 0 ? 0 : ends[i - 1]);
+        sizesInRange = size >= CHUNK_MIN_SIZE && size <= CHUNK_MAX_SIZE;
+    }
+    checkCondition(sizesInRange && ends[ends.size() - 1] == (long) base.length(),
+                   "Chunks cover the input and stay within the size bounds");
+    string shifted = "inserted" + base;
+    Vector<long> shiftedEnds = chunkEnds(shifted);
+    int numShared = 0;
+    foreach (long end in ends) {
+        foreach (long shiftedEnd in shiftedEnds) {
+            if (shiftedEnd == end + 8) numShared++;
+        }
+    }
+    checkCondition(numShared >= ends.size() - 1, "Inserting at the start moves only the first cut");
+
+    logInfo("Testing deduplicated archives");
+    spec.seed = 2;
+    spec.size = 100000;
+    Vector<string> contents;
+    contents.add(base);
+    contents.add(base);
+    contents.add(shifted);
+    contents.add(generateCorpus(spec));
+    contents.add("");
+    Vector<FileCompressionJob> jobs;
+    for (int i = 0; i < contents.size(); i++) {
+        FileCompressionJob job;
+        job.inputName = job.outputName = "huffDedupTest" + integerToString(i);
+        writeStringToFile(job.inputName, contents[i]);
+        jobs.add(job);
+    }
+    CompressionOptions options;
+    options.numThreads = 2;
+    options.maxBufferedBytes = 1;
+    checkCondition(createArchive("huffDedupTest.hfa", jobs, options, true) == 0,
+                   "A deduplicated archive is created");
+    checkCondition(jobs[1].stats.compressedBytes == 0 &&
+                   jobs[2].stats.compressedBytes < jobs[0].stats.compressedBytes / 2,
+                   "Chunks seen before are not compressed again");
+    Vector<FileCompressionJob> wholeJobs = jobs;
+    checkCondition(createArchive("huffDedupWhole.hfa", wholeJobs, options) == 0,
+                   "The same files make an archive without deduplication");
+
+    Vector<ArchiveEntry> entries;
+    readArchiveDirectory("huffDedupTest.hfa", entries);
+    bool shared = entries.size() == 5 && entries[0].chunks.size() == entries[1].chunks.size();
+    for (int i = 0; shared && i < entries[0].chunks.size(); i++) {
+        shared = entries[0].chunks[i].offset == entries[1].chunks[i].offset;
+    }
+    checkCondition(shared && entries[4].chunks.isEmpty(), "Identical files share their chunks");
+    long long dedupSize = readFileToString("huffDedupTest.hfa").length();
+    long long wholeSize = readFileToString("huffDedupWhole.hfa").length();
+    checkCondition(dedupSize < wholeSize / 2, "Shared data is stored once");
+
+    Vector<FileCompressionJob> wanted;
+    for (int i = 0; i < contents.size(); i++) {
+        FileCompressionJob job;
+        job.inputName = jobs[i].outputName;
+        job.outputName = "huffDedupOut" + integerToString(i);
+        wanted.add(job);
+    }
+    bool roundTrips = extractArchive("huffDedupTest.hfa", wanted, 2) == 0;
+    for (int i = 0; roundTrips && i < contents.size(); i++) {
+        roundTrips = readFileToString(wanted[i].outputName) == contents[i];
+    }
+    checkCondition(roundTrips, "Every file is extracted from its chunks");
+
+    // flip a byte in a chunk the first two files share
+    string archive = readFileToString("huffDedupTest.hfa");
+    long long middle = entries[0].chunks[1].offset + entries[0].chunks[1].compressedSize / 2;
+    archive[middle] = char(archive[middle] ^ 0x55);
+    writeStringToFile("huffDedupBad.hfa", archive);
+    checkCondition(extractArchive("huffDedupBad.hfa", wanted, 2) >= 2 &&
+                   !wanted[0].succeeded && !wanted[1].succeeded && wanted[3].succeeded,
+                   "A damaged chunk fails every file that holds it");
+
+    logInfo("Testing deduplicated archives through huff");
+    string output, messages;
+    checkCondition(runTool("a --dedup huffDedupTool.hfa huffDedupTest0 huffDedupTest1", "", output,
+                           messages) == EXIT_OK, "huff a --dedup packs files");
+    checkCondition(runTool("l huffDedupTool.hfa", "", output, messages) == EXIT_OK &&
+                   output.find("huffDedupTest1\n") != string::npos, "huff l lists them");
+    remove("huffDedupTest1");
+    checkCondition(runTool("x huffDedupTool.hfa huffDedupTest1", "", output, messages) == EXIT_OK &&
+                   readFileToString("huffDedupTest1") == base, "huff x extracts them");
+    checkCondition(runTool("c --dedup huffDedupTest0", "", output, messages) == EXIT_USAGE,
+                   "--dedup is only for archives");
+
+    for (int i = 0; i < contents.size(); i++) {
+        remove(jobs[i].inputName.c_str());
+        remove(wanted[i].outputName.c_str());
+    }
+    remove("huffDedupTest.hfa");
+    remove("huffDedupWhole.hfa");
+    remove("huffDedupBad.hfa");
+    remove("huffDedupTool.hfa");
+}
+
+/* Function: deltaAgainst
+ * --------------------------------------------------------
+ * Returns the delta that turns reference into text.
+ */
+string deltaAgainst(const string& reference, const string& text, CompressionStats* stats = NULL) {
+    istringstream referenceSource(reference), source(text);
+    ostringstream sink;
+    compressDelta(referenceSource, source, sink, CompressionOptions(), stats);
+    return sink.str();
+}
+
+/* Function: applyDelta
+ * --------------------------------------------------------
+ * Returns what the delta gives applied to reference, or the message of
+ * the error it reports.
+ */
+string applyDelta(const string& reference, const string& delta) {
+    istringstream referenceSource(reference), source(delta);
+    ostringstream sink;
+    try {
+        decompressDelta(referenceSource, source, sink);
+    } catch (ErrorException& ex) {
+        return "error: " + ex.getMessage();
+    }
+    return sink.str();
+}
+
+/* Function: testDelta
+ * --------------------------------------------------------
+ * Tests delta compression against a reference, directly and through
+ * huff.
+ */
+void testDelta() {
+    logInfo("Testing delta compression");
+    CorpusSpec spec;
+    spec.size = 500000;
+    string reference = generateCorpus(spec);
+    string changed = reference;
+    changed.replace(1000, 100, string(100, 'x'));
+    changed.insert(200000, "a few new lines\nthat were not there before\n");
+    changed.erase(400000, 300);
+    CompressionStats stats;
+    string delta = deltaAgainst(reference, changed, &stats);
+    logInfo("Delta of " + integerToString(delta.length()) + " bytes");
+    checkCondition(applyDelta(reference, delta) == changed, "A changed version round-trips");
+    checkCondition(delta.length() < 1000 && stats.compressedBytes == (long long) delta.length() &&
+                   stats.uncompressedBytes == (long long) changed.length(),
+                   "The delta is about the size of the changes");
+    string moved = changed.substr(250000) + changed.substr(0, 250000);
+    checkCondition(applyDelta(reference, deltaAgainst(reference, moved)) == moved,
+                   "Moved runs are copied from anywhere in the reference");
+
+    spec.seed = 2;
+    string unrelated = generateCorpus(spec);
+    string unrelatedDelta = deltaAgainst(reference, unrelated);
+    checkCondition(applyDelta(reference, unrelatedDelta) == unrelated &&
+                   unrelatedDelta.length() < compressAtLevel(unrelated, 6).length() + 200,
+                   "An unrelated file costs little more than compressing it");
+    checkCondition(applyDelta("", deltaAgainst("", "")) == "" &&
+                   applyDelta("", deltaAgainst("", "short")) == "short" &&
+                   applyDelta("short", deltaAgainst("short", "")) == "",
+                   "Empty files and references round-trip");
+
+    // longer than the encoder's window, with more than a window of new bytes
+    spec.size = 1500000;
+    string longReference = generateCorpus(spec);
+    spec.seed = 3;
+    string longInsert = generateCorpus(spec);
+    string longChanged = longReference.substr(0, 1048000) + longInsert + longReference.substr(1048000);
+    string longDelta = deltaAgainst(longReference, longChanged);
+    checkCondition(applyDelta(longReference, longDelta) == longChanged &&
+                   longDelta.length() < compressAtLevel(longInsert, 6).length() + 1000,
+                   "A long version is encoded through the window");
+
+    checkCondition(applyDelta(unrelated, delta) ==
+                   "error: Delta was made against a different reference.",
+                   "A delta against another reference is rejected");
+    string damaged = delta;
+    damaged[damaged.length() / 2] = char(damaged[damaged.length() / 2] ^ 0x55);
+    checkCondition(applyDelta(reference, damaged).find("error: ") == 0, "A damaged delta is rejected");
+    checkCondition(applyDelta(reference, compressAtLevel(changed, 6)) == "error: Not a delta.",
+                   "A file that is not a delta is rejected");
+
+    logInfo("Testing delta compression through huff");
+    writeStringToFile("huffDeltaOld", reference);
+    writeStringToFile("huffDeltaNew", changed);
+    string output, messages;
+    checkCondition(runTool("c --ref huffDeltaOld huffDeltaNew huffDeltaNew.huf", "", output,
+                           messages) == EXIT_OK &&
+                   readFileToString("huffDeltaNew.huf").length() == delta.length(),
+                   "huff c --ref writes a delta");
+    checkCondition(runTool("t --ref huffDeltaOld huffDeltaNew.huf", "", output, messages) == EXIT_OK &&
+                   runTool("d --ref huffDeltaOld huffDeltaNew.huf -", "", output, messages) == EXIT_OK &&
+                   output == changed, "huff d --ref applies it");
+    checkCondition(runTool("d --ref huffDeltaNew huffDeltaNew.huf -", "", output, messages) == EXIT_FAILED &&
+                   messages.find("different reference") != string::npos,
+                   "huff d --ref reports the wrong reference");
+    checkCondition(runTool("bench --ref huffDeltaOld huffDeltaNew", "", output, messages) == EXIT_USAGE,
+                   "--ref is only for c, d and t");
+
+    remove("huffDeltaOld");
+    remove("huffDeltaNew");
+    remove("huffDeltaNew.huf");
+}
+
+/* Function: searchMatchesFind
+ * --------------------------------------------------------
+ * Returns whether searching the compressed form of text finds the
+ * pattern exactly where string::find does.
+ */
+bool searchMatchesFind(const string& text, const string& compressed, const string& pattern,
+                       SearchStats* stats = NULL) {
+    istringbstream source(compressed);
+    Vector<long long> found = searchCompressed(source, pattern, stats);
+    int numExpected = 0;
+    for (size_t at = text.find(pattern); at != string::npos; at = text.find(pattern, at + 1)) {
+        if (numExpected >= found.size() || found[numExpected] != (long long) at) return false;
+        numExpected++;
+    }
+    return numExpected == found.size();
+}
+
+/* Function: compressWithOptions
+ * --------------------------------------------------------
+ * Returns what compress writes for text with the given level and block
+ * size.
+ */
+string compressWithOptions(const string& text, int level, long blockSize) {
+    CompressionOptions options;
+    options.level = level;
+    options.blockSize = blockSize;
+    istringstream source(text);
+    ostringstream compressed;
+    compress(source, compressed, options);
+    return compressed.str();
+}
+
+/* Function: testCompressedSearch
+ * --------------------------------------------------------
+ * Tests searching compressed files without decompressing them.
+ */
+void testCompressedSearch() {
+    logInfo("Testing search in compressed files");
+    string log;
+    for (int i = 0; i < 6000; i++) {
+        log += "2026-10-17 12:" + integerToString(10 + i % 50) + " INFO request " +
+               integerToString(i * 7919 % 100000) + " served in " + integerToString(i % 97) +
+               " ms\n";
+    }
+    log.insert(log.length() / 3, "ERROR disk full on /var/log\n");
+    Vector<string> patterns;
+    patterns.add("ERROR disk full");
+    patterns.add("served in 42 ms");
+    patterns.add("request 1");
+    patterns.add("INFO");
+    patterns.add("\n2026");
+    patterns.add("e");
+    patterns.add("QQ");
+    patterns.add(log.substr(65535 - 5, 40));
+
+    // tiny blocks make streams shorter than the patterns
+    int levels[] = { 1, 4, 6, 9 };
+    long blockSizes[] = { 0, 1000, 7 };
+    bool allMatch = true;
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 3; j++) {
+            string text = (blockSizes[j] < 100) ? log.substr(0, 5000) : log;
+            string compressed = compressWithOptions(text, levels[i], blockSizes[j]);
+            foreach (string pattern in patterns) {
+                if (!searchMatchesFind(text, compressed, pattern)) {
+                    logInfo("Search differs for \"" + pattern + "\" at level " +
+                            integerToString(levels[i]) + ", block size " +
+                            integerToString(blockSizes[j]));
+                    allMatch = false;
+                }
+            }
+        }
+    }
+    checkCondition(allMatch, "Every pattern is found where it is, at every level and block size");
+
+    CorpusSpec spec;
+    spec.distribution = CORPUS_UNIFORM;
+    spec.size = 200000;
+    string random = generateCorpus(spec);
+    string stored = compressWithOptions(random, 1, 0);
+    checkCondition(searchMatchesFind(random, stored, random.substr(123456, 20)) &&
+                   searchMatchesFind(random, stored, random.substr(1000, 2)),
+                   "Stored blocks are searched too");
+
+    SearchStats stats;
+    checkCondition(searchMatchesFind(log, compressWithOptions(log, 4, 0), "ERROR disk full", &stats),
+                   "A rare pattern is found");
+    logInfo(integerToString(stats.bytesScanned) + " bytes scanned, " +
+            integerToString(stats.codesSkipped) + " codes skipped, " +
+            integerToString(stats.bytesDecoded) + " bytes decoded");
+    checkCondition(stats.bytesScanned > 0 && stats.bytesDecoded < (long long) log.length() / 100 &&
+                   stats.codesSkipped < (long long) log.length() / 2,
+                   "A rare pattern is found without decompressing most of the file");
+
+    bool rejected = false;
+    try {
+        istringbstream source(compressAtLevel(log, 4));
+        searchCompressed(source, "");
+    } catch (ErrorException&) {
+        rejected = true;
+    }
+    checkCondition(rejected, "An empty pattern is rejected");
+}
+
 /* Function: openFile
  * --------------------------------------------------------
  * Prompts the user for the name of a file to open, opening
@@ -996,15 +3116,38 @@ void runCompress() {
 	ofbstream outfile;
 	openFile(outfile, "Filename for compressed output: ");
 		
+	/* Optionally record a timeline of the stages. */
+	string traceFile = getLine("Filename for a trace of the stages (blank for none): ");
+	if (!traceFile.empty()) startTracing();
+
 	/* Compress the file. */
 	cout << "Compressing... " << flush;
-	compress(infile, outfile);
+	CompressionStats stats;
+	compress(infile, outfile, &stats);
 	cout << "done!" << endl << endl;
+
+	if (!traceFile.empty()) {
+		stopTracing();
+		ofstream traceOutput(traceFile.c_str());
+		writeTraceJSON(traceOutput);
+	}
 		
 	/* Report statistics. */
 	cout << "Original file size: " << infile.size() << "B" << endl;
 	cout << "New file size:      " << outfile.size() << "B" << endl;
-	cout << "Compression ratio:  " << double(outfile.size()) / infile.size() << endl << endl;
+	cout << "Compression ratio:  " << double(outfile.size()) / infile.size() << endl;
+	cout << "Header size:        " << stats.headerBytes << "B" << endl;
+	cout << "Distinct bytes:     " << stats.distinctSymbols() << endl;
+	cout << "Code lengths:       " << stats.minCodeLength << " to " << stats.maxCodeLength
+	     << " bits, " << stats.averageCodeLength() << " on average" << endl;
+	cout << "Bits per byte:      " << stats.achievedBitsPerSymbol() << " (entropy "
+	     << stats.entropyBitsPerSymbol() << ")" << endl;
+	for (int stage = 0; stage < NUM_COMPRESSION_STAGES; stage++) {
+		if (stats.stageSeconds[stage] == 0) continue;
+		cout << setw(20) << left << string(compressionStageName(CompressionStage(stage))) + ":"
+		     << right << stats.stageSeconds[stage] << "s" << endl;
+	}
+	cout << endl;
 	getLine("Press ENTER to continue...");
 }
 
@@ -1025,6 +3168,31 @@ void runDecompress() {
 	getLine("Press ENTER to continue...");
 }
 
+/* Function: runBenchmark
+ * --------------------------------------------------------
+ * Harness to benchmark every stage on the test corpus and write the
+ * results to a file as JSON or CSV.
+ */
+void runBenchmark() {
+	ofstream outfile;
+	openFile(outfile, "Filename for results (.json or .csv): ");
+	string stageFilter = getLine("Stages to run (blank for all): ");
+
+	BenchmarkOptions options;
+	options.stageFilter = stageFilter;
+	options.streamedSize = getInteger("Megabytes to stream through each stage (0 for none): ") * 1024LL * 1024;
+	options.perfCounters = (getLine("Count cycles, instructions and cache misses (y/n)? ") == "y");
+	options.countAllocations = (getLine("Count allocations (y/n)? ") == "y");
+	Vector<BenchmarkResult> results = runBenchmarks(options, &cout);
+	if (getLine("Format (json or csv): ") == "csv") {
+		writeBenchmarkCSV(outfile, results);
+	} else {
+		writeBenchmarkJSON(outfile, results);
+	}
+	cout << "Results written!" << endl;
+	getLine("Press ENTER to continue...");
+}
+
 /* Function: compareFiles
  * --------------------------------------------------------
  * Compares two files byte-by-byte to determine whether or
@@ -1088,6 +3256,7 @@ void displayMenu() {
     cout << setw(2) << MANUAL_TEST_COMPRESS_LZW << ": Manual test compressing a file using LZW" << endl;
     cout << setw(2) << MANUAL_TEST_DECOMPRESS_LZW << ": Manual test decompressing a file using LZW" << endl;
     cout << setw(2) << AUTOMATIC_TEST_LZW << ": Automatic tests of functions used in LZW compression and decompression" << endl;
+    cout << setw(2) << BENCHMARK << ": Benchmark the throughput of each stage" << endl;
 	cout << setw(2) << QUIT << ": Quit" << endl;
 }
 
@@ -1147,6 +3316,23 @@ int main() {
 				break;
 			case AUTOMATIC_COMPLETE_TESTS:
 				testCompleteStack();
+                testAutoCompression();
+                testCompressionLevels();
+                testDeadlineCompression();
+                testBenchmark();
+                testCorpusGenerator();
+                testCompressionStats();
+                testTracing();
+                testAllocationDiagnostics();
+                testCommandLine();
+                testBatchCompression();
+                testPipeline();
+                testAsyncIO();
+                testArchive();
+                testResultCache();
+                testDeduplication();
+                testDelta();
+                testCompressedSearch();
 				break;
 			case COMPARE:
 				compareFiles();
@@ -1160,6 +3346,15 @@ int main() {
                 break;
 			case AUTOMATIC_TEST_LZW:
                 testAutomaticLZW();
+                testBoundedLZW();
+                testStreamingLZW();
+                testLZWLibraryAPI();
+                testHybridLZW();
+                testPresetLZW();
+                testBlockLZW();
+                break;
+            case BENCHMARK:
+                runBenchmark();
                 break;
             case QUIT:
 				return 0;
@@ -0,0 +1,23 @@
+/**********************************************************
+ * File: HuffmanTool.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * The main program of the huff command-line tool (see CommandLine.h).
+ * It is built as its own target, without the console of the test
+ * harness, so that standard input and output are the process's own.
+ */
+
+#include <iostream>
+#include <string>
+#include "CommandLine.h"
+using namespace std;
+
+int main(int argc, char** argv) {
+	Vector<string> args;
+	for (int i = 1; i < argc; i++) {
+		args.add(argv[i]);
+	}
+	return runCommandLine(args, cin, cout, cerr);
+}
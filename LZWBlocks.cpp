@@ -0,0 +1,241 @@
+/**********************************************************
+ * File: LZWBlocks.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of block-mode LZW from LZWBlocks.h.
+ *
+ * File format (all numbers big-endian):
+ *   - 4 bytes holding the magic number "LZWB".
+ *   - 4 bytes holding the block size.
+ *   - The blocks, one after another, each a complete LZW stream as
+ *     written by lzwCompress.
+ *   - The block index: for each block, 8 bytes holding its offset from
+ *     the start of the file, 4 bytes holding its compressed size and
+ *     4 bytes holding its original size.
+ *   - 8 bytes holding the offset of the block index, 4 bytes holding the
+ *     number of blocks and 4 bytes holding the magic number "LZWI".  This
+ *     trailer has a fixed size, so it can be found by seeking to the end.
+ */
+
+#include "LZWBlocks.h"
+#include "ThreadPool.h"
+#include "BinaryIO.h"
+#include "Tracing.h"
+#include "error.h"
+
+/* Constants: BLOCKS_MAGIC, INDEX_MAGIC, TRAILER_BYTES
+ * The magic numbers at the start and end of a block-mode file, and the
+ *   size of the trailer that ends it.
+ */
+static const unsigned long BLOCKS_MAGIC = 0x4C5A5742;   // "LZWB"
+static const unsigned long INDEX_MAGIC = 0x4C5A5749;    // "LZWI"
+static const int TRAILER_BYTES = 16;
+
+/* Constant: BLOCKS_PER_THREAD
+ * How many blocks per thread are read in and handed to the pool at once.
+ *   More than one keeps threads busy when some blocks take longer than
+ *   others, at the cost of holding more of the input in memory.
+ */
+static const int BLOCKS_PER_THREAD = 2;
+
+/* Class: CompressBlockTask
+ * --------------------------------------------------------
+ * Compresses one block of input on a pool thread.
+ */
+class CompressBlockTask : public ThreadPoolTask {
+public:
+    std::string input;
+    std::string output;
+    const LZWOptions* options;
+
+    void run() {
+        TRACE_SCOPE("lzw-compress");
+        output = lzwCompress(input, *options);
+    }
+};
+
+/* Class: DecompressBlockTask
+ * --------------------------------------------------------
+ * Decompresses one block on a pool thread and checks that it came out
+ * the size the block index says it should.
+ */
+class DecompressBlockTask : public ThreadPoolTask {
+public:
+    std::string input;
+    std::string output;
+    const LZWPreset* preset;
+    long originalSize;
+
+    void run() {
+        TRACE_SCOPE("lzw-decompress");
+        output = lzwDecompress(input, preset);
+        if (output.length() != originalSize) {
+            error("Block-mode LZW file has a block of the wrong size.");
+        }
+    }
+};
+
+/* Function: lzwCompressBlocks
+ * Usage: lzwCompressBlocks(infile, outfile, options, blockSize, numThreads);
+ * --------------------------------------------------------
+ * Reads a batch of blocks, compresses the whole batch in parallel and
+ * writes it out in order, then moves on to the next batch.  Offsets are
+ * counted as the blocks are written rather than asked of the stream, so
+ * that the output can be a pipe.
+ */
+void lzwCompressBlocks(istream& infile, ostream& outfile,
+                       const LZWOptions& options, long blockSize, int numThreads) {
+    if (blockSize < 1 || blockSize > 0x7FFFFFFFL) error("LZW block size is out of range.");
+    if (numThreads == 0) numThreads = defaultThreadCount();
+
+    // the batch is declared first so that it outlives the pool, whose
+    //   destructor waits for any tasks still running
+    Vector<CompressBlockTask> batch(numThreads * BLOCKS_PER_THREAD);
+    ThreadPool pool(numThreads);
+    Vector<LZWBlockInfo> index;
+
+    writeNumber(outfile, BLOCKS_MAGIC, 4);
+    writeNumber(outfile, blockSize, 4);
+    long long offset = 8;
+
+    while (infile) {
+        int batchSize = 0;
+        while (batchSize < batch.size() && infile) {
+            TRACE_SCOPE("read");
+            CompressBlockTask& task = batch[batchSize];
+            task.input.resize(blockSize);
+            infile.read(&task.input[0], blockSize);
+            task.input.resize(infile.gcount());
+            if (task.input.empty()) break;
+
+            task.options = &options;
+            pool.submit(&task);
+            batchSize++;
+        }
+        {
+            TRACE_SCOPE("wait");
+            pool.waitForAll();
+        }
+
+        TRACE_SCOPE("write");
+        for (int i = 0; i < batchSize; i++) {
+            LZWBlockInfo block;
+            block.offset = offset;
+            block.compressedSize = batch[i].output.length();
+            block.originalSize = batch[i].input.length();
+            index.add(block);
+
+            outfile.write(batch[i].output.data(), batch[i].output.length());
+            offset += block.compressedSize;
+        }
+    }
+
+    foreach (LZWBlockInfo block in index) {
+        writeNumber(outfile, block.offset, 8);
+        writeNumber(outfile, block.compressedSize, 4);
+        writeNumber(outfile, block.originalSize, 4);
+    }
+    writeNumber(outfile, offset, 8);
+    writeNumber(outfile, index.size(), 4);
+    writeNumber(outfile, INDEX_MAGIC, 4);
+}
+
+/* Function: readLZWBlockIndex
+ * Usage: Vector<LZWBlockInfo> blocks = readLZWBlockIndex(infile);
+ * --------------------------------------------------------
+ * Checks the magic number at the start, reads the trailer at the end
+ * and then the index it points to.  Every block must lie between the
+ * header and the index.
+ */
+Vector<LZWBlockInfo> readLZWBlockIndex(istream& infile) {
+    infile.clear();
+    infile.seekg(0, ios::beg);
+    if (readNumber(infile, 4) != BLOCKS_MAGIC) error("File is not a block-mode LZW file.");
+
+    infile.seekg(-TRAILER_BYTES, ios::end);
+    if (!infile) error("Block-mode LZW file is truncated.");
+    long long indexOffset = readNumber(infile, 8);
+    long numBlocks = long(readNumber(infile, 4));
+    if (readNumber(infile, 4) != INDEX_MAGIC) error("Block-mode LZW file has no block index.");
+
+    infile.seekg(indexOffset, ios::beg);
+    if (!infile) error("Block-mode LZW file has an invalid block index.");
+    Vector<LZWBlockInfo> index;
+    for (long i = 0; i < numBlocks; i++) {
+        LZWBlockInfo block;
+        block.offset = readNumber(infile, 8);
+        block.compressedSize = long(readNumber(infile, 4));
+        block.originalSize = long(readNumber(infile, 4));
+        if (block.offset < 8 || block.offset + block.compressedSize > indexOffset) {
+            error("Block-mode LZW file has an invalid block index.");
+        }
+        index.add(block);
+    }
+    return index;
+}
+
+/* Function: readBlock
+ * Usage: string compressed = readBlock(infile, block);
+ * --------------------------------------------------------
+ * Reads the compressed bytes of one block.
+ */
+static std::string readBlock(istream& infile, const LZWBlockInfo& block) {
+    std::string compressed(block.compressedSize, '\0');
+    infile.clear();
+    infile.seekg(block.offset, ios::beg);
+    if (block.compressedSize > 0) infile.read(&compressed[0], block.compressedSize);
+    if (infile.gcount() != block.compressedSize) error("Block-mode LZW file is truncated.");
+    return compressed;
+}
+
+/* Function: lzwDecompressBlock
+ * Usage: string data = lzwDecompressBlock(infile, blocks[i], preset);
+ * --------------------------------------------------------
+ * Reads and decompresses the one block on the calling thread.
+ */
+std::string lzwDecompressBlock(istream& infile, const LZWBlockInfo& block,
+                               const LZWPreset* preset) {
+    DecompressBlockTask task;
+    task.input = readBlock(infile, block);
+    task.preset = preset;
+    task.originalSize = block.originalSize;
+    task.run();
+    return task.output;
+}
+
+/* Function: lzwDecompressBlocks
+ * Usage: lzwDecompressBlocks(infile, outfile, preset, numThreads);
+ * --------------------------------------------------------
+ * Works through the block index a batch at a time: reads the batch,
+ * decompresses it in parallel and writes it out in index order.
+ */
+void lzwDecompressBlocks(istream& infile, ostream& outfile,
+                         const LZWPreset* preset, int numThreads) {
+    if (numThreads == 0) numThreads = defaultThreadCount();
+    Vector<LZWBlockInfo> index = readLZWBlockIndex(infile);
+
+    Vector<DecompressBlockTask> batch(numThreads * BLOCKS_PER_THREAD);
+    ThreadPool pool(numThreads);
+    for (int start = 0; start < index.size(); start += batch.size()) {
+        int batchSize = 0;
+        for (int i = start; i < index.size() && batchSize < batch.size(); i++) {
+            TRACE_SCOPE("read");
+            DecompressBlockTask& task = batch[batchSize++];
+            task.input = readBlock(infile, index[i]);
+            task.preset = preset;
+            task.originalSize = index[i].originalSize;
+            pool.submit(&task);
+        }
+        {
+            TRACE_SCOPE("wait");
+            pool.waitForAll();
+        }
+
+        TRACE_SCOPE("write");
+        for (int i = 0; i < batchSize; i++) {
+            outfile.write(batch[i].output.data(), batch[i].output.length());
+        }
+    }
+}
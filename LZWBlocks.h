@@ -0,0 +1,84 @@
+/*******************************************************
+ * File: LZWBlocks.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Block-mode LZW.  The input is cut into fixed-size blocks that are
+ * compressed independently of one another, each starting from a fresh
+ * (or preset) dictionary, so that the blocks can be compressed and
+ * decompressed in parallel on a ThreadPool.  A block index at the end
+ * of the file records where each block lives, which keeps the blocks
+ * in order and allows any one of them to be decompressed on its own.
+ */
+
+#ifndef LZWBlocks_Included
+#define LZWBlocks_Included
+
+#include "LZWEncoding.h"
+#include "vector.h"
+#include <iostream>
+#include <string>
+
+/* Constant: LZW_DEFAULT_BLOCK_SIZE
+ * The default number of input bytes per block.  Larger blocks give the
+ *   dictionary more time to pay off; smaller blocks give more parallelism
+ *   and finer-grained random access.
+ */
+const long LZW_DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+/* Type: LZWBlockInfo
+ * One entry of the block index: where the compressed block starts in
+ *   the file, how many bytes it takes up there, and how many bytes it
+ *   decompresses to.
+ */
+struct LZWBlockInfo {
+    long long offset;
+    long compressedSize;
+    long originalSize;
+};
+
+/* Function: lzwCompressBlocks
+ * Usage: lzwCompressBlocks(infile, outfile, options, blockSize, numThreads);
+ * --------------------------------------------------------
+ * Compresses everything remaining in infile as independent blocks of
+ * blockSize bytes, using numThreads threads, and writes the blocks in
+ * order followed by the block index.  A numThreads of 0 uses one thread
+ * per processor.  No more than two blocks per thread are held in memory
+ * at once.  The output does not need to be seekable.
+ */
+void lzwCompressBlocks(istream& infile, ostream& outfile,
+                       const LZWOptions& options = LZWOptions(),
+                       long blockSize = LZW_DEFAULT_BLOCK_SIZE,
+                       int numThreads = 0);
+
+/* Function: lzwDecompressBlocks
+ * Usage: lzwDecompressBlocks(infile, outfile, preset, numThreads);
+ * --------------------------------------------------------
+ * Decompresses a file written by lzwCompressBlocks using numThreads
+ * threads (0 for one per processor).  The input must be seekable, since
+ * the block index is at its end.  Pass the preset the file was compressed
+ * with, if any.
+ */
+void lzwDecompressBlocks(istream& infile, ostream& outfile,
+                         const LZWPreset* preset = NULL,
+                         int numThreads = 0);
+
+/* Function: readLZWBlockIndex
+ * Usage: Vector<LZWBlockInfo> blocks = readLZWBlockIndex(infile);
+ * --------------------------------------------------------
+ * Reads the block index of a file written by lzwCompressBlocks.
+ * Reports an error if the file is not in that format.
+ */
+Vector<LZWBlockInfo> readLZWBlockIndex(istream& infile);
+
+/* Function: lzwDecompressBlock
+ * Usage: string data = lzwDecompressBlock(infile, blocks[i], preset);
+ * --------------------------------------------------------
+ * Decompresses a single block, given its entry in the block index,
+ * without touching any of the others.
+ */
+std::string lzwDecompressBlock(istream& infile, const LZWBlockInfo& block,
+                               const LZWPreset* preset = NULL);
+
+#endif
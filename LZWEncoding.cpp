@@ -0,0 +1,802 @@
+/**********************************************************
+ * File: LZWEncoding.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the bounded-memory LZW encoder and decoder
+ * from LZWEncoding.h.
+ *
+ * Stream format:
+ *   - 8 bits holding maxCodeBits.
+ *   - 8 bits of flags: LZW_FLAG_HUFFMAN and LZW_FLAG_PRESET.
+ *   - With LZW_FLAG_PRESET set, 32 bits holding the ID of the preset the
+ *     dictionary was seeded with.  The preset's entries take the codes
+ *     right after the STOP code, and are restored on every CLEAR.
+ *   - A sequence of codes, each written most significant bit first.
+ *     Codes start out 9 bits wide and grow by one bit whenever the
+ *     largest code the decoder could see next no longer fits, up to
+ *     maxCodeBits.  A CLEAR code resets both the dictionary and the
+ *     width; the STOP code ends the stream.
+ *
+ * With LZW_FLAG_HUFFMAN set, the codes are instead grouped into blocks
+ * of up to LZW_HUFFMAN_BLOCK_CODES codes, each written as:
+ *   - 16 bits holding the number of codes in the block.
+ *   - 17 bits holding the number of distinct symbols in the block (see
+ *     GROUP_LOW_BITS for how codes map to symbols), then for each symbol
+ *     in increasing order, its distance from the previous one (Elias
+ *     gamma coded, starting from -1) and the length of its Huffman prefix
+ *     in 5 bits.
+ *   - For each code, the prefix of its symbol in the canonical Huffman
+ *     code with those lengths, followed by GROUP_LOW_BITS plain bits for
+ *     codes of dictionary entries.
+ *
+ * Preset file format:
+ *   - 16 bits holding the number of entries.
+ *   - For each entry, 16 bits holding its prefix code and 8 bits
+ *     holding its last byte.
+ *
+ * The decoder adds its dictionary entries one code later than the
+ * encoder does (it needs the first byte of the following entry), so
+ * the encoder sizes each code by nextCode - 1 and the decoder sizes
+ * each code by its own nextCode; the two values always agree.
+ */
+
+#include "LZWEncoding.h"
+#include "HuffmanEncoding.h"
+#include "error.h"
+
+/* Constants: BLOCK_COUNT_BITS, TABLE_SIZE_BITS, PREFIX_LENGTH_BITS
+ * Field widths of the header of a Huffman coded block.
+ */
+static const int BLOCK_COUNT_BITS = 16;
+static const int TABLE_SIZE_BITS = 17;
+static const int PREFIX_LENGTH_BITS = 5;
+
+/* Constant: GROUP_LOW_BITS
+ * When codes are Huffman coded, the single-byte and control codes each
+ *   get a symbol of their own, but dictionary entries are grouped: each
+ *   run of 2^GROUP_LOW_BITS consecutive codes shares a symbol, and the
+ *   position within the run follows the symbol's prefix as GROUP_LOW_BITS
+ *   plain bits.  Most entries are used only a handful of times per block,
+ *   so a symbol per entry would make the code table cost more than the
+ *   Huffman code saves.
+ */
+static const int GROUP_LOW_BITS = 8;
+
+/* Function: symbolForCode
+ * Usage: ext_char symbol = symbolForCode(code);
+ * --------------------------------------------------------
+ * Returns the Huffman symbol standing for the given code, as described
+ *   under GROUP_LOW_BITS.
+ */
+static ext_char symbolForCode(int code) {
+    if (code < LZW_FIRST_FREE_CODE) return code;
+    return LZW_FIRST_FREE_CODE + ((code - LZW_FIRST_FREE_CODE) >> GROUP_LOW_BITS);
+}
+
+/* Constructor: LZWOptions
+ * --------------------------------------------------------
+ * Defaults to the largest dictionary, which is cleared once the
+ * compression ratio starts to drop.
+ */
+LZWOptions::LZWOptions() {
+    maxCodeBits = LZW_LARGEST_MAX_CODE_BITS;
+    resetPolicy = LZW_RESET_ON_RATIO_DROP;
+    huffmanCodes = false;
+    preset = NULL;
+}
+
+/* Function: bitsForCode
+ * Usage: int bits = bitsForCode(largestCode, maxCodeBits);
+ * --------------------------------------------------------
+ * Returns the number of bits needed to write any code up to and
+ *   including largestCode, but never fewer than LZW_MIN_CODE_BITS
+ *   or more than maxCodeBits.
+ */
+static int bitsForCode(int largestCode, int maxCodeBits) {
+    int bits = LZW_MIN_CODE_BITS;
+    while (bits < maxCodeBits && (1 << bits) <= largestCode) {
+        bits++;
+    }
+    return bits;
+}
+
+/* Function: checkMaxCodeBits
+ * Usage: checkMaxCodeBits(maxCodeBits);
+ * --------------------------------------------------------
+ * Reports an error if maxCodeBits is outside the supported range.
+ */
+static void checkMaxCodeBits(int maxCodeBits) {
+    if (maxCodeBits < LZW_SMALLEST_MAX_CODE_BITS ||
+        maxCodeBits > LZW_LARGEST_MAX_CODE_BITS) {
+        error("LZW maximum code width must be between 12 and 16 bits.");
+    }
+}
+
+/* Function: checkPreset
+ * Usage: checkPreset(preset, maxCodes);
+ * --------------------------------------------------------
+ * Reports an error unless every entry of the preset is built on a
+ *   single byte or an earlier entry, and the preset leaves room for
+ *   new entries in a dictionary of maxCodes codes.
+ */
+static void checkPreset(const LZWPreset& preset, int maxCodes) {
+    int numEntries = preset.prefixes.size();
+    if (preset.suffixes.size() != numEntries) {
+        error("LZW preset has a different number of prefixes and suffixes.");
+    }
+    if (LZW_FIRST_FREE_CODE + numEntries >= maxCodes) {
+        error("LZW preset is too large for the dictionary.");
+    }
+    for (int i = 0; i < numEntries; i++) {
+        int prefix = preset.prefixes[i];
+        if (prefix < 0 || (prefix > 255 && prefix < LZW_FIRST_FREE_CODE) ||
+            prefix >= LZW_FIRST_FREE_CODE + i) {
+            error("LZW preset contains an invalid entry.");
+        }
+    }
+}
+
+/* Function: presetID
+ * Usage: unsigned long id = presetID(preset);
+ * --------------------------------------------------------
+ * Computes the ID of a preset as the 32-bit FNV-1a hash of its entries,
+ *   so that presets with the same phrases always have the same ID.  Zero
+ *   is never used.
+ */
+static unsigned long presetID(const LZWPreset& preset) {
+    unsigned long hash = 2166136261UL;
+    for (int i = 0; i < preset.prefixes.size(); i++) {
+        int bytes[3] = { preset.prefixes[i] >> 8, preset.prefixes[i] & 0xFF, preset.suffixes[i] };
+        for (int j = 0; j < 3; j++) {
+            hash = ((hash ^ bytes[j]) * 16777619UL) & 0xFFFFFFFFUL;
+        }
+    }
+    return (hash == 0) ? 1 : hash;
+}
+
+/* Function: writeCode
+ * Usage: writeCode(outfile, code, numBits);
+ * --------------------------------------------------------
+ * Writes the low numBits bits of code to the output file, most
+ * significant bit first, using the bit-level API of obstream.
+ */
+void writeCode(obstream& outfile, unsigned long code, int numBits) {
+    for (int bit = numBits - 1; bit >= 0; bit--) {
+        outfile.writeBit((code >> bit) & 1);
+    }
+}
+
+/* Function: readCode
+ * Usage: unsigned long code = readCode(infile, numBits);
+ * --------------------------------------------------------
+ * Reads a numBits-wide code, most significant bit first, from the
+ * input file.  Reports an error if the file ends in the middle of
+ * the code.
+ */
+unsigned long readCode(ibstream& infile, int numBits) {
+    unsigned long code = 0;
+    for (int i = 0; i < numBits; i++) {
+        int bit = infile.readBit();
+        if (bit == EOF) error("Compressed LZW file ended in the middle of a code.");
+        code = (code << 1) | bit;
+    }
+    return code;
+}
+
+/* Function: writeGamma
+ * Usage: writeGamma(outfile, value);
+ * --------------------------------------------------------
+ * Writes a positive value as an Elias gamma code: one zero bit for
+ *   every bit after the leading one, then the value itself.  Small
+ *   values, which are by far the most common, take only a few bits.
+ */
+static void writeGamma(obstream& outfile, unsigned long value) {
+    int numBits = 1;
+    while ((value >> numBits) != 0) numBits++;
+    writeCode(outfile, 0, numBits - 1);
+    writeCode(outfile, value, numBits);
+}
+
+/* Function: readGamma
+ * Usage: unsigned long value = readGamma(infile);
+ * --------------------------------------------------------
+ * Reads a value written by writeGamma.
+ */
+static unsigned long readGamma(ibstream& infile) {
+    int numZeros = 0;
+    while (readCode(infile, 1) == 0) {
+        if (++numZeros > 31) error("Compressed LZW file contains an invalid code table.");
+    }
+    return (1UL << numZeros) | readCode(infile, numZeros);
+}
+
+/* Function: trainLZWPreset
+ * Usage: LZWPreset preset = trainLZWPreset(sample, maxEntries);
+ * --------------------------------------------------------
+ * Runs LZW over the sample without ever clearing the dictionary, while
+ * counting how many times each code is written.  The most used entries
+ * are kept together with the entries they are built on, and renumbered
+ * in their original order so that every prefix still comes first.
+ */
+LZWPreset trainLZWPreset(const std::string& sample, int maxEntries) {
+    int maxCodes = 1 << LZW_LARGEST_MAX_CODE_BITS;
+    if (maxEntries < 0 || LZW_FIRST_FREE_CODE + maxEntries >= maxCodes) {
+        error("LZW preset size is out of range.");
+    }
+
+    Map<int, int> dictionary;
+    std::vector<int> entryPrefixes, uses(maxCodes);
+    std::vector<unsigned char> entrySuffixes;
+    int nextCode = LZW_FIRST_FREE_CODE;
+    int prefix = -1;
+    for (int i = 0; i < sample.length(); i++) {
+        int ch = (unsigned char)sample[i];
+        if (prefix == -1) {
+            prefix = ch;
+            continue;
+        }
+        int key = (prefix << 8) | ch;
+        if (dictionary.containsKey(key)) {
+            prefix = dictionary.get(key);
+            continue;
+        }
+        uses[prefix]++;
+        if (nextCode < maxCodes) {
+            dictionary.put(key, nextCode++);
+            entryPrefixes.push_back(prefix);
+            entrySuffixes.push_back((unsigned char)ch);
+        }
+        prefix = ch;
+    }
+    if (prefix != -1) uses[prefix]++;
+
+    // the priority queue hands back the lowest priority first, so the
+    //   most used entries are queued with the most negative priority
+    PriorityQueue<int> ranked;
+    for (int code = LZW_FIRST_FREE_CODE; code < nextCode; code++) {
+        if (uses[code] > 0) ranked.enqueue(code, -uses[code]);
+    }
+    std::vector<bool> keep(nextCode, false);
+    int numKept = 0;
+    while (!ranked.isEmpty() && numKept < maxEntries) {
+        int code = ranked.dequeue();
+        int needed = 0;
+        for (int c = code; c >= LZW_FIRST_FREE_CODE && !keep[c];
+             c = entryPrefixes[c - LZW_FIRST_FREE_CODE]) {
+            needed++;
+        }
+        if (numKept + needed > maxEntries) continue;
+        for (int c = code; c >= LZW_FIRST_FREE_CODE && !keep[c];
+             c = entryPrefixes[c - LZW_FIRST_FREE_CODE]) {
+            keep[c] = true;
+        }
+        numKept += needed;
+    }
+
+    LZWPreset preset;
+    std::vector<int> newCodes(nextCode);
+    for (int code = 0; code < 256; code++) {
+        newCodes[code] = code;
+    }
+    for (int code = LZW_FIRST_FREE_CODE; code < nextCode; code++) {
+        if (!keep[code]) continue;
+        newCodes[code] = LZW_FIRST_FREE_CODE + preset.prefixes.size();
+        preset.prefixes.push_back(newCodes[entryPrefixes[code - LZW_FIRST_FREE_CODE]]);
+        preset.suffixes.push_back(entrySuffixes[code - LZW_FIRST_FREE_CODE]);
+    }
+    preset.id = presetID(preset);
+    return preset;
+}
+
+/* Function: writeLZWPreset
+ * Usage: writeLZWPreset(outfile, preset);
+ * --------------------------------------------------------
+ * Writes the entries in the preset file format described at the top
+ * of this file.
+ */
+void writeLZWPreset(obstream& outfile, const LZWPreset& preset) {
+    checkPreset(preset, 1 << LZW_LARGEST_MAX_CODE_BITS);
+    writeCode(outfile, preset.prefixes.size(), LZW_LARGEST_MAX_CODE_BITS);
+    for (int i = 0; i < preset.prefixes.size(); i++) {
+        writeCode(outfile, preset.prefixes[i], LZW_LARGEST_MAX_CODE_BITS);
+        writeCode(outfile, preset.suffixes[i], 8);
+    }
+}
+
+/* Function: readLZWPreset
+ * Usage: LZWPreset preset = readLZWPreset(infile);
+ * --------------------------------------------------------
+ * Reads the entries back and recomputes the ID from them.
+ */
+LZWPreset readLZWPreset(ibstream& infile) {
+    LZWPreset preset;
+    int numEntries = int(readCode(infile, LZW_LARGEST_MAX_CODE_BITS));
+    for (int i = 0; i < numEntries; i++) {
+        preset.prefixes.push_back(int(readCode(infile, LZW_LARGEST_MAX_CODE_BITS)));
+        preset.suffixes.push_back((unsigned char)readCode(infile, 8));
+    }
+    checkPreset(preset, 1 << LZW_LARGEST_MAX_CODE_BITS);
+    preset.id = presetID(preset);
+    return preset;
+}
+
+/* Constructor: LZWEncoder
+ * --------------------------------------------------------
+ * The hash table has twice as many slots as the dictionary has
+ * entries so that it is never more than half full and probe
+ * sequences stay short.
+ */
+LZWEncoder::LZWEncoder(obstream& outfile, const LZWOptions& options)
+    : outfile(outfile), options(options) {
+    checkMaxCodeBits(options.maxCodeBits);
+    maxCodes = 1 << options.maxCodeBits;
+
+    int tableBits = options.maxCodeBits + 1;
+    keys.resize(1 << tableBits);
+    codes.resize(1 << tableBits);
+    hashShift = 32 - tableBits;
+
+    firstCode = LZW_FIRST_FREE_CODE;
+    if (options.preset != NULL) {
+        checkPreset(*options.preset, maxCodes);
+        firstCode += options.preset->prefixes.size();
+    }
+
+    prefix = -1;
+    bytesIn = 0;
+    bitsOut = 0;
+
+    int flags = 0;
+    if (options.huffmanCodes) flags |= LZW_FLAG_HUFFMAN;
+    if (options.preset != NULL) flags |= LZW_FLAG_PRESET;
+    writeCode(outfile, options.maxCodeBits, LZW_WIDTH_BITS);
+    writeCode(outfile, flags, LZW_FLAG_BITS);
+    if (options.preset != NULL) {
+        writeCode(outfile, options.preset->id, LZW_PRESET_ID_BITS);
+    }
+    clearDictionary();
+}
+
+/* Member function: findSlot
+ * --------------------------------------------------------
+ * Returns the slot in the hash table that either holds key or is
+ * the empty slot where key belongs.
+ */
+int LZWEncoder::findSlot(int key) {
+    int mask = keys.size() - 1;
+    int slot = int((unsigned int)(key) * 2654435761u >> hashShift);
+    while (keys[slot] != 0 && keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* Member function: emit
+ * --------------------------------------------------------
+ * Writes a single code using the width the decoder will expect, or
+ * adds it to the current block when codes are Huffman coded.
+ */
+void LZWEncoder::emit(int code) {
+    int bits = bitsForCode(nextCode - 1, options.maxCodeBits);
+    bitsOut += bits;
+    if (!options.huffmanCodes) {
+        writeCode(outfile, code, bits);
+        return;
+    }
+
+    blockCodes.push_back(code);
+    if (blockCodes.size() == LZW_HUFFMAN_BLOCK_CODES) writeBlock();
+}
+
+/* Member function: writeBlock
+ * --------------------------------------------------------
+ * Counts how often each symbol appears in the block, builds a Huffman
+ * tree from those counts with buildEncodingTree, and writes the block
+ * using the canonical code with the same prefix lengths, so that only
+ * the lengths have to be stored.
+ */
+void LZWEncoder::writeBlock() {
+    Map<ext_char, int> frequencies;
+    for (int i = 0; i < blockCodes.size(); i++) {
+        frequencies[symbolForCode(blockCodes[i])]++;
+    }
+
+    Node* encodingTree = buildEncodingTree(frequencies);
+    Map<ext_char, int> lengths;
+    encTreeToCodeLengths(encodingTree, lengths, 0);
+    freeTree(encodingTree);
+
+    // a tree with a single leaf gives it an empty prefix; give it one bit
+    //   so that every symbol still takes up room in the file
+    if (lengths.size() == 1) {
+        foreach (ext_char symbol in frequencies) {
+            lengths.put(symbol, 1);
+        }
+    }
+
+    writeCode(outfile, blockCodes.size(), BLOCK_COUNT_BITS);
+    writeCode(outfile, lengths.size(), TABLE_SIZE_BITS);
+    int prevSymbol = -1;
+    foreach (ext_char symbol in lengths) {
+        writeGamma(outfile, symbol - prevSymbol);
+        writeCode(outfile, lengths.get(symbol), PREFIX_LENGTH_BITS);
+        prevSymbol = symbol;
+    }
+
+    Node* canonicalTree = buildCanonicalTree(lengths);
+    Map<ext_char, string> prefixes;
+    encTreeToBinaryPrefixes(canonicalTree, prefixes, "");
+    freeTree(canonicalTree);
+    for (int i = 0; i < blockCodes.size(); i++) {
+        int code = blockCodes[i];
+        writeEncodingPrefix(prefixes.get(symbolForCode(code)), outfile);
+        if (code >= LZW_FIRST_FREE_CODE) {
+            writeCode(outfile, code - LZW_FIRST_FREE_CODE, GROUP_LOW_BITS);
+        }
+    }
+    blockCodes.clear();
+}
+
+/* Member function: clearDictionary
+ * --------------------------------------------------------
+ * Forgets every multi-byte entry and puts back the preset entries,
+ * if any.  The single-byte entries are implicit and never stored in
+ * the hash table.
+ */
+void LZWEncoder::clearDictionary() {
+    for (int i = 0; i < keys.size(); i++) {
+        keys[i] = 0;
+    }
+    nextCode = LZW_FIRST_FREE_CODE;
+    if (options.preset == NULL) return;
+
+    for (int i = 0; i < options.preset->prefixes.size(); i++) {
+        int key = ((options.preset->prefixes[i] << 8) | options.preset->suffixes[i]) + 1;
+        int slot = findSlot(key);
+        keys[slot] = key;
+        codes[slot] = nextCode++;
+    }
+}
+
+/* Member function: checkRatio
+ * --------------------------------------------------------
+ * Called after each code once the dictionary is full.  Every
+ * LZW_RATIO_CHECK_BYTES of input, compares the ratio achieved since
+ * the dictionary filled up against the best ratio seen so far, and
+ * clears the dictionary as soon as it has gotten worse.
+ */
+void LZWEncoder::checkRatio() {
+    if (bytesIn < nextRatioCheck) return;
+    nextRatioCheck = bytesIn + LZW_RATIO_CHECK_BYTES;
+
+    double ratio = double(bytesIn - fullBytesIn) / (bitsOut - fullBitsOut);
+    if (ratio >= bestRatio) {
+        bestRatio = ratio;
+    } else {
+        emit(LZW_CLEAR_CODE);
+        clearDictionary();
+    }
+}
+
+/* Member function: encode
+ * --------------------------------------------------------
+ * Extends the current match one byte at a time.  When the match can
+ * no longer be extended, writes its code and, if there is room, adds
+ * the extended string to the dictionary.
+ */
+void LZWEncoder::encode(const char* data, long length) {
+    for (long i = 0; i < length; i++) {
+        int ch = (unsigned char)data[i];
+        bytesIn++;
+
+        if (prefix == -1) {
+            prefix = ch;
+            continue;
+        }
+
+        // keys are offset by one so that zero can mark an empty slot
+        int key = ((prefix << 8) | ch) + 1;
+        int slot = findSlot(key);
+        if (keys[slot] == key) {
+            prefix = codes[slot];
+            continue;
+        }
+
+        emit(prefix);
+        if (nextCode < maxCodes) {
+            keys[slot] = key;
+            codes[slot] = nextCode++;
+
+            if (nextCode == maxCodes) {
+                if (options.resetPolicy == LZW_RESET_WHEN_FULL) {
+                    emit(LZW_CLEAR_CODE);
+                    clearDictionary();
+                } else {
+                    // start measuring the ratio of the full dictionary
+                    fullBytesIn = bytesIn;
+                    fullBitsOut = bitsOut;
+                    nextRatioCheck = bytesIn + LZW_RATIO_CHECK_BYTES;
+                    bestRatio = 0;
+                }
+            }
+        } else if (options.resetPolicy == LZW_RESET_ON_RATIO_DROP) {
+            checkRatio();
+        }
+        prefix = ch;
+    }
+}
+
+/* Member function: finish
+ * --------------------------------------------------------
+ * The decoder adds a dictionary entry after reading the last data
+ * code even though the encoder never does, so account for that entry
+ * before sizing the STOP code.
+ */
+void LZWEncoder::finish() {
+    if (prefix != -1) {
+        emit(prefix);
+        if (nextCode < maxCodes) nextCode++;
+        prefix = -1;
+    }
+    emit(LZW_STOP_CODE);
+    if (!blockCodes.empty()) writeBlock();
+}
+
+/* Function: lzwCompress
+ * Usage: lzwCompress(data, outfile, options);
+ * --------------------------------------------------------
+ * Compresses an in-memory buffer in a single call to the encoder.
+ */
+void lzwCompress(const std::string& data, obstream& outfile,
+                 const LZWOptions& options) {
+    LZWEncoder encoder(outfile, options);
+    encoder.encode(data.data(), data.length());
+    encoder.finish();
+}
+
+/* Function: lzwCompress
+ * Usage: string compressed = lzwCompress(data, options);
+ * --------------------------------------------------------
+ * Compresses an in-memory buffer into another in-memory buffer.
+ */
+std::string lzwCompress(const std::string& data, const LZWOptions& options) {
+    ostringbstream outfile;
+    lzwCompress(data, outfile, options);
+    return outfile.str();
+}
+
+/* Function: lzwCompress
+ * Usage: lzwCompress(infile, outfile, options);
+ * --------------------------------------------------------
+ * Reads the input LZW_CHUNK_SIZE bytes at a time with read(), so no
+ * more than one chunk of it is ever held in memory and bytes such as
+ * '\r' and '\n' pass through untouched.
+ */
+void lzwCompress(istream& infile, obstream& outfile, const LZWOptions& options) {
+    LZWEncoder encoder(outfile, options);
+    std::vector<char> chunk(LZW_CHUNK_SIZE);
+    while (infile) {
+        infile.read(&chunk[0], chunk.size());
+        encoder.encode(&chunk[0], infile.gcount());
+    }
+    encoder.finish();
+}
+
+/* Constructor: LZWDecoder
+ * --------------------------------------------------------
+ * The dictionary is stored as three parallel arrays: for each code,
+ * the code of everything but its last byte, its last byte and its
+ * length.  The single-byte and preset entries never change, so they
+ * are filled in once here.
+ */
+LZWDecoder::LZWDecoder(ibstream& infile, const LZWPreset* preset) : infile(infile) {
+    maxCodeBits = int(readCode(infile, LZW_WIDTH_BITS));
+    checkMaxCodeBits(maxCodeBits);
+    maxCodes = 1 << maxCodeBits;
+
+    int flags = int(readCode(infile, LZW_FLAG_BITS));
+    if ((flags & ~(LZW_FLAG_HUFFMAN | LZW_FLAG_PRESET)) != 0) {
+        error("Compressed LZW file has unknown flags set.");
+    }
+    if ((flags & LZW_FLAG_PRESET) != 0) {
+        unsigned long id = readCode(infile, LZW_PRESET_ID_BITS);
+        if (preset == NULL) error("Compressed LZW file needs a preset dictionary.");
+        if (preset->id != id) error("Compressed LZW file was written with a different preset dictionary.");
+        checkPreset(*preset, maxCodes);
+    } else {
+        preset = NULL;
+    }
+    huffmanCodes = (flags & LZW_FLAG_HUFFMAN) != 0;
+    blockTree = NULL;
+    blockCodesLeft = 0;
+
+    prefixes.resize(maxCodes);
+    suffixes.resize(maxCodes);
+    lengths.resize(maxCodes);
+    for (int i = 0; i < 256; i++) {
+        prefixes[i] = -1;
+        suffixes[i] = (unsigned char)i;
+        lengths[i] = 1;
+    }
+    firstCode = LZW_FIRST_FREE_CODE;
+    if (preset != NULL) {
+        for (int i = 0; i < preset->prefixes.size(); i++, firstCode++) {
+            prefixes[firstCode] = preset->prefixes[i];
+            suffixes[firstCode] = preset->suffixes[i];
+            lengths[firstCode] = lengths[preset->prefixes[i]] + 1;
+        }
+    }
+    entry.resize(maxCodes);
+    entryPos = 0;
+    entryLength = 0;
+
+    nextCode = firstCode;
+    prevCode = -1;
+    finished = false;
+}
+
+/* Destructor: ~LZWDecoder
+ * --------------------------------------------------------
+ * Frees the tree of the last Huffman block read.
+ */
+LZWDecoder::~LZWDecoder() {
+    freeTree(blockTree);
+}
+
+/* Member function: readBlock
+ * --------------------------------------------------------
+ * Reads the header of the next Huffman coded block and rebuilds the
+ * canonical code tree from the stored prefix lengths.
+ */
+void LZWDecoder::readBlock() {
+    freeTree(blockTree);
+    blockTree = NULL;
+
+    blockCodesLeft = long(readCode(infile, BLOCK_COUNT_BITS));
+    long tableSize = long(readCode(infile, TABLE_SIZE_BITS));
+    if (blockCodesLeft == 0 || tableSize == 0 || tableSize > maxCodes) {
+        error("Compressed LZW file contains an invalid code table.");
+    }
+
+    Map<ext_char, int> lengths;
+    long code = -1;
+    for (long i = 0; i < tableSize; i++) {
+        code += readGamma(infile);
+        if (code > symbolForCode(maxCodes - 1)) error("Compressed LZW file contains an invalid code table.");
+        lengths.put(int(code), int(readCode(infile, PREFIX_LENGTH_BITS)));
+    }
+
+    blockTree = buildCanonicalTree(lengths);
+    if (blockTree == NULL) error("Compressed LZW file contains an invalid code table.");
+}
+
+/* Member function: readNextCode
+ * --------------------------------------------------------
+ * Reads the next code, either at the given width or, when codes are
+ * Huffman coded, by decoding it with the current block's tree.
+ */
+int LZWDecoder::readNextCode(int numBits) {
+    if (!huffmanCodes) return int(readCode(infile, numBits));
+
+    if (blockCodesLeft == 0) readBlock();
+    blockCodesLeft--;
+    int code = readEncodedSymbol(infile, blockTree);
+    if (code == EOF) error("Compressed LZW file contains an invalid code.");
+    if (code >= LZW_FIRST_FREE_CODE) {
+        code = LZW_FIRST_FREE_CODE + ((code - LZW_FIRST_FREE_CODE) << GROUP_LOW_BITS)
+            + int(readCode(infile, GROUP_LOW_BITS));
+    }
+    return code;
+}
+
+/* Member function: readEntry
+ * --------------------------------------------------------
+ * Reads codes until one of them stands for data, expands that data
+ * back to front into the entry buffer and returns true.  Returns
+ * false once the STOP code has been read.
+ */
+bool LZWDecoder::readEntry() {
+    while (true) {
+        // right after a reset only single bytes, preset entries and control
+        //   codes can appear
+        int largestCode = (prevCode == -1) ? firstCode - 1 : nextCode;
+        int code = readNextCode(bitsForCode(largestCode, maxCodeBits));
+
+        if (code == LZW_STOP_CODE) return false;
+        if (code == LZW_CLEAR_CODE) {
+            nextCode = firstCode;
+            prevCode = -1;
+            continue;
+        }
+
+        if (prevCode == -1) {
+            if (code >= firstCode) error("Compressed LZW file contains an invalid code.");
+            entryLength = lengths[code];
+            for (int i = entryLength - 1, c = code; i >= 0; i--, c = prefixes[c]) {
+                entry[i] = suffixes[c];
+            }
+            prevCode = code;
+            return true;
+        }
+
+        // the one code not yet in the dictionary is the previous entry
+        //   followed by its own first byte
+        if (code < nextCode) {
+            entryLength = lengths[code];
+            for (int i = entryLength - 1, c = code; i >= 0; i--, c = prefixes[c]) {
+                entry[i] = suffixes[c];
+            }
+        } else if (code == nextCode && nextCode < maxCodes) {
+            entryLength = lengths[prevCode] + 1;
+            for (int i = entryLength - 2, c = prevCode; i >= 0; i--, c = prefixes[c]) {
+                entry[i] = suffixes[c];
+            }
+            entry[entryLength - 1] = entry[0];
+        } else {
+            error("Compressed LZW file contains an invalid code.");
+        }
+
+        if (nextCode < maxCodes) {
+            prefixes[nextCode] = prevCode;
+            suffixes[nextCode] = entry[0];
+            lengths[nextCode] = lengths[prevCode] + 1;
+            nextCode++;
+        }
+        prevCode = code;
+        return true;
+    }
+}
+
+/* Member function: decode
+ * --------------------------------------------------------
+ * Copies out whatever is left of the last entry, then keeps reading
+ * entries until the buffer is full.  An entry that does not fit is
+ * finished off by the next call.
+ */
+long LZWDecoder::decode(char* buffer, long capacity) {
+    long filled = 0;
+    while (filled < capacity) {
+        if (entryPos == entryLength) {
+            if (finished || !readEntry()) {
+                finished = true;
+                break;
+            }
+            entryPos = 0;
+        }
+        long toCopy = entryLength - entryPos;
+        if (toCopy > capacity - filled) toCopy = capacity - filled;
+        for (long i = 0; i < toCopy; i++) {
+            buffer[filled++] = entry[entryPos++];
+        }
+    }
+    return filled;
+}
+
+/* Function: lzwDecompress
+ * Usage: lzwDecompress(infile, outfile, preset);
+ * --------------------------------------------------------
+ * Decompresses LZW_CHUNK_SIZE bytes at a time and writes each chunk
+ * out as soon as it is full.
+ */
+void lzwDecompress(ibstream& infile, ostream& outfile, const LZWPreset* preset) {
+    LZWDecoder decoder(infile, preset);
+    std::vector<char> chunk(LZW_CHUNK_SIZE);
+    long length;
+    while ((length = decoder.decode(&chunk[0], chunk.size())) > 0) {
+        outfile.write(&chunk[0], length);
+    }
+}
+
+/* Function: lzwDecompress
+ * Usage: string original = lzwDecompress(compressed, preset);
+ * --------------------------------------------------------
+ * Decompresses an in-memory buffer into another in-memory buffer.
+ */
+std::string lzwDecompress(const std::string& compressed, const LZWPreset* preset) {
+    istringbstream infile(compressed);
+    ostringstream outfile;
+    lzwDecompress(infile, outfile, preset);
+    return outfile.str();
+}
@@ -0,0 +1,388 @@
+/*******************************************************
+ * File: LZWEncoding.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A bounded-memory implementation of the Lempel-Ziv-Welch (LZW)
+ * compression scheme.
+ *
+ * Unlike the dictionary in LZWLibrary.h, which grows without bound,
+ * the dictionary here never holds more than 2^maxCodeBits entries.
+ * Once it fills up, the encoder writes an explicit CLEAR code and
+ * both sides start over with a fresh dictionary, so arbitrarily
+ * large inputs can be compressed in a fixed amount of memory.
+ *
+ * Optionally, the codes themselves can be Huffman coded block by block
+ * instead of being written at a fixed width (see LZWOptions::huffmanCodes),
+ * and the dictionary can start out holding phrases from a preset trained
+ * on typical input (see LZWPreset), which lets small inputs compress well.
+ */
+
+#ifndef LZWEncoding_Included
+#define LZWEncoding_Included
+
+#include "bstream.h"
+#include "HuffmanTypes.h"
+#include <string>
+#include <vector>
+
+/* Constant: LZW_CLEAR_CODE
+ * The code written to tell the decoder to throw its dictionary away.
+ */
+const int LZW_CLEAR_CODE = 256;
+
+/* Constant: LZW_STOP_CODE
+ * The code written after the last data code of a compressed stream.
+ */
+const int LZW_STOP_CODE = 257;
+
+/* Constant: LZW_FIRST_FREE_CODE
+ * The first code available for multi-byte dictionary entries.
+ */
+const int LZW_FIRST_FREE_CODE = 258;
+
+/* Constant: LZW_MIN_CODE_BITS
+ * The width, in bits, of the first codes written after the dictionary
+ *   is cleared.  Nine bits is enough to hold any of the 256 single-byte
+ *   codes plus the CLEAR and STOP codes.
+ */
+const int LZW_MIN_CODE_BITS = 9;
+
+/* Constants: LZW_SMALLEST_MAX_CODE_BITS, LZW_LARGEST_MAX_CODE_BITS
+ * The range of allowed values for LZWOptions::maxCodeBits.
+ */
+const int LZW_SMALLEST_MAX_CODE_BITS = 12;
+const int LZW_LARGEST_MAX_CODE_BITS = 16;
+
+/* Constant: LZW_WIDTH_BITS
+ * The number of bits used to store the maximum code width in a file.
+ */
+const int LZW_WIDTH_BITS = 8;
+
+/* Constant: LZW_FLAG_BITS, LZW_FLAG_HUFFMAN
+ * The number of bits used to store the stream flags in a file, and the
+ *   flag marking a stream whose codes are Huffman coded.
+ */
+const int LZW_FLAG_BITS = 8;
+const int LZW_FLAG_HUFFMAN = 1;
+
+/* Constants: LZW_FLAG_PRESET, LZW_PRESET_ID_BITS
+ * The flag marking a stream whose dictionary was seeded from a preset,
+ *   and the number of bits used to store that preset's ID.
+ */
+const int LZW_FLAG_PRESET = 2;
+const int LZW_PRESET_ID_BITS = 32;
+
+/* Constant: LZW_DEFAULT_PRESET_ENTRIES
+ * The default number of phrases kept by trainLZWPreset.  This leaves
+ *   room for new entries even in the smallest (12-bit) dictionary.
+ */
+const int LZW_DEFAULT_PRESET_ENTRIES = 2048;
+
+/* Constant: LZW_HUFFMAN_BLOCK_CODES
+ * When codes are Huffman coded, the number of codes that share a single
+ *   code table.  Larger blocks spread the cost of the table over more
+ *   codes; smaller blocks follow changes in the input more closely.
+ */
+const int LZW_HUFFMAN_BLOCK_CODES = 32768;
+
+/* Constant: LZW_RATIO_CHECK_BYTES
+ * When the dictionary is full and the LZW_RESET_ON_RATIO_DROP policy is
+ *   in effect, the compression ratio is checked every time this many more
+ *   input bytes have been consumed.
+ */
+const long LZW_RATIO_CHECK_BYTES = 10000;
+
+/* Constant: LZW_CHUNK_SIZE
+ * The number of bytes read or written at a time when compressing from
+ *   or decompressing to a stream.
+ */
+const long LZW_CHUNK_SIZE = 64 * 1024;
+
+/* Type: LZWResetPolicy
+ * Decides when the encoder clears its dictionary.
+ *
+ *   LZW_RESET_WHEN_FULL     - clear as soon as the dictionary fills up.
+ *   LZW_RESET_ON_RATIO_DROP - keep using the full dictionary as long as
+ *                             the compression ratio holds up, and clear
+ *                             it once the ratio starts to degrade.
+ */
+enum LZWResetPolicy {
+    LZW_RESET_WHEN_FULL,
+    LZW_RESET_ON_RATIO_DROP
+};
+
+/* Type: LZWPreset
+ * Phrases used to seed the dictionary before any input is seen.  Entry i
+ *   receives code LZW_FIRST_FREE_CODE + i and stands for the phrase of
+ *   code prefixes[i] followed by the byte suffixes[i]; each prefix is a
+ *   single byte or an earlier entry.  The id identifies the preset in
+ *   compressed streams so that the decoder can tell whether it has been
+ *   handed the right one; it is derived from the entries themselves.
+ */
+struct LZWPreset {
+    std::vector<int> prefixes;
+    std::vector<unsigned char> suffixes;
+    unsigned long id;
+};
+
+/* Type: LZWOptions
+ * Settings that control the LZW encoder.  The decoder reads everything
+ *   it needs from the compressed stream itself.
+ */
+struct LZWOptions {
+    /* The widest code the encoder may write (12 to 16 bits).  This also
+     * fixes the size of the dictionary at 2^maxCodeBits entries.
+     */
+    int maxCodeBits;
+
+    /* When to clear the dictionary. */
+    LZWResetPolicy resetPolicy;
+
+    /* Whether to Huffman code the LZW codes block by block instead of
+     * writing each one at full width.  This pays off on binary data, where
+     * LZW finds few repeated strings and most of its output is single-byte
+     * codes with a very uneven distribution; on text, where dictionary
+     * codes are used about equally often, it makes little difference.
+     */
+    bool huffmanCodes;
+
+    /* Phrases to seed the dictionary with, both at the start and every
+     * time it is cleared, or NULL to start from single bytes only.  The
+     * same preset must be handed to the decoder.  The preset must leave
+     * room for new entries in a dictionary of 2^maxCodeBits codes.
+     */
+    const LZWPreset* preset;
+
+    /* Sets maxCodeBits to 16, resetPolicy to LZW_RESET_ON_RATIO_DROP,
+     * huffmanCodes to false and preset to NULL.
+     */
+    LZWOptions();
+};
+
+/* Function: writeCode
+ * Usage: writeCode(outfile, code, numBits);
+ * --------------------------------------------------------
+ * Writes the low numBits bits of code to the output file, most
+ * significant bit first, using the bit-level API of obstream.
+ */
+void writeCode(obstream& outfile, unsigned long code, int numBits);
+
+/* Function: readCode
+ * Usage: unsigned long code = readCode(infile, numBits);
+ * --------------------------------------------------------
+ * Reads a numBits-wide code, most significant bit first, from the
+ * input file.  Reports an error if the file ends in the middle of
+ * the code.
+ */
+unsigned long readCode(ibstream& infile, int numBits);
+
+/* Function: trainLZWPreset
+ * Usage: LZWPreset preset = trainLZWPreset(sample, maxEntries);
+ * --------------------------------------------------------
+ * Builds a preset from sample input that resembles the data to be
+ * compressed.  The sample is run through LZW with a large dictionary,
+ * and the phrases whose codes were written most often are kept, along
+ * with the shorter phrases they are built on, up to maxEntries in all.
+ */
+LZWPreset trainLZWPreset(const std::string& sample,
+                         int maxEntries = LZW_DEFAULT_PRESET_ENTRIES);
+
+/* Function: writeLZWPreset
+ * Usage: writeLZWPreset(outfile, preset);
+ * --------------------------------------------------------
+ * Saves a preset to a file so that it can be shared between the
+ * programs that compress and decompress with it.
+ */
+void writeLZWPreset(obstream& outfile, const LZWPreset& preset);
+
+/* Function: readLZWPreset
+ * Usage: LZWPreset preset = readLZWPreset(infile);
+ * --------------------------------------------------------
+ * Loads a preset saved by writeLZWPreset.  Reports an error if the file
+ * does not hold a valid preset.
+ */
+LZWPreset readLZWPreset(ibstream& infile);
+
+/* Class: LZWEncoder
+ * --------------------------------------------------------
+ * Compresses bytes with LZW and writes the resulting codes to an
+ * obstream.  Data may be handed to encode() in as many pieces as
+ * is convenient; call finish() once all of it has been supplied.
+ */
+class LZWEncoder {
+public:
+    /* Constructor: LZWEncoder
+     * Usage: LZWEncoder encoder(outfile, options);
+     * --------------------------------------------------------
+     * Writes the stream header to outfile and prepares an empty
+     * dictionary.
+     */
+    LZWEncoder(obstream& outfile, const LZWOptions& options);
+
+    /* Member function: encode
+     * Usage: encoder.encode(data, length);
+     * --------------------------------------------------------
+     * Compresses the next length bytes of the input.
+     */
+    void encode(const char* data, long length);
+
+    /* Member function: finish
+     * Usage: encoder.finish();
+     * --------------------------------------------------------
+     * Writes the code for any pending input followed by the STOP code.
+     */
+    void finish();
+
+private:
+    obstream& outfile;
+    LZWOptions options;
+
+    /* Open-addressed hash table mapping (prefix code, next byte) pairs
+     * to dictionary codes.  A key of 0 marks an empty slot.
+     */
+    std::vector<int> keys;
+    std::vector<int> codes;
+    int hashShift;
+
+    int prefix;       // code for the input matched so far, or -1
+    int nextCode;     // code the next dictionary entry will receive
+    int maxCodes;     // 2^maxCodeBits
+    int firstCode;    // first code after the preset entries
+
+    /* Bookkeeping for the LZW_RESET_ON_RATIO_DROP policy: totals so far,
+     * the totals at the moment the dictionary filled up, the point at
+     * which the ratio will next be checked and the best ratio seen since
+     * the dictionary filled up.  When codes are Huffman coded, bitsOut
+     * still counts each code at its fixed width, since the Huffman code
+     * for a block is not known until the block is complete.
+     */
+    long bytesIn, bitsOut;
+    long fullBytesIn, fullBitsOut;
+    long nextRatioCheck;
+    double bestRatio;
+
+    /* Codes waiting to be Huffman coded as part of the current block. */
+    std::vector<int> blockCodes;
+
+    int findSlot(int key);
+    void emit(int code);
+    void writeBlock();
+    void clearDictionary();
+    void checkRatio();
+};
+
+/* Class: LZWDecoder
+ * --------------------------------------------------------
+ * Reads a compressed stream written by LZWEncoder and hands back the
+ * original bytes a buffer at a time.  Each call picks up exactly where
+ * the previous one stopped, so the output can be consumed in chunks of
+ * any size.
+ */
+class LZWDecoder {
+public:
+    /* Constructor: LZWDecoder
+     * Usage: LZWDecoder decoder(infile);
+     *        LZWDecoder decoder(infile, &preset);
+     * --------------------------------------------------------
+     * Reads the stream header from infile.  A stream compressed with a
+     * preset can only be decoded with that same preset; an error is
+     * reported if it is missing or has a different ID.
+     */
+    LZWDecoder(ibstream& infile, const LZWPreset* preset = NULL);
+
+    /* Destructor: ~LZWDecoder
+     * --------------------------------------------------------
+     * Frees the code tree of the current Huffman block, if any.
+     */
+    ~LZWDecoder();
+
+    /* Member function: decode
+     * Usage: long length = decoder.decode(buffer, capacity);
+     * --------------------------------------------------------
+     * Fills buffer with up to capacity decompressed bytes and returns
+     * how many were written.  Returns 0 once the whole stream has been
+     * decoded.  Reports an error if the stream is malformed.
+     */
+    long decode(char* buffer, long capacity);
+
+private:
+    ibstream& infile;
+    int maxCodeBits;
+    int maxCodes;
+
+    /* For each code: the code of everything but its last byte, its last
+     * byte and its length.
+     */
+    std::vector<int> prefixes;
+    std::vector<unsigned char> suffixes;
+    std::vector<int> lengths;
+
+    /* The most recently decoded entry and how much of it has been
+     * handed out so far.
+     */
+    std::vector<char> entry;
+    int entryPos, entryLength;
+
+    int nextCode;     // code the next dictionary entry will receive
+    int firstCode;    // first code after the preset entries
+    int prevCode;     // previous data code, or -1 right after a reset
+    bool finished;    // whether the STOP code has been read
+
+    /* When codes are Huffman coded: the tree for the current block and
+     * the number of codes left in it.
+     */
+    bool huffmanCodes;
+    Node* blockTree;
+    long blockCodesLeft;
+
+    bool readEntry();
+    int readNextCode(int numBits);
+    void readBlock();
+
+    /* The decoder owns blockTree, so it must not be copied. */
+    LZWDecoder(const LZWDecoder&);
+    LZWDecoder& operator=(const LZWDecoder&);
+};
+
+/* Function: lzwCompress
+ * Usage: lzwCompress(infile, outfile, options);
+ *        lzwCompress(data, outfile, options);
+ *        string compressed = lzwCompress(data, options);
+ * --------------------------------------------------------
+ * Main entry point for the LZW compressor.  Compresses everything
+ * remaining in the given stream, or the given buffer, and writes the
+ * complete compressed stream (header, codes and STOP code) to outfile
+ * or returns it as a string.  The options may be left out to use the
+ * defaults.
+ *
+ * Streams are read in chunks of LZW_CHUNK_SIZE bytes, so the whole input
+ * is never held in memory; open files in binary mode so that every byte
+ * is preserved.  None of these functions touch the console, and invalid
+ * options are reported through error().
+ */
+void lzwCompress(istream& infile, obstream& outfile,
+                 const LZWOptions& options = LZWOptions());
+void lzwCompress(const std::string& data, obstream& outfile,
+                 const LZWOptions& options = LZWOptions());
+std::string lzwCompress(const std::string& data,
+                        const LZWOptions& options = LZWOptions());
+
+/* Function: lzwDecompress
+ * Usage: lzwDecompress(infile, outfile);
+ *        string original = lzwDecompress(compressed, &preset);
+ * --------------------------------------------------------
+ * Main entry point for the LZW decompressor.  Decompresses a stream
+ * written by lzwCompress, writing the original bytes to outfile in
+ * chunks of LZW_CHUNK_SIZE bytes or returning them as a string.  If
+ * the stream was compressed with a preset, the same preset must be
+ * passed in.  Reports an error through error() if the stream is
+ * malformed.
+ */
+void lzwDecompress(ibstream& infile, ostream& outfile,
+                   const LZWPreset* preset = NULL);
+std::string lzwDecompress(const std::string& compressed,
+                          const LZWPreset* preset = NULL);
+
+#endif
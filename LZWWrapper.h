@@ -9,10 +9,10 @@
  *
  * The compression algorithm implemented here is not good for very small files
  *   such as the poem file in ./test/encodeDecode/poem;
- * This compression algorithm also will fail for very large files as it will
- *   overrun the maximum allowed size of integers. From more research,
- *   the code needs a reset dictionary function. I attempted to make
- *   this slightly better by changing to an unsigned long.
+ * The implementation in LZWLibrary.h will fail for very large files as it
+ *   overruns the maximum allowed size of integers, so the file commands below
+ *   use the bounded-memory encoder in LZWEncoding.h, which clears its
+ *   dictionary when it fills up.
  *
  * I also wrote a substantative extension in the form of a series of tests in
  *   HuffmanEncodingTest.cpp to test this algorithm.
@@ -39,33 +39,46 @@
 #include <vector>
 #include <map>
 #include "LZWLibrary.h"
+#include "LZWEncoding.h"
+#include "bstream.h"
+#include "error.h"
 
 using namespace std;
 
+/* Constant: LZW_DEFAULT_MAX_CODE_BITS
+ * The widest code that writeToFile will produce unless told otherwise.
+ */
+const int LZW_DEFAULT_MAX_CODE_BITS = 24;
+
+/* Constant: LZW_COUNT_BITS
+ * The number of bits used to store the number of codes in the file.
+ */
+const int LZW_COUNT_BITS = 32;
+
 /*
- * Function: readFileToString
+ * Function: readFileIntoCompressedVector
  * Usage: vector<unsigned long> compressed = readFileIntoCompressedVector(inputFile);
  * --------------------------------------------------------
- * Read a file from disk that consists of compressed data (in the form of
- *   a vector of integers) and return a vector of integers.
+ * Read a file from disk that consists of compressed data written by
+ *   writeToFile and return the vector of LZW codes it holds.
+ *
+ * The codes are stored with exactly the width that writeToFile used, which
+ *   we can recompute on the fly: the i-th code can be no larger than 255 + i,
+ *   since the compressor adds one dictionary entry for every code it emits.
  */
-vector<unsigned long> readFileIntoCompressedVector(ifstream& inputFile) {
+vector<unsigned long> readFileIntoCompressedVector(ibstream& inputFile) {
     vector<unsigned long> compressed;
-    string encodedLine;
-    while (getline(inputFile, encodedLine)) {
-        // the for loop is terribly inefficient; however, i cannot find a way
-        //   to eliminate the NULL characters that are being written to
-        //   disk, which is causing a lot of problems in reading and
-        //   especially in converting to C-string.
-        // hexdump outputTest.txt
-        //   37 37 0a 00 31 32 31 00
-        //   Notice the two instances of "00". We need to remove these.
-        string strInt = "";
-        for (int i = 0; i < encodedLine.size(); i++) {
-            if (int(encodedLine[i]) != 0) strInt += encodedLine[i];
+    int maxCodeBits = int(readCode(inputFile, LZW_WIDTH_BITS));
+    unsigned long numCodes = readCode(inputFile, LZW_COUNT_BITS);
+    
+    int codeBits = LZW_MIN_CODE_BITS;
+    for (unsigned long i = 0; i < numCodes; i++) {
+        // widen the code once the largest possible code no longer fits
+        if (255 + i >= (1UL << codeBits)) codeBits++;
+        if (codeBits > maxCodeBits) {
+            error("Compressed LZW file holds codes wider than its maximum.");
         }
-        int elem = atoi(strInt.c_str());
-        compressed.push_back(elem);
+        compressed.push_back(readCode(inputFile, codeBits));
     }
     return compressed;
 }
@@ -75,7 +88,9 @@ vector<unsigned long> readFileIntoCompressedVector(ifstream& inputFile) {
  * Usage: string rawInputContents = readFileToString(inputFile);
  * --------------------------------------------------------
  * Take a file and read in its contents one line at a time, building
- *   up a string representation of the file's contents.
+ *   up a string representation of the file's contents. Note that this drops
+ *   the final newline and does not preserve "\r\n" line endings, which is
+ *   why compressFileLZW streams the file in binary chunks instead.
  */
 string readFileToString(ifstream& file) {
     string fileContents;
@@ -108,16 +123,33 @@ string convertInt(int number) {
 
 /*
  * Function: writeToFile
- * Usage: writeToFile(ofstream& outFile, Vector<int>& content);
+ * Usage: writeToFile(outFile, content);
+ *        writeToFile(outFile, content, maxCodeBits);
  * --------------------------------------------------------
- * Take a vector of ints, which represent the compressed data, and
- *  write those integers to an output file.
+ * Take a vector of LZW codes, which represent the compressed data, and
+ *  pack them into the output file in binary.
+ *
+ * The file starts with the maximum code width (8 bits) and the number of
+ *  codes (32 bits). The codes follow back to back, starting at 9 bits wide
+ *  and growing by one bit each time the dictionary outgrows the current
+ *  width, up to maxCodeBits.
  */
-void writeToFile(ofstream& outFile, vector<unsigned long>& content) {
-    for (int i = 0; i < content.size(); i++) {
-        string toWrite = convertInt(content[i]);
-        if (i < content.size() - 1) toWrite += "\n";
-        outFile.write(toWrite.c_str(), sizeof(toWrite.c_str()));
+void writeToFile(obstream& outFile, vector<unsigned long>& content,
+                 int maxCodeBits = LZW_DEFAULT_MAX_CODE_BITS) {
+    if (maxCodeBits < LZW_MIN_CODE_BITS || maxCodeBits > LZW_COUNT_BITS) {
+        error("LZW maximum code width must be between 9 and 32 bits.");
+    }
+    writeCode(outFile, maxCodeBits, LZW_WIDTH_BITS);
+    writeCode(outFile, content.size(), LZW_COUNT_BITS);
+    
+    int codeBits = LZW_MIN_CODE_BITS;
+    for (unsigned long i = 0; i < content.size(); i++) {
+        // widen the code once the largest possible code no longer fits
+        if (255 + i >= (1UL << codeBits)) codeBits++;
+        if (codeBits > maxCodeBits) {
+            error("Input is too large for the maximum LZW code width.");
+        }
+        writeCode(outFile, content[i], codeBits);
     }
 }
 
@@ -126,12 +158,14 @@ void writeToFile(ofstream& outFile, vector<unsigned long>& content) {
  * Usage: compressFileLZW();
  * --------------------------------------------------------
  * Compress a file by using an iteration of the LZW algorithm.
- *   Prompt the user for a file to compress, read that file into a string,
- *   perform compression, and then write the compressed data to a file.
+ *   Prompt the user for a file to compress and a file to hold the result,
+ *   then stream the one through the LZW encoder into the other. The input
+ *   is read in fixed-size binary chunks and the dictionary is bounded (see
+ *   LZWEncoding.h), so memory use does not depend on the size of the file.
  */
 void compressFileLZW() {
     // Step 1: Prompt the user for the file to be compressed
-    ifstream inputFile;
+    ifbstream inputFile;
     while (true) {
 		string filename = getLine("Enter a file to compress with LZW: ");
 		inputFile.open(filename.c_str());
@@ -141,21 +175,10 @@ void compressFileLZW() {
 		cout << "Sorry, I couldn't open that file." << endl;
 		inputFile.clear();
 	}
-        
-    // Step 2: Read input file into string
-    const string rawInputContents = readFileToString(inputFile);
     
-    // Step 3: Perform the compression by reading through the input file
-    //   and compressing into a dictionary, represented as a vector of integers
-    vector<unsigned long> compressed;
-    compressString(rawInputContents, std::back_inserter(compressed));
-    
-    // Step 4: Close the input file
-    inputFile.close();
-    
-    // Step 5: Prompt the user for a file to store the compressed data, then
+    // Step 2: Prompt the user for a file to store the compressed data, then
     //   open the file to be written to
-    ofstream outFile;
+    ofbstream outFile;
     while (true) {
         string filename = getLine("Enter a name for the output file: ");
         outFile.open(filename.c_str());
@@ -166,9 +189,11 @@ void compressFileLZW() {
         outFile.clear();
     }
     
-    // Step 6: Write the compressed file to disk; in essense, we need to
-    //   serialize a vector of integers
-    writeToFile(outFile, compressed);
+    // Step 3: Perform the compression one chunk at a time, writing the
+    //   variable-width binary codes straight to disk
+    LZWOptions options;
+    lzwCompress(inputFile, outFile, options);
+    inputFile.close();
     outFile.close();
 }
 
@@ -198,13 +223,14 @@ bool askBoolQuestion(string preface, string question) {
  * Function: decompressFileLZW
  * Usage: decompressFileLZW();
  * --------------------------------------------------------
- * Prompt the user for a file to decompress and then decompress it. During
- *   the decompression process, ask the user whether the specific file should
- *   be decompressed.
+ * Prompt the user for a file to decompress and then decompress it. Before
+ *   decompressing, ask the user whether the output should be printed and
+ *   whether it should be written to disk, so that the output can be streamed
+ *   straight to its destination rather than held in memory.
  */
 void decompressFileLZW() {
     // Step 1: Prompt the user for the file to be decompressed
-    ifstream inputFile;
+    ifbstream inputFile;
     while (true) {
 		string filename = getLine("Enter a file to be decompressed with LZW: ");
 		inputFile.open(filename.c_str());
@@ -215,22 +241,15 @@ void decompressFileLZW() {
 		inputFile.clear();
 	}
     
-    // Step 2: Read input file into compressed Vector<int>
-    vector<unsigned long> compressed = readFileIntoCompressedVector(inputFile);
-    inputFile.close();
-    
-    // Step 3: Decompress the compressed content
-    string deCompressed = decompress(compressed.begin(), compressed.end());
-    
-    // Step 4: Decompress file by reading compressed Vector<int> and
-    //   print it as a string
+    // Step 2: Ask the user whether to print the decompressed data
     bool toPrint = askBoolQuestion("", "Do you want to print the"
                                    " decompressed output? ");
     if (toPrint) {
-        cout << deCompressed << endl;
+        lzwDecompress(inputFile, cout);
+        cout << endl;
     }
     
-    // Step 5: Ask the user whether to write the decompressed data to an
+    // Step 3: Ask the user whether to write the decompressed data to an
     //   output file.
     bool toWriteToFile = askBoolQuestion("", "Do you want to write the"
                                          " decompressed output to disk? ");
@@ -238,14 +257,18 @@ void decompressFileLZW() {
         ofstream outFile;
         while (true) {
             string filename = getLine("Enter a name for the output file: ");
-            outFile.open(filename.c_str());
+            outFile.open(filename.c_str(), ios::out | ios::binary);
             
             if (outFile.is_open()) break;
             
             cout << "Sorry, I was unable to open that file for writing" << endl;
             outFile.clear();
         }
-        outFile.write(deCompressed.c_str(), sizeof(deCompressed.length()));
+        
+        // the compressed file may already have been decoded once for printing
+        inputFile.rewind();
+        lzwDecompress(inputFile, outFile);
         outFile.close();
     }
-}
\ No newline at end of file
+    inputFile.close();
+}
@@ -2,14 +2,30 @@
  * File: MemoryDiagnostics.cpp
  *
  * Implementation of memory diagnostic functions.
+ *
+ * Every block handed out by the replacement operator new
+ * starts with a header recording its size, the stage it was
+ * charged to and the tracking generation it belongs to, so
+ * that operator delete can take it off the right stage's live
+ * bytes.  Starting tracking moves on to a new generation
+ * rather than hunting down the blocks already counted.  The
+ * calling thread's stage is kept in a pthread key, which,
+ * unlike a Map, needs no allocation to look up.
  */
 
 #include "MemoryDiagnostics.h"
 #include "HuffmanTypes.h"
+#include <pthread.h>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
 
-/* Global variables (ewww!) tracking total allocations. */
-static long gTotalAllocs = 0;
-static long gTotalFrees = 0;
+/* Global variables (ewww!) tracking total allocations.  They
+ * are only ever changed atomically, since Nodes are made and
+ * freed on several threads at once.
+ */
+static volatile long gTotalAllocs = 0;
+static volatile long gTotalFrees = 0;
 
 /* Operators new and delete
  * Usage: Implicit
@@ -19,11 +35,11 @@ static long gTotalFrees = 0;
  * deallocations.
  */
 void* Node::operator new (size_t bytesNeeded) {
-	++gTotalAllocs;
+	__sync_fetch_and_add(&gTotalAllocs, 1);
 	return ::operator new(bytesNeeded);
 }
 void	Node::operator delete(void* toDelete) {
-	++gTotalFrees;
+	__sync_fetch_and_add(&gTotalFrees, 1);
 	return ::operator delete(toDelete);
 }
 
@@ -35,7 +51,7 @@ void	Node::operator delete(void* toDelete) {
  * throughout the program.
  */
 long numAllocations() {
-	return gTotalAllocs;
+	return __sync_fetch_and_add(&gTotalAllocs, 0);
 }
 
 /* Function: numDeallocations
@@ -45,6 +61,312 @@ long numAllocations() {
  * throughout the program.
  */
 long numDeallocations() {
-	return gTotalFrees;
+	return __sync_fetch_and_add(&gTotalFrees, 0);
+}
+
+/* Constant: TOTAL_SLOT
+ * The counters have one slot per stage, plus this one for all
+ *   stages together.
+ */
+static const int TOTAL_SLOT = NUM_ALLOCATION_STAGES;
+
+/* Variables: tracking, generation
+ * Whether allocations are being counted, and which round of
+ * tracking the counts belong to.
+ */
+static volatile bool tracking = false;
+static volatile int generation = 0;
+
+/* Variables: allocationCounts, deallocationCounts, byteCounts, liveBytes, peakLiveBytes
+ * The counters of each stage, and of all of them in TOTAL_SLOT.
+ */
+static volatile long long allocationCounts[NUM_ALLOCATION_STAGES + 1];
+static volatile long long deallocationCounts[NUM_ALLOCATION_STAGES + 1];
+static volatile long long byteCounts[NUM_ALLOCATION_STAGES + 1];
+static volatile long long liveBytes[NUM_ALLOCATION_STAGES + 1];
+static volatile long long peakLiveBytes[NUM_ALLOCATION_STAGES + 1];
+
+/* Variables: stageKey, stageKeyOnce
+ * The key holding each thread's stage, plus one so that a thread
+ * that never set it reads as OTHER_ALLOCATION_STAGE.
+ */
+static pthread_key_t stageKey;
+static pthread_once_t stageKeyOnce = PTHREAD_ONCE_INIT;
+
+/* Function: createStageKey
+ * Usage: pthread_once(&stageKeyOnce, createStageKey);
+ * --------------------------------------------------------
+ * Makes the key, exactly once.
+ */
+static void createStageKey() {
+	pthread_key_create(&stageKey, NULL);
+}
+
+/* Function: setAllocationStage
+ * Usage: setAllocationStage(STATS_ENCODE);
+ * --------------------------------------------------------
+ * Stores the stage in the key, treating anything out of range as
+ * OTHER_ALLOCATION_STAGE.
+ */
+void setAllocationStage(int stage) {
+	if (stage < 0 || stage >= NUM_ALLOCATION_STAGES) stage = OTHER_ALLOCATION_STAGE;
+	pthread_once(&stageKeyOnce, createStageKey);
+	pthread_setspecific(stageKey, (void*) size_t(stage + 1));
+}
+
+/* Function: allocationStageName
+ * Usage: string name = allocationStageName(stage);
+ * --------------------------------------------------------
+ * Defers to compressionStageName for the real stages.
+ */
+const char* allocationStageName(int stage) {
+	if (stage < 0 || stage >= NUM_COMPRESSION_STAGES) return "other";
+	return compressionStageName(CompressionStage(stage));
+}
+
+/* Functions: startAllocationTracking, stopAllocationTracking, isTrackingAllocations
+ * --------------------------------------------------------
+ * Starting zeroes the counters before moving on to a new
+ * generation, so blocks from earlier rounds are left alone when
+ * freed.  The calling thread starts out in no stage.
+ */
+void startAllocationTracking() {
+	tracking = false;
+	for (int slot = 0; slot <= TOTAL_SLOT; slot++) {
+		allocationCounts[slot] = 0;
+		deallocationCounts[slot] = 0;
+		byteCounts[slot] = 0;
+		liveBytes[slot] = 0;
+		peakLiveBytes[slot] = 0;
+	}
+	__sync_fetch_and_add(&generation, 1);
+	setAllocationStage(OTHER_ALLOCATION_STAGE);
+	tracking = true;
+}
+
+void stopAllocationTracking() {
+	tracking = false;
+}
+
+bool isTrackingAllocations() {
+	return tracking;
+}
+
+/* Function: allocationStats
+ * Usage: AllocationStats stats = allocationStats(STATS_ENCODE);
+ * --------------------------------------------------------
+ * Reads the counters of one stage.  Each is read atomically, but
+ * they are not read all at the same instant.
+ */
+AllocationStats allocationStats(int stage) {
+	int slot = (stage < 0 || stage > TOTAL_SLOT) ? OTHER_ALLOCATION_STAGE : stage;
+	AllocationStats stats;
+	stats.allocations = __sync_fetch_and_add(&allocationCounts[slot], 0);
+	stats.deallocations = __sync_fetch_and_add(&deallocationCounts[slot], 0);
+	stats.bytes = __sync_fetch_and_add(&byteCounts[slot], 0);
+	stats.liveBytes = __sync_fetch_and_add(&liveBytes[slot], 0);
+	stats.peakLiveBytes = __sync_fetch_and_add(&peakLiveBytes[slot], 0);
+	return stats;
+}
+
+/* Function: totalAllocationStats
+ * Usage: AllocationStats stats = totalAllocationStats();
+ * --------------------------------------------------------
+ * Reads the counters of TOTAL_SLOT.
+ */
+AllocationStats totalAllocationStats() {
+	return allocationStats(TOTAL_SLOT);
+}
+
+#ifdef HUFFMAN_ALLOCATION_HOOK
+
+/* Function: currentStage
+ * Usage: int stage = currentStage();
+ * --------------------------------------------------------
+ * Returns the stage the calling thread's allocations are charged
+ * to.
+ */
+static int currentStage() {
+	pthread_once(&stageKeyOnce, createStageKey);
+	size_t stored = (size_t) pthread_getspecific(stageKey);
+	return (stored == 0) ? OTHER_ALLOCATION_STAGE : int(stored - 1);
+}
+
+/* Function: raisePeak
+ * Usage: raisePeak(peakLiveBytes[stage], live);
+ * --------------------------------------------------------
+ * Raises the peak to live if live is higher, retrying for as
+ * long as other threads keep changing the peak underneath.
+ */
+static void raisePeak(volatile long long& peak, long long live) {
+	long long seen = peak;
+	while (live > seen) {
+		long long previous = __sync_val_compare_and_swap(&peak, seen, live);
+		if (previous == seen) break;
+		seen = previous;
+	}
+}
+
+/* Function: countAllocation
+ * Usage: countAllocation(slot, bytes);
+ * --------------------------------------------------------
+ * Adds a block of the given size to one slot's counters.
+ */
+static void countAllocation(int slot, long long bytes) {
+	__sync_fetch_and_add(&allocationCounts[slot], 1);
+	__sync_fetch_and_add(&byteCounts[slot], bytes);
+	raisePeak(peakLiveBytes[slot], __sync_add_and_fetch(&liveBytes[slot], bytes));
+}
+
+/* Function: countDeallocation
+ * Usage: countDeallocation(slot, bytes);
+ * --------------------------------------------------------
+ * Takes a freed block of the given size off one slot's live
+ * bytes.
+ */
+static void countDeallocation(int slot, long long bytes) {
+	__sync_fetch_and_add(&deallocationCounts[slot], 1);
+	__sync_fetch_and_sub(&liveBytes[slot], bytes);
+}
+
+/* Type: BlockHeader
+ * What comes before each block handed out by operator new.  The
+ *   padding keeps the block itself as aligned as malloc's.
+ */
+union BlockHeader {
+	struct {
+		size_t bytes;
+		int stage;        // -1 if the block was not counted
+		int generation;
+	} info;
+	char padding[16];
+};
+
+/* Function: allocateBlock
+ * Usage: void* block = allocateBlock(bytes);
+ * --------------------------------------------------------
+ * Allocates a block with a header in front, counting it if
+ * tracking is on, and returns the part after the header, or NULL
+ * if malloc fails.
+ */
+static void* allocateBlock(size_t bytes) {
+	BlockHeader* header = (BlockHeader*) malloc(sizeof(BlockHeader) + bytes);
+	if (header == NULL) return NULL;
+	header->info.bytes = bytes;
+	header->info.stage = -1;
+	if (tracking) {
+		int stage = currentStage();
+		header->info.stage = stage;
+		header->info.generation = generation;
+		countAllocation(stage, bytes);
+		countAllocation(TOTAL_SLOT, bytes);
+	}
+	return header + 1;
+}
+
+/* Function: freeBlock
+ * Usage: freeBlock(block);
+ * --------------------------------------------------------
+ * Frees a block from allocateBlock, taking it off the live bytes
+ * if it was counted in the current round of tracking.
+ */
+static void freeBlock(void* block) {
+	if (block == NULL) return;
+	BlockHeader* header = (BlockHeader*) block - 1;
+	if (tracking && header->info.stage >= 0 && header->info.generation == generation) {
+		countDeallocation(header->info.stage, header->info.bytes);
+		countDeallocation(TOTAL_SLOT, header->info.bytes);
+	}
+	free(header);
+}
+
+/* Function: allocateOrThrow
+ * Usage: void* block = allocateOrThrow(bytes);
+ * --------------------------------------------------------
+ * Behaves as the standard operator new does when memory runs
+ * out: calls the new handler and tries again until there is no
+ * handler, then throws bad_alloc.
+ */
+static void* allocateOrThrow(size_t bytes) {
+	while (true) {
+		void* block = allocateBlock(bytes);
+		if (block != NULL) return block;
+		std::new_handler handler = std::set_new_handler(NULL);
+		std::set_new_handler(handler);
+		if (handler == NULL) throw std::bad_alloc();
+		handler();
+	}
+}
+
+/* Operators new and delete
+ * Usage: Implicit
+ * --------------------------------------------------------
+ * The replacements for the global operators.  Every form is
+ * replaced, so that no block from malloc alone ever reaches the
+ * replacement delete.  The sized forms of delete, which C++14
+ * compilers call when they know the size, go the same way.
+ */
+void* operator new(size_t bytes) {
+	return allocateOrThrow(bytes);
+}
+
+void* operator new[](size_t bytes) {
+	return allocateOrThrow(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) throw() {
+	try {
+		return allocateOrThrow(bytes);
+	} catch (std::bad_alloc&) {
+		return NULL;
+	}
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) throw() {
+	try {
+		return allocateOrThrow(bytes);
+	} catch (std::bad_alloc&) {
+		return NULL;
+	}
+}
+
+void operator delete(void* block) throw() {
+	freeBlock(block);
+}
+
+void operator delete[](void* block) throw() {
+	freeBlock(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) throw() {
+	freeBlock(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) throw() {
+	freeBlock(block);
+}
+
+void operator delete(void* block, size_t) throw() {
+	freeBlock(block);
+}
+
+void operator delete[](void* block, size_t) throw() {
+	freeBlock(block);
+}
+
+/* Function: allocationHookInstalled
+ * Usage: if (allocationHookInstalled()) ...
+ * --------------------------------------------------------
+ * The operators above are compiled in.
+ */
+bool allocationHookInstalled() {
+	return true;
+}
+
+#else
+
+bool allocationHookInstalled() {
+	return false;
 }
 
+#endif
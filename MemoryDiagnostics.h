@@ -4,10 +4,28 @@
  * Code to allow for memory diagnostics.  These functions
  * allow us to count how many Nodes you have allocated and
  * deallocated.
+ *
+ * Beyond Nodes, every allocation made through the global
+ * operator new can be tracked as well, so that the Maps,
+ * Sets, Vectors and strings of the compressor show up too.
+ * While tracking is on, each allocation is charged to the
+ * stage its thread is in (see StageTimer in
+ * CompressionStats.h), and the count, bytes and peak live
+ * bytes of every stage are kept.  All counters are updated
+ * atomically, so any number of threads may allocate at once.
+ *
+ * The global operator new and delete are only replaced when
+ * HUFFMAN_ALLOCATION_HOOK is defined when compiling, as it is
+ * for the test program, which also runs the benchmarks.  The
+ * replacements put a small header on every block, so they are
+ * left out of huff itself.  Without them, only Nodes are
+ * counted.
  */
 #ifndef MemoryDiagnostics_Included
 #define MemoryDiagnostics_Included
 
+#include "CompressionStats.h"
+
 /* Function: numAllocations
  * Usage: long x = numAllocations();
  * --------------------------------------------------------
@@ -24,4 +42,82 @@ long numAllocations();
  */
 long numDeallocations();
 
+/* Constants: OTHER_ALLOCATION_STAGE, NUM_ALLOCATION_STAGES
+ * Allocations are charged to one of the CompressionStages, or
+ *   to OTHER_ALLOCATION_STAGE when their thread is in none of
+ *   them.
+ */
+const int OTHER_ALLOCATION_STAGE = NUM_COMPRESSION_STAGES;
+const int NUM_ALLOCATION_STAGES = NUM_COMPRESSION_STAGES + 1;
+
+/* Type: AllocationStats
+ * What was allocated in one stage, or in all of them, while
+ *   tracking was on.  Blocks are charged to the stage that
+ *   allocated them, even when another stage frees them.
+ */
+struct AllocationStats {
+	long long allocations;
+	long long deallocations;
+	long long bytes;           // allocated in total
+	long long liveBytes;       // allocated and not yet freed
+	long long peakLiveBytes;   // the most that were live at once
+};
+
+/* Function: allocationHookInstalled
+ * Usage: if (allocationHookInstalled()) ...
+ * --------------------------------------------------------
+ * Returns whether the global operator new and delete were
+ * replaced, that is, whether tracking can see anything.
+ */
+bool allocationHookInstalled();
+
+/* Functions: startAllocationTracking, stopAllocationTracking, isTrackingAllocations
+ * Usage: startAllocationTracking();
+ *        ...
+ *        stopAllocationTracking();
+ * --------------------------------------------------------
+ * Set every count back to zero and start tracking; stop
+ * tracking, leaving the counts as they are; and tell whether
+ * allocations are being tracked.  Blocks allocated before
+ * tracking last started are never counted, not even when
+ * they are freed.  Best started and stopped while no other
+ * thread is allocating.
+ */
+void startAllocationTracking();
+void stopAllocationTracking();
+bool isTrackingAllocations();
+
+/* Function: setAllocationStage
+ * Usage: setAllocationStage(STATS_ENCODE);
+ * --------------------------------------------------------
+ * Charges the calling thread's allocations to the given
+ * stage from now on.  StageTimer does this for the stages it
+ * times.
+ */
+void setAllocationStage(int stage);
+
+/* Function: allocationStageName
+ * Usage: string name = allocationStageName(stage);
+ * --------------------------------------------------------
+ * Returns the name of the CompressionStage, or "other".
+ */
+const char* allocationStageName(int stage);
+
+/* Function: allocationStats
+ * Usage: AllocationStats stats = allocationStats(STATS_ENCODE);
+ * --------------------------------------------------------
+ * Returns what has been allocated in the given stage since
+ * tracking last started.
+ */
+AllocationStats allocationStats(int stage);
+
+/* Function: totalAllocationStats
+ * Usage: AllocationStats stats = totalAllocationStats();
+ * --------------------------------------------------------
+ * Returns what has been allocated in all stages together.
+ * The peak is the most that was live at once overall, which
+ * may be less than the sum of the stages' peaks.
+ */
+AllocationStats totalAllocationStats();
+
 #endif
@@ -0,0 +1,202 @@
+/**********************************************************
+ * File: PerfCounters.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the performance counters from PerfCounters.h.
+ *
+ * Each counter is opened as its own perf event rather than as a group,
+ * so that a processor lacking one event (virtual machines often lack the
+ * cache events) still provides the others.  When there are more events
+ * than hardware counters, the kernel takes turns counting them, so each
+ * count is read with how long the event was enabled and how long it was
+ * actually counting, and scaled up by the ratio of the two.
+ */
+
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+/* Function: perfCounterName
+ * Usage: string name = perfCounterName(counter);
+ * --------------------------------------------------------
+ * Returns a short name for the counter, such as "branch-misses".
+ */
+std::string perfCounterName(PerfCounter counter) {
+    switch (counter) {
+    case PERF_CYCLES: return "cycles";
+    case PERF_INSTRUCTIONS: return "instructions";
+    case PERF_BRANCH_MISSES: return "branch-misses";
+    case PERF_L1D_MISSES: return "l1d-misses";
+    case PERF_LLC_MISSES: return "llc-misses";
+    }
+    return "unknown";
+}
+
+#ifdef __linux__
+
+/* Function: openCounter
+ * Usage: int descriptor = openCounter(counter);
+ * --------------------------------------------------------
+ * Opens a disabled, user-mode-only counter for the calling thread on
+ * any processor.  Returns -1 and leaves errno set on failure.
+ */
+static int openCounter(PerfCounter counter) {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof attributes);
+    attributes.size = sizeof attributes;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const unsigned long long cacheReadMiss =
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    switch (counter) {
+    case PERF_CYCLES:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case PERF_INSTRUCTIONS:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case PERF_BRANCH_MISSES:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    case PERF_L1D_MISSES:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_L1D | cacheReadMiss;
+        break;
+    case PERF_LLC_MISSES:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_LL | cacheReadMiss;
+        break;
+    }
+    return int(syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+
+#endif
+
+/* Constructor: PerfCounters
+ * --------------------------------------------------------
+ * Opens what it can and remembers why the rest failed.
+ */
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        descriptors[i] = -1;
+        values[i] = -1;
+        timesRead[i] = false;
+    }
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        descriptors[i] = openCounter(PerfCounter(i));
+        if (descriptors[i] < 0 && reason.empty()) {
+            reason = perfCounterName(PerfCounter(i)) + ": " + strerror(errno);
+            if (errno == EACCES || errno == EPERM) {
+                reason += " (see /proc/sys/kernel/perf_event_paranoid)";
+            }
+        }
+    }
+#else
+    reason = "Performance counters are only supported on Linux.";
+#endif
+}
+
+/* Destructor: ~PerfCounters
+ * --------------------------------------------------------
+ * Closes whichever counters were opened.
+ */
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (descriptors[i] >= 0) close(descriptors[i]);
+    }
+#endif
+}
+
+/* Member function: isAvailable
+ * --------------------------------------------------------
+ * A counter is available if its descriptor was opened.
+ */
+bool PerfCounters::isAvailable(PerfCounter counter) const {
+    return descriptors[counter] >= 0;
+}
+
+/* Member function: unavailableReason
+ * --------------------------------------------------------
+ * Returns the reason recorded by the constructor.
+ */
+std::string PerfCounters::unavailableReason() const {
+    return reason;
+}
+
+/* Member function: start
+ * --------------------------------------------------------
+ * Records the time each open counter has been enabled and running so
+ * far, since resetting it zeroes only the count, then resets and
+ * enables it.
+ */
+void PerfCounters::start() {
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (descriptors[i] < 0) continue;
+        // the count, then the time enabled and the time running
+        unsigned long long reading[3];
+        timesRead[i] = (read(descriptors[i], reading, sizeof reading) == sizeof reading);
+        if (timesRead[i]) {
+            enabledBefore[i] = reading[1];
+            runningBefore[i] = reading[2];
+        }
+        ioctl(descriptors[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(descriptors[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/* Member function: stop
+ * --------------------------------------------------------
+ * Disables each open counter and reads its count, scaling it up if the
+ * counter only ran for part of the time it was enabled since start().
+ * A counter whose count or times cannot be read, or that did not get
+ * to run since start(), is reported as unavailable this time.
+ */
+void PerfCounters::stop() {
+#ifdef __linux__
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (descriptors[i] < 0) continue;
+        ioctl(descriptors[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        values[i] = -1;
+        if (descriptors[i] < 0 || !timesRead[i]) continue;
+        unsigned long long reading[3];
+        if (read(descriptors[i], reading, sizeof reading) != sizeof reading) continue;
+        unsigned long long enabled = reading[1] - enabledBefore[i];
+        unsigned long long running = reading[2] - runningBefore[i];
+        if (running == 0) continue;
+        if (running >= enabled) {
+            values[i] = (long long) reading[0];
+        } else {
+            values[i] = (long long) ((double) reading[0] * enabled / running + 0.5);
+        }
+    }
+#endif
+}
+
+/* Member function: value
+ * --------------------------------------------------------
+ * Returns the count read by stop().
+ */
+long long PerfCounters::value(PerfCounter counter) const {
+    return values[counter];
+}
@@ -0,0 +1,128 @@
+/*******************************************************
+ * File: PerfCounters.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Hardware performance counters for the benchmark.  Wall-clock time
+ * says how fast a stage is but not why; counting cycles, instructions,
+ * branch mispredictions and cache misses while it runs shows whether it
+ * is limited by the bit-at-a-time loops, by chasing pointers through
+ * Map and Node structures, or by something else.
+ *
+ * The counters come from perf_event_open, so they exist only on Linux,
+ * and only when the kernel allows unprivileged use (see
+ * /proc/sys/kernel/perf_event_paranoid) and the processor or virtual
+ * machine provides them.  Any counter that cannot be opened is simply
+ * reported as unavailable.
+ */
+
+#ifndef PerfCounters_Included
+#define PerfCounters_Included
+
+#include <string>
+
+/* Type: PerfCounter
+ * The events that are counted.
+ *
+ *   PERF_CYCLES        - processor cycles.
+ *   PERF_INSTRUCTIONS  - instructions retired.
+ *   PERF_BRANCH_MISSES - mispredicted branches.
+ *   PERF_L1D_MISSES    - level 1 data cache read misses.
+ *   PERF_LLC_MISSES    - last level cache read misses.
+ */
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES
+};
+
+/* Constant: NUM_PERF_COUNTERS
+ * The number of values of PerfCounter.
+ */
+const int NUM_PERF_COUNTERS = 5;
+
+/* Function: perfCounterName
+ * Usage: string name = perfCounterName(counter);
+ * --------------------------------------------------------
+ * Returns a short name for the counter, such as "branch-misses".
+ */
+std::string perfCounterName(PerfCounter counter);
+
+/* Class: PerfCounters
+ * --------------------------------------------------------
+ * A set of counters for the calling thread.  Counting only happens
+ * between start() and stop(), and only in user mode.
+ */
+class PerfCounters {
+public:
+    /* Constructor: PerfCounters
+     * Usage: PerfCounters counters;
+     * --------------------------------------------------------
+     * Tries to open every counter.  Never fails; check isAvailable.
+     */
+    PerfCounters();
+
+    /* Destructor: ~PerfCounters
+     * --------------------------------------------------------
+     * Closes the counters.
+     */
+    ~PerfCounters();
+
+    /* Member function: isAvailable
+     * Usage: if (counters.isAvailable(PERF_CYCLES)) ...
+     * --------------------------------------------------------
+     * Returns whether the counter could be opened.
+     */
+    bool isAvailable(PerfCounter counter) const;
+
+    /* Member function: unavailableReason
+     * Usage: string reason = counters.unavailableReason();
+     * --------------------------------------------------------
+     * Returns why the first counter that could not be opened was
+     * unavailable, or "" if all of them are available.
+     */
+    std::string unavailableReason() const;
+
+    /* Member functions: start, stop
+     * Usage: counters.start();
+     *        ...
+     *        counters.stop();
+     * --------------------------------------------------------
+     * Zero the counters and start counting, and stop counting and read
+     * the counts.
+     */
+    void start();
+    void stop();
+
+    /* Member function: value
+     * Usage: long long cycles = counters.value(PERF_CYCLES);
+     * --------------------------------------------------------
+     * Returns the count from the last start() and stop(), or -1 if the
+     * counter is unavailable.  If the kernel had to share the hardware
+     * counters among more events than they can count at once, the count
+     * is an estimate, scaled up from the part of the time the counter
+     * ran; if the counter never ran, it is unavailable.
+     */
+    long long value(PerfCounter counter) const;
+
+private:
+    int descriptors[NUM_PERF_COUNTERS];   // -1 when unavailable
+    long long values[NUM_PERF_COUNTERS];
+    std::string reason;
+
+    /* The time each counter had been enabled and running when start()
+     * was last called, and whether it could be read.
+     */
+    unsigned long long enabledBefore[NUM_PERF_COUNTERS];
+    unsigned long long runningBefore[NUM_PERF_COUNTERS];
+    bool timesRead[NUM_PERF_COUNTERS];
+
+    /* Counters are open file descriptors, so they must not be copied. */
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+};
+
+#endif
@@ -0,0 +1,407 @@
+/**********************************************************
+ * File: ResultCache.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the result cache from ResultCache.h.  The index of
+ * results is read from the directory when the cache is opened and kept
+ * up to date in memory from then on; eviction finds the least recently
+ * used result by a scan of the index, which is cheap next to deleting
+ * a file.
+ */
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include "ResultCache.h"
+#include "Checksum.h"
+#include "ThreadPool.h"
+#include "error.h"
+#include "filelib.h"
+
+/* Constant: RESULT_CACHE_VERSION
+ * Part of every key, so that a change to the compressed format can
+ *   retire every result stored before it by changing this number.
+ */
+static const unsigned long long RESULT_CACHE_VERSION = 1;
+
+/* Constants: RESULT_SUFFIX, TEMPORARY_PREFIX
+ * The ends of the names of results and of results being written.
+ */
+static const char* const RESULT_SUFFIX = ".huf";
+static const char* const TEMPORARY_PREFIX = "tmp-";
+
+/* Constant: CACHE_READ_SIZE
+ * How much is read at a time when hashing and copying.
+ */
+static const long CACHE_READ_SIZE = 256 * 1024;
+
+/* Constructor: ResultCacheStats
+ * --------------------------------------------------------
+ * Starts every count at zero.
+ */
+ResultCacheStats::ResultCacheStats() {
+    hits = misses = bypasses = evictions = reflinks = 0;
+    numEntries = 0;
+    bytes = 0;
+}
+
+/* Function: microsecondsNow
+ * Usage: long long now = microsecondsNow();
+ * --------------------------------------------------------
+ * Returns the time of day in microseconds since the epoch, the
+ * resolution at which modification times are set.
+ */
+static long long microsecondsNow() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000000LL + now.tv_usec;
+}
+
+/* Constant: KEY_LENGTH
+ * The length of a key: the hash and the length of the input, each as
+ *   sixteen hex digits, joined by a dash.
+ */
+static const int KEY_LENGTH = 16 + 1 + 16;
+
+/* Function: isResultName
+ * Usage: if (isResultName(name)) ...
+ * --------------------------------------------------------
+ * Returns whether a file in the cache directory is a result: a key
+ * followed by RESULT_SUFFIX.
+ */
+static bool isResultName(const std::string& name) {
+    std::string suffix = RESULT_SUFFIX;
+    if (name.length() != KEY_LENGTH + suffix.length() ||
+        name.compare(KEY_LENGTH, suffix.length(), suffix) != 0 || name[16] != '-') {
+        return false;
+    }
+    for (int i = 0; i < KEY_LENGTH; i++) {
+        if (i != 16 && !isxdigit(name[i])) return false;
+    }
+    return true;
+}
+
+/* Function: cacheSeed
+ * Usage: unsigned long long seed = cacheSeed(options);
+ * --------------------------------------------------------
+ * Packs into one number everything about the options that changes the
+ * output: the level, the block size, and whether blocks are compressed
+ * one after another, sharing tables, or each on its own.
+ */
+static unsigned long long cacheSeed(const CompressionOptions& options) {
+    int numThreads = (options.numThreads == 0) ? defaultThreadCount() : options.numThreads;
+    unsigned long long seed = RESULT_CACHE_VERSION << 56;
+    seed |= (unsigned long long) (numThreads == 1) << 48;
+    seed |= (unsigned long long) options.blockSize << 8;
+    seed |= (unsigned long long) options.level;
+    return seed;
+}
+
+/* Function: copyStream
+ * Usage: copyStream(source, sink);
+ * --------------------------------------------------------
+ * Copies everything left in source to sink.  Reports an error if
+ * either fails.
+ */
+static void copyStream(std::istream& source, std::ostream& sink) {
+    std::string chunk(CACHE_READ_SIZE, '\0');
+    while (source) {
+        source.read(&chunk[0], CACHE_READ_SIZE);
+        sink.write(chunk.data(), source.gcount());
+    }
+    if (source.bad()) error("Cannot read the cached result.");
+    if (!sink) error("Cannot write the output.");
+}
+
+/* Function: copyFile
+ * Usage: bool reflinked = copyFile(sourceName, targetName);
+ * --------------------------------------------------------
+ * Makes targetName a copy of sourceName, sharing its data by reflink
+ * where the file system allows (FICLONE, on Linux), and copying it
+ * otherwise.  Returns whether it was reflinked.  Reports an error if
+ * either file cannot be used.
+ */
+static bool copyFile(const std::string& sourceName, const std::string& targetName) {
+    int source = open(sourceName.c_str(), O_RDONLY);
+    if (source < 0) error("Cannot read the cached result.");
+    int target = open(targetName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (target < 0) {
+        close(source);
+        error("Cannot create " + targetName + ".");
+    }
+    bool reflinked = false;
+#ifdef FICLONE
+    reflinked = (ioctl(target, FICLONE, source) == 0);
+#endif
+    bool failed = false;
+    if (!reflinked) {
+        std::string chunk(CACHE_READ_SIZE, '\0');
+        while (!failed) {
+            ssize_t count = read(source, &chunk[0], CACHE_READ_SIZE);
+            if (count <= 0) {
+                failed = (count < 0);
+                break;
+            }
+            failed = (write(target, chunk.data(), count) != count);
+        }
+    }
+    close(source);
+    if (close(target) != 0) failed = true;
+    if (failed) error("Cannot write the output.");
+    return reflinked;
+}
+
+/* Constructor: ResultCache
+ * --------------------------------------------------------
+ * Reads the index from the directory, taking each result's last use
+ * from its modification time.
+ */
+ResultCache::ResultCache(const std::string& directory, long long maxBytes) {
+    if (maxBytes <= 0) error("Cache size is out of range.");
+    this->directory = directory;
+    this->maxBytes = maxBytes;
+    lastUse = 0;
+    numTemporaries = 0;
+    if (!isDirectory(directory)) createDirectoryPath(directory);
+
+    Vector<std::string> names;
+    listDirectory(directory, names);
+    foreach (std::string name in names) {
+        if (!isResultName(name)) continue;
+        struct stat status;
+        if (stat((directory + "/" + name).c_str(), &status) != 0) continue;
+        Entry entry;
+        entry.size = status.st_size;
+#ifdef __APPLE__
+        entry.lastUsed = status.st_mtimespec.tv_sec * 1000000LL + status.st_mtimespec.tv_nsec / 1000;
+#else
+        entry.lastUsed = status.st_mtim.tv_sec * 1000000LL + status.st_mtim.tv_nsec / 1000;
+#endif
+        if (entry.lastUsed > lastUse) lastUse = entry.lastUsed;
+        entries.put(name.substr(0, KEY_LENGTH), entry);
+        counts.numEntries++;
+        counts.bytes += entry.size;
+    }
+    evict();
+}
+
+/* Member function: compress
+ * --------------------------------------------------------
+ * Looks the input up, compresses it into the cache on a miss, and copies
+ * the result to outfile.
+ */
+void ResultCache::compress(std::istream& infile, std::ostream& outfile,
+                           const CompressionOptions& options, CompressionStats* stats) {
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(stats, local);
+    std::string key;
+    bool hit = lookUp(infile, options, key, active);
+    if (key.empty()) {
+        ::compress(infile, outfile, options, stats);
+        return;
+    }
+    if (!hit) store(infile, options, key, stats);
+
+    StageTimer timer(hit ? active : NULL);
+    timer.start(STATS_FLUSH);
+    std::ifstream result(pathFor(key).c_str(), std::ios::binary);
+    if (!result.is_open()) error("Cannot read the cached result.");
+    copyStream(result, outfile);
+    timer.stop();
+    if (hit) finishCompressionStats(STATS_COMPRESSION, active);
+    evict();
+}
+
+/* Member function: compressFile
+ * --------------------------------------------------------
+ * Looks the input up, compresses it into the cache on a miss, and
+ * reflinks or copies the result to the output.
+ */
+void ResultCache::compressFile(const std::string& inputName, const std::string& outputName,
+                               const CompressionOptions& options, CompressionStats* stats) {
+    std::ifstream input(inputName.c_str(), std::ios::binary);
+    if (!input.is_open()) error("Cannot open the file.");
+    CompressionStats local;
+    CompressionStats* active = activeCompressionStats(stats, local);
+    std::string key;
+    bool hit = lookUp(input, options, key, active);
+    if (!hit) store(input, options, key, stats);
+
+    StageTimer timer(hit ? active : NULL);
+    timer.start(STATS_FLUSH);
+    try {
+        if (copyFile(pathFor(key), outputName)) counts.reflinks++;
+    } catch (ErrorException&) {
+        remove(outputName.c_str());
+        throw;
+    }
+    timer.stop();
+    if (hit) finishCompressionStats(STATS_COMPRESSION, active);
+    evict();
+}
+
+/* Member function: getStats
+ * --------------------------------------------------------
+ * Returns a copy of the counts.
+ */
+ResultCacheStats ResultCache::getStats() const {
+    return counts;
+}
+
+/* Member function: lookUp
+ * Usage: if (lookUp(infile, options, key, active)) ...
+ * --------------------------------------------------------
+ * Hashes the rest of infile into key, rewinds it, and returns whether
+ * the result is cached, marking it used if so.  The key holds the
+ * input's length as well as its hash, so that a result is only ever
+ * handed out for an input that agrees with it on both; a collision of
+ * the 64-bit hash alone cannot return another input's output.  Leaves
+ * key empty, and returns false, if infile cannot seek.  The time spent
+ * hashing is charged to active, which on a hit is also given the sizes.
+ */
+bool ResultCache::lookUp(std::istream& infile, const CompressionOptions& options,
+                         std::string& key, CompressionStats* active) {
+    key = "";
+    std::streampos start = infile.tellg();
+    if (start == std::streampos(-1)) {
+        counts.bypasses++;
+        return false;
+    }
+
+    StageTimer timer(active);
+    timer.start(STATS_HISTOGRAM);
+    ContentHash hash(cacheSeed(options));
+    std::string chunk(CACHE_READ_SIZE, '\0');
+    while (infile) {
+        infile.read(&chunk[0], CACHE_READ_SIZE);
+        hash.update(chunk.data(), long(infile.gcount()));
+    }
+    if (infile.bad()) error("Cannot read the input.");
+    infile.clear();
+    infile.seekg(start);
+    timer.stop();
+
+    std::ostringstream hex;
+    hex.fill('0');
+    hex << std::hex << std::setw(16) << hash.digest() << "-"
+        << std::setw(16) << (unsigned long long) hash.length();
+    key = hex.str();
+    if (!entries.containsKey(key) || !isFile(pathFor(key))) {
+        if (entries.containsKey(key)) {
+            // another process evicted it
+            counts.bytes -= entries[key].size;
+            counts.numEntries--;
+            entries.remove(key);
+        }
+        counts.misses++;
+        return false;
+    }
+    counts.hits++;
+    touch(key);
+    if (active != NULL) {
+        active->uncompressedBytes = hash.length();
+        active->compressedBytes = entries[key].size;
+    }
+    return true;
+}
+
+/* Member function: store
+ * Usage: store(infile, options, key, stats);
+ * --------------------------------------------------------
+ * Compresses infile into a temporary file in the cache, then renames it
+ * to the key's result.
+ */
+void ResultCache::store(std::istream& infile, const CompressionOptions& options,
+                        const std::string& key, CompressionStats* stats) {
+    std::ostringstream name;
+    name << directory << "/" << TEMPORARY_PREFIX << getpid() << "-" << numTemporaries++;
+    std::string temporary = name.str();
+    std::ofstream result(temporary.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!result.is_open()) error("Cannot write to the cache.");
+    try {
+        ::compress(infile, result, options, stats);
+        result.close();
+        if (result.fail()) error("Cannot write to the cache.");
+        if (rename(temporary.c_str(), pathFor(key).c_str()) != 0) error("Cannot write to the cache.");
+    } catch (ErrorException&) {
+        if (result.is_open()) result.close();
+        remove(temporary.c_str());
+        throw;
+    }
+
+    struct stat status;
+    Entry entry;
+    entry.size = (stat(pathFor(key).c_str(), &status) == 0) ? status.st_size : 0;
+    entry.lastUsed = 0;
+    if (entries.containsKey(key)) {
+        counts.bytes -= entries[key].size;
+    } else {
+        counts.numEntries++;
+    }
+    entries.put(key, entry);
+    counts.bytes += entry.size;
+    touch(key);
+}
+
+/* Member function: pathFor
+ * Usage: string path = pathFor(key);
+ * --------------------------------------------------------
+ * Returns the name of the key's result.
+ */
+std::string ResultCache::pathFor(const std::string& key) const {
+    return directory + "/" + key + RESULT_SUFFIX;
+}
+
+/* Member function: touch
+ * Usage: touch(key);
+ * --------------------------------------------------------
+ * Marks a result as the most recently used, in the index and in its
+ * modification time.  Uses are kept strictly increasing, so that two
+ * within the same microsecond are still told apart.
+ */
+void ResultCache::touch(const std::string& key) {
+    long long now = microsecondsNow();
+    lastUse = (now > lastUse) ? now : lastUse + 1;
+    entries[key].lastUsed = lastUse;
+    struct timeval times[2];
+    times[0].tv_sec = times[1].tv_sec = time_t(lastUse / 1000000);
+    times[0].tv_usec = times[1].tv_usec = suseconds_t(lastUse % 1000000);
+    utimes(pathFor(key).c_str(), times);
+}
+
+/* Member function: evict
+ * Usage: evict();
+ * --------------------------------------------------------
+ * Deletes the least recently used results until the rest fit.
+ */
+void ResultCache::evict() {
+    while (counts.bytes > maxBytes && !entries.isEmpty()) {
+        std::string oldest;
+        long long oldestUse = 0;
+        foreach (std::string key in entries) {
+            if (oldest.empty() || entries[key].lastUsed < oldestUse) {
+                oldest = key;
+                oldestUse = entries[key].lastUsed;
+            }
+        }
+        remove(pathFor(oldest).c_str());
+        counts.bytes -= entries[oldest].size;
+        counts.numEntries--;
+        counts.evictions++;
+        entries.remove(oldest);
+    }
+}
@@ -0,0 +1,135 @@
+/*******************************************************
+ * File: ResultCache.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * An on-disk cache of compressed results, so that inputs compressed
+ * again unchanged, as in a nightly job, cost a single read pass instead
+ * of a full compression.  Results are named by their content: the key
+ * is a ContentHash (see Checksum.h) of the input, seeded with the
+ * options that shape the output, together with the input's length, and
+ * each result is a file in the cache directory named after its key.  A
+ * hit copies that file to the output, by reflink where the file system
+ * can share the data, so that even the copy is nearly free.
+ *
+ * The cache is bounded in size: once its results add up to more than
+ * the limit, the least recently used are deleted.  How recently a result
+ * was used is kept in its file's modification time, so the order
+ * survives from one run to the next, and several caches can be opened
+ * on the same directory.  A result is written under a temporary name
+ * and renamed into place, so that no reader ever sees half of one.
+ */
+
+#ifndef ResultCache_Included
+#define ResultCache_Included
+
+#include "CompressionLevels.h"
+#include "map.h"
+#include <iostream>
+#include <string>
+
+/* Type: ResultCacheStats
+ * What a ResultCache has done since it was opened.
+ */
+struct ResultCacheStats {
+    /* Inputs whose result was found, inputs compressed and stored, and
+     * inputs that could not be looked up because their streams cannot
+     * seek, and were just compressed.
+     */
+    long long hits;
+    long long misses;
+    long long bypasses;
+
+    /* Results deleted to stay within the size limit, and hits handed
+     * out by reflink rather than by copying.
+     */
+    long long evictions;
+    long long reflinks;
+
+    /* The results held now, and their total size. */
+    int numEntries;
+    long long bytes;
+
+    /* Sets everything to zero. */
+    ResultCacheStats();
+};
+
+/* Class: ResultCache
+ * --------------------------------------------------------
+ * A cache of the results of compress with options, held in a directory.
+ * It may only be used by one thread at a time.
+ */
+class ResultCache {
+public:
+    /* Constructor: ResultCache
+     * Usage: ResultCache cache(directory, maxBytes);
+     * --------------------------------------------------------
+     * Opens the cache in directory, creating the directory if need be,
+     * holding at most maxBytes of results, and evicts results if those
+     * already there add up to more.  Reports an error if maxBytes is
+     * not positive.
+     */
+    ResultCache(const std::string& directory, long long maxBytes);
+
+    /* Member function: compress
+     * Usage: cache.compress(infile, outfile, options, &stats);
+     * --------------------------------------------------------
+     * Writes to outfile what compress with options would, hashing the
+     * rest of infile first and copying the cached result if there is
+     * one.  Otherwise infile is rewound, compressed into the cache and
+     * copied out.  If infile cannot seek, it is simply compressed.  On a
+     * hit, stats gives the sizes, with the hashing counted as reading
+     * the input and the copying as writing the output.
+     */
+    void compress(std::istream& infile, std::ostream& outfile, const CompressionOptions& options,
+                  CompressionStats* stats = NULL);
+
+    /* Member function: compressFile
+     * Usage: cache.compressFile(inputName, outputName, options, &stats);
+     * --------------------------------------------------------
+     * Like compress, but from one named file to another, so that the
+     * result can be reflinked.  Reports an error, removing the output,
+     * if either file cannot be used.
+     */
+    void compressFile(const std::string& inputName, const std::string& outputName,
+                      const CompressionOptions& options, CompressionStats* stats = NULL);
+
+    /* Member function: getStats
+     * Usage: ResultCacheStats stats = cache.getStats();
+     * --------------------------------------------------------
+     * Returns what the cache has done.
+     */
+    ResultCacheStats getStats() const;
+
+private:
+    /* Type: Entry
+     * A result in the cache: its size, and when it was last used, in
+     *   nanoseconds since the epoch.
+     */
+    struct Entry {
+        long long size;
+        long long lastUsed;
+    };
+
+    std::string directory;
+    long long maxBytes;
+    Map<std::string, Entry> entries;
+    ResultCacheStats counts;
+    long long lastUse;                  // the latest lastUsed handed out
+    int numTemporaries;
+
+    bool lookUp(std::istream& infile, const CompressionOptions& options, std::string& key,
+                CompressionStats* active);
+    void store(std::istream& infile, const CompressionOptions& options, const std::string& key,
+               CompressionStats* stats);
+    std::string pathFor(const std::string& key) const;
+    void touch(const std::string& key);
+    void evict();
+
+    /* A cache owns its index, so it must not be copied. */
+    ResultCache(const ResultCache&);
+    ResultCache& operator=(const ResultCache&);
+};
+
+#endif
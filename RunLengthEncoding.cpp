@@ -0,0 +1,112 @@
+/**********************************************************
+ * File: RunLengthEncoding.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the run-length encoding from RunLengthEncoding.h.
+ */
+
+#include "RunLengthEncoding.h"
+#include "error.h"
+
+/* Function: runLengthAt
+ * Usage: long run = runLengthAt(data, pos);
+ * --------------------------------------------------------
+ * Returns how many times the byte at pos repeats, starting at pos,
+ *   up to RLE_MAX_RUN.
+ */
+static long runLengthAt(const std::string& data, long pos) {
+    long run = 1;
+    while (pos + run < data.length() && run < RLE_MAX_RUN &&
+           data[pos + run] == data[pos]) {
+        run++;
+    }
+    return run;
+}
+
+/* Function: packBits
+ * Usage: long size = packBits(data, output);
+ * --------------------------------------------------------
+ * Does the work for both rleCompress and rleCompressedSize: walks the
+ *   data, emitting runs of at least RLE_MIN_RUN bytes as runs and
+ *   gathering everything else into groups of literals.  Appends the
+ *   encoding to output, unless output is NULL, and returns its length.
+ */
+static long packBits(const std::string& data, std::string* output) {
+    long size = 0;
+    long pos = 0;
+    while (pos < data.length()) {
+        long run = runLengthAt(data, pos);
+        if (run >= RLE_MIN_RUN) {
+            if (output != NULL) {
+                *output += char(run + 125);
+                *output += data[pos];
+            }
+            size += 2;
+            pos += run;
+            continue;
+        }
+
+        // gather literals until the next run worth encoding begins
+        long start = pos;
+        while (pos < data.length() && pos - start < RLE_MAX_LITERALS &&
+               runLengthAt(data, pos) < RLE_MIN_RUN) {
+            pos++;
+        }
+        if (output != NULL) {
+            *output += char(pos - start - 1);
+            output->append(data, start, pos - start);
+        }
+        size += 1 + (pos - start);
+    }
+    return size;
+}
+
+/* Function: rleCompress
+ * Usage: string compressed = rleCompress(data);
+ * --------------------------------------------------------
+ * Reserves the exact output size up front, then encodes.
+ */
+std::string rleCompress(const std::string& data) {
+    std::string compressed;
+    compressed.reserve(rleCompressedSize(data));
+    packBits(data, &compressed);
+    return compressed;
+}
+
+/* Function: rleCompressedSize
+ * Usage: long size = rleCompressedSize(data);
+ * --------------------------------------------------------
+ * Runs the encoder without any output.
+ */
+long rleCompressedSize(const std::string& data) {
+    return packBits(data, NULL);
+}
+
+/* Function: rleDecompress
+ * Usage: string original = rleDecompress(compressed);
+ * --------------------------------------------------------
+ * Reads one control byte at a time and expands what follows it.
+ */
+std::string rleDecompress(const std::string& compressed) {
+    std::string data;
+    long pos = 0;
+    while (pos < compressed.length()) {
+        int control = (unsigned char)compressed[pos++];
+        if (control < RLE_MAX_LITERALS) {
+            long count = control + 1;
+            if (pos + count > compressed.length()) {
+                error("Run-length encoded data ends in the middle of a group of literals.");
+            }
+            data.append(compressed, pos, count);
+            pos += count;
+        } else {
+            if (pos >= compressed.length()) {
+                error("Run-length encoded data ends in the middle of a run.");
+            }
+            data.append(control - 125, compressed[pos++]);
+        }
+    }
+    return data;
+}
@@ -0,0 +1,53 @@
+/*******************************************************
+ * File: RunLengthEncoding.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A byte-oriented run-length encoding in the style of PackBits.  It
+ * does nothing for text, but it is very fast and shrinks inputs made
+ * of long runs of the same byte (blank image rows, zero padding) far
+ * better than Huffman encoding can.
+ */
+
+#ifndef RunLengthEncoding_Included
+#define RunLengthEncoding_Included
+
+#include <string>
+
+/* Constants: RLE_MIN_RUN, RLE_MAX_RUN, RLE_MAX_LITERALS
+ * The shortest run worth encoding as a run, the longest run a single
+ *   control byte can describe, and the most literal bytes a single
+ *   control byte can introduce.
+ */
+const int RLE_MIN_RUN = 3;
+const int RLE_MAX_RUN = 130;
+const int RLE_MAX_LITERALS = 128;
+
+/* Function: rleCompress
+ * Usage: string compressed = rleCompress(data);
+ * --------------------------------------------------------
+ * Run-length encodes the data.  The output is a sequence of control
+ * bytes: a control byte c below 128 is followed by c + 1 literal bytes,
+ * and a control byte c of 128 or more is followed by a single byte that
+ * is repeated c - 125 times.
+ */
+std::string rleCompress(const std::string& data);
+
+/* Function: rleCompressedSize
+ * Usage: long size = rleCompressedSize(data);
+ * --------------------------------------------------------
+ * Returns the length rleCompress would produce for the data, without
+ * building the output.
+ */
+long rleCompressedSize(const std::string& data);
+
+/* Function: rleDecompress
+ * Usage: string original = rleDecompress(compressed);
+ * --------------------------------------------------------
+ * Reverses rleCompress.  Reports an error through error() if the input
+ * ends in the middle of a run or a group of literals.
+ */
+std::string rleDecompress(const std::string& compressed);
+
+#endif
@@ -0,0 +1,40 @@
+/**********************************************************
+ * File: SPSCRing.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * The waiting shared by every SPSCRing; the rings themselves are
+ * templates and live in SPSCRing.h.
+ */
+
+#include "SPSCRing.h"
+#include <sched.h>
+#include <unistd.h>
+
+/* Constants: RING_SPINS, RING_YIELDS, RING_NAP_MICROSECONDS
+ * A waiting side first checks again right away RING_SPINS times, since
+ *   the other side is often about to finish; then gives up its processor
+ *   RING_YIELDS times, which is all it takes when there are fewer
+ *   processors than threads; and from then on naps between checks, so
+ *   that a stage stuck behind a slow disk costs next to nothing.
+ */
+static const int RING_SPINS = 100;
+static const int RING_YIELDS = 100;
+static const int RING_NAP_MICROSECONDS = 50;
+
+/* Function: ringBackoff
+ * Usage: ringBackoff(attempts);
+ * --------------------------------------------------------
+ * Spins, yields or naps, depending on how many attempts came before.
+ */
+void ringBackoff(int& attempts) {
+    if (attempts < RING_SPINS) {
+        attempts++;
+    } else if (attempts < RING_SPINS + RING_YIELDS) {
+        attempts++;
+        sched_yield();
+    } else {
+        usleep(RING_NAP_MICROSECONDS);
+    }
+}
@@ -0,0 +1,178 @@
+/*******************************************************
+ * File: SPSCRing.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A bounded ring buffer connecting exactly one producer thread to
+ * exactly one consumer thread, used to chain the stages of a pipeline.
+ * Neither side ever takes a lock: the producer alone moves the tail and
+ * the consumer alone moves the head, and each only reads the other's
+ * index.  A producer that finds the ring full, or a consumer that finds
+ * it empty, spins briefly, then yields, then sleeps in short naps until
+ * the other side catches up, so a slow stage holds back the stages
+ * feeding it instead of letting work pile up without bound.
+ */
+
+#ifndef SPSCRing_Included
+#define SPSCRing_Included
+
+/* Function: ringBackoff
+ * Usage: ringBackoff(attempts);
+ * --------------------------------------------------------
+ * Waits a little before a ring is looked at again, longer the more
+ * attempts have already been made, and counts this attempt.
+ */
+void ringBackoff(int& attempts);
+
+/* Class: SPSCRing
+ * --------------------------------------------------------
+ * A first-in, first-out ring of at most a fixed number of values.  Only
+ * one thread may push and only one other thread may pop.
+ */
+template <typename ValueType>
+class SPSCRing {
+public:
+    /* Constructor: SPSCRing
+     * Usage: SPSCRing<T> ring(capacity);
+     * --------------------------------------------------------
+     * Makes an empty ring holding up to capacity values (at least one).
+     */
+    SPSCRing(int capacity);
+
+    /* Destructor: ~SPSCRing
+     * --------------------------------------------------------
+     * Frees the slots.  Values still in the ring are dropped.
+     */
+    ~SPSCRing();
+
+    /* Member functions: tryPush, tryPop
+     * Usage: if (ring.tryPush(value)) ...
+     *        if (ring.tryPop(value)) ...
+     * --------------------------------------------------------
+     * Add a value at the tail, or take the value at the head, if there
+     * is room or a value.  Return whether they did.  Never wait.
+     */
+    bool tryPush(const ValueType& value);
+    bool tryPop(ValueType& value);
+
+    /* Member functions: push, pop
+     * Usage: ring.push(value);
+     *        ValueType value = ring.pop();
+     * --------------------------------------------------------
+     * Add a value at the tail, waiting while the ring is full, or take
+     * the value at the head, waiting while it is empty.
+     */
+    void push(const ValueType& value);
+    ValueType pop();
+
+    /* Member function: capacity
+     * Usage: int n = ring.capacity();
+     * --------------------------------------------------------
+     * Returns the most values the ring holds at once.
+     */
+    int capacity() const;
+
+    /* Member functions: numFullWaits, numEmptyWaits
+     * Usage: long waits = ring.numFullWaits();
+     * --------------------------------------------------------
+     * Return how many times push found the ring full, and how many
+     * times pop found it empty.  Each should only be read by the thread
+     * that pushes, or pops, or once both have finished.
+     */
+    long numFullWaits() const;
+    long numEmptyWaits() const;
+
+private:
+    ValueType* slots;
+    int numSlots;             // one more than the capacity, so full != empty
+    volatile int head;        // the next slot to pop; moved by the consumer only
+    volatile int tail;        // the next slot to push; moved by the producer only
+    long fullWaits;
+    long emptyWaits;
+
+    /* The ring is shared by two threads, so it must not be copied. */
+    SPSCRing(const SPSCRing&);
+    SPSCRing& operator=(const SPSCRing&);
+};
+
+/* Implementation section
+ * --------------------------------------------------------
+ * A value is stored in its slot before the tail moves past it, and
+ * copied out before the head moves past it; the full barriers from
+ * __sync_synchronize keep the other thread from seeing the index move
+ * first.
+ */
+
+template <typename ValueType>
+SPSCRing<ValueType>::SPSCRing(int capacity) {
+    if (capacity < 1) capacity = 1;
+    numSlots = capacity + 1;
+    slots = new ValueType[numSlots];
+    head = 0;
+    tail = 0;
+    fullWaits = 0;
+    emptyWaits = 0;
+}
+
+template <typename ValueType>
+SPSCRing<ValueType>::~SPSCRing() {
+    delete[] slots;
+}
+
+template <typename ValueType>
+bool SPSCRing<ValueType>::tryPush(const ValueType& value) {
+    int next = (tail + 1) % numSlots;
+    if (next == head) return false;
+    slots[tail] = value;
+    __sync_synchronize();
+    tail = next;
+    return true;
+}
+
+template <typename ValueType>
+bool SPSCRing<ValueType>::tryPop(ValueType& value) {
+    if (head == tail) return false;
+    __sync_synchronize();
+    value = slots[head];
+    __sync_synchronize();
+    head = (head + 1) % numSlots;
+    return true;
+}
+
+template <typename ValueType>
+void SPSCRing<ValueType>::push(const ValueType& value) {
+    int attempts = 0;
+    while (!tryPush(value)) {
+        if (attempts == 0) fullWaits++;
+        ringBackoff(attempts);
+    }
+}
+
+template <typename ValueType>
+ValueType SPSCRing<ValueType>::pop() {
+    ValueType value;
+    int attempts = 0;
+    while (!tryPop(value)) {
+        if (attempts == 0) emptyWaits++;
+        ringBackoff(attempts);
+    }
+    return value;
+}
+
+template <typename ValueType>
+int SPSCRing<ValueType>::capacity() const {
+    return numSlots - 1;
+}
+
+template <typename ValueType>
+long SPSCRing<ValueType>::numFullWaits() const {
+    return fullWaits;
+}
+
+template <typename ValueType>
+long SPSCRing<ValueType>::numEmptyWaits() const {
+    return emptyWaits;
+}
+
+#endif
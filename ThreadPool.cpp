@@ -0,0 +1,232 @@
+/**********************************************************
+ * File: ThreadPool.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the thread pool from ThreadPool.h.
+ *
+ * Each worker's queue has a Lock of its own, so that workers taking
+ * tasks from their own queues do not wait on one another.  The counts
+ * are guarded by the pool's main Lock.  Since Lock::signal wakes every
+ * waiting thread, that lock is used both to tell idle workers that a
+ * task has arrived and to tell waitForAll that a task has finished;
+ * each side rechecks its own condition.
+ *
+ * A task is put on its queue before it is counted in numQueued, and
+ * taken off before it is uncounted, so a worker that finds numQueued
+ * above zero may at worst look through the queues once for nothing.
+ */
+
+#include <exception>
+#include <pthread.h>
+#include <unistd.h>
+#include "ThreadPool.h"
+#include "Timing.h"
+#include "Tracing.h"
+#include "error.h"
+
+/* Function: defaultThreadCount
+ * Usage: int numThreads = defaultThreadCount();
+ * --------------------------------------------------------
+ * Asks the operating system how many processors are online.
+ */
+int defaultThreadCount() {
+#ifdef _SC_NPROCESSORS_ONLN
+    long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numProcessors > 0) return int(numProcessors);
+#endif
+    return 1;
+}
+
+/* Variables: workerKey, workerKeyOnce
+ * The key holding the queue of the worker a thread is, if it is one,
+ * so that tasks submitted from a task go to their own worker's queue.
+ */
+static pthread_key_t workerKey;
+static pthread_once_t workerKeyOnce = PTHREAD_ONCE_INIT;
+
+/* Function: createWorkerKey
+ * Usage: pthread_once(&workerKeyOnce, createWorkerKey);
+ * --------------------------------------------------------
+ * Makes the key, exactly once.
+ */
+static void createWorkerKey() {
+    pthread_key_create(&workerKey, NULL);
+}
+
+/* Constructor: ThreadPool
+ * --------------------------------------------------------
+ * Makes every worker's queue, then forks the worker threads, each of
+ * which runs runWorker until the pool is destroyed.
+ */
+ThreadPool::ThreadPool(int numThreads) {
+    numQueued = 0;
+    numUnfinished = 0;
+    numStarted = 0;
+    nextQueue = 0;
+    steals = 0;
+    stopping = false;
+    pthread_once(&workerKeyOnce, createWorkerKey);
+    if (numThreads < 1) numThreads = 1;
+    for (int i = 0; i < numThreads; i++) {
+        queues.add(new WorkerQueue);
+    }
+    for (int i = 0; i < numThreads; i++) {
+        threads.add(fork(runWorker, *this));
+    }
+}
+
+/* Destructor: ~ThreadPool
+ * --------------------------------------------------------
+ * Workers only exit once every queue is empty, so every queued task
+ * still runs before the threads are joined.
+ */
+ThreadPool::~ThreadPool() {
+    synchronized (lock) {
+        stopping = true;
+        lock.signal();
+    }
+    for (int i = 0; i < threads.size(); i++) {
+        join(threads[i]);
+    }
+    for (int i = 0; i < queues.size(); i++) {
+        delete queues[i];
+    }
+}
+
+/* Member function: submit
+ * --------------------------------------------------------
+ * Puts the task on the calling worker's queue, or on the next queue in
+ * turn when called from outside the pool, then wakes the idle workers.
+ */
+void ThreadPool::submit(ThreadPoolTask* task) {
+    WorkerQueue* queue = (WorkerQueue*) pthread_getspecific(workerKey);
+    int found = -1;
+    for (int i = 0; queue != NULL && i < queues.size() && found < 0; i++) {
+        if (queues[i] == queue) found = i;
+    }
+    if (found < 0) {
+        // a worker of some other pool counts as outside this one
+        synchronized (lock) {
+            queue = queues[nextQueue];
+            nextQueue = (nextQueue + 1) % queues.size();
+        }
+    }
+    synchronized (queue->lock) {
+        queue->tasks.enqueue(task);
+    }
+    synchronized (lock) {
+        numQueued++;
+        numUnfinished++;
+        lock.signal();
+    }
+}
+
+/* Member function: waitForAll
+ * --------------------------------------------------------
+ * Sleeps until the count of unfinished tasks drops to zero.  The
+ * error, if any, is reported after the lock has been released.
+ */
+void ThreadPool::waitForAll() {
+    std::string message;
+    synchronized (lock) {
+        while (numUnfinished > 0) {
+            lock.wait();
+        }
+        message = firstError;
+        firstError = "";
+    }
+    if (!message.empty()) error(message);
+}
+
+/* Member function: numSteals
+ * --------------------------------------------------------
+ * Reads the count under the lock.
+ */
+long ThreadPool::numSteals() {
+    long result;
+    synchronized (lock) {
+        result = steals;
+    }
+    return result;
+}
+
+/* Member function: takeTask
+ * Usage: ThreadPoolTask* task = takeTask(worker);
+ * --------------------------------------------------------
+ * Takes the oldest task from the worker's own queue or, failing that,
+ * from the other queues in turn, starting with the next worker's.
+ * Returns NULL if every queue is empty.
+ */
+ThreadPoolTask* ThreadPool::takeTask(int worker) {
+    ThreadPoolTask* task = NULL;
+    bool stolen = false;
+    for (int i = 0; task == NULL && i < queues.size(); i++) {
+        WorkerQueue* queue = queues[(worker + i) % queues.size()];
+        synchronized (queue->lock) {
+            if (!queue->tasks.isEmpty()) task = queue->tasks.dequeue();
+        }
+        stolen = (i > 0);
+    }
+    if (task != NULL) {
+        synchronized (lock) {
+            numQueued--;
+            if (stolen) steals++;
+        }
+    }
+    return task;
+}
+
+/* Function: runWorker
+ * --------------------------------------------------------
+ * The body of each worker thread: pick a queue of its own, then take a
+ * task, run it outside every lock, record its outcome and repeat,
+ * sleeping whenever all the queues are empty.  Returns once the pool
+ * is stopping and no tasks remain.  While tracing, the time spent
+ * waiting for a task is recorded as "idle".
+ */
+void ThreadPool::runWorker(ThreadPool& pool) {
+    TRACE_THREAD_NAME("pool worker");
+    int worker = 0;
+    synchronized (pool.lock) {
+        worker = pool.numStarted++;
+    }
+    pthread_setspecific(workerKey, pool.queues[worker]);
+
+    while (true) {
+        ThreadPoolTask* task = pool.takeTask(worker);
+        if (task == NULL) {
+            double idleStart = TRACE_ACTIVE() ? currentTime() : 0;
+            bool stop = false;
+            synchronized (pool.lock) {
+                while (pool.numQueued == 0 && !pool.stopping) {
+                    pool.lock.wait();
+                }
+                stop = (pool.numQueued == 0);
+            }
+            if (idleStart > 0) TRACE_EVENT("idle", idleStart, currentTime());
+            if (stop) break;
+            continue;
+        }
+
+        // anything a task throws fails only that task, never the thread
+        std::string message;
+        try {
+            task->run();
+        } catch (ErrorException& ex) {
+            message = ex.getMessage();
+        } catch (std::exception& ex) {
+            message = ex.what();
+        } catch (...) {
+            message = "Task failed with an unknown exception.";
+        }
+
+        synchronized (pool.lock) {
+            if (!message.empty() && pool.firstError.empty()) pool.firstError = message;
+            pool.numUnfinished--;
+            pool.lock.signal();
+        }
+    }
+    pthread_setspecific(workerKey, NULL);
+}
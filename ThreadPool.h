@@ -0,0 +1,133 @@
+/*******************************************************
+ * File: ThreadPool.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A fixed-size pool of worker threads, built on the Thread and Lock
+ * abstractions from thread.h, that runs independent tasks such as
+ * compressing separate blocks of a file.
+ *
+ * Each worker keeps its own queue of tasks.  Tasks submitted from
+ * outside the pool are dealt out to the workers in turn, while a task
+ * submitted by a task goes to the queue of the worker running it.  A
+ * worker runs the tasks on its own queue oldest first and, once its
+ * queue is empty, steals the oldest task from another worker's, so that
+ * one worker stuck on a long task does not leave the tasks behind it
+ * waiting while the others sit idle.  Taking the oldest tasks first
+ * keeps them finishing in roughly the order they were submitted, which
+ * is the order callers writing results in sequence wait for them.
+ */
+
+#ifndef ThreadPool_Included
+#define ThreadPool_Included
+
+#include "thread.h"
+#include "queue.h"
+#include "vector.h"
+#include <string>
+
+/* Class: ThreadPoolTask
+ * --------------------------------------------------------
+ * A unit of work for the pool.  Subclasses override run() and keep
+ * whatever input and output they need as data members.
+ */
+class ThreadPoolTask {
+public:
+    virtual ~ThreadPoolTask() {}
+
+    /* Member function: run
+     * Usage: task->run();
+     * --------------------------------------------------------
+     * Does the work.  Called exactly once, on one of the pool's threads.
+     * Errors may be reported through error() as usual; any other
+     * exception, such as bad_alloc, is caught and reported the same way.
+     */
+    virtual void run() = 0;
+};
+
+/* Function: defaultThreadCount
+ * Usage: int numThreads = defaultThreadCount();
+ * --------------------------------------------------------
+ * Returns the number of processors available, or 1 if that cannot
+ * be determined.
+ */
+int defaultThreadCount();
+
+/* Class: ThreadPool
+ * --------------------------------------------------------
+ * Runs submitted tasks on a fixed number of worker threads, in no
+ * particular order.  The pool does not take ownership of the tasks;
+ * they must stay alive until waitForAll() returns.  The pool never
+ * touches a task once its run() has returned, so a task may also delete
+ * itself as the last thing run() does.
+ */
+class ThreadPool {
+public:
+    /* Constructor: ThreadPool
+     * Usage: ThreadPool pool(numThreads);
+     * --------------------------------------------------------
+     * Starts numThreads worker threads (at least one).
+     */
+    ThreadPool(int numThreads);
+
+    /* Destructor: ~ThreadPool
+     * --------------------------------------------------------
+     * Finishes any tasks still queued, then stops the worker threads.
+     */
+    ~ThreadPool();
+
+    /* Member function: submit
+     * Usage: pool.submit(task);
+     * --------------------------------------------------------
+     * Queues a task to be run by one of the workers.  May be called
+     * from a task running on the pool.
+     */
+    void submit(ThreadPoolTask* task);
+
+    /* Member function: waitForAll
+     * Usage: pool.waitForAll();
+     * --------------------------------------------------------
+     * Waits until every task submitted so far has finished.  If any of
+     * them reported an error, the first such error is reported again
+     * here, on the calling thread.  Must not be called from a task.
+     */
+    void waitForAll();
+
+    /* Member function: numSteals
+     * Usage: long steals = pool.numSteals();
+     * --------------------------------------------------------
+     * Returns how many tasks so far were run by a worker other than
+     * the one they were queued for.
+     */
+    long numSteals();
+
+private:
+    /* Type: WorkerQueue
+     * One worker's tasks, with the lock that guards them.
+     */
+    struct WorkerQueue {
+        Lock lock;
+        Queue<ThreadPoolTask*> tasks;
+    };
+
+    Lock lock;                     // guards everything below but the queues
+    Vector<WorkerQueue*> queues;   // one per worker
+    Vector<Thread> threads;
+    int numQueued;                 // tasks sitting in the queues
+    int numUnfinished;             // tasks submitted but not yet finished
+    int numStarted;                // workers that have picked their queue
+    int nextQueue;                 // where the next outside task goes
+    long steals;
+    bool stopping;                 // set once the destructor runs
+    std::string firstError;        // message of the first failed task, if any
+
+    ThreadPoolTask* takeTask(int worker);
+    static void runWorker(ThreadPool& pool);
+
+    /* The pool owns running threads, so it must not be copied. */
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
@@ -0,0 +1,42 @@
+/**********************************************************
+ * File: Timing.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the timer from Timing.h.
+ */
+
+#include "Timing.h"
+#include <time.h>
+
+#if defined(__APPLE__) && !defined(CLOCK_MONOTONIC)
+#include <mach/mach_time.h>
+
+/* Function: currentTime
+ * Usage: double start = currentTime();
+ * --------------------------------------------------------
+ * Mac OS X before 10.12 has no clock_gettime, so this uses
+ * mach_absolute_time, converting its ticks to seconds.
+ */
+double currentTime() {
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return double(mach_absolute_time()) * timebase.numer / timebase.denom / 1e9;
+}
+
+#else
+
+/* Function: currentTime
+ * Usage: double start = currentTime();
+ * --------------------------------------------------------
+ * Uses clock_gettime with CLOCK_MONOTONIC, which is available on Linux
+ * and on Mac OS X from 10.12.
+ */
+double currentTime() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*******************************************************
+ * File: Timing.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A monotonic timer for measuring how long compression takes, used to
+ * stay within time budgets and to report throughput.  Unlike the time
+ * of day, it never jumps when the clock is set, so a measurement is not
+ * thrown off by NTP or by an administrator changing the time.
+ */
+
+#ifndef Timing_Included
+#define Timing_Included
+
+/* Function: currentTime
+ * Usage: double start = currentTime();
+ * --------------------------------------------------------
+ * Returns the time in seconds since some fixed point, with nanosecond
+ * resolution where the system has it.  Only differences between two
+ * calls are meaningful.
+ */
+double currentTime();
+
+#endif
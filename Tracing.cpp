@@ -0,0 +1,269 @@
+/**********************************************************
+ * File: Tracing.cpp
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * Implementation of the timeline tracing from Tracing.h.
+ *
+ * Each thread finds its buffer through a pthread key, so recording an
+ * event touches nothing shared but the on/off flag and the generation
+ * number.  Starting a new trace bumps the generation instead of clearing
+ * the buffers, since other threads may be writing to them; each thread
+ * clears its own buffer when it notices the change, and buffers from an
+ * older generation are left out of the output.  Buffers are kept until
+ * the program ends, so that the events of threads that have already
+ * finished can still be written out.
+ */
+
+#include "Tracing.h"
+#include "Timing.h"
+#include "thread.h"
+#include <pthread.h>
+#include <cstddef>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+/* Type: TraceRecord
+ * One recorded event.
+ */
+struct TraceRecord {
+    const char* name;
+    double start;
+    double end;
+};
+
+/* Type: ThreadTrace
+ * The ring buffer of one thread.  Event i of the trace is kept in
+ *   records[i % records.size()], so once written passes the size only
+ *   the most recent events remain.
+ */
+struct ThreadTrace {
+    int id;
+    std::string name;
+    long generation;
+    std::vector<TraceRecord> records;
+    long long written;
+};
+
+/* Variables: tracing, generation, eventsPerThread, origin
+ * Whether events are being recorded, which trace they belong to, how
+ *   many each thread keeps, and the time the trace started.
+ */
+static volatile bool tracing = false;
+static volatile long generation = 0;
+static int eventsPerThread = DEFAULT_TRACE_EVENTS;
+static double origin = 0;
+
+/* Variables: threadTraces, traceKey, traceKeyOnce
+ * Every buffer made so far, and the key that finds the calling thread's.
+ */
+static std::vector<ThreadTrace*> threadTraces;
+static pthread_key_t traceKey;
+static pthread_once_t traceKeyOnce = PTHREAD_ONCE_INIT;
+
+/* Function: traceLock
+ * Usage: synchronized (traceLock()) ...
+ * --------------------------------------------------------
+ * Returns the lock guarding threadTraces, made the first time it is
+ * needed.
+ */
+static Lock& traceLock() {
+    static Lock lock;
+    return lock;
+}
+
+/* Function: createTraceKey
+ * Usage: pthread_once(&traceKeyOnce, createTraceKey);
+ * --------------------------------------------------------
+ * Makes the key, exactly once.  Buffers outlive their threads, so the
+ * key has no destructor.
+ */
+static void createTraceKey() {
+    pthread_key_create(&traceKey, NULL);
+}
+
+/* Function: findThreadTrace
+ * Usage: ThreadTrace* trace = findThreadTrace();
+ * --------------------------------------------------------
+ * Returns the calling thread's buffer, making and registering it the
+ * first time.  A new buffer has no room for events yet.
+ */
+static ThreadTrace* findThreadTrace() {
+    pthread_once(&traceKeyOnce, createTraceKey);
+    ThreadTrace* trace = (ThreadTrace*) pthread_getspecific(traceKey);
+    if (trace == NULL) {
+        trace = new ThreadTrace;
+        trace->generation = -1;
+        trace->written = 0;
+        synchronized (traceLock()) {
+            threadTraces.push_back(trace);
+            trace->id = int(threadTraces.size());
+        }
+        std::ostringstream name;
+        name << "thread " << trace->id;
+        trace->name = name.str();
+        pthread_setspecific(traceKey, trace);
+    }
+    return trace;
+}
+
+/* Function: currentThreadTrace
+ * Usage: ThreadTrace* trace = currentThreadTrace();
+ * --------------------------------------------------------
+ * Returns the calling thread's buffer, emptied and sized for the current
+ * trace if it still holds an older one.
+ */
+static ThreadTrace* currentThreadTrace() {
+    ThreadTrace* trace = findThreadTrace();
+    if (trace->generation != generation) {
+        trace->generation = generation;
+        trace->records.assign(eventsPerThread, TraceRecord());
+        trace->written = 0;
+    }
+    return trace;
+}
+
+/* Functions: startTracing, stopTracing, isTracing
+ * --------------------------------------------------------
+ * Starting moves on to a new generation, so that every buffer is
+ * emptied before it is next used.
+ */
+void startTracing(int eventsPerThread) {
+    tracing = false;
+    ::eventsPerThread = (eventsPerThread < 1) ? 1 : eventsPerThread;
+    origin = currentTime();
+    generation++;
+    tracing = true;
+}
+
+void stopTracing() {
+    tracing = false;
+}
+
+bool isTracing() {
+    return tracing;
+}
+
+/* Function: setTraceThreadName
+ * Usage: setTraceThreadName("writer");
+ * --------------------------------------------------------
+ * The name is kept with the buffer, so threads can be named before
+ * tracing starts and keep their names from one trace to the next.
+ */
+void setTraceThreadName(const std::string& name) {
+    findThreadTrace()->name = name;
+}
+
+/* Function: traceEvent
+ * Usage: traceEvent("encode", start, end);
+ * --------------------------------------------------------
+ * Writes the event over the oldest slot once the buffer is full.
+ */
+void traceEvent(const char* name, double start, double end) {
+    if (!tracing) return;
+    ThreadTrace* trace = currentThreadTrace();
+    TraceRecord& record = trace->records[trace->written % trace->records.size()];
+    record.name = name;
+    record.start = start;
+    record.end = end;
+    trace->written++;
+}
+
+/* Function: droppedTraceEvents
+ * Usage: long long dropped = droppedTraceEvents();
+ * --------------------------------------------------------
+ * Adds up how far each current buffer has wrapped around.
+ */
+long long droppedTraceEvents() {
+    long long dropped = 0;
+    synchronized (traceLock()) {
+        for (int i = 0; i < int(threadTraces.size()); i++) {
+            ThreadTrace* trace = threadTraces[i];
+            if (trace->generation != generation) continue;
+            long long kept = trace->records.size();
+            if (trace->written > kept) dropped += trace->written - kept;
+        }
+    }
+    return dropped;
+}
+
+/* Function: jsonText
+ * Usage: outfile << '"' << jsonText(name) << '"';
+ * --------------------------------------------------------
+ * Escapes quotes, backslashes and control characters for JSON.
+ */
+static std::string jsonText(const std::string& text) {
+    std::ostringstream escaped;
+    for (int i = 0; i < int(text.length()); i++) {
+        unsigned char ch = text[i];
+        if (ch == '"' || ch == '\\') {
+            escaped << '\\' << ch;
+        } else if (ch < 0x20) {
+            escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(ch)
+                    << std::dec << std::setfill(' ');
+        } else {
+            escaped << ch;
+        }
+    }
+    return escaped.str();
+}
+
+/* Function: writeTraceJSON
+ * Usage: writeTraceJSON(outfile);
+ * --------------------------------------------------------
+ * Writes a metadata event naming each thread, then each thread's events
+ * from oldest to newest as complete ("X") events, with times in
+ * microseconds since the trace started.
+ */
+void writeTraceJSON(std::ostream& outfile) {
+    std::vector<ThreadTrace*> traces;
+    synchronized (traceLock()) {
+        for (int i = 0; i < int(threadTraces.size()); i++) {
+            if (threadTraces[i]->generation == generation) traces.push_back(threadTraces[i]);
+        }
+    }
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\"traceEvents\": [" << std::endl;
+    bool first = true;
+    for (int i = 0; i < int(traces.size()); i++) {
+        ThreadTrace* trace = traces[i];
+        json << (first ? "" : ",\n") << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+             << "\"tid\": " << trace->id << ", \"args\": {\"name\": \""
+             << jsonText(trace->name) << "\"}}";
+        first = false;
+
+        long long size = trace->records.size();
+        long long oldest = (trace->written > size) ? trace->written - size : 0;
+        for (long long j = oldest; j < trace->written; j++) {
+            const TraceRecord& record = trace->records[j % size];
+            json << ",\n  {\"name\": \"" << jsonText(record.name) << "\", \"cat\": \"huffman\", "
+                 << "\"ph\": \"X\", \"pid\": 1, \"tid\": " << trace->id
+                 << ", \"ts\": " << (record.start - origin) * 1e6
+                 << ", \"dur\": " << (record.end - record.start) * 1e6 << "}";
+        }
+    }
+    json << std::endl << "], \"displayTimeUnit\": \"ms\", "
+         << "\"otherData\": {\"droppedEvents\": " << droppedTraceEvents() << "}}" << std::endl;
+    outfile << json.str();
+}
+
+/* Constructor: TraceScope
+ * --------------------------------------------------------
+ * Only reads the clock if tracing is on.
+ */
+TraceScope::TraceScope(const char* name) {
+    this->name = name;
+    start = tracing ? currentTime() : -1;
+}
+
+/* Destructor: ~TraceScope
+ * --------------------------------------------------------
+ * Records the event, unless tracing was off when the scope began.
+ */
+TraceScope::~TraceScope() {
+    if (start >= 0) traceEvent(name, start, currentTime());
+}
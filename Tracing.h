@@ -0,0 +1,122 @@
+/*******************************************************
+ * File: Tracing.h
+ *
+ * Eric Beach
+ * Assignment 6 (Extension)
+ *
+ * A lightweight timeline of what each thread was doing, for finding
+ * where the reader, the worker threads and the writer wait on one
+ * another.  Code marks the stages it goes through with TRACE_SCOPE, and
+ * while tracing is on each thread records when every marked stage began
+ * and ended.  The timeline is written as Chrome trace-event JSON, which
+ * Perfetto (ui.perfetto.dev) and chrome://tracing can open.
+ *
+ * Each thread records into a ring buffer of its own, so recording takes
+ * no lock; once the buffer is full, the oldest events are overwritten.
+ * While tracing is off, each marked stage costs one test of a flag, and
+ * defining HUFFMAN_NO_TRACING when compiling removes the marks entirely.
+ */
+
+#ifndef Tracing_Included
+#define Tracing_Included
+
+#include <iostream>
+#include <string>
+
+/* Constant: DEFAULT_TRACE_EVENTS
+ * How many events each thread keeps unless startTracing is told
+ *   otherwise.
+ */
+const int DEFAULT_TRACE_EVENTS = 65536;
+
+/* Functions: startTracing, stopTracing, isTracing
+ * Usage: startTracing();
+ *        ...
+ *        stopTracing();
+ * --------------------------------------------------------
+ * Throw away any events recorded so far and start recording, keeping up
+ * to eventsPerThread events per thread; stop recording; and tell whether
+ * events are being recorded.
+ */
+void startTracing(int eventsPerThread = DEFAULT_TRACE_EVENTS);
+void stopTracing();
+bool isTracing();
+
+/* Function: setTraceThreadName
+ * Usage: setTraceThreadName("writer");
+ * --------------------------------------------------------
+ * Names the calling thread in the timeline, whether or not tracing is
+ * on.  Threads that are never named appear as "thread" followed by a
+ * number.
+ */
+void setTraceThreadName(const std::string& name);
+
+/* Function: traceEvent
+ * Usage: traceEvent("encode", start, currentTime());
+ * --------------------------------------------------------
+ * Records that the calling thread spent the time from start to end, as
+ * given by currentTime, in the named stage.  The name must be a string
+ * literal or otherwise outlive the trace.  Does nothing while tracing is
+ * off.
+ */
+void traceEvent(const char* name, double start, double end);
+
+/* Function: droppedTraceEvents
+ * Usage: long long dropped = droppedTraceEvents();
+ * --------------------------------------------------------
+ * Returns how many events have been overwritten because a thread's ring
+ * buffer was full.
+ */
+long long droppedTraceEvents();
+
+/* Function: writeTraceJSON
+ * Usage: writeTraceJSON(outfile);
+ * --------------------------------------------------------
+ * Writes the events recorded since tracing was last started, as a Chrome
+ * trace-event JSON object.  Should only be called once the traced work
+ * has finished, since other threads' buffers are read without locking.
+ */
+void writeTraceJSON(std::ostream& outfile);
+
+/* Class: TraceScope
+ * --------------------------------------------------------
+ * Records the time from its construction to its destruction as one
+ * event.  Use it through TRACE_SCOPE.
+ */
+class TraceScope {
+public:
+    TraceScope(const char* name);
+    ~TraceScope();
+
+private:
+    const char* name;
+    double start;   // negative if tracing was off at construction
+};
+
+/* Macros: TRACE_SCOPE, TRACE_EVENT, TRACE_THREAD_NAME, TRACE_ACTIVE
+ * Usage: TRACE_SCOPE("encode");
+ *        TRACE_EVENT("encode", start, end);
+ *        TRACE_THREAD_NAME("writer");
+ *        if (TRACE_ACTIVE()) ...
+ * --------------------------------------------------------
+ * The marks code should use: record the rest of the enclosing block as
+ * an event, record an event whose times are already known, name the
+ * calling thread, and tell whether tracing is on.  With
+ * HUFFMAN_NO_TRACING defined they compile to nothing, and TRACE_ACTIVE
+ * to false.
+ */
+#ifndef HUFFMAN_NO_TRACING
+#define TRACE_CONCAT_LINE(prefix, line) prefix##line
+#define TRACE_SCOPE_NAME(line) TRACE_CONCAT_LINE(traceScope, line)
+#define TRACE_SCOPE(name) TraceScope TRACE_SCOPE_NAME(__LINE__)(name)
+#define TRACE_EVENT(name, start, end) traceEvent(name, start, end)
+#define TRACE_THREAD_NAME(name) setTraceThreadName(name)
+#define TRACE_ACTIVE() isTracing()
+#else
+#define TRACE_SCOPE(name) ((void) 0)
+#define TRACE_EVENT(name, start, end) ((void) 0)
+#define TRACE_THREAD_NAME(name) ((void) 0)
+#define TRACE_ACTIVE() false
+#endif
+
+#endif